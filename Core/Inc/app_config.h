@@ -7,6 +7,9 @@
  * 2 = USART2 (PA2/PA3) 调试模式
  * 3 = USART2 (PA2/PA3) 简单测试
  * 4 = USART1 (PA9/PA10) 回环测试 - 使用huart1
+ * 5 = Modbus网关模式：USART1 为上游（本站 0x01），其余目标地址直通转发到 USART2 总线
+ * 6 = ModbusInstance_t 协议栈（modbus_slave.c + app_modbus_new.c）：USART1 0x01、USART2 0x02，
+ *     寄存器按 app_modbus_regmap.h 分发；只支持 0x03/0x06/0x10/0x16/0x17/0x08/0x0B
  * 
  * 注意：
  * - USART1对应代码中的huart1，引脚为PA9/PA10
@@ -17,6 +20,12 @@
 #define RUN_MODE_ECHO_TEST 4
 #endif
 
+/* 两个 USART 都跑 Modbus 协议栈的模式（双从站/网关） */
+#define RUN_MODE_MODBUS   (RUN_MODE_ECHO_TEST == 0 || RUN_MODE_ECHO_TEST == 5)
+#define RUN_MODE_GATEWAY  (RUN_MODE_ECHO_TEST == 5)
+/* 两个 USART 跑 ModbusInstance_t 协议栈（Modbus_Poll）的模式 */
+#define RUN_MODE_INSTANCE (RUN_MODE_ECHO_TEST == 6)
+
 #endif /* APP_CONFIG_H */
 
 
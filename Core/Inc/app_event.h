@@ -0,0 +1,72 @@
+/**
+ * @file app_event.h
+ * @brief 主循环事件标志与休眠调度
+ * @details
+ * 中断（USART IDLE、发送完成、错误）只置位对应通道的待处理标志，
+ * 主循环在 WFI 中休眠，直到有标志置位才醒来处理，取代 HAL_Delay(1) 轮询。
+ * 同时用 DWT 周期计数器统计唤醒次数与休眠时间，评估 CPU 余量。
+ *
+ * @note 休眠采用 PRIMASK 屏蔽下检查标志再 WFI 的方式：
+ *       检查与休眠之间到来的中断会挂起并立即唤醒 WFI，不会丢事件。
+ */
+
+#ifndef APP_EVENT_H
+#define APP_EVENT_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+//=============================================================================
+// 1. 事件位定义 (Event Bits)
+//=============================================================================
+
+#define APP_EVT_MB_USART1   (1UL << 0)  /**< USART1 Modbus：收到帧/发送完成/错误 */
+#define APP_EVT_MB_USART2   (1UL << 1)  /**< USART2 Modbus：收到帧/发送完成/错误 */
+#define APP_EVT_SECOND      (1UL << 2)  /**< SysTick 每秒一次：刷新统计等周期任务 */
+#define APP_EVT_GATEWAY     (1UL << 3)  /**< 网关：上游新字节/续传/超时检查（网关模式） */
+#define APP_EVT_CAPTURE     (1UL << 4)  /**< 抓包：USART3 一段送完，继续送抓包环（MODBUS_CAPTURE_ENABLE） */
+#define APP_EVT_RELAY       (1UL << 5)  /**< 继电器定时到期动作：刷新线圈/状态寄存器 */
+
+/**
+ * @brief 主循环运行统计
+ */
+typedef struct
+{
+    uint32_t wakeups;           /**< WFI 唤醒次数（含 SysTick 等无事件唤醒） */
+    uint32_t dispatches;        /**< 取到事件并返回给主循环的次数 */
+    uint32_t idleCycles;        /**< WFI 中休眠的 CPU 周期数 */
+    uint32_t windowCycles;      /**< 统计窗口总周期数 */
+} AppEventStats_t;
+
+//=============================================================================
+// 2. 接口函数 (API)
+//=============================================================================
+
+/**
+ * @brief 初始化事件标志并启动 DWT 周期计数器
+ */
+void appEventInit(void);
+
+/**
+ * @brief 置位事件（中断或主循环中均可调用）
+ */
+void appEventSet(uint32_t events);
+
+/**
+ * @brief 休眠直到有事件，返回并清除全部已置位的事件
+ */
+uint32_t appEventWait(void);
+
+/**
+ * @brief 读取统计
+ * @param stats 输出
+ * @param reset 非 0 时读取后开启新的统计窗口
+ */
+void appEventGetStats(AppEventStats_t *stats, uint8_t reset);
+
+/**
+ * @brief 统计窗口内的空闲千分比（0~1000）
+ */
+uint16_t appEventIdlePermille(const AppEventStats_t *stats);
+
+#endif /* APP_EVENT_H */
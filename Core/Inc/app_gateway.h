@@ -0,0 +1,70 @@
+/**
+ * @file app_gateway.h
+ * @brief Modbus RTU 直通网关（USART1 上游 ↔ USART2 下游）
+ * @details
+ * RUN_MODE_ECHO_TEST == 5 时启用。USART1 仍作为本站（0x01）应答，
+ * 目标地址落在路由表中的请求转发到 USART2 总线，下游应答原样送回上游。
+ *
+ * 直通（cut-through）：上游波特率不低于下游时，收到能确定帧长的报头
+ * （地址 + 功能码 + 字节数）后就开始向下游发送，剩余字节随到随发，
+ * 不等整帧收完；CRC 原样透传，上游帧最终校验失败时下游从站自行丢弃。
+ * 上游较慢时退回存储转发，避免下游帧内出现超过 t1.5 的间隙。
+ * 起转与续传由上游逐字节中断（RXNEIE 只作唤醒，数据仍走 DMA）驱动；
+ * 下游发完已到字节而上游还没跟上时保持 DE 等待，间隙达到下游 t1.5
+ * 即中止本次直通，待整帧收齐后按存储转发重发。
+ *
+ * 广播（地址 0）本站照常执行，同时转发到下游，发完即结束、不等应答。
+ * 每个路由段有独立的应答超时，超时回 0x0B（目标无响应）；
+ * 网关正忙于上一笔事务时，新的转发请求回 0x0A（路径不可用，广播不回）。
+ *
+ * 请求/应答延时直方图与计数发布在 USART1 的输入寄存器 70-87，
+ * 布局见 Core/Doc/ModbusRegisterMap.md。
+ */
+
+#ifndef APP_GATEWAY_H
+#define APP_GATEWAY_H
+
+#include <stdint.h>
+#include "../../MDK-ARM/modbus_rtu_slave.h"
+
+//=============================================================================
+// 1. 统计寄存器布局 (Input Register Layout)
+//=============================================================================
+
+#define GW_IREG_REQ_HIST        70U     /**< 70-75 请求转发延时直方图（上游收完 → 下游发完） */
+#define GW_IREG_RESP_HIST       76U     /**< 76-81 应答延时直方图（下游发完 → 收到应答） */
+#define GW_HIST_BUCKETS         6U
+#define GW_IREG_FORWARDED       82U     /**< 已转发请求数 */
+#define GW_IREG_RESPONSES       83U     /**< 已送回应答数 */
+#define GW_IREG_TIMEOUTS        84U     /**< 应答超时数（回 0x0B） */
+#define GW_IREG_DROPPED         85U     /**< 上游 CRC 错/帧长与报头不符而作废的请求数 */
+#define GW_IREG_UNDERRUNS       86U     /**< 直通续传时上游断流达到下游 t1.5、中止直通的次数 */
+#define GW_IREG_BUSY            87U     /**< 网关忙拒绝数（回 0x0A） */
+
+//=============================================================================
+// 2. 接口函数 (API)
+//=============================================================================
+
+/**
+ * @brief 绑定上下游实例（两者须已 ModbusRTU_Init）
+ * @note 下游实例的本站地址被置为 0（只收广播），使下游总线上的帧全部走转发回调
+ */
+void gatewayInit(ModbusRTU_Slave *upstream, ModbusRTU_Slave *downstream);
+
+/**
+ * @brief 主循环每次唤醒时调用：事务收尾、挂起续传的补查、超时
+ */
+void gatewayProcess(void);
+
+/**
+ * @brief 上游 USART 中断入口、HAL 之前调用：检测直通报头并起转，或续传挂起的下游发送
+ */
+void gatewayRxProgressISR(void);
+
+/**
+ * @brief SysTick 中调用：有事务进行时唤醒主循环检查超时（1ms 粒度），
+ *        并补开被 HAL 结束接收时清掉的逐字节中断
+ */
+void gatewayTickISR(void);
+
+#endif /* APP_GATEWAY_H */
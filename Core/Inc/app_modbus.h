@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "stm32f1xx_hal.h"
+#include "modbus_crc.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -0,0 +1,27 @@
+/**
+ * @file app_modbus_new.h
+ * @brief ModbusInstance_t 协议栈的应用层接口（运行模式 6，见 app_config.h）
+ * @details
+ * 寄存器映射由 app_modbus_regmap.h 声明，App_RegisterCallback 按映射表分发读写；
+ * 两个实例由 main.c 定义并调用 Modbus_Init 绑定硬件，再交给 App_Modbus_Init 注册回调、启动接收。
+ */
+
+#ifndef APP_MODBUS_NEW_H
+#define APP_MODBUS_NEW_H
+
+#include "modbus_slave.h"
+
+/**
+ * @brief 协议栈回调：按寄存器映射表完成 0x03/0x06/0x10/0x16 的数据读写
+ * @return MODBUS_OK 或 Modbus 异常码
+ */
+int App_RegisterCallback(uint8_t u8FuncCode, uint16_t u16Addr, uint16_t u16Count, uint16_t* pData);
+
+/**
+ * @brief 清空寄存器存储区，为两个实例注册回调并启动第一次 DMA 接收
+ * @param pInstance1 USART1 实例（已 Modbus_Init）
+ * @param pInstance2 USART2 实例（已 Modbus_Init）
+ */
+void App_Modbus_Init(ModbusInstance_t *pInstance1, ModbusInstance_t *pInstance2);
+
+#endif /* APP_MODBUS_NEW_H */
@@ -0,0 +1,44 @@
+/**
+ * @file app_modbus_regmap.h
+ * @brief 应用层 Modbus 保持寄存器映射（唯一声明处）
+ * @details
+ * 寄存器映射只在 APP_MODBUS_REGMAP 中声明一次（X-macro），两处展开：
+ * 1. app_modbus_new.c 展开为 static const 描述符表，协议回调按表分发；
+ * 2. Tools/host/regmap_dump.c 展开为主机端映射文件 Tools/modbus_regmap.json，
+ *    供上位机工具使用（make -C Tools/host regmap），并检查表项有序、不重叠。
+ *
+ * 每一项为一段连续地址：
+ * - get/set 为 NULL：普通存储，读写直接整段拷贝；
+ * - get/set 非 NULL：逐寄存器调用访问函数（如继电器实时状态）。
+ * scale/unit 为上位机换算用：工程值 = 原始值 / scale。
+ *
+ * @note 表项必须按起始地址升序排列且互不重叠（按二分查找分发）。
+ *       本头文件不依赖 HAL，可直接用于主机端工具。
+ */
+
+#ifndef APP_MODBUS_REGMAP_H
+#define APP_MODBUS_REGMAP_H
+
+#include <stdint.h>
+
+//=============================================================================
+// 1. 访问权限 (Access Rights)
+//=============================================================================
+
+#define APP_REG_RO      0x01U   /**< 只读 */
+#define APP_REG_WO      0x02U   /**< 只写 */
+#define APP_REG_RW      (APP_REG_RO | APP_REG_WO)
+
+//=============================================================================
+// 2. 寄存器映射表 (Register Map)
+//=============================================================================
+
+/**
+ * X(名称, 起始地址, 数量, 权限, 读函数, 写函数, scale, 单位, 说明)
+ */
+#define APP_MODBUS_REGMAP(X)                                                                        \
+    X(RELAY_CONTROL, 0, 1,  APP_REG_RW, appRegRelayGet, appRegRelaySet, 1, "bitmap", "继电器控制，bit0-4 对应继电器1-5") \
+    X(RELAY_STATUS,  1, 1,  APP_REG_RO, appRegRelayGet, NULL,           1, "bitmap", "继电器实际状态")                   \
+    X(SYSTEM,        2, 62, APP_REG_RW, NULL,           NULL,           1, "",       "系统扩展区域")
+
+#endif /* APP_MODBUS_REGMAP_H */
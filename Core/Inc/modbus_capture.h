@@ -0,0 +1,124 @@
+/**
+ * @file modbus_capture.h
+ * @brief RTU 线路抓包格式（.mbcap）与固件侧抓包环
+ * @details
+ * 抓包文件 = 文件头 + 若干记录，全部小端：
+ *   文件头  8 字节魔数 "MBCAP1\r\n"、波特率、采集节点角色（ModbusCaptureHdr_t）
+ *   记录    同步字节 0xA5、标志/通道、长度、首字节起始位时刻 us（32 位回绕），后跟 len 个原始字节
+ * 一条记录是线路上连续到达的一段字节（段内字节首尾相接，按字符时间排开），
+ * 段与段之间的空隙由时间戳给出：帧内间隙、t1.5/t3.5 违例、帧间静默都原样保留。
+ * 串口流可能从中间开始读：读者按同步字节与长度上限重新对齐，缺文件头时角色/波特率由命令行给出。
+ *
+ * 写入方：
+ *   - 主机工具：mb_load -c FILE（主站角色，F_TX = 主站发出的请求）；
+ *   - 固件：MODBUS_CAPTURE_ENABLE 为 1 时，帧处理路径把收到的每一帧（含发给别的从站的、CRC 错的）
+ *     和本站应答写入抓包环，主循环经 USART3（PB10，仅发送，MB_CAP_STREAM_BAUD）用 DMA 连续送出，
+ *     上电先送文件头，主机端 `stty raw; cat` 即得 .mbcap。t1.5 违例等结帧时就丢弃的帧不在其中。
+ * 读取方：Tools/host 的 mb_replay（在仿真固件上按原时序或加速回放并比对应答）。
+ *
+ * 本头文件的格式部分不依赖 HAL，可直接用于主机端工具。
+ */
+
+#ifndef MODBUS_CAPTURE_H
+#define MODBUS_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#ifndef MODBUS_CAPTURE_ENABLE
+#define MODBUS_CAPTURE_ENABLE   0
+#endif
+
+//=============================================================================
+// 1. 文件格式 (File Format)
+//=============================================================================
+
+#define MB_CAP_MAGIC            "MBCAP1\r\n"
+#define MB_CAP_MAGIC_LEN        8U
+#define MB_CAP_SYNC             0xA5U
+#define MB_CAP_REC_MAX          256U        /**< 单条记录最多字节数（一帧 RTU 上限） */
+
+/* 记录标志（高 4 位）与通道号（低 4 位：0 = USART1，1 = USART2；主机工具为 -p 的顺序） */
+#define MB_CAP_CHAN_MASK        0x0FU
+#define MB_CAP_F_TX             0x10U       /**< 采集节点自己发出的字节，否则为从线路上收到的 */
+#define MB_CAP_F_ERR            0x20U       /**< 本段有线路错误（FE/NE/PE/ORE） */
+
+#define MB_CAP_ROLE_SLAVE       0U          /**< 采集节点是从站（固件）：F_TX = 本站应答 */
+#define MB_CAP_ROLE_MASTER      1U          /**< 采集节点是主站（主机工具）：F_TX = 请求 */
+
+typedef struct
+{
+    uint8_t  magic[MB_CAP_MAGIC_LEN];
+    uint32_t baud;                  /**< 线路波特率（8N1，各通道相同） */
+    uint8_t  role;                  /**< MB_CAP_ROLE_xxx */
+    uint8_t  reserved[3];
+} ModbusCaptureHdr_t;
+
+typedef struct
+{
+    uint8_t  sync;                  /**< MB_CAP_SYNC */
+    uint8_t  flags;                 /**< MB_CAP_F_xxx | 通道 */
+    uint16_t len;                   /**< 后跟字节数，1..MB_CAP_REC_MAX */
+    uint32_t tUs;                   /**< 首字节起始位时刻，us，32 位回绕（约 71 分钟） */
+} ModbusCaptureRec_t;
+
+//=============================================================================
+// 2. 固件抓包环 (Firmware Capture Ring)
+//=============================================================================
+
+#define MB_CAP_RING_SIZE        2048U       /**< 抓包环字节数（2 的幂），满时整条记录丢弃 */
+#define MB_CAP_STREAM_BAUD      921600U     /**< USART3 输出波特率，应不低于被抓线路之和的约 1.5 倍 */
+
+#if MODBUS_CAPTURE_ENABLE
+
+/**
+ * @brief 清空抓包环并写入文件头
+ */
+void ModbusCapture_Init(uint32_t baud);
+
+/**
+ * @brief 记录收到的一帧（主循环调用）
+ * @param idleCyc 帧后 IDLE 中断的 DWT 周期计数（最后一字节之后一个字符时间），用于反推首字节时刻
+ * @param err     非 0 时置 MB_CAP_F_ERR
+ */
+void ModbusCapture_Rx(uint8_t chan, const uint8_t *data, uint16_t len, uint32_t idleCyc, uint32_t baud, uint8_t err);
+
+/**
+ * @brief 记录本站开始发送的一帧（主循环或 TIM2 中断调用）
+ */
+void ModbusCapture_Tx(uint8_t chan, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief 取抓包环中连续可读的一段（不越过环尾），返回字节数
+ */
+uint16_t ModbusCapture_Peek(const uint8_t **data);
+
+/**
+ * @brief 释放已送出的 n 个字节
+ */
+void ModbusCapture_Consume(uint16_t n);
+
+/**
+ * @brief 因环满丢弃的记录数
+ */
+uint32_t ModbusCapture_Dropped(void);
+
+#else
+
+static inline void ModbusCapture_Init(uint32_t baud) { (void)baud; }
+static inline void ModbusCapture_Rx(uint8_t chan, const uint8_t *data, uint16_t len, uint32_t idleCyc, uint32_t baud, uint8_t err) { (void)chan; (void)data; (void)len; (void)idleCyc; (void)baud; (void)err; }
+static inline void ModbusCapture_Tx(uint8_t chan, const uint8_t *data, uint16_t len) { (void)chan; (void)data; (void)len; }
+static inline uint16_t ModbusCapture_Peek(const uint8_t **data) { (void)data; return 0; }
+static inline void ModbusCapture_Consume(uint16_t n) { (void)n; }
+static inline uint32_t ModbusCapture_Dropped(void) { return 0; }
+
+#endif /* MODBUS_CAPTURE_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODBUS_CAPTURE_H */
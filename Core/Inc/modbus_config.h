@@ -52,6 +52,30 @@
  */
 #define MODBUS_SUPPORT_FC10 1
 
+/**
+ * @brief 是否支持功能码 0x16 (Mask Write Register)
+ * @note 回调以功能码 0x16 调用，pData[0] = AND 掩码，pData[1] = OR 掩码，
+ *       由应用层在一次回调内完成读改写。
+ */
+#define MODBUS_SUPPORT_FC16 1
+
+/**
+ * @brief 是否支持功能码 0x17 (Read/Write Multiple Registers)
+ * @note 先以 0x10 回调写入，再以 0x03 回调读取，一帧完成。
+ */
+#define MODBUS_SUPPORT_FC17 1
+
+/**
+ * @brief 是否支持功能码 0x08 (Diagnostics)
+ * @note 子功能与计数定义见 modbus_diag.h，计数保存在实例的 stDiag 中，不经过应用回调。
+ */
+#define MODBUS_SUPPORT_FC08 1
+
+/**
+ * @brief 是否支持功能码 0x0B (Get Comm Event Counter)
+ */
+#define MODBUS_SUPPORT_FC0B 1
+
 
 //=============================================================================
 // 3. Э�鳣�����쳣�� (Protocol Constants & Exception Codes)
@@ -0,0 +1,127 @@
+/**
+ * @file modbus_crc.h
+ * @brief Modbus RTU CRC16 公共计算模块
+ * @details
+ * 三套 Modbus 协议栈（modbus_rtu_slave.c、modbus_slave.c、usart2_echo_test.c）
+ * 共用的 CRC16/MODBUS 实现。采用 slicing-by-4 查表：每次处理 4 字节，
+ * 4 次查表互不依赖，比逐字节查表少一半的移位和依赖链。
+ *
+ * 查找表由 Tools/gen_crc16_tables.py 在编译前生成（modbus_crc16_table.c），
+ * 生成器会先与逐位算法交叉校验，不再手工粘贴表格。
+ *
+ * 本头文件不依赖 HAL，可直接用于主机端测试与基准程序。
+ */
+
+#ifndef MODBUS_CRC_H
+#define MODBUS_CRC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** CRC16/MODBUS 初始值 */
+#define MB_CRC16_INIT   0xFFFFU
+
+/**
+ * @brief slicing-by-4 查找表（生成文件 modbus_crc16_table.c 提供）
+ * @details g_mbCrc16Table[0] 即传统的单字节表；
+ *          g_mbCrc16Table[k][i] 为字节 i 后再跟 k 个零字节时的 CRC 贡献。
+ */
+extern const uint16_t g_mbCrc16Table[4][256];
+
+/**
+ * @brief 增量更新 CRC
+ * @param crc  当前 CRC 状态（新帧从 MB_CRC16_INIT 开始）
+ * @param data 数据指针（无对齐要求）
+ * @param len  数据长度
+ * @return 更新后的 CRC 状态
+ * @note 可分段调用：Update(Update(INIT, a, n), b, m) 等于对 a||b 一次计算。
+ *       对包含末尾两个 CRC 字节的完整帧计算，结果为 0 即表示校验通过。
+ */
+uint16_t ModbusCRC16_Update(uint16_t crc, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief 计算一段数据的 CRC16（低字节先发）
+ */
+static inline uint16_t ModbusCRC16(const uint8_t *data, uint16_t len)
+{
+    return ModbusCRC16_Update(MB_CRC16_INIT, data, len);
+}
+
+/**
+ * @brief 折叠两个字节（slicing-by-2），用于边序列化边计算的场合
+ * @details 16 位 CRC 恰好被两个字节消耗完，两次查表互不依赖。
+ *          等价于 ModbusCRC16_Update(crc, {b0, b1}, 2)。
+ */
+static inline uint16_t ModbusCRC16_Update2(uint16_t crc, uint8_t b0, uint8_t b1)
+{
+    return (uint16_t)(g_mbCrc16Table[1][(uint8_t)(crc ^ b0)]
+                    ^ g_mbCrc16Table[0][(uint8_t)((crc >> 8) ^ b1)]);
+}
+
+/**
+ * @brief 折叠四个字节（slicing-by-4 单步），与 ModbusCRC16_Update 主循环相同
+ */
+static inline uint16_t ModbusCRC16_Update4(uint16_t crc, uint8_t b0, uint8_t b1,
+                                           uint8_t b2, uint8_t b3)
+{
+    return (uint16_t)(g_mbCrc16Table[3][(uint8_t)(crc ^ b0)]
+                    ^ g_mbCrc16Table[2][(uint8_t)((crc >> 8) ^ b1)]
+                    ^ g_mbCrc16Table[1][b2]
+                    ^ g_mbCrc16Table[0][b3]);
+}
+
+/**
+ * @brief 边收边算的 CRC 状态（按接收缓冲区下标推进）
+ * @details DMA 半满/满、IDLE 等事件到来时把 [pos, end) 折叠进 crc；
+ *          同一位置重复折叠无副作用，因此各事件不必关心谁先谁后。
+ *          帧结束时 crc == 0 即整帧（含 CRC 两字节）校验通过。
+ */
+typedef struct {
+    uint16_t crc;   /* 当前 CRC 状态 */
+    uint16_t pos;   /* 已折叠到的缓冲区下标 */
+} ModbusCRC16_Stream;
+
+static inline void ModbusCRC16_StreamReset(ModbusCRC16_Stream *s)
+{
+    s->crc = MB_CRC16_INIT;
+    s->pos = 0;
+}
+
+/**
+ * @brief 把 buf[s->pos, end) 折叠进 CRC 状态
+ * @param buf 接收缓冲区起始地址（不是本段起始地址）
+ * @param end DMA 当前写入位置；不大于 pos 时直接返回
+ */
+static inline void ModbusCRC16_StreamFold(ModbusCRC16_Stream *s, const uint8_t *buf, uint16_t end)
+{
+    if (end > s->pos) {
+        s->crc = ModbusCRC16_Update(s->crc, buf + s->pos, (uint16_t)(end - s->pos));
+        s->pos = end;
+    }
+}
+
+/**
+ * @brief 环形缓冲区版本：从 s->pos 起折叠 n 字节，越过环尾自动回到 0
+ * @param size 环大小，必须为 2 的幂；n 不得超过 size
+ */
+static inline void ModbusCRC16_StreamFoldRing(ModbusCRC16_Stream *s, const uint8_t *ring,
+                                              uint16_t size, uint16_t n)
+{
+    uint16_t first = (uint16_t)(size - s->pos);
+    if (n > first) {
+        s->crc = ModbusCRC16_Update(s->crc, ring + s->pos, first);
+        s->crc = ModbusCRC16_Update(s->crc, ring, (uint16_t)(n - first));
+    } else {
+        s->crc = ModbusCRC16_Update(s->crc, ring + s->pos, n);
+    }
+    s->pos = (uint16_t)((s->pos + n) & (size - 1U));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODBUS_CRC_H */
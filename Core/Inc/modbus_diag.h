@@ -0,0 +1,101 @@
+/**
+ * @file modbus_diag.h
+ * @brief Modbus 串行链路诊断计数器与 0x08/0x0B 功能码（两套协议栈共用）
+ * @details
+ * 每个通道一份 ModbusDiag_t，热路径上只做普通的 16 位自增（与规范的计数宽度一致，
+ * 溢出自然回绕），不加锁。每个字段只有一个写者：标注 [ISR] 的由串口/帧定时中断累加
+ * （这些中断同一抢占级，互不嵌套），其余只在主循环的帧处理中修改；
+ * 清零由主循环执行，与中断自增撞上最多丢一次计数。
+ *
+ * 0x08 支持的子功能：
+ *   0x00 回送请求数据        0x01 重启通信（清计数、退出只听模式）
+ *   0x02 诊断寄存器          0x04 强制只听模式（不应答）
+ *   0x0A 清计数与诊断寄存器  0x0B-0x12 各计数器（见 ModbusDiag_t）
+ *   0x14 清溢出计数与标志
+ * 0x12 上报字符溢出与报文溢出之和；0x13 为规范保留的子功能，回异常 0x01。
+ * 0x0B 返回状态字 0x0000 与通信事件计数（正常完成的报文数，不含异常应答和 0x0B 本身）。
+ *
+ * 本头文件不依赖 HAL，可直接用于主机端工具。
+ */
+
+#ifndef MODBUS_DIAG_H
+#define MODBUS_DIAG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define MB_FUNC_DIAGNOSTICS                 0x08
+#define MB_FUNC_GET_COMM_EVENT_COUNTER      0x0B
+
+/* 0x08 子功能码 */
+#define MB_DIAG_RETURN_QUERY_DATA           0x0000U
+#define MB_DIAG_RESTART_COMM                0x0001U
+#define MB_DIAG_RETURN_DIAG_REGISTER        0x0002U
+#define MB_DIAG_FORCE_LISTEN_ONLY           0x0004U
+#define MB_DIAG_CLEAR_COUNTERS              0x000AU
+#define MB_DIAG_BUS_MESSAGE_COUNT           0x000BU
+#define MB_DIAG_BUS_COMM_ERROR_COUNT        0x000CU
+#define MB_DIAG_BUS_EXCEPTION_COUNT         0x000DU
+#define MB_DIAG_SLAVE_MESSAGE_COUNT         0x000EU
+#define MB_DIAG_SLAVE_NO_RESPONSE_COUNT     0x000FU
+#define MB_DIAG_SLAVE_NAK_COUNT             0x0010U
+#define MB_DIAG_SLAVE_BUSY_COUNT            0x0011U
+#define MB_DIAG_BUS_CHAR_OVERRUN_COUNT      0x0012U
+#define MB_DIAG_CLEAR_OVERRUN               0x0014U
+
+/* 诊断寄存器位（读取时由计数与状态合成） */
+#define MB_DIAG_REG_OVERRUN                 0x0001U     /**< 溢出计数（0x12）非 0，0x14 清除 */
+#define MB_DIAG_REG_LISTEN_ONLY             0x0002U     /**< 处于只听模式 */
+
+/**
+ * @brief 单通道诊断计数器（与 0x08 子功能一一对应）
+ */
+typedef struct
+{
+    uint16_t busMessage;        /**< 0x0B [ISR] 总线上检测到的全部报文（含发给别的从站的） */
+    uint16_t busCommError;      /**< 0x0C CRC 错误（与 busFrameError 之和上报） */
+    uint16_t busFrameError;     /**< 0x0C [ISR] t1.5 违例等结帧时即丢弃的错误帧 */
+    uint16_t busException;      /**< 0x0D 本站发出的异常应答 */
+    uint16_t slaveMessage;      /**< 0x0E 发给本站（含广播）且校验通过的报文 */
+    uint16_t slaveNoResponse;   /**< 0x0F 发给本站但未应答（广播、只听模式） */
+    uint16_t slaveNak;          /**< 0x10 NAK 异常（本实现不产生，恒为 0） */
+    uint16_t slaveBusy;         /**< 0x11 忙异常（0x06） */
+    uint16_t charOverrun;       /**< 0x12 [ISR] USART 字符溢出（ORE，与 messageOverrun 之和上报） */
+    uint16_t messageOverrun;    /**< 0x12 [ISR] 帧超长/队列满/被覆盖而丢弃的报文 */
+    uint16_t eventCount;        /**< 0x0B 功能码：正常完成的报文数 */
+    uint8_t  listenOnly;        /**< 只听模式：只计数，除 0x08/0x01 外不处理不应答 */
+} ModbusDiag_t;
+
+/**
+ * @brief 清零全部计数（不改变只听模式）
+ */
+void ModbusDiag_Clear(ModbusDiag_t *diag);
+
+/**
+ * @brief 只听模式下该请求是否仍需处理（只有 0x08/0x01 重启通信）
+ */
+static inline uint8_t ModbusDiag_Accepts(const ModbusDiag_t *diag, const uint8_t *req, uint16_t len)
+{
+    return (uint8_t)(!diag->listenOnly
+        || (len >= 4U && req[1] == MB_FUNC_DIAGNOSTICS && req[2] == 0x00U && req[3] == 0x01U));
+}
+
+/**
+ * @brief 处理 0x08 / 0x0B 请求
+ * @param req   请求帧（地址起，不含 CRC）
+ * @param len   请求长度（不含 CRC）
+ * @param resp  应答缓冲区（地址起，调用方负责追加 CRC），至少 len 字节
+ * @param exCode 输出：非 0 时应回该异常码
+ * @return 应答长度（不含 CRC）；0 表示不应答（强制只听、只听模式下重启）或需回异常
+ */
+uint16_t ModbusDiag_Serve(ModbusDiag_t *diag, const uint8_t *req, uint16_t len,
+                          uint8_t *resp, uint8_t *exCode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MODBUS_DIAG_H */
@@ -64,5 +64,19 @@ void Modbus_HAL_SetDirTx(ModbusInstance_t *pInstance);
  */
 void Modbus_HAL_SetDirRx(ModbusInstance_t *pInstance);
 
+/**
+ * @brief USART IDLE 中断调用：停止接收 DMA，记下帧长并重新启动接收
+ * @note 协议栈空闲时才交出新帧；处理/发送期间到达的帧丢弃并计入报文溢出。
+ * @param pInstance 指向目标Modbus实例的指针
+ * @return 1 = 有新帧待 Modbus_Poll 处理
+ */
+uint8_t Modbus_HAL_RxIdleISR(ModbusInstance_t *pInstance);
+
+/**
+ * @brief 发送完成（TC）中断调用：切回接收方向，协议栈回到空闲
+ * @param pInstance 指向目标Modbus实例的指针
+ */
+void Modbus_HAL_TxCpltISR(ModbusInstance_t *pInstance);
+
 
 #endif // MODBUS_HAL_H
@@ -11,6 +11,7 @@
 
 #include <stdint.h>
 #include "modbus_config.h"
+#include "modbus_diag.h"
 
 /* ���ʹ��STM32 HAL�⣬��������ͷ�ļ��Ի�ȡӲ��������Ͷ��� */
 /* �û��ɸ����Լ���ƽ̨�޸Ĵ˲��� */
@@ -96,6 +97,9 @@ typedef struct
     /* === Ӧ�ò�ӿ� === */
     pfnModbusCallback pfnAppCallback; /**< ָ��Ӧ�ò����ݴ����ص�������ָ�� */
 
+    /* === 诊断计数 (0x08 / 0x0B) === */
+    ModbusDiag_t stDiag;              /**< 串行链路诊断计数与只听模式，见 modbus_diag.h */
+
 } ModbusInstance_t;
 
 
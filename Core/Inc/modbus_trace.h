@@ -0,0 +1,154 @@
+/**
+ * @file modbus_trace.h
+ * @brief Modbus 请求处理流水线的 DWT 周期级延时跟踪
+ * @details
+ * 每个请求在以下时刻用 DWT->CYCCNT 打点：
+ *   IDLE      USART IDLE 中断（最后一个字节之后一个字符时间，stm32f1xx_it.c）
+ *   PROCESS   ModbusRTU_ProcessFrame 开始处理该帧
+ *   CRC       CRC 校验完成
+ *   HANDLER   功能码处理函数返回（应答已序列化到 txBuffer）
+ *   TX_START  调用 HAL_UART_Transmit_DMA（DE 前保护时间之后）
+ *   TC        最后一个字节发送完成（USART TC）
+ * 应答发送完成时整条记录写入定长环（g_mbTraceRing，供调试器查看），
+ * 并按功能码累计 min/avg/max/p99（IDLE → TX_START，即从请求最后一字节到我们第一个应答字节）
+ * 与各阶段平均耗时。统计经 ModbusTrace_Snapshot 展开为输入寄存器，
+ * Tools/uart_test.py --test trace 读取打印。
+ *
+ * p99 由每功能码的半倍频程直方图给出（桶上界，误差 < 41%，不超过 max）。
+ * 任一桶或累加和将满时，桶、样本数与累加和一起折半，长时间轮询下 avg/p99 仍一致，
+ * 样本数因此是衰减后的有效样本数；min/max 为清零以来的极值。
+ * 需要 DWT 周期计数器已使能（appEventInit）。
+ * MODBUS_TRACE_ENABLE 为 0 时打点全部编译为空。
+ */
+
+#ifndef MODBUS_TRACE_H
+#define MODBUS_TRACE_H
+
+#include <stdint.h>
+#include "stm32f1xx_hal.h"
+
+#ifndef MODBUS_TRACE_ENABLE
+#define MODBUS_TRACE_ENABLE     1
+#endif
+
+//=============================================================================
+// 1. 打点阶段与记录 (Stages & Records)
+//=============================================================================
+
+typedef enum
+{
+    MB_TRACE_IDLE = 0,
+    MB_TRACE_PROCESS,
+    MB_TRACE_CRC,
+    MB_TRACE_HANDLER,
+    MB_TRACE_TX_START,
+    MB_TRACE_TC,
+    MB_TRACE_STAGES
+} ModbusTraceStage_t;
+
+typedef struct
+{
+    uint32_t t[MB_TRACE_STAGES];    /**< 各阶段 DWT 周期计数 */
+    uint8_t  fc;                    /**< 请求功能码 */
+    uint8_t  port;                  /**< 0 = USART1, 1 = USART2 */
+} ModbusTraceRecord_t;
+
+/**
+ * @brief 每个从站实例内嵌一份：当前请求的打点
+ */
+typedef struct
+{
+    volatile uint32_t idleCyc;      /**< 最近一次 IDLE 中断时刻，结帧时随描述符带走 */
+    ModbusTraceRecord_t cur;
+    volatile uint8_t active;        /**< cur 正在跟踪一个需要应答的请求 */
+} ModbusTraceCtx_t;
+
+#define MB_TRACE_RING_LEN       16U         /**< 原始记录环长度（2 的幂） */
+
+//=============================================================================
+// 2. 输入寄存器布局 (Input Register Layout)
+//=============================================================================
+
+/* 每个功能码一组 12 个寄存器，共 MB_TRACE_FC_SLOTS 组；时间单位 us，饱和于 65535 */
+#define MB_TRACE_FC_SLOTS       11U         /**< 01,02,03,04,05,06,0F,10,16,17，其余归入最后一组（fc=0） */
+#define MB_TRACE_REGS_PER_FC    12U
+#define MB_TRACE_REG_COUNT      (MB_TRACE_FC_SLOTS * MB_TRACE_REGS_PER_FC)
+
+#define MB_TRACE_OFS_FC         0U          /**< 功能码 */
+#define MB_TRACE_OFS_COUNT      1U          /**< 样本数 */
+#define MB_TRACE_OFS_MIN        2U          /**< IDLE → TX_START 最小值 */
+#define MB_TRACE_OFS_AVG        3U
+#define MB_TRACE_OFS_MAX        4U
+#define MB_TRACE_OFS_P99        5U
+#define MB_TRACE_OFS_STAGE_AVG  6U          /**< 6-10：IDLE→PROCESS、PROCESS→CRC、CRC→HANDLER、HANDLER→TX_START、TX_START→TC 平均 */
+
+//=============================================================================
+// 3. 接口函数 (API)
+//=============================================================================
+
+#if MODBUS_TRACE_ENABLE
+
+extern ModbusTraceRecord_t g_mbTraceRing[MB_TRACE_RING_LEN];
+
+/**
+ * @brief USART IDLE 中断中调用
+ */
+static inline void ModbusTrace_MarkIdle(ModbusTraceCtx_t *c)
+{
+    c->idleCyc = DWT->CYCCNT;
+}
+
+/**
+ * @brief 开始跟踪一个本站请求
+ * @param idleCyc 该帧结帧前最后一次 IDLE 的时刻（来自帧描述符）
+ */
+static inline void ModbusTrace_Begin(ModbusTraceCtx_t *c, uint32_t idleCyc, uint8_t fc, uint8_t port)
+{
+    c->cur.t[MB_TRACE_IDLE] = idleCyc;
+    c->cur.t[MB_TRACE_PROCESS] = DWT->CYCCNT;
+    c->cur.fc = fc;
+    c->cur.port = port;
+    c->active = 1;
+}
+
+static inline void ModbusTrace_Stamp(ModbusTraceCtx_t *c, ModbusTraceStage_t stage)
+{
+    if (c->active) c->cur.t[stage] = DWT->CYCCNT;
+}
+
+/**
+ * @brief 请求不需要应答（广播/CRC 错/发送失败）：放弃本条记录
+ */
+static inline void ModbusTrace_Abort(ModbusTraceCtx_t *c)
+{
+    c->active = 0;
+}
+
+/**
+ * @brief TC 时调用：打最后一个点，记录入环并累计统计（中断上下文）
+ */
+void ModbusTrace_Commit(ModbusTraceCtx_t *c);
+
+/**
+ * @brief 把统计展开为 MB_TRACE_REG_COUNT 个输入寄存器值
+ */
+void ModbusTrace_Snapshot(uint16_t *regs);
+
+/**
+ * @brief 清空统计与记录环
+ */
+void ModbusTrace_Reset(void);
+
+#else
+
+static inline void ModbusTrace_MarkIdle(ModbusTraceCtx_t *c) { (void)c; }
+static inline void ModbusTrace_Begin(ModbusTraceCtx_t *c, uint32_t idleCyc, uint8_t fc, uint8_t port) { (void)c; (void)idleCyc; (void)fc; (void)port; }
+static inline void ModbusTrace_Stamp(ModbusTraceCtx_t *c, ModbusTraceStage_t stage) { (void)c; (void)stage; }
+static inline void ModbusTrace_Abort(ModbusTraceCtx_t *c) { (void)c; }
+static inline void ModbusTrace_Commit(ModbusTraceCtx_t *c) { (void)c; }
+static inline void ModbusTrace_Snapshot(uint16_t *regs) { for (uint32_t i = 0; i < MB_TRACE_REG_COUNT; i++) regs[i] = 0; }
+static inline void ModbusTrace_Reset(void) { }
+
+#endif /* MODBUS_TRACE_ENABLE */
+
+#endif /* MODBUS_TRACE_H */
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "stm32f1xx_hal.h"
+#include "relay_event.h"
 
 //=============================================================================
 // 1. 继电器定义和枚举 (Relay Definitions & Enums)
@@ -113,9 +114,26 @@ HAL_StatusTypeDef relayToggle(RelayChannel_e channel);
  * @retval HAL_OK 设置成功
  * @retval HAL_ERROR 设置失败
  * @note 例如：stateMask=0x05 表示继电器1和继电器3开启，其他关闭
+ * @note 每个 GPIO 端口只写一次 BSRR（PB4/PB3 一次、PA15/PA12/PA11 一次），同一端口上的继电器同时动作
  */
 HAL_StatusTypeDef relaySetAllStates(uint8_t stateMask);
 
+/**
+ * @brief 只改变部分继电器的状态
+ * @param changeMask 要改变的通道掩码，未置位的通道保持原状
+ * @param stateMask 目标状态掩码（仅 changeMask 中的位有效）
+ * @return HAL_StatusTypeDef HAL状态码
+ * @retval HAL_OK 设置成功
+ * @note 与 relaySetAllStates 相同，每个端口一次 BSRR 写入；可在中断中调用
+ */
+HAL_StatusTypeDef relaySetMasked(uint8_t changeMask, uint8_t stateMask);
+
+/**
+ * @brief 同 relaySetMasked，并注明变位来源（记入事件环，见 relay_event.h）
+ * @param source 变位来源 (@ref RelaySource_e)
+ */
+HAL_StatusTypeDef relaySetMaskedFrom(uint8_t changeMask, uint8_t stateMask, uint8_t source);
+
 /**
  * @brief 获取所有继电器的状态掩码
  * @return uint8_t 状态掩码，bit0对应继电器1，bit1对应继电器2，以此类推
@@ -0,0 +1,78 @@
+/**
+ * @file relay_event.h
+ * @brief 继电器变位事件环：每次状态变化记一条（通道、新状态、来源、时刻、序号）
+ * @details
+ * 写入方是 relay.c 的输出函数，主循环（Modbus 写）与 SysTick（定时、排队命令）都会调用。
+ * 追加不加锁：序号用 LDREX/STREX 领取，领到的序号决定环中槽位，
+ * 槽内先写内容、最后写序号，读方以“槽内序号 == 期望序号”判断该条完整且未被覆盖。
+ * 环满后新事件覆盖最旧的，读方从序号的跳跃即可知道漏了多少条。
+ *
+ * 主循环把新事件发布到输入寄存器窗口（布局见 Core/Doc/ModbusRegisterMap.md），
+ * 窗口把环连续映射两遍，主站从“上次读到的序号 + 1”所在槽开始一次 0x04 读即可
+ * 按序号顺序取回之后的全部事件，不必每个轮询周期重读状态寄存器。
+ */
+
+#ifndef RELAY_EVENT_H
+#define RELAY_EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//=============================================================================
+// 1. 事件定义 (Event Definitions)
+//=============================================================================
+
+#define RELAY_EVENT_RING        16U         /**< 环中事件数（2 的幂） */
+#define RELAY_EVENT_REGS        4U          /**< 每条事件在寄存器窗口中占用的寄存器数 */
+
+/**
+ * @brief 变位来源
+ */
+typedef enum
+{
+    RELAY_SRC_APP = 0,          /**< 应用代码直接调用（自检、测试） */
+    RELAY_SRC_MODBUS,           /**< Modbus 写线圈/继电器位图 */
+    RELAY_SRC_TIMER,            /**< 定时引擎（relay_timer.h） */
+    RELAY_SRC_SEQUENCE          /**< 场景排队命令（relay_seq.h） */
+} RelaySource_e;
+
+/**
+ * @brief 一条变位事件
+ */
+typedef struct
+{
+    uint32_t seq;               /**< 序号，从 1 开始；槽内为其他值表示该槽正在写或已被覆盖 */
+    uint32_t tickMs;            /**< HAL_GetTick 时刻 */
+    uint8_t  channel;           /**< RelayChannel_e */
+    uint8_t  state;             /**< 新状态 RelayState_e */
+    uint8_t  source;            /**< RelaySource_e */
+    uint8_t  reserved;
+} RelayEvent_t;
+
+//=============================================================================
+// 2. 公共API函数声明 (Public API Function Prototypes)
+//=============================================================================
+
+/**
+ * @brief 追加一条事件（任意上下文，不加锁）
+ */
+void relayEventPush(uint8_t channel, uint8_t state, uint8_t source);
+
+/**
+ * @brief 最近领取的序号（0 = 尚无事件）
+ */
+uint32_t relayEventLatest(void);
+
+/**
+ * @brief 按序号取一条事件
+ * @return bool false 表示该条已被覆盖或仍在写入
+ */
+bool relayEventGet(uint32_t seq, RelayEvent_t *event);
+
+/**
+ * @brief 把事件编码为寄存器窗口中的 RELAY_EVENT_REGS 个寄存器
+ * @details 序号低 16 位；bit0-3 通道、bit7 新状态、bit8-11 来源；时刻高 16 位；时刻低 16 位
+ */
+void relayEventToRegs(const RelayEvent_t *event, uint16_t *regs);
+
+#endif // RELAY_EVENT_H
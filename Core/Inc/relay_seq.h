@@ -0,0 +1,71 @@
+/**
+ * @file relay_seq.h
+ * @brief 继电器场景命令队列：错开各路吸合时刻，限制浪涌电流
+ * @details
+ * 主循环（Modbus 写回调）只把目标位图放进队列就返回，应答不等继电器动作；
+ * 后台在 SysTick（1ms）中断里逐条执行：
+ *   - 需要断开的通道在命令开始时一次断开（断开没有浪涌）；
+ *   - 需要吸合的通道按通道号从小到大，每隔“错开间隔”吸合一路，
+ *     相邻两路的间隔在命令之间同样保持（下一条命令的第一路不会紧跟上一条的最后一路）。
+ * 错开间隔为 0 时整条命令在一次输出中完成。
+ *
+ * 队列为单生产者（主循环）单消费者（SysTick）环形队列，入队无需关中断。
+ * 执行中的命令在完成前仍占一个队列位置，因此队列深度包含正在执行的那一条。
+ */
+
+#ifndef RELAY_SEQ_H
+#define RELAY_SEQ_H
+
+#include <stdint.h>
+#include "relay.h"
+
+//=============================================================================
+// 1. 配置 (Configuration)
+//=============================================================================
+
+#define RELAY_SEQ_DEPTH                 8U      /**< 队列容量（2 的幂） */
+#define RELAY_SEQ_STAGGER_DEFAULT_MS    100U    /**< 默认错开间隔 */
+
+//=============================================================================
+// 2. 公共API函数声明 (Public API Function Prototypes)
+//=============================================================================
+
+/**
+ * @brief 目标位图入队（bit0 对应继电器1）
+ * @return HAL_StatusTypeDef HAL状态码
+ * @retval HAL_OK 已入队
+ * @retval HAL_BUSY 队列已满
+ */
+HAL_StatusTypeDef relaySeqEnqueue(uint8_t targetMask);
+
+/**
+ * @brief 清空队列并停止正在执行的命令（已动作的通道保持当前状态）
+ */
+void relaySeqFlush(void);
+
+/**
+ * @brief 设置相邻两路吸合之间的错开间隔（ms），下一次吸合起生效
+ */
+void relaySeqSetStagger(uint16_t staggerMs);
+
+/**
+ * @brief 队列中的命令数（含正在执行的一条）
+ */
+uint8_t relaySeqDepth(void);
+
+/**
+ * @brief 正在执行的命令尚未吸合的通道位图，空闲时为 0
+ */
+uint8_t relaySeqPending(void);
+
+/**
+ * @brief 已执行完的命令数（16 位回绕）
+ */
+uint16_t relaySeqCompleted(void);
+
+/**
+ * @brief SysTick 中调用：开始下一条命令或吸合下一路
+ */
+void relaySeqTickISR(void);
+
+#endif // RELAY_SEQ_H
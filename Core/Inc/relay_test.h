@@ -3,6 +3,8 @@
  * @brief 继电器功能测试模块头文件
  * @details
  * 提供继电器系统的测试和验证功能，包括单路测试、批量测试等。
+ * 定时引擎、场景队列、变位事件环与直接写取消的自检用步进时钟：关中断后直接改 uwTick
+ * 并调用 SysTick 里的两个处理函数，结果与实际耗时无关，主机上由 Tools/host 的 relaytest 运行。
  * 
  * @author Lighting Ultra Team
  * @date 2025-01-20
@@ -57,6 +59,44 @@ HAL_StatusTypeDef relaySyncFlashTest(uint8_t flashCount, uint32_t onTimeMs, uint
  */
 //uint32_t relayResponseTimeTest(RelayChannel_e channel, uint8_t testCount);
 
+/**
+ * @brief 定时引擎自检 (relay_timer.h)
+ * @details 脉冲到期、重新装定、闪烁翻转与续期（含中断晚到时保持原节拍）、取消，
+ *          到期时刻跨越 HAL_GetTick 32 位回绕，无效命令字拒绝
+ * @note 步进时钟期间关中断；结束时取消全部定时、清空排队、继电器全关，
+ *       错开间隔恢复为默认值，uwTick 还原为进入时的值
+ * @return bool 测试结果
+ * @retval true 全部检查通过
+ * @retval false 存在失败检查（行号见测试报告）
+ */
+bool relayTimerSelfTest(void);
+
+/**
+ * @brief 场景队列自检 (relay_seq.h)
+ * @details 命令内与跨命令的逐路吸合间隔、断开通道立即断开并取消其定时、
+ *          间隔为 0 时同时吸合、队列满返回 HAL_BUSY、清空
+ * @note 同 relayTimerSelfTest
+ * @return bool 测试结果
+ */
+bool relaySeqSelfTest(void);
+
+/**
+ * @brief 变位事件环自检 (relay_event.h)
+ * @details 写入超过一整环后，被覆盖与未写入的序号读取失败，环内事件内容正确；寄存器编码
+ * @note 同 relayTimerSelfTest；测试事件（来源 APP）会出现在事件寄存器窗口中
+ * @return bool 测试结果
+ */
+bool relayEventSelfTest(void);
+
+/**
+ * @brief 直接写取消自检
+ * @details 经 ModbusRTU_CommitWriteCoils / ModbusRTU_CommitWriteRange（线圈、保持寄存器 10）
+ *          写继电器：清空排队，只取消状态被改变的通道上的定时
+ * @note 同 relayTimerSelfTest；使用 USART1 从站 g_mb 的线圈与保持寄存器
+ * @return bool 测试结果
+ */
+bool relayDirectWriteSelfTest(void);
+
 /**
  * @brief 打印继电器测试报告
  * @details 通过调试串口输出测试结果 (需要实现printf重定向)
@@ -0,0 +1,87 @@
+/**
+ * @file relay_timer.h
+ * @brief 继电器定时引擎：延时开、延时关、脉冲、闪烁
+ * @details
+ * 每路继电器一个定时器，由一次保持寄存器写入装定（命令字格式见下），
+ * 到期动作在 SysTick（1ms）中断里执行，不依赖主站轮询时序，也不必再发一条“关”命令。
+ *
+ * 运行中的定时器按到期时刻排成有序链表，每个 tick 只比较表头一次：
+ * 无到期时 O(1)，与通道数无关；装定/取消在主循环中按序插入（最多 5 项）。
+ * 到期的通道合并成一次 relaySetMasked（每个端口一次 BSRR 写入），
+ * 随后置位 APP_EVT_RELAY 让主循环刷新线圈/状态寄存器。
+ *
+ * 命令字（16 位）：
+ *   bit15-13  模式（RelayTimerMode_e）
+ *   bit12     时间单位：0 = 10ms，1 = 1s
+ *   bit11-0   时间计数 1-4095（10ms-40.95s 或 1s-4095s）；模式为 0 时忽略
+ */
+
+#ifndef RELAY_TIMER_H
+#define RELAY_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "relay.h"
+
+//=============================================================================
+// 1. 命令字定义 (Command Word)
+//=============================================================================
+
+/**
+ * @brief 定时模式
+ */
+typedef enum
+{
+    RELAY_TIMER_CANCEL = 0,     /**< 取消该路定时，继电器保持当前状态 */
+    RELAY_TIMER_ON_DELAY,       /**< 延时开：T 后开启 */
+    RELAY_TIMER_OFF_DELAY,      /**< 延时关：T 后关闭（此前保持当前状态） */
+    RELAY_TIMER_PULSE,          /**< 脉冲：立即开启，T 后关闭 */
+    RELAY_TIMER_BLINK,          /**< 闪烁：立即开启，此后每 T 翻转一次，直到取消 */
+    RELAY_TIMER_MODE_COUNT
+} RelayTimerMode_e;
+
+#define RELAY_TIMER_MODE_SHIFT      13U
+#define RELAY_TIMER_UNIT_1S         (1U << 12)
+#define RELAY_TIMER_COUNT_MASK      0x0FFFU
+
+#define RELAY_TIMER_CMD(mode, unit1s, count) \
+    ((uint16_t)(((uint16_t)(mode) << RELAY_TIMER_MODE_SHIFT) | ((unit1s) ? RELAY_TIMER_UNIT_1S : 0U) \
+                | ((uint16_t)(count) & RELAY_TIMER_COUNT_MASK)))
+
+//=============================================================================
+// 2. 公共API函数声明 (Public API Function Prototypes)
+//=============================================================================
+
+/**
+ * @brief 检查命令字是否有效（模式在范围内，非取消时计数不为 0）
+ */
+bool relayTimerCommandValid(uint16_t cmd);
+
+/**
+ * @brief 按命令字装定（或取消）某路定时器，覆盖该路正在运行的定时
+ * @param channel 继电器通道 (@ref RelayChannel_e)
+ * @param cmd 命令字
+ * @return HAL_StatusTypeDef HAL状态码
+ * @retval HAL_OK 装定成功
+ * @retval HAL_ERROR 通道或命令字无效
+ * @note 主循环调用；脉冲/闪烁在返回前已开启继电器
+ */
+HAL_StatusTypeDef relayTimerArm(RelayChannel_e channel, uint16_t cmd);
+
+/**
+ * @brief 取消若干路的定时（bit0 对应继电器1），继电器保持当前状态
+ */
+void relayTimerCancel(uint8_t channelMask);
+
+/**
+ * @brief 读取某路正在运行的命令字
+ * @return uint16_t 命令字；空闲（未装定或一次性定时已到期）时为 0
+ */
+uint16_t relayTimerGetCommand(RelayChannel_e channel);
+
+/**
+ * @brief SysTick 中调用：执行到期的定时动作
+ */
+void relayTimerTickISR(void);
+
+#endif // RELAY_TIMER_H
@@ -0,0 +1,92 @@
+/**
+ * @file app_event.c
+ * @brief 主循环事件标志与休眠调度实现
+ * @details
+ * s_pending 由中断置位、主循环取走；读改写都在关中断下完成，
+ * USART 与 DMA 中断不同抢占级时也不会丢位。
+ */
+
+#include "app_event.h"
+
+//=============================================================================
+// 1. 私有变量 (Private Variables)
+//=============================================================================
+
+static volatile uint32_t s_pending;
+static AppEventStats_t   s_stats;
+static uint32_t          s_windowStart;
+
+//=============================================================================
+// 2. 接口实现 (API Implementation)
+//=============================================================================
+
+void appEventInit(void)
+{
+    /* 使能 DWT 周期计数器（72MHz 下约 59 秒回绕，按差值计算不受影响） */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    s_pending = 0;
+    s_stats.wakeups = 0;
+    s_stats.dispatches = 0;
+    s_stats.idleCycles = 0;
+    s_stats.windowCycles = 0;
+    s_windowStart = DWT->CYCCNT;
+}
+
+void appEventSet(uint32_t events)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_pending |= events;
+    __set_PRIMASK(primask);
+}
+
+uint32_t appEventWait(void)
+{
+    uint32_t events;
+
+    __disable_irq();
+    while (s_pending == 0U) {
+        /* 屏蔽下 WFI：挂起的中断会唤醒内核，开中断后立即执行 */
+        uint32_t t0 = DWT->CYCCNT;
+        __DSB();
+        __WFI();
+        s_stats.idleCycles += DWT->CYCCNT - t0;
+        s_stats.wakeups++;
+        __enable_irq();
+        __ISB();
+        __disable_irq();
+    }
+    events = s_pending;
+    s_pending = 0;
+    s_stats.dispatches++;
+    __enable_irq();
+
+    return events;
+}
+
+void appEventGetStats(AppEventStats_t *stats, uint8_t reset)
+{
+    uint32_t now = DWT->CYCCNT;
+
+    __disable_irq();
+    s_stats.windowCycles = now - s_windowStart;
+    *stats = s_stats;
+    if (reset) {
+        s_stats.wakeups = 0;
+        s_stats.dispatches = 0;
+        s_stats.idleCycles = 0;
+        s_windowStart = now;
+    }
+    __enable_irq();
+}
+
+uint16_t appEventIdlePermille(const AppEventStats_t *stats)
+{
+    if (stats->windowCycles == 0U) {
+        return 0;
+    }
+    return (uint16_t)(((uint64_t)stats->idleCycles * 1000U) / stats->windowCycles);
+}
@@ -0,0 +1,475 @@
+/**
+ * @file app_gateway.c
+ * @brief Modbus RTU 直通网关实现
+ * @details
+ * 同一时刻只有一笔事务（RTU 主站本就一问一答）：
+ *   IDLE → FORWARD（向下游发送请求）→ WAIT（等应答）→ IDLE
+ *
+ * 请求字节直接从上游接收环发往下游（SendRaw 不拷贝），环回绕时分两段；
+ * 下游每段发送完成时在 TxChainCallback 中续发已到达的字节，
+ * 总线保持发送方向。上游帧最终的描述符给出 CRC/帧长结论。
+ *
+ * 下游发完时上游字节还没到：TxChainCallback 返回 MB_TX_CHAIN_HOLD 保持 DE 挂起，
+ * 由上游下一个字节的中断续发；挂起达到下游 t1.5 时协议栈用 TIM2 放弃续传、
+ * 释放总线，本次直通中止（下游从站把半截帧当作坏帧丢掉），整帧收齐后按存储转发重发。
+ *
+ * 并发约定：上游 USART 中断与下游发送完成中断同一抢占级，互不打断；
+ * 主循环操作发送进度或事务状态时进入临界区。
+ */
+
+#include <string.h>
+#include "app_gateway.h"
+#include "app_event.h"
+
+//=============================================================================
+// 1. 路由表 (Routes)
+//=============================================================================
+
+typedef struct
+{
+    uint8_t  firstAddr;     /**< 目标从站地址范围（含） */
+    uint8_t  lastAddr;
+    uint16_t timeoutMs;     /**< 下游发完到收到应答的超时 */
+} GatewayRoute_t;
+
+#define GW_BROADCAST_ADDR   0U
+
+/* 上游本站地址 0x01 由 USART1 自己应答，不在路由表中 */
+static const GatewayRoute_t s_routes[] = {
+    {   0,   0, 100U },     /* 广播：发完即结束，超时只用于等上游帧结论 */
+    {   2,  31, 100U },     /* 柜内从站：响应快 */
+    {  32, 247, 500U },     /* 远端/慢速从站 */
+};
+
+#define GW_ROUTE_COUNT  (sizeof(s_routes) / sizeof(s_routes[0]))
+
+//=============================================================================
+// 2. 私有类型与变量 (Private Types & Variables)
+//=============================================================================
+
+typedef enum
+{
+    GW_IDLE = 0,
+    GW_FORWARD,
+    GW_WAIT
+} GatewayState_t;
+
+typedef enum
+{
+    GW_VERDICT_PENDING = 0, /**< 直通中，上游帧尚未收完 */
+    GW_VERDICT_OK,
+    GW_VERDICT_BAD,         /**< CRC 错或帧长与报头不符 */
+    GW_VERDICT_ABORTED      /**< 续传间隙达到下游 t1.5，直通已中止 */
+} GatewayVerdict_t;
+
+typedef struct
+{
+    volatile uint8_t  state;
+    volatile uint8_t  txDone;       /**< 请求已全部发到下游 */
+    volatile uint8_t  stalled;      /**< 下游已发完到达的字节，DE 保持，等上游续传 */
+    volatile uint8_t  verdict;
+    uint8_t  target;
+    uint8_t  fc;
+    uint8_t  cutThrough;            /**< 上游波特率 >= 下游，允许直通 */
+    uint16_t timeoutMs;
+    uint32_t reqStart;              /**< 请求在上游接收环中的帧首累计序号 */
+    uint16_t reqLen;                /**< 帧长（直通时由报头推算） */
+    volatile uint16_t sent;         /**< 已交给下游 DMA 的字节数 */
+    uint32_t lastStart;             /**< 上一笔已处理请求的帧首，防止重复直通 */
+    uint32_t beginTick;
+    uint32_t reqEndCyc;             /**< 上游请求收完（描述符到达）时刻 */
+    volatile uint32_t txDoneCyc;
+    volatile uint32_t txDoneTick;
+    volatile uint32_t respFrom;     /**< 下游接收环中早于此序号的字节是发送期间的回显 */
+    uint32_t stallCyc;              /**< 挂起时刻（下游最后一个字符发完） */
+    uint32_t gapMaxCyc;             /**< 下游 t1.5：协议栈未开帧定时器时由这里按它中止 */
+} Gateway_t;
+
+typedef struct
+{
+    uint16_t reqHist[GW_HIST_BUCKETS];
+    uint16_t respHist[GW_HIST_BUCKETS];
+    uint16_t forwarded;
+    uint16_t responses;
+    uint16_t timeouts;
+    uint16_t dropped;
+    uint16_t underruns;
+    uint16_t busy;
+} GatewayStats_t;
+
+/* 直方图上界（us），最后一个桶收纳其余 */
+static const uint32_t s_reqBoundsUs[GW_HIST_BUCKETS - 1U]  = { 250U, 500U, 1000U, 2000U, 5000U };
+static const uint32_t s_respBoundsUs[GW_HIST_BUCKETS - 1U] = { 2000U, 5000U, 10000U, 20000U, 50000U };
+
+static ModbusRTU_Slave *s_up;
+static ModbusRTU_Slave *s_down;
+static Gateway_t        s_gw;
+static GatewayStats_t   s_stats;
+
+//=============================================================================
+// 3. 私有函数 (Private Functions)
+//=============================================================================
+
+static const GatewayRoute_t *gwRoute(uint8_t addr)
+{
+    for (uint32_t i = 0; i < GW_ROUTE_COUNT; i++) {
+        if (addr >= s_routes[i].firstAddr && addr <= s_routes[i].lastAddr) {
+            return &s_routes[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint8_t gwUpByte(uint32_t seq)
+{
+    return s_up->rxRing[seq & MB_RX_RING_MASK];
+}
+
+/**
+ * @brief 由报头推算请求帧长（含 CRC）
+ * @return 0 = 报头尚未收齐；0xFFFF = 功能码帧长不定，只能存储转发
+ */
+static uint16_t gwRequestLength(uint32_t start, uint32_t avail)
+{
+    if (avail < 2U) return 0;
+    switch (gwUpByte(start + 1U)) {
+        case MB_FUNC_READ_COILS:
+        case MB_FUNC_READ_DISCRETE_INPUTS:
+        case MB_FUNC_READ_HOLDING_REGISTERS:
+        case MB_FUNC_READ_INPUT_REGISTERS:
+        case MB_FUNC_WRITE_SINGLE_COIL:
+        case MB_FUNC_WRITE_SINGLE_REGISTER:
+            return 8U;
+        case MB_FUNC_MASK_WRITE_REGISTER:
+            return 10U;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:
+        case MB_FUNC_WRITE_MULTIPLE_REGISTERS:
+            return (avail < 7U) ? 0U : (uint16_t)(9U + gwUpByte(start + 6U));
+        case MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS:
+            return (avail < 11U) ? 0U : (uint16_t)(13U + gwUpByte(start + 10U));
+        default:
+            return 0xFFFFU;
+    }
+}
+
+static void gwHistAdd(uint16_t *hist, const uint32_t *bounds, uint32_t us)
+{
+    uint32_t i = 0;
+    while (i < GW_HIST_BUCKETS - 1U && us >= bounds[i]) i++;
+    if (hist[i] != 0xFFFFU) hist[i]++;
+}
+
+static uint32_t gwCyclesToUs(uint32_t cycles)
+{
+    return cycles / (SystemCoreClock / 1000000U);
+}
+
+static void gwStatsPublish(void)
+{
+    MB_RegWriteBegin(s_up);                 /* 诊断统计每秒刷新，不登记变化 */
+    for (uint32_t i = 0; i < GW_HIST_BUCKETS; i++) {
+        s_up->inputRegs[GW_IREG_REQ_HIST + i]  = s_stats.reqHist[i];
+        s_up->inputRegs[GW_IREG_RESP_HIST + i] = s_stats.respHist[i];
+    }
+    s_up->inputRegs[GW_IREG_FORWARDED] = s_stats.forwarded;
+    s_up->inputRegs[GW_IREG_RESPONSES] = s_stats.responses;
+    s_up->inputRegs[GW_IREG_TIMEOUTS]  = s_stats.timeouts;
+    s_up->inputRegs[GW_IREG_DROPPED]   = s_stats.dropped;
+    s_up->inputRegs[GW_IREG_UNDERRUNS] = s_stats.underruns;
+    s_up->inputRegs[GW_IREG_BUSY]      = s_stats.busy;
+    MB_RegWriteEnd(s_up);
+}
+
+/* 向上游回异常应答；上游正在发送时放弃（主站会按自己的超时重试） */
+static void gwReplyException(uint8_t addr, uint8_t fc, uint8_t code)
+{
+    if (s_up->txInProgress) return;
+    s_up->txBuffer[0] = addr;
+    s_up->txBuffer[1] = (uint8_t)(fc | 0x80U);
+    s_up->txBuffer[2] = code;
+    uint16_t crc = ModbusCRC16(s_up->txBuffer, 3);
+    s_up->txBuffer[3] = (uint8_t)(crc & 0xFFU);
+    s_up->txBuffer[4] = (uint8_t)(crc >> 8);
+    (void)ModbusRTU_SendRaw(s_up, s_up->txBuffer, 5);
+}
+
+static void gwFinish(void)
+{
+    uint32_t pm = MB_CriticalEnter();       /* 回到 IDLE 后上游中断随即可能起转 */
+    s_gw.lastStart = s_gw.reqStart;
+    s_gw.state = GW_IDLE;
+    MB_CriticalExit(pm);
+    gwStatsPublish();
+}
+
+/**
+ * @brief 把上游已到达、尚未发出的请求字节交给下游 DMA
+ * @return 1 = 已启动一段发送
+ * @note 调用方保证下游没有 DMA 在途（起转、挂起或发送完成中断），主循环中须在临界区内调用
+ */
+static uint8_t gwPump(void)
+{
+    uint32_t avail = ModbusRTU_RxWritePos(s_up) - s_gw.reqStart;
+    if (avail > s_gw.reqLen) avail = s_gw.reqLen;
+    if (avail <= s_gw.sent) return 0;
+
+    uint16_t off = (uint16_t)((s_gw.reqStart + s_gw.sent) & MB_RX_RING_MASK);
+    uint16_t n = (uint16_t)(avail - s_gw.sent);
+    if (n > MB_RX_RING_SIZE - off) n = (uint16_t)(MB_RX_RING_SIZE - off);
+    if (ModbusRTU_SendRaw(s_down, &s_up->rxRing[off], n) != HAL_OK) return 0;
+    s_gw.sent = (uint16_t)(s_gw.sent + n);
+    return 1;
+}
+
+static void gwBegin(uint32_t start, uint16_t len, const GatewayRoute_t *route, uint8_t verdict)
+{
+    s_gw.reqStart  = start;
+    s_gw.reqLen    = len;
+    s_gw.target    = gwUpByte(start);
+    s_gw.fc        = gwUpByte(start + 1U);
+    s_gw.timeoutMs = route->timeoutMs;
+    s_gw.verdict   = verdict;
+    s_gw.sent      = 0;
+    s_gw.txDone    = 0;
+    s_gw.beginTick = HAL_GetTick();
+    s_gw.reqEndCyc = DWT->CYCCNT;
+    s_gw.state     = GW_FORWARD;
+    if (s_stats.forwarded != 0xFFFFU) s_stats.forwarded++;
+    (void)gwPump();
+}
+
+/* 直通：当前上游帧的报头一旦能确定帧长就开始转发（上游中断中调用） */
+static void gwTryCutThrough(void)
+{
+    uint32_t start = s_up->rxFrameStart;       /* 中断结帧时更新，与本函数同一抢占级 */
+    uint32_t avail = ModbusRTU_RxWritePos(s_up) - start;
+
+    /* 上游正在应答时接收环里只有回显 */
+    if (avail < 2U || start == s_gw.lastStart || s_down->txInProgress || s_up->txInProgress) return;
+    const GatewayRoute_t *route = gwRoute(gwUpByte(start));
+    if (route == NULL) return;
+    uint16_t len = gwRequestLength(start, avail);
+    if (len == 0U) return;                      /* 报头未收齐，下个字节再看 */
+    if (len == 0xFFFFU || len > MB_RTU_FRAME_MAX_SIZE) {
+        s_gw.lastStart = start;                 /* 留给存储转发处理 */
+        return;
+    }
+    gwBegin(start, len, route, GW_VERDICT_PENDING);
+}
+
+/**
+ * @brief 挂起中的下游发送：上游已有新字节且间隙未到 t1.5 就续发，到了就中止
+ * @note 上游中断中调用，或主循环在临界区内调用（协议栈到期释放后的收尾、补查断流）
+ */
+static void gwResume(void)
+{
+    if (!s_gw.stalled) return;
+    if (s_gw.verdict == GW_VERDICT_BAD) {
+        s_gw.stalled = 0;                       /* 上游帧已判坏：不再续发，按作废收尾 */
+        ModbusRTU_TxChainAbort(s_down);
+    } else if (!s_down->txInProgress || DWT->CYCCNT - s_gw.stallCyc >= s_gw.gapMaxCyc) {
+        /* 下游帧内间隙已达 t1.5：之后再发的字节只会被当成另一帧，放弃本次直通 */
+        s_gw.stalled = 0;
+        s_gw.verdict = GW_VERDICT_ABORTED;
+        if (s_stats.underruns != 0xFFFFU) s_stats.underruns++;
+        ModbusRTU_TxChainAbort(s_down);         /* 协议栈已到期释放时什么也不做 */
+        appEventSet(APP_EVT_GATEWAY);
+    } else if (gwPump()) {
+        s_gw.stalled = 0;                       /* DE 一直保持，SendRaw 按续传处理 */
+    }
+}
+
+static void gwResponse(const ModbusRTU_RxDesc *d, const uint8_t *frame)
+{
+    uint32_t now = DWT->CYCCNT;
+    if (s_up->txInProgress || d->length > MB_RTU_FRAME_MAX_SIZE) return;
+
+    memcpy(s_up->txBuffer, frame, d->length);
+    (void)ModbusRTU_SendRaw(s_up, s_up->txBuffer, d->length);
+
+    int32_t lag = (int32_t)(s_gw.txDoneCyc - s_gw.reqEndCyc);
+    gwHistAdd(s_stats.reqHist, s_reqBoundsUs, (lag > 0) ? gwCyclesToUs((uint32_t)lag) : 0U);
+    gwHistAdd(s_stats.respHist, s_respBoundsUs, gwCyclesToUs(now - s_gw.txDoneCyc));
+    if (s_stats.responses != 0xFFFFU) s_stats.responses++;
+    gwFinish();
+}
+
+//=============================================================================
+// 4. 协议栈回调 (Stack Callbacks)
+//=============================================================================
+
+void ModbusRTU_ForeignFrameCallback(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d,
+                                    const uint8_t *frame, uint8_t crcOk)
+{
+    if (mb == s_down) {
+        /* 只认发送完成之后到达、地址匹配的应答；发送期间的回显序号更早，广播没有应答 */
+        if ((s_gw.state == GW_WAIT || (s_gw.state == GW_FORWARD && s_gw.txDone))
+            && crcOk && frame[0] == s_gw.target && s_gw.target != GW_BROADCAST_ADDR
+            && (int32_t)(d->start - s_gw.respFrom) >= 0) {
+            gwResponse(d, frame);
+        }
+        return;
+    }
+    if (mb != s_up) return;
+
+    const GatewayRoute_t *route = gwRoute(frame[0]);
+    if (route == NULL) return;                  /* 既非本站也不在路由表：别人的帧 */
+
+    /* 上游中断随时可能起转或中止直通：判断与起转在临界区内一并完成 */
+    uint8_t aborted = 0;
+    uint32_t pm = MB_CriticalEnter();
+    if (s_gw.state == GW_FORWARD && d->start == s_gw.reqStart) {
+        if (s_gw.verdict != GW_VERDICT_ABORTED) {
+            /* 直通请求收完：补上结论 */
+            s_gw.reqEndCyc = DWT->CYCCNT;
+            s_gw.verdict = (crcOk && d->length == s_gw.reqLen) ? GW_VERDICT_OK : GW_VERDICT_BAD;
+            MB_CriticalExit(pm);
+            return;
+        }
+        /* 直通已中止、整帧现已收齐：结束那次直通，下面按存储转发重发 */
+        s_gw.lastStart = s_gw.reqStart;
+        s_gw.state = GW_IDLE;
+        aborted = 1;
+    }
+    if (!crcOk) {
+        if (s_stats.dropped != 0xFFFFU) s_stats.dropped++;
+    } else if (s_gw.state != GW_IDLE || s_down->txInProgress) {
+        if (s_stats.busy != 0xFFFFU) s_stats.busy++;
+        if (frame[0] != GW_BROADCAST_ADDR) {
+            gwReplyException(frame[0], frame[1], MB_EX_GATEWAY_PATH_UNAVAILABLE);
+        }
+    } else {
+        /* 存储转发：整帧已在上游接收环中 */
+        gwBegin(d->start, d->length, route, GW_VERDICT_OK);
+    }
+    MB_CriticalExit(pm);
+    if (aborted) gwStatsPublish();
+}
+
+uint8_t ModbusRTU_TxChainCallback(ModbusRTU_Slave *mb)
+{
+    if (mb != s_down || s_gw.state != GW_FORWARD) return 0;
+    if (s_gw.verdict != GW_VERDICT_BAD && gwPump()) return 1;
+
+    if (s_gw.sent >= s_gw.reqLen) {
+        s_gw.txDoneCyc  = DWT->CYCCNT;
+        s_gw.txDoneTick = HAL_GetTick();
+        s_gw.respFrom   = ModbusRTU_RxWritePos(s_down);
+        s_gw.txDone     = 1;
+    } else if (s_gw.verdict != GW_VERDICT_BAD) {
+        /* 上游字节还没到：保持 DE 挂起，由上游下一个字节的中断续发 */
+        s_gw.stalled  = 1;
+        s_gw.stallCyc = DWT->CYCCNT;
+        return MB_TX_CHAIN_HOLD;
+    }
+    appEventSet(APP_EVT_GATEWAY);
+    return 0;
+}
+
+//=============================================================================
+// 5. 接口实现 (API Implementation)
+//=============================================================================
+
+void gatewayInit(ModbusRTU_Slave *upstream, ModbusRTU_Slave *downstream)
+{
+    s_up = upstream;
+    s_down = downstream;
+    s_down->slaveAddr = 0;                      /* 下游总线上的帧全部是转发应答 */
+
+    memset(&s_gw, 0, sizeof(s_gw));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_gw.state = GW_IDLE;
+    s_gw.lastStart = 0xFFFFFFFFU;
+    s_gw.cutThrough = (uint8_t)(s_up->huart->Init.BaudRate >= s_down->huart->Init.BaudRate);
+
+    /* 下游 t1.5，与协议栈判帧一致：19200 以上取规范固定值 */
+    uint32_t baud = s_down->huart->Init.BaudRate;
+    uint32_t bits = 1U + ((s_down->huart->Init.WordLength == UART_WORDLENGTH_9B) ? 9U : 8U)
+                  + ((s_down->huart->Init.StopBits == UART_STOPBITS_2) ? 2U : 1U);
+    uint32_t t15Us = (baud > 19200U) ? MB_T15_FIXED_US : (bits * 1500000U + baud - 1U) / baud;
+    s_gw.gapMaxCyc = t15Us * (SystemCoreClock / 1000000U);
+
+    /* 逐字节唤醒：数据仍由 DMA 取走，USART 中断入口据此起转/续传 */
+    if (s_gw.cutThrough) __HAL_UART_ENABLE_IT(s_up->huart, UART_IT_RXNE);
+    gwStatsPublish();
+}
+
+void gatewayProcess(void)
+{
+    if (s_up == NULL) return;
+
+    switch (s_gw.state) {
+        case GW_IDLE:
+            break;                              /* 起转在上游中断里 */
+
+        case GW_FORWARD: {
+            uint32_t pm = MB_CriticalEnter();
+            gwResume();                         /* 上游断流时没有字节中断来收尾 */
+            uint8_t busy = s_down->txInProgress;
+            uint8_t started = (uint8_t)(!busy && !s_gw.txDone
+                                        && s_gw.verdict != GW_VERDICT_BAD
+                                        && s_gw.verdict != GW_VERDICT_ABORTED && gwPump());
+            MB_CriticalExit(pm);
+            if (busy || started) break;
+
+            if (s_gw.verdict == GW_VERDICT_BAD) {
+                if (s_stats.dropped != 0xFFFFU) s_stats.dropped++;
+                gwFinish();
+            } else if (s_gw.txDone) {
+                if (s_gw.verdict == GW_VERDICT_OK) {
+                    if (s_gw.target == GW_BROADCAST_ADDR) {
+                        gwFinish();             /* 广播没有应答 */
+                    } else {
+                        s_gw.state = GW_WAIT;
+                    }
+                } else if (HAL_GetTick() - s_gw.txDoneTick >= s_gw.timeoutMs) {
+                    /* 上游帧始终没有结论（t1.5 违例整帧被丢）：作废 */
+                    if (s_stats.dropped != 0xFFFFU) s_stats.dropped++;
+                    gwFinish();
+                }
+            } else if (HAL_GetTick() - s_gw.beginTick >= s_gw.timeoutMs) {
+                /* 上游中途断流，或直通中止后整帧始终没有收齐 */
+                if (s_stats.dropped != 0xFFFFU) s_stats.dropped++;
+                gwFinish();
+            }
+            break;
+        }
+
+        case GW_WAIT:
+            if (HAL_GetTick() - s_gw.txDoneTick >= s_gw.timeoutMs) {
+                if (s_stats.timeouts != 0xFFFFU) s_stats.timeouts++;
+                gwReplyException(s_gw.target, s_gw.fc, MB_EX_GATEWAY_TARGET_FAILED);
+                gwFinish();
+            }
+            break;
+
+        default:
+            s_gw.state = GW_IDLE;
+            break;
+    }
+}
+
+void gatewayRxProgressISR(void)
+{
+    if (s_up == NULL || !s_gw.cutThrough) return;
+    if (s_gw.state == GW_IDLE) {
+        gwTryCutThrough();
+    } else if (s_gw.state == GW_FORWARD) {
+        gwResume();
+    }
+}
+
+void gatewayTickISR(void)
+{
+    if (s_up == NULL) return;
+    if (s_gw.state != GW_IDLE) {
+        appEventSet(APP_EVT_GATEWAY);           /* 断流/超时检查 */
+    }
+    /* HAL 出错中止接收时会清 RXNEIE，接收重启后在这里补开；
+       SysTick 优先级最低，改 CR1 要防 USART 中断在读改写中间插进来 */
+    if (s_gw.cutThrough && !(s_up->huart->Instance->CR1 & USART_CR1_RXNEIE)) {
+        uint32_t pm = MB_CriticalEnter();
+        __HAL_UART_ENABLE_IT(s_up->huart, UART_IT_RXNE);
+        MB_CriticalExit(pm);
+    }
+}
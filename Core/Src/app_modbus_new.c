@@ -13,144 +13,266 @@
  * @version 2.0.0
  */
 
-#include "app_modbus.h"
-#include "modbus_slave.h"
+#include "app_modbus_new.h"
 #include "modbus_hal.h"
 #include "relay.h"
-
-// 声明g_modbus_instance1和g_modbus_instance2在main.c中定义
-extern ModbusInstance_t g_modbus_instance1;
-extern ModbusInstance_t g_modbus_instance2;
+#include "app_modbus_regmap.h"
+#include <string.h>
 
 //=============================================================================
 // 1. 应用数据存储 (Application Data Storage)
 //=============================================================================
 
 /**
- * @brief Modbus寄存器地址定义
- * @details 定义各功能模块在Modbus寄存器中的地址分配
+ * @brief 寄存器描述符（由 app_modbus_regmap.h 展开，只读表放在 Flash）
  */
-#define MODBUS_REG_RELAY_CONTROL    0   /**< 继电器控制寄存器地址 */
-#define MODBUS_REG_RELAY_STATUS     1   /**< 继电器状态寄存器地址 */
-#define MODBUS_REG_SYSTEM_INFO      2   /**< 系统信息寄存器起始地址 */
+typedef struct
+{
+    uint16_t u16Start;                              /**< 起始地址 */
+    uint16_t u16Count;                              /**< 连续寄存器数量 */
+    uint8_t  u8Access;                              /**< APP_REG_RO / WO / RW */
+    uint16_t (*pfnGet)(uint16_t u16Addr);           /**< NULL = 普通存储 */
+    int      (*pfnSet)(uint16_t u16Addr, uint16_t u16Value);
+    uint16_t u16Scale;                              /**< 上位机换算：工程值 = 原始值 / scale */
+} AppRegDesc_t;
 
 /**
- * @brief Modbus保持寄存器映射区域
- * @details 寄存器功能分配：
- *          - 寄存器0: 继电器控制 (bit0-bit4对应继电器1-5)
- *          - 寄存器1: 继电器状态反馈 (只读)
- *          - 寄存器2-63: 系统扩展区域
+ * @brief 保持寄存器存储区
+ * @details 普通存储段按地址直接落在此数组中，整段读写即一次 memcpy；
+ *          访问函数段（继电器）不使用对应位置。
  */
 static uint16_t holding_registers[MODBUS_HOLDING_REG_COUNT];
 
+static uint16_t appRegRelayGet(uint16_t u16Addr);
+static int appRegRelaySet(uint16_t u16Addr, uint16_t u16Value);
+
+#define APP_REG_DESC(name, start, count, access, get, set, scale, unit, desc) \
+    { (start), (count), (access), (get), (set), (scale) },
+
+static const AppRegDesc_t s_regMap[] =
+{
+    APP_MODBUS_REGMAP(APP_REG_DESC)
+};
+
+#define APP_REG_MAP_LEN     (sizeof(s_regMap) / sizeof(s_regMap[0]))
+
+/* 映射表末端不得超出存储区 */
+#define APP_REG_END(name, start, count, access, get, set, scale, unit, desc) \
+    typedef char appRegEndCheck_##name[((start) + (count) <= MODBUS_HOLDING_REG_COUNT) ? 1 : -1];
+APP_MODBUS_REGMAP(APP_REG_END)
+
 //=============================================================================
 // 2. 应用回调函数实现 (Application Callback Implementation)
 //=============================================================================
 
 /**
- * @brief 应用层实现的回调函数
- * @details
- * 当协议栈需要应用数据的时候，协议栈会在验证通过一条合法的命令后，
- * 调用此函数来执行实际的数据读写操作。
- * @note 此函数可能由不同Modbus实例并发调用，需要为不同通信实现不同逻辑。
- *       这里用ModbusInstance_t结构体中的一个用户数据指针(pUserData)，
- *       用于回调函数中区分不同的设备。
+ * @brief 继电器寄存器访问函数（控制与状态都反映实际输出）
  */
-int App_RegisterCallback(uint8_t u8FuncCode, uint16_t u16Addr, uint16_t u16Count, uint16_t* pData)
+static uint16_t appRegRelayGet(uint16_t u16Addr)
+{
+    (void)u16Addr;
+    return (uint16_t)relayGetAllStates();
+}
+
+static int appRegRelaySet(uint16_t u16Addr, uint16_t u16Value)
+{
+    (void)u16Addr;
+    return (relaySetAllStates((uint8_t)u16Value) == HAL_OK) ? MODBUS_OK : MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+}
+
+/**
+ * @brief 二分查找包含 u16Addr 的描述符
+ * @return 描述符下标；地址落在空洞中返回 -1
+ */
+static int appRegFind(uint16_t u16Addr)
+{
+    int lo = 0;
+    int hi = (int)APP_REG_MAP_LEN - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        const AppRegDesc_t *d = &s_regMap[mid];
+        if (u16Addr < d->u16Start)
+        {
+            hi = mid - 1;
+        }
+        else if (u16Addr >= d->u16Start + d->u16Count)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            return mid;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 检查 [u16Addr, u16Addr + u16Count) 全部映射且具备 u8Need 权限
+ * @return 第一个描述符下标；不满足返回 -1
+ */
+static int appRegCheckRange(uint16_t u16Addr, uint16_t u16Count, uint8_t u8Need)
+{
+    int first = appRegFind(u16Addr);
+    uint32_t u32End = (uint32_t)u16Addr + u16Count;
+    uint32_t u32Pos = u16Addr;
+
+    for (int i = first; i >= 0 && i < (int)APP_REG_MAP_LEN; i++)
+    {
+        const AppRegDesc_t *d = &s_regMap[i];
+        if (d->u16Start != u32Pos && i != first)
+        {
+            return -1;      // 中间有空洞
+        }
+        if ((d->u8Access & u8Need) != u8Need)
+        {
+            return -1;
+        }
+        u32Pos = (uint32_t)d->u16Start + d->u16Count;
+        if (u32Pos >= u32End)
+        {
+            return first;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 按映射表读取一段寄存器：普通存储段整段拷贝，访问函数段逐个调用
+ */
+static int appRegRead(uint16_t u16Addr, uint16_t u16Count, uint16_t *pData)
 {
-    // 检查请求的地址范围是否合法
-    if ((u16Addr + u16Count) > MODBUS_HOLDING_REG_COUNT)
+    int i = appRegCheckRange(u16Addr, u16Count, APP_REG_RO);
+    if (i < 0)
     {
         return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
     }
 
-    switch (u8FuncCode)
+    while (u16Count > 0)
     {
-#if (MODBUS_SUPPORT_FC03 == 1)
-        case 0x03: // 读保持寄存器
-            // 将应用数据到协议栈提供的缓冲区
-            for (int i = 0; i < u16Count; i++)
+        const AppRegDesc_t *d = &s_regMap[i++];
+        uint16_t u16Off = (uint16_t)(u16Addr - d->u16Start);
+        uint16_t n = (uint16_t)(d->u16Count - u16Off);
+        if (n > u16Count)
+        {
+            n = u16Count;
+        }
+
+        if (d->pfnGet == NULL)
+        {
+            memcpy(pData, &holding_registers[u16Addr], n * sizeof(uint16_t));
+        }
+        else
+        {
+            for (uint16_t k = 0; k < n; k++)
             {
-                uint16_t regAddr = u16Addr + i;
-                
-                // 根据寄存器地址返回相应数据
-                if (regAddr == MODBUS_REG_RELAY_STATUS)
-                {
-                    // 返回继电器实时状态
-                    pData[i] = (uint16_t)relayGetAllStates();
-                }
-                else
+                pData[k] = d->pfnGet((uint16_t)(u16Addr + k));
+            }
+        }
+        pData += n;
+        u16Addr = (uint16_t)(u16Addr + n);
+        u16Count = (uint16_t)(u16Count - n);
+    }
+    return MODBUS_OK;
+}
+
+/**
+ * @brief 按映射表写入一段寄存器（先整段检查权限，再写）
+ */
+static int appRegWrite(uint16_t u16Addr, uint16_t u16Count, const uint16_t *pData)
+{
+    int i = appRegCheckRange(u16Addr, u16Count, APP_REG_WO);
+    if (i < 0)
+    {
+        return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+    }
+
+    while (u16Count > 0)
+    {
+        const AppRegDesc_t *d = &s_regMap[i++];
+        uint16_t u16Off = (uint16_t)(u16Addr - d->u16Start);
+        uint16_t n = (uint16_t)(d->u16Count - u16Off);
+        if (n > u16Count)
+        {
+            n = u16Count;
+        }
+
+        if (d->pfnSet == NULL)
+        {
+            memcpy(&holding_registers[u16Addr], pData, n * sizeof(uint16_t));
+        }
+        else
+        {
+            for (uint16_t k = 0; k < n; k++)
+            {
+                int result = d->pfnSet((uint16_t)(u16Addr + k), pData[k]);
+                if (result != MODBUS_OK)
                 {
-                    // 返回寄存器缓存值
-                    pData[i] = holding_registers[regAddr];
+                    return result;
                 }
             }
-            break;
+        }
+        pData += n;
+        u16Addr = (uint16_t)(u16Addr + n);
+        u16Count = (uint16_t)(u16Count - n);
+    }
+    return MODBUS_OK;
+}
+
+/**
+ * @brief 应用层实现的回调函数
+ * @details
+ * 当协议栈需要应用数据的时候，协议栈会在验证通过一条合法的命令后，
+ * 调用此函数来执行实际的数据读写操作。地址分发全部由 s_regMap 完成。
+ * @note 两路串口共用同一张映射表；Modbus_Poll 都在主循环中串行执行，回调不会交错。
+ */
+int App_RegisterCallback(uint8_t u8FuncCode, uint16_t u16Addr, uint16_t u16Count, uint16_t* pData)
+{
+    switch (u8FuncCode)
+    {
+#if (MODBUS_SUPPORT_FC03 == 1)
+        case 0x03: // 读保持寄存器
+            return appRegRead(u16Addr, u16Count, pData);
 #endif
-            
+
 #if (MODBUS_SUPPORT_FC06 == 1)
         case 0x06: // 写单个寄存器
-            // 处理继电器控制寄存器
-            if (u16Addr == MODBUS_REG_RELAY_CONTROL)
-            {
-                // 控制继电器状态
-                if (relaySetAllStates((uint8_t)(*pData)) == HAL_OK)
-                {
-                    holding_registers[u16Addr] = *pData;
-                }
-                else
-                {
-                    return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
-                }
-            }
-            else
-            {
-                // 普通寄存器写入
-                holding_registers[u16Addr] = *pData;
-            }
-            break;
+            return appRegWrite(u16Addr, 1, pData);
 #endif
-            
+
 #if (MODBUS_SUPPORT_FC10 == 1)
         case 0x10: // 写多个寄存器
-            // 处理多个寄存器写入
-            for (int i = 0; i < u16Count; i++)
+            return appRegWrite(u16Addr, u16Count, pData);
+#endif
+
+#if (MODBUS_SUPPORT_FC16 == 1)
+        case 0x16: // 掩码写寄存器：pData[0] = AND，pData[1] = OR
+        {
+            // 需要可读可写；读改写与写入（含继电器输出）在同一次回调内完成
+            if (appRegCheckRange(u16Addr, 1, APP_REG_RW) < 0)
             {
-                uint16_t regAddr = u16Addr + i;
-                
-                // 处理继电器控制寄存器
-                if (regAddr == MODBUS_REG_RELAY_CONTROL)
-                {
-                    if (relaySetAllStates((uint8_t)pData[i]) == HAL_OK)
-                    {
-                        holding_registers[regAddr] = pData[i];
-                    }
-                    else
-                    {
-                        return MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
-                    }
-                }
-                else
-                {
-                    // 普通寄存器写入
-                    holding_registers[regAddr] = pData[i];
-                }
+                return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
             }
-            break;
+            uint16_t u16Current;
+            appRegRead(u16Addr, 1, &u16Current);
+            uint16_t u16New = (uint16_t)((u16Current & pData[0]) | (pData[1] & (uint16_t)~pData[0]));
+            return appRegWrite(u16Addr, 1, &u16New);
+        }
 #endif
+
         default:
             // 这里不会到达，因为协议栈已经过滤了不支持的功能码
             return MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
     }
-
-    return MODBUS_OK; // 操作成功
 }
 
 //=============================================================================
 // 3. 应用初始化函数 (Application Initialization Function)
 //=============================================================================
 
-void App_Modbus_Init(void)
+void App_Modbus_Init(ModbusInstance_t *pInstance1, ModbusInstance_t *pInstance2)
 {
     /* 初始化保持寄存器为默认值 */
     for(int i = 0; i < MODBUS_HOLDING_REG_COUNT; i++)
@@ -158,17 +280,15 @@ void App_Modbus_Init(void)
         holding_registers[i] = 0;
     }
     
-    // 同步继电器状态到寄存器
-    holding_registers[MODBUS_REG_RELAY_CONTROL] = relayGetAllStates();
-    holding_registers[MODBUS_REG_RELAY_STATUS] = relayGetAllStates();
+    // 继电器控制/状态寄存器由访问函数直接反映实际输出，无需同步
 
     /* === 初始化Modbus实例1 (USART1) === */
     // Modbus_Init在main.c中调用，这里只注册回调函数和硬件
-    Modbus_RegisterCallback(&g_modbus_instance1, App_RegisterCallback);
-    Modbus_HAL_Init(&g_modbus_instance1); // 启动第一次DMA接收
+    Modbus_RegisterCallback(pInstance1, App_RegisterCallback);
+    Modbus_HAL_Init(pInstance1); // 启动第一次DMA接收
 
     /* === 初始化Modbus实例2 (USART2) === */
     // Modbus_Init在main.c中调用，这里只注册回调函数和硬件
-    Modbus_RegisterCallback(&g_modbus_instance2, App_RegisterCallback);
-    Modbus_HAL_Init(&g_modbus_instance2); // 启动第一次DMA接收
+    Modbus_RegisterCallback(pInstance2, App_RegisterCallback);
+    Modbus_HAL_Init(pInstance2); // 启动第一次DMA接收
 }
@@ -6,7 +6,7 @@
  * @FilePath: \MDK-ARMe:\data\lighting_ultra\lighting_ultra\Core\Src\main.c
  * @Description: 这是默认设置,请设置`customMade`, 打开koroFileHeader查看配置 进行设置: https://github.com/OBKoro1/koro1FileHeader/wiki/%E9%85%8D%E7%BD%AE
  */
-/* main.c — STM32F103VCT6 + HAL + USART1 DMA + TIM2 + IDLE 检帧 + 快照式读 */
+/* main.c — STM32F103VCT6 + HAL + USART1 DMA + TIM2 t1.5/t3.5 检帧 + 快照式读 */
 #include "stm32f1xx_hal.h"
 #include "stm32f1xx_hal_tim.h"
 #include "../../MDK-ARM/modbus_rtu_slave.h"
@@ -15,6 +15,12 @@
 #include "usart2_simple_test.h"
 #include "usart1_echo_test.h"
 #include "app_config.h"
+#include "app_event.h"
+#include "relay.h"
+#include "relay_timer.h"
+#include "relay_seq.h"
+#include "app_gateway.h"
+#include "app_modbus_new.h"
 
 /* 运行模式选择集中到 app_config.h */
 
@@ -26,12 +32,21 @@ DMA_HandleTypeDef  hdma_usart1_tx;
 UART_HandleTypeDef huart2;  /* USART2: PA2/PA3 */
 DMA_HandleTypeDef  hdma_usart2_rx;
 DMA_HandleTypeDef  hdma_usart2_tx;
-// TIM_HandleTypeDef  htim2; // 暂时注释
+
+#if MODBUS_CAPTURE_ENABLE
+UART_HandleTypeDef huart3;  /* USART3: PB10 仅发送，抓包流输出 */
+DMA_HandleTypeDef  hdma_usart3_tx;
+#endif
 
 /* ---------------- 全局 Modbus 实例 ---------------- */
 ModbusRTU_Slave g_mb;   /* 绑定到 huart1 (USART1) */
 ModbusRTU_Slave g_mb2;  /* 绑定到 huart2 (USART2) */
 
+#if RUN_MODE_INSTANCE
+ModbusInstance_t g_modbus_instance1;   /* 运行模式 6：ModbusInstance_t 协议栈，USART1 */
+ModbusInstance_t g_modbus_instance2;   /* 运行模式 6：ModbusInstance_t 协议栈，USART2 */
+#endif
+
 
 
 /* ---------------- 原型 ---------------- */
@@ -40,16 +55,249 @@ static void MX_GPIO_Init(void);
 static void MX_DMA_Init(void);
 static void MX_USART1_UART_Init(void);  /* USART1: PA9/PA10 */
 static void MX_USART2_UART_Init(void);  /* USART2: PA2/PA3 */
-// static void MX_TIM2_Init(void); // 暂时注释
+#if MODBUS_CAPTURE_ENABLE
+static void MX_USART3_UART_Init(void);  /* USART3: PB10 */
+#endif
 
 /* RS485 direction control is now defined in modbus_rtu_slave.h */
 
-/* ---------------- 用户写寄存器回调（示例：保持寄存器0 控制 LED） ---------------- */
-void ModbusRTU_PostWriteCallback(uint16_t addr, uint16_t value)
+#if RUN_MODE_MODBUS
+/* ---------------- 主循环负载统计（输入寄存器，两个通道相同） ---------------- */
+#define IREG_LOOP_IDLE_PERMILLE   90U   /* 上一秒空闲千分比 */
+#define IREG_LOOP_WAKEUPS         91U   /* 上一秒 WFI 唤醒次数 */
+#define IREG_LOOP_DISPATCHES      92U   /* 上一秒处理事件次数 */
+#define IREG_UART_ERR_BASE        93U   /* 93-96 本通道 ORE/FE/NE/PE 累计次数（饱和于 65535） */
+#define IREG_TRACE_BASE           100U  /* 100-231 按功能码的请求处理延时（modbus_trace.h） */
+#define HREG_TRACE_RESET          20U   /* 写非 0：清空延时统计，随后自动回 0 */
+
+static inline uint16_t LoopStatsSat16(uint32_t v)
+{
+    return (v > 0xFFFFU) ? 0xFFFFU : (uint16_t)v;
+}
+
+static void LoopStatsPublish(void)
+{
+    AppEventStats_t st;
+    appEventGetStats(&st, 1);
+    uint16_t idle = appEventIdlePermille(&st);
+    uint16_t wakeups = LoopStatsSat16(st.wakeups);
+    uint16_t dispatches = LoopStatsSat16(st.dispatches);
+    static uint16_t trace[MB_TRACE_REG_COUNT];
+    ModbusTrace_Snapshot(trace);               /* 两个通道共用一份统计 */
+
+    ModbusRTU_Slave *mbs[2] = { &g_mb, &g_mb2 };
+    for (uint32_t i = 0; i < 2U; i++) {
+        /* 每秒自刷新的诊断块直接写，不登记变化（否则输入寄存器位图永远不空） */
+        MB_RegWriteBegin(mbs[i]);
+        mbs[i]->inputRegs[IREG_LOOP_IDLE_PERMILLE] = idle;
+        mbs[i]->inputRegs[IREG_LOOP_WAKEUPS]       = wakeups;
+        mbs[i]->inputRegs[IREG_LOOP_DISPATCHES]    = dispatches;
+        mbs[i]->inputRegs[IREG_UART_ERR_BASE + 0U] = LoopStatsSat16(mbs[i]->rxErrOverrun);
+        mbs[i]->inputRegs[IREG_UART_ERR_BASE + 1U] = LoopStatsSat16(mbs[i]->rxErrFraming);
+        mbs[i]->inputRegs[IREG_UART_ERR_BASE + 2U] = LoopStatsSat16(mbs[i]->rxErrNoise);
+        mbs[i]->inputRegs[IREG_UART_ERR_BASE + 3U] = LoopStatsSat16(mbs[i]->rxErrParity);
+        memcpy(&mbs[i]->inputRegs[IREG_TRACE_BASE], trace, sizeof(trace));
+        MB_RegWriteEnd(mbs[i]);
+    }
+}
+#endif
+
+#if MODBUS_CAPTURE_ENABLE
+/* ---------------- 抓包流：上一段 DMA 送完后释放，再送抓包环中下一段连续字节 ---------------- */
+static void CaptureDrain(void)
+{
+    static uint16_t inFlight;
+    if (huart3.gState != HAL_UART_STATE_READY) return;
+    if (inFlight != 0U) {
+        ModbusCapture_Consume(inFlight);
+        inFlight = 0;
+    }
+    const uint8_t *data;
+    uint16_t n = ModbusCapture_Peek(&data);
+    if (n != 0U && HAL_UART_Transmit_DMA(&huart3, (uint8_t *)data, n) == HAL_OK) {
+        inFlight = n;
+    }
+}
+#endif
+
+/* ---------------- 线圈 0-4 / 保持寄存器 10 的 bit0-4 驱动继电器 1-5 ----------------
+   离散输入 0-4 反映实际状态；保持寄存器 10 可用 0x16 掩码写单独开关某几路；
+   保持寄存器 30-34 为继电器 1-5 的定时命令字（relay_timer.h），运行中读回命令字，空闲为 0。
+   保持寄存器 11 写目标位图入队，后台按寄存器 12 的间隔逐路吸合（relay_seq.h），写入即应答；
+   输入寄存器 97-99 为队列深度、当前命令待吸合位图、已完成命令数。
+   直接写线圈/寄存器 10 清空排队，并取消状态被改变的通道上的定时。
+   输入寄存器 236 为最新变位事件序号，240-367 为事件环窗口（relay_event.h）：
+   16 个槽、每槽 4 个寄存器，连续映射两遍，从任意槽起一次读 64 个寄存器即按序号顺序取回 16 条 */
+#define COIL_RELAY_BASE     0U
+#define HREG_RELAY_MASK     10U
+#define HREG_RELAY_SEQ      11U
+#define HREG_RELAY_STAGGER  12U
+#define HREG_RELAY_TIMER    30U
+#define IREG_RELAY_SEQ_BASE 97U
+#define IREG_RELAY_EVT_SEQ  236U
+#define IREG_RELAY_EVT_BASE 240U
+#define RELAY_MASK_ALL      ((1U << RELAY_CHANNEL_COUNT) - 1U)
+
+static uint16_t s_relaySeqTarget;                               /* 最近一次入队的目标位图 */
+static uint16_t s_relayStagger = RELAY_SEQ_STAGGER_DEFAULT_MS;
+static uint32_t s_relayEvtPublished;                            /* 已发布到窗口的最新事件序号 */
+
+typedef char relayEvtWindowCheck[(IREG_RELAY_EVT_BASE + 2U * RELAY_EVENT_RING * RELAY_EVENT_REGS
+                                  <= MB_INPUT_REGS_SIZE) ? 1 : -1];
+
+static void RelayStatusPublish(void)
+{
+    uint8_t mask = relayGetAllStates();
+
+    /* 上次发布之后的新事件（最多一整环）先编码好，再写进两个通道的窗口 */
+    static uint16_t evtRegs[RELAY_EVENT_RING][RELAY_EVENT_REGS];
+    uint8_t evtSlot[RELAY_EVENT_RING];
+    uint32_t evtCount = 0;
+    uint32_t latest = relayEventLatest();
+    uint32_t seq = (latest - s_relayEvtPublished > RELAY_EVENT_RING) ? latest - RELAY_EVENT_RING : s_relayEvtPublished;
+    while (seq != latest) {
+        RelayEvent_t e;
+        seq++;
+        if (relayEventGet(seq, &e)) {
+            relayEventToRegs(&e, evtRegs[evtCount]);
+            evtSlot[evtCount++] = (uint8_t)(seq & (RELAY_EVENT_RING - 1U));
+        }
+    }
+    s_relayEvtPublished = latest;
+
+    ModbusRTU_Slave *mbs[2] = { &g_mb, &g_mb2 };
+    for (uint32_t i = 0; i < 2U; i++) {
+        MB_RegWriteBegin(mbs[i]);
+        for (uint16_t ch = 0; ch < RELAY_CHANNEL_COUNT; ch++) {
+            uint8_t on = (uint8_t)((mask >> ch) & 1U);
+            MB_BitPut(mbs[i]->coils, COIL_RELAY_BASE + ch, on);   /* 两个串口的线圈保持一致 */
+            MB_BitPut(mbs[i]->discreteInputs, ch, on);
+        }
+        MB_PutHolding(mbs[i], HREG_RELAY_MASK, mask);
+        MB_PutHolding(mbs[i], HREG_RELAY_SEQ, s_relaySeqTarget);
+        MB_PutHolding(mbs[i], HREG_RELAY_STAGGER, s_relayStagger);
+        for (uint16_t ch = 0; ch < RELAY_CHANNEL_COUNT; ch++) {
+            MB_PutHolding(mbs[i], HREG_RELAY_TIMER + ch, relayTimerGetCommand((RelayChannel_e)ch));
+        }
+        MB_PutInput(mbs[i], IREG_RELAY_SEQ_BASE + 0U, relaySeqDepth());
+        MB_PutInput(mbs[i], IREG_RELAY_SEQ_BASE + 1U, relaySeqPending());
+        MB_PutInput(mbs[i], IREG_RELAY_SEQ_BASE + 2U, relaySeqCompleted());
+        for (uint32_t k = 0; k < evtCount; k++) {
+            uint16_t slot = (uint16_t)(IREG_RELAY_EVT_BASE + evtSlot[k] * RELAY_EVENT_REGS);
+            MB_PutInputRange(mbs[i], slot, evtRegs[k], RELAY_EVENT_REGS);
+            MB_PutInputRange(mbs[i], (uint16_t)(slot + RELAY_EVENT_RING * RELAY_EVENT_REGS),
+                             evtRegs[k], RELAY_EVENT_REGS);                        /* 镜像 */
+        }
+        MB_PutInput(mbs[i], IREG_RELAY_EVT_SEQ, (uint16_t)latest);
+        MB_RegWriteEnd(mbs[i]);
+    }
+}
+
+/* 直接开关继电器：新状态 = (当前 & keepMask) | (setMask & ~keepMask)。
+   清空排队、取消将被改变的通道上的定时、输出，与读取当前状态在同一关中断区间内完成：
+   SysTick 里的定时/排队动作刚改过的通道不会被落后的寄存器镜像改回去 */
+static void RelayApplyBits(uint8_t keepMask, uint8_t setMask)
+{
+    uint32_t primask = MB_CriticalEnter();
+    uint8_t cur = relayGetAllStates();
+    uint8_t mask = (uint8_t)(((cur & keepMask) | (setMask & (uint8_t)~keepMask)) & RELAY_MASK_ALL);
+    relaySeqFlush();
+    relayTimerCancel((uint8_t)(mask ^ cur));
+    relaySetMaskedFrom(RELAY_MASK_ALL, mask, RELAY_SRC_MODBUS);
+    MB_CriticalExit(primask);
+}
+
+void ModbusRTU_CommitWriteCoils(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity)
+{
+    if (startAddr >= COIL_RELAY_BASE + RELAY_CHANNEL_COUNT
+        || (uint32_t)startAddr + quantity <= COIL_RELAY_BASE) {
+        return;
+    }
+    /* 只动本次写到的通道，其余通道以实际状态为准（线圈镜像可能落后于定时动作） */
+    uint8_t written = 0;
+    uint8_t mask = 0;
+    for (uint16_t ch = 0; ch < RELAY_CHANNEL_COUNT; ch++) {
+        uint16_t coil = COIL_RELAY_BASE + ch;
+        if (coil < startAddr || coil >= (uint32_t)startAddr + quantity) continue;
+        written |= (uint8_t)(1U << ch);
+        if (MB_BitGet(mb->coils, coil)) mask |= (uint8_t)(1U << ch);
+    }
+    RelayApplyBits((uint8_t)~written, mask);
+    RelayStatusPublish();
+}
+
+/* 0x16 写继电器位图：对实际状态做 AND/OR，不用可能落后的寄存器 10 镜像 */
+uint8_t ModbusRTU_MaskWriteHook(ModbusRTU_Slave *mb, uint16_t addr, uint16_t andMask,
+                                uint16_t orMask, uint8_t *handled)
 {
-    if (addr == 0) {
-        /* PB1 低电平点亮 */
-        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_1, (value > 0) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    (void)mb;
+    *handled = (addr == HREG_RELAY_MASK);
+    if (*handled) {
+        RelayApplyBits((uint8_t)andMask, (uint8_t)orMask);
+        RelayStatusPublish();
+    }
+    return 0;
+}
+
+/* ---------------- 用户写寄存器校验：定时命令字/目标位图无效时整段拒绝（异常码 0x03），
+   队列已满时拒绝入队（异常码 0x06，主站稍后重试） ---------------- */
+uint8_t ModbusRTU_ValidateWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr,
+                                     uint16_t quantity, const uint8_t *values)
+{
+    (void)mb;
+    for (uint16_t i = 0; i < quantity; i++) {
+        uint16_t addr = startAddr + i;
+        uint16_t value = MB_BE16(&values[2U * i]);
+        if (addr >= HREG_RELAY_TIMER && addr < HREG_RELAY_TIMER + RELAY_CHANNEL_COUNT
+            && !relayTimerCommandValid(value)) {
+            return MB_EX_ILLEGAL_DATA_VALUE;
+        }
+        if (addr == HREG_RELAY_SEQ) {
+            if (value & (uint16_t)~RELAY_MASK_ALL) return MB_EX_ILLEGAL_DATA_VALUE;
+            if (relaySeqDepth() >= RELAY_SEQ_DEPTH) return MB_EX_SLAVE_DEVICE_BUSY;
+        }
+    }
+    return 0;
+}
+
+/* ---------------- 用户写寄存器回调 ---------------- */
+void ModbusRTU_CommitWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity)
+{
+    if (startAddr == 0) {
+        /* 示例：保持寄存器0 控制 LED，PB1 低电平点亮 */
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_1, (mb->holdingRegs[0] > 0) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    }
+#if RUN_MODE_MODBUS
+    if (startAddr <= HREG_TRACE_RESET && (uint32_t)startAddr + quantity > HREG_TRACE_RESET
+        && mb->holdingRegs[HREG_TRACE_RESET] != 0U) {
+        ModbusTrace_Reset();
+        MB_SafeWriteHolding(mb, HREG_TRACE_RESET, 0);
+    }
+#endif
+    uint8_t relayChanged = 0;
+    if (startAddr <= HREG_RELAY_MASK && (uint32_t)startAddr + quantity > HREG_RELAY_MASK) {
+        RelayApplyBits(0, (uint8_t)(mb->holdingRegs[HREG_RELAY_MASK] & RELAY_MASK_ALL));
+        relayChanged = 1;
+    }
+    if (startAddr <= HREG_RELAY_STAGGER && (uint32_t)startAddr + quantity > HREG_RELAY_STAGGER) {
+        s_relayStagger = mb->holdingRegs[HREG_RELAY_STAGGER];
+        relaySeqSetStagger(s_relayStagger);
+        relayChanged = 1;
+    }
+    if (startAddr <= HREG_RELAY_SEQ && (uint32_t)startAddr + quantity > HREG_RELAY_SEQ) {
+        s_relaySeqTarget = mb->holdingRegs[HREG_RELAY_SEQ];
+        relaySeqEnqueue((uint8_t)s_relaySeqTarget);             /* 已在 Validate 中检查余量 */
+        relayChanged = 1;
+    }
+    for (uint16_t ch = 0; ch < RELAY_CHANNEL_COUNT; ch++) {
+        uint16_t addr = HREG_RELAY_TIMER + ch;
+        if (startAddr <= addr && (uint32_t)startAddr + quantity > addr) {
+            relayTimerArm((RelayChannel_e)ch, mb->holdingRegs[addr]);   /* 已在 Validate 中校验 */
+            relayChanged = 1;
+        }
+    }
+    if (relayChanged) {
+        RelayStatusPublish();
     }
 }
 
@@ -63,21 +311,29 @@ int main(void)
     MX_DMA_Init();
     MX_USART1_UART_Init();  /* 初始化串口2 (USART1) */
     MX_USART2_UART_Init();  /* 初始化串口1 (USART2) */
-    // MX_TIM2_Init(); // 暂时注释，避免链接错误
+#if MODBUS_CAPTURE_ENABLE
+    MX_USART3_UART_Init();  /* 抓包流输出 */
+#endif
 
     /* 使能 USART IDLE 中断 */
     /* 为了调试方便，两个串口的IDLE中断都启用 */
     __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
     __HAL_UART_ENABLE_IT(&huart2, UART_IT_IDLE);
 
-    #if RUN_MODE_ECHO_TEST == 0
+    #if RUN_MODE_MODBUS
         /* 仅在Modbus模式下初始化 */
         /* Modbus 初始化 */
+        appEventInit();
+        ModbusCapture_Init(huart1.Init.BaudRate);   /* 需在 DWT 使能之后 */
         ModbusRTU_Init(&g_mb,  &huart1, 0x01);  /* USART1: 从站地址 0x01 */
         ModbusRTU_Init(&g_mb2, &huart2, 0x02);  /* USART2: 从站地址 0x02 */
-
-        /* 启动 1ms 定时中断（兜底用） */
-        // HAL_TIM_Base_Start_IT(&htim2); // 暂时注释，避免链接错误
+        relayInit();
+        RelayStatusPublish();
+    #if RUN_MODE_GATEWAY
+        /* 网关模式：USART1 上游仍是本站 0x01，路由表内的地址直通转发到 USART2 */
+        gatewayInit(&g_mb, &g_mb2);
+    #endif
+        /* TIM2 由 ModbusRTU_Init 按寄存器配置为 1MHz 自由计数，用作 t1.5/t3.5 帧定时 */
 
         /* 测试数据 */
         g_mb.holdingRegs[0] = 100;
@@ -93,6 +349,17 @@ int main(void)
         g_mb2.inputRegs[1]   = 6000;
     #endif
 
+    #if RUN_MODE_INSTANCE
+        /* ModbusInstance_t 协议栈：IDLE 中断交出整帧，主循环 Modbus_Poll 处理 */
+        appEventInit();
+        relayInit();
+        Modbus_Init(&g_modbus_instance1, 0x01, &huart1, &hdma_usart1_rx, &hdma_usart1_tx,
+                    MB_USART1_RS485_DE_GPIO_Port, MB_USART1_RS485_DE_Pin);
+        Modbus_Init(&g_modbus_instance2, 0x02, &huart2, &hdma_usart2_rx, &hdma_usart2_tx,
+                    MB_USART2_RS485_DE_GPIO_Port, MB_USART2_RS485_DE_Pin);
+        App_Modbus_Init(&g_modbus_instance1, &g_modbus_instance2);
+    #endif
+
     #if RUN_MODE_ECHO_TEST == 3
         /* 简单测试模式 - 最基础版本 */
         usart2SimpleTestRun();
@@ -105,12 +372,40 @@ int main(void)
     #elif RUN_MODE_ECHO_TEST == 4
         /* USART1(PA9/PA10)回环测试模式 */
         usart1EchoTestRun();
+    #elif RUN_MODE_INSTANCE
+        /* ModbusInstance_t 协议栈：WFI 休眠，IDLE 交出新帧后才轮询对应实例 */
+        while (1) {
+            uint32_t ev = appEventWait();
+            if (ev & APP_EVT_MB_USART1) {
+                Modbus_Poll(&g_modbus_instance1);
+            }
+            if (ev & APP_EVT_MB_USART2) {
+                Modbus_Poll(&g_modbus_instance2);
+            }
+        }
     #else
-        /* Modbus双串口模式 */
+        /* Modbus双串口/网关模式：WFI 休眠，IDLE/Tx完成/错误中断置位事件后才处理 */
         while (1) {
-            ModbusRTU_Process(&g_mb);   /* 处理USART1 */
-            ModbusRTU_Process(&g_mb2);  /* 处理USART2 */
-            HAL_Delay(1);
+            uint32_t ev = appEventWait();
+            if (ev & APP_EVT_RELAY) {
+                /* 定时到期/排队命令已动作，先刷新线圈/状态/定时/队列寄存器，本轮的读请求即看到新状态 */
+                RelayStatusPublish();
+            }
+            if (ev & APP_EVT_MB_USART1) {
+                ModbusRTU_Process(&g_mb);   /* 处理USART1 */
+            }
+            if (ev & APP_EVT_MB_USART2) {
+                ModbusRTU_Process(&g_mb2);  /* 处理USART2 */
+            }
+            if (ev & APP_EVT_SECOND) {
+                LoopStatsPublish();
+            }
+        #if RUN_MODE_GATEWAY
+            gatewayProcess();
+        #endif
+        #if MODBUS_CAPTURE_ENABLE
+            CaptureDrain();         /* 每次醒来都送：新帧、上一段送完（APP_EVT_CAPTURE）或每秒兜底 */
+        #endif
         }
     #endif
 }
@@ -188,16 +483,18 @@ static void MX_DMA_Init(void)
 {
     __HAL_RCC_DMA1_CLK_ENABLE();
 
+    /* RX 通道与对应 USART 同抢占级（0）：半满/满与 IDLE 都会折叠接收 CRC，
+       同级互不抢占，折叠状态无需再加锁 */
     /* USART1 DMA */
     HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 1, 0);  /* TX */
     HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
-    HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 1, 1);  /* RX */
+    HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 1);  /* RX */
     HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
     
     /* USART2 DMA */
     HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 1, 2);  /* TX */
     HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
-    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 1, 3);  /* RX */
+    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 0, 3);  /* RX */
     HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
 }
 
@@ -319,24 +616,50 @@ static void MX_USART2_UART_Init(void)
     HAL_NVIC_EnableIRQ(USART2_IRQn);
 }
 
-/* ---------------- TIM2: 1ms 中断 (暂时注释) ---------------- */
-/*
-static void MX_TIM2_Init(void)
+#if MODBUS_CAPTURE_ENABLE
+/* ---------------- USART3 (PB10 TX)：抓包流，仅发送 ---------------- */
+static void MX_USART3_UART_Init(void)
 {
-    __HAL_RCC_TIM2_CLK_ENABLE();
-
-    htim2.Instance = TIM2;
-    htim2.Init.Prescaler         = 72 - 1;   // 72MHz /72 = 1MHz
-    htim2.Init.CounterMode       = TIM_COUNTERMODE_UP;
-    htim2.Init.Period            = 1000 - 1; // 1ms
-    htim2.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
-    htim2.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
-    if (HAL_TIM_Base_Init(&htim2) != HAL_OK) { while(1); }
-
-    HAL_NVIC_SetPriority(TIM2_IRQn, 2, 0);
-    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+    __HAL_RCC_USART3_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    /* GPIO：TX PB10（RX PB11 不用） */
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_InitStruct.Pin   = GPIO_PIN_10;
+    GPIO_InitStruct.Mode  = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* USART3 配置 */
+    huart3.Instance        = USART3;
+    huart3.Init.BaudRate   = MB_CAP_STREAM_BAUD;
+    huart3.Init.WordLength = UART_WORDLENGTH_8B;
+    huart3.Init.StopBits   = UART_STOPBITS_1;
+    huart3.Init.Parity     = UART_PARITY_NONE;
+    huart3.Init.Mode       = UART_MODE_TX;
+    huart3.Init.HwFlowCtl  = UART_HWCONTROL_NONE;
+    huart3.Init.OverSampling = UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart3) != HAL_OK) { while(1); }
+
+    /* DMA TX: DMA1_Channel2 */
+    hdma_usart3_tx.Instance                 = DMA1_Channel2;
+    hdma_usart3_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma_usart3_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_usart3_tx.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_usart3_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart3_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_usart3_tx.Init.Mode                = DMA_NORMAL;
+    hdma_usart3_tx.Init.Priority            = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_usart3_tx) != HAL_OK) { while(1); }
+    __HAL_LINKDMA(&huart3, hdmatx, hdma_usart3_tx);
+
+    /* 抓包流优先级最低，不抢占 Modbus 通道 */
+    HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+    HAL_NVIC_SetPriority(USART3_IRQn, 3, 1);
+    HAL_NVIC_EnableIRQ(USART3_IRQn);
 }
-*/
+#endif
 
 /* ---------------- Error Handler ---------------- */
 void Error_Handler(void)
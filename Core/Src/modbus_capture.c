@@ -0,0 +1,147 @@
+/**
+ * @file modbus_capture.c
+ * @brief 固件侧抓包环：帧处理路径写入，主循环经 USART3 DMA 送出
+ * @details
+ * 生产者有两个：主循环（收到的帧、直接发送的应答）与 TIM2 中断（DE 前保护时间到期后才发送的应答），
+ * 写入在关中断下完成，一条记录要么整条进环要么整条丢弃；消费者只有主循环。
+ * 时间戳由 DWT 周期计数扩展为 32 位 us（每次写入时累加，两次写入间隔不超过 CYCCNT 回绕周期即可，
+ * 主循环每秒至少醒一次）。
+ * 需要 DWT 周期计数器已使能（appEventInit），帧的 IDLE 时刻来自 modbus_trace 的打点。
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+#include "modbus_capture.h"
+#include "modbus_trace.h"
+
+#if MODBUS_CAPTURE_ENABLE
+
+#if !MODBUS_TRACE_ENABLE
+#error "MODBUS_CAPTURE_ENABLE 需要 MODBUS_TRACE_ENABLE（帧的 IDLE 时刻由跟踪打点提供）"
+#endif
+
+#define MB_CAP_RING_MASK        (MB_CAP_RING_SIZE - 1U)
+
+//=============================================================================
+// 1. 私有变量 (Private Variables)
+//=============================================================================
+
+static uint8_t  s_ring[MB_CAP_RING_SIZE];
+static volatile uint32_t s_head;        /* 生产者（自由运行） */
+static volatile uint32_t s_tail;        /* 消费者（自由运行） */
+static uint32_t s_dropped;
+
+static uint32_t s_lastCyc;              /* 扩展时钟：上次换算时的 CYCCNT */
+static uint32_t s_us;                   /* 扩展时钟：s_lastCyc 对应的 us */
+static uint32_t s_cycRem;               /* 不足 1us 的余数周期 */
+
+//=============================================================================
+// 2. 私有函数 (Private Functions)
+//=============================================================================
+
+/* 关中断下调用：把扩展时钟推进到现在，返回周期计数 cyc 对应的 us（cyc 不晚于现在） */
+static uint32_t mbCapUsAt(uint32_t cyc)
+{
+    uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+    uint32_t now = DWT->CYCCNT;
+    uint32_t elapsed = (now - s_lastCyc) + s_cycRem;
+    s_us += elapsed / cyclesPerUs;
+    s_cycRem = elapsed % cyclesPerUs;
+    s_lastCyc = now;
+    return s_us - (now - cyc) / cyclesPerUs;
+}
+
+static void mbCapCopy(uint32_t pos, const void *src, uint32_t len)
+{
+    uint32_t off = pos & MB_CAP_RING_MASK;
+    uint32_t first = MB_CAP_RING_SIZE - off;
+    if (first >= len) {
+        memcpy(&s_ring[off], src, len);
+    } else {
+        memcpy(&s_ring[off], src, first);
+        memcpy(s_ring, (const uint8_t *)src + first, len - first);
+    }
+}
+
+static void mbCapPut(uint8_t flags, const uint8_t *data, uint16_t len, uint32_t cyc, uint32_t backUs)
+{
+    if (len == 0U) return;
+    if (len > MB_CAP_REC_MAX) len = MB_CAP_REC_MAX;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    ModbusCaptureRec_t rec;
+    rec.sync  = MB_CAP_SYNC;
+    rec.flags = flags;
+    rec.len   = len;
+    rec.tUs   = mbCapUsAt(cyc) - backUs;
+
+    uint32_t need = (uint32_t)sizeof(rec) + len;
+    if (MB_CAP_RING_SIZE - (s_head - s_tail) < need) {
+        s_dropped++;
+    } else {
+        mbCapCopy(s_head, &rec, sizeof(rec));
+        mbCapCopy(s_head + sizeof(rec), data, len);
+        s_head += need;
+    }
+    __set_PRIMASK(primask);
+}
+
+//=============================================================================
+// 3. 接口函数 (API)
+//=============================================================================
+
+void ModbusCapture_Init(uint32_t baud)
+{
+    ModbusCaptureHdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MB_CAP_MAGIC, MB_CAP_MAGIC_LEN);
+    hdr.baud = baud;
+    hdr.role = MB_CAP_ROLE_SLAVE;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    s_head = 0;
+    s_tail = 0;
+    s_dropped = 0;
+    s_lastCyc = DWT->CYCCNT;
+    s_us = 0;
+    s_cycRem = 0;
+    mbCapCopy(0, &hdr, sizeof(hdr));
+    s_head = sizeof(hdr);
+    __set_PRIMASK(primask);
+}
+
+void ModbusCapture_Rx(uint8_t chan, const uint8_t *data, uint16_t len, uint32_t idleCyc, uint32_t baud, uint8_t err)
+{
+    /* IDLE 在最后一字节之后空闲一个字符时置位：首字节起始位 = IDLE - (len + 1) 个字符 */
+    uint32_t backUs = (uint32_t)(((uint64_t)(len + 1U) * 10U * 1000000U + baud / 2U) / baud);
+    mbCapPut((uint8_t)((chan & MB_CAP_CHAN_MASK) | (err ? MB_CAP_F_ERR : 0U)), data, len, idleCyc, backUs);
+}
+
+void ModbusCapture_Tx(uint8_t chan, const uint8_t *data, uint16_t len)
+{
+    mbCapPut((uint8_t)((chan & MB_CAP_CHAN_MASK) | MB_CAP_F_TX), data, len, DWT->CYCCNT, 0);
+}
+
+uint16_t ModbusCapture_Peek(const uint8_t **data)
+{
+    uint32_t tail = s_tail;
+    uint32_t avail = s_head - tail;
+    uint32_t off = tail & MB_CAP_RING_MASK;
+    uint32_t n = MB_CAP_RING_SIZE - off;
+    *data = &s_ring[off];
+    return (uint16_t)((avail < n) ? avail : n);
+}
+
+void ModbusCapture_Consume(uint16_t n)
+{
+    s_tail += n;
+}
+
+uint32_t ModbusCapture_Dropped(void)
+{
+    return s_dropped;
+}
+
+#endif /* MODBUS_CAPTURE_ENABLE */
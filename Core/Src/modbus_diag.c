@@ -0,0 +1,123 @@
+/**
+ * @file modbus_diag.c
+ * @brief Modbus 0x08 诊断 / 0x0B 通信事件计数实现
+ * @details
+ * 0x08 应答是请求的回送：计数类子功能把数据字段替换为计数值，
+ * 0x00 原样回送任意长度的数据。数据字段不为 0 的计数请求回异常 0x03。
+ */
+
+#include <string.h>
+#include "modbus_diag.h"
+
+void ModbusDiag_Clear(ModbusDiag_t *diag)
+{
+    uint8_t listenOnly = diag->listenOnly;
+    memset(diag, 0, sizeof(*diag));
+    diag->listenOnly = listenOnly;
+}
+
+static uint16_t mbDiagRegister(const ModbusDiag_t *diag)
+{
+    uint16_t reg = 0;
+    if (diag->charOverrun != 0U || diag->messageOverrun != 0U) reg |= MB_DIAG_REG_OVERRUN;
+    if (diag->listenOnly) reg |= MB_DIAG_REG_LISTEN_ONLY;
+    return reg;
+}
+
+static uint16_t mbDiagCounter(const ModbusDiag_t *diag, uint16_t sub, uint8_t *found)
+{
+    *found = 1;
+    switch (sub) {
+        case MB_DIAG_RETURN_DIAG_REGISTER:    return mbDiagRegister(diag);
+        case MB_DIAG_BUS_MESSAGE_COUNT:       return diag->busMessage;
+        case MB_DIAG_BUS_COMM_ERROR_COUNT:    return (uint16_t)(diag->busCommError + diag->busFrameError);
+        case MB_DIAG_BUS_EXCEPTION_COUNT:     return diag->busException;
+        case MB_DIAG_SLAVE_MESSAGE_COUNT:     return diag->slaveMessage;
+        case MB_DIAG_SLAVE_NO_RESPONSE_COUNT: return diag->slaveNoResponse;
+        case MB_DIAG_SLAVE_NAK_COUNT:         return diag->slaveNak;
+        case MB_DIAG_SLAVE_BUSY_COUNT:        return diag->slaveBusy;
+        case MB_DIAG_BUS_CHAR_OVERRUN_COUNT:  return (uint16_t)(diag->charOverrun + diag->messageOverrun);
+        default:
+            *found = 0;
+            return 0;
+    }
+}
+
+uint16_t ModbusDiag_Serve(ModbusDiag_t *diag, const uint8_t *req, uint16_t len,
+                          uint8_t *resp, uint8_t *exCode)
+{
+    *exCode = 0;
+
+    if (req[1] == MB_FUNC_GET_COMM_EVENT_COUNTER) {
+        if (len != 2U) {
+            *exCode = 0x03;
+            return 0;
+        }
+        resp[0] = req[0];
+        resp[1] = req[1];
+        resp[2] = 0x00;                             /* 状态字：无未完成的程序命令 */
+        resp[3] = 0x00;
+        resp[4] = (uint8_t)(diag->eventCount >> 8);
+        resp[5] = (uint8_t)(diag->eventCount & 0xFFU);
+        return 6;
+    }
+
+    /* 0x08：地址 + 功能码 + 子功能(2) + 数据(>=2) */
+    if (len < 6U) {
+        *exCode = 0x03;
+        return 0;
+    }
+    uint16_t sub  = (uint16_t)((req[2] << 8) | req[3]);
+    uint16_t data = (uint16_t)((req[4] << 8) | req[5]);
+
+    switch (sub) {
+        case MB_DIAG_RETURN_QUERY_DATA:
+            memmove(resp, req, len);
+            return len;
+
+        case MB_DIAG_RESTART_COMM: {
+            if (len != 6U || (data != 0x0000U && data != 0xFF00U)) break;
+            uint8_t wasListening = diag->listenOnly;
+            diag->listenOnly = 0;
+            ModbusDiag_Clear(diag);
+            if (wasListening) return 0;             /* 只听模式下的重启不应答 */
+            memmove(resp, req, len);
+            return len;
+        }
+
+        case MB_DIAG_FORCE_LISTEN_ONLY:
+            if (len != 6U || data != 0x0000U) break;
+            diag->listenOnly = 1;
+            return 0;
+
+        case MB_DIAG_CLEAR_COUNTERS:
+            if (len != 6U || data != 0x0000U) break;
+            ModbusDiag_Clear(diag);
+            memmove(resp, req, len);
+            return len;
+
+        case MB_DIAG_CLEAR_OVERRUN:
+            if (len != 6U || data != 0x0000U) break;
+            diag->charOverrun = 0;
+            diag->messageOverrun = 0;
+            memmove(resp, req, len);
+            return len;
+
+        default: {
+            uint8_t found;
+            uint16_t value = mbDiagCounter(diag, sub, &found);
+            if (!found) {
+                *exCode = 0x01;                     /* 不支持或保留的子功能（含 0x13） */
+                return 0;
+            }
+            if (len != 6U || data != 0x0000U) break;
+            memmove(resp, req, 4);
+            resp[4] = (uint8_t)(value >> 8);
+            resp[5] = (uint8_t)(value & 0xFFU);
+            return 6;
+        }
+    }
+
+    *exCode = 0x03;
+    return 0;
+}
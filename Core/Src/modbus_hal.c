@@ -48,13 +48,11 @@ HAL_StatusTypeDef Modbus_HAL_Transmit(ModbusInstance_t *pInstance, uint16_t u16L
         return HAL_ERROR;
     }
 
-    // 1. 将RS485收发器设置为发送模式
+    // 1. 将RS485收发器设置为发送模式（收发器使能时间远小于 DMA 启动到首个起始位的延迟，无需空转等待）
     Modbus_HAL_SetDirTx(pInstance);
-    
-    // 2. 添加小延时确保RS485方向切换稳定
-    for(volatile int i = 0; i < 10; i++); // 约1微秒延时
 
-    // 3. 使用STM32 HAL库函数启动DMA模式下的UART发送
+    // 2. 使用STM32 HAL库函数启动DMA模式下的UART发送；HAL 在 DMA 完成后改开 TC 中断，
+    //    发送完成回调在 TC 时到来，可直接在回调中切回接收
     return HAL_UART_Transmit_DMA(pInstance->huart, pInstance->au8TxBuffer, u16Length);
 }
 
@@ -72,4 +70,46 @@ void Modbus_HAL_SetDirRx(ModbusInstance_t *pInstance)
     {
         HAL_GPIO_WritePin(pInstance->de_re_port, pInstance->de_re_pin, GPIO_PIN_RESET);
     }
+}
+
+uint8_t Modbus_HAL_RxIdleISR(ModbusInstance_t *pInstance)
+{
+    if (pInstance == NULL || pInstance->hdma_rx == NULL)
+    {
+        return 0;
+    }
+
+    // 1. 上一帧仍在处理或发送：接收已停，缓冲区归协议栈所有，本帧丢弃
+    //    （此时不能调用 HAL_UART_DMAStop，它会连发送 DMA 一起中止）
+    if (pInstance->eState != STATE_IDLE)
+    {
+        pInstance->stDiag.messageOverrun++;
+        return 0;
+    }
+
+    // 2. 停止DMA后计数不再变化，剩余计数即可换算出本帧长度
+    Modbus_HAL_StopReception(pInstance);
+    uint16_t u16Len = (uint16_t)(MODBUS_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(pInstance->hdma_rx));
+    if (u16Len == 0)
+    {
+        Modbus_HAL_StartReception(pInstance);
+        return 0;
+    }
+
+    // 3. 交出新帧；处理期间不重启接收，由 Modbus_Poll（不应答）或发送完成后再启动
+    pInstance->u16RxLen = u16Len;
+    pInstance->eState = STATE_FRAME_RECEIVED;
+    return 1;
+}
+
+void Modbus_HAL_TxCpltISR(ModbusInstance_t *pInstance)
+{
+    if (pInstance == NULL)
+    {
+        return;
+    }
+    // TC 置位时最后一个停止位已移出，可直接释放总线
+    Modbus_HAL_SetDirRx(pInstance);
+    pInstance->eState = STATE_IDLE;
+    Modbus_HAL_StartReception(pInstance);
 }
\ No newline at end of file
@@ -8,8 +8,12 @@
 
 #include "modbus_slave.h"
 #include "modbus_hal.h"
+#include "modbus_crc.h"
 #include <string.h> // for memcpy
 
+/* 读应答（地址 + 功能码 + 字节数 + 数据 + CRC）须放得进发送缓冲区 */
+#define MODBUS_MAX_READ_REGS    ((MODBUS_BUFFER_SIZE - 5) / 2)
+
 //=============================================================================
 // 1. �ڲ���������ԭ�� (Internal Helper Function Prototypes)
 //=============================================================================
@@ -22,6 +26,14 @@
  */
 static uint16_t prvCRC16(const uint8_t *puchMsg, uint16_t usDataLen);
 
+/**
+ * @brief 把请求中的大端寄存器值转换为本机字节序
+ * @param pu8Src 请求中的数据起始地址（无对齐要求）
+ * @param u16Count 寄存器个数
+ * @param pu16Dst 输出缓冲区
+ */
+static void prvUnpackRegisters(const uint8_t *pu8Src, uint16_t u16Count, uint16_t *pu16Dst);
+
 /**
  * @brief ����һ֡�����ġ��ѽ��յ�����
  * @param pInstance ָ��ǰModbusʵ��
@@ -64,6 +76,7 @@ void Modbus_Init(ModbusInstance_t *pInstance,
     pInstance->eState = STATE_IDLE;
     pInstance->u16RxLen = 0;
     pInstance->pfnAppCallback = NULL;
+    memset(&pInstance->stDiag, 0, sizeof(pInstance->stDiag));
     
     // 清空接收和发送缓冲区
     for(int i = 0; i < MODBUS_BUFFER_SIZE; i++)
@@ -113,6 +126,11 @@ void Modbus_Poll(ModbusInstance_t *pInstance)
             // �յ���֡�������л�״̬����ʼ����
             pInstance->eState = STATE_PROCESSING;
             prvProcessFrame(pInstance);
+            if (pInstance->eState == STATE_IDLE)
+            {
+                // 不应答（CRC 错、非本站、广播、只听模式）：立即恢复接收；要应答的在发送完成后恢复
+                Modbus_HAL_StartReception(pInstance);
+            }
             break;
 
         case STATE_PROCESSING:
@@ -136,29 +154,40 @@ void Modbus_Poll(ModbusInstance_t *pInstance)
 static void prvProcessFrame(ModbusInstance_t *pInstance)
 {
     // 1. ��С����У�� (��ַ + ������ + CRC�� + CRC��)
+    pInstance->stDiag.busMessage++;
     if (pInstance->u16RxLen < 4)
     {
         pInstance->eState = STATE_IDLE;
         return;
     }
 
+    // 2. CRC校验（先于地址过滤，发给其他从站的错误帧也计入总线通信错误）
+    uint16_t u16CalculatedCRC = prvCRC16(pInstance->au8RxBuffer, pInstance->u16RxLen - 2);
+    // Modbus RTU: CRC低字节在前，高字节在后
+    uint16_t u16ReceivedCRC = (pInstance->au8RxBuffer[pInstance->u16RxLen - 2]) | (pInstance->au8RxBuffer[pInstance->u16RxLen - 1] << 8);
+
+    if (u16CalculatedCRC!= u16ReceivedCRC)
+    {
+        pInstance->stDiag.busCommError++;
+        pInstance->eState = STATE_IDLE;
+        return;
+    }
+
     uint8_t u8SlaveAddr = pInstance->au8RxBuffer[0];
     uint8_t u8FuncCode = pInstance->au8RxBuffer[1];
 
-    // 2. ��ַУ��
+    // 3. ��ַУ��
     if ((u8SlaveAddr!= pInstance->u8SlaveAddress) && (u8SlaveAddr!= MODBUS_BROADCAST_ADDRESS))
     {
         pInstance->eState = STATE_IDLE;
         return;
     }
 
-    // 3. CRC校验
-    uint16_t u16CalculatedCRC = prvCRC16(pInstance->au8RxBuffer, pInstance->u16RxLen - 2);
-    // Modbus RTU: CRC低字节在前，高字节在后
-    uint16_t u16ReceivedCRC = (pInstance->au8RxBuffer[pInstance->u16RxLen - 2]) | (pInstance->au8RxBuffer[pInstance->u16RxLen - 1] << 8);
-
-    if (u16CalculatedCRC!= u16ReceivedCRC)
+    pInstance->stDiag.slaveMessage++;
+    if (!ModbusDiag_Accepts(&pInstance->stDiag, pInstance->au8RxBuffer, pInstance->u16RxLen - 2))
     {
+        // 只听模式：只计数，不处理不应答
+        pInstance->stDiag.slaveNoResponse++;
         pInstance->eState = STATE_IDLE;
         return;
     }
@@ -179,7 +208,7 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
                 u16RegCount = (pInstance->au8RxBuffer[4] << 8) | pInstance->au8RxBuffer[5];
                 
                 // �������ļĴ��������Ƿ��ں�����Χ��
-                if (u16RegCount > 0 && u16RegCount <= 125)
+                if (u16RegCount > 0 && u16RegCount <= MODBUS_MAX_READ_REGS)
                 {
                     // ׼��һ����ʱ���������ص��������
                     uint16_t temp_data_buffer[125];
@@ -222,8 +251,8 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
                 if (callback_result == MODBUS_OK)
                 {
                     // �ɹ���ԭ����������֡��Ϊ��Ӧ
-                    memcpy(pInstance->au8TxBuffer, pInstance->au8RxBuffer, 8);
-                    u16TxLen = 8;
+                    memcpy(pInstance->au8TxBuffer, pInstance->au8RxBuffer, 6); // 不含请求 CRC，下面统一追加
+                    u16TxLen = 6;
                 }
             }
             break;
@@ -236,11 +265,15 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
                 u16RegCount = (pInstance->au8RxBuffer[4] << 8) | pInstance->au8RxBuffer[5];
                 uint8_t u8ByteCount = pInstance->au8RxBuffer[6];
 
-                if ((u8ByteCount == u16RegCount * 2) && (u16RegCount > 0 && u16RegCount <= 123))
+                if ((u8ByteCount == u16RegCount * 2) && (u16RegCount > 0 && u16RegCount <= 123)
+                    && (pInstance->u16RxLen >= 9 + u8ByteCount))
                 {
+                    // 请求中的寄存器值为大端，转换为本机字节序再交给回调
+                    uint16_t temp_data_buffer[123];
+                    prvUnpackRegisters(&pInstance->au8RxBuffer[7], u16RegCount, temp_data_buffer);
                     if (pInstance->pfnAppCallback!= NULL)
                     {
-                        callback_result = pInstance->pfnAppCallback(u8FuncCode, u16StartAddr, u16RegCount, (uint16_t*)&pInstance->au8RxBuffer[7]);
+                        callback_result = pInstance->pfnAppCallback(u8FuncCode, u16StartAddr, u16RegCount, temp_data_buffer);
                     }
 
                     if (callback_result == MODBUS_OK)
@@ -257,6 +290,96 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
                 }
             }
             break;
+#endif
+#if (MODBUS_SUPPORT_FC16 == 1)
+        case 0x16: // 掩码写寄存器：新值 = (当前 & AND) | (OR & ~AND)
+            if (pInstance->u16RxLen == 10)
+            {
+                u16StartAddr = (pInstance->au8RxBuffer[2] << 8) | pInstance->au8RxBuffer[3];
+                uint16_t au16Masks[2];
+                prvUnpackRegisters(&pInstance->au8RxBuffer[4], 2, au16Masks);
+                if (pInstance->pfnAppCallback!= NULL)
+                {
+                    // 读改写由应用层在一次回调内完成，两路串口都在主循环中轮询，不会交错
+                    callback_result = pInstance->pfnAppCallback(u8FuncCode, u16StartAddr, 1, au16Masks);
+                }
+
+                if (callback_result == MODBUS_OK)
+                {
+                    // 成功则原样回显请求
+                    memcpy(pInstance->au8TxBuffer, pInstance->au8RxBuffer, 8);
+                    u16TxLen = 8;
+                }
+            }
+            break;
+#endif
+#if (MODBUS_SUPPORT_FC17 == 1)
+        case 0x17: // 读写多个寄存器：先写后读
+            if (pInstance->u16RxLen >= 13)
+            {
+                uint16_t u16ReadAddr   = (pInstance->au8RxBuffer[2] << 8) | pInstance->au8RxBuffer[3];
+                uint16_t u16ReadCount  = (pInstance->au8RxBuffer[4] << 8) | pInstance->au8RxBuffer[5];
+                uint16_t u16WriteAddr  = (pInstance->au8RxBuffer[6] << 8) | pInstance->au8RxBuffer[7];
+                uint16_t u16WriteCount = (pInstance->au8RxBuffer[8] << 8) | pInstance->au8RxBuffer[9];
+                uint8_t  u8ByteCount   = pInstance->au8RxBuffer[10];
+
+                if ((u16ReadCount > 0 && u16ReadCount <= MODBUS_MAX_READ_REGS)
+                    && (u16WriteCount > 0 && u16WriteCount <= 121)
+                    && (u8ByteCount == u16WriteCount * 2)
+                    && (pInstance->u16RxLen >= 13 + u8ByteCount))
+                {
+                    uint16_t temp_data_buffer[125];
+                    prvUnpackRegisters(&pInstance->au8RxBuffer[11], u16WriteCount, temp_data_buffer);
+                    if (pInstance->pfnAppCallback!= NULL)
+                    {
+                        // 先按读范围试读一次：读地址非法时不执行写入，整条请求回异常
+                        uint16_t au16Probe[MODBUS_MAX_READ_REGS];
+                        callback_result = pInstance->pfnAppCallback(0x03, u16ReadAddr, u16ReadCount, au16Probe);
+                        if (callback_result == MODBUS_OK)
+                        {
+                            callback_result = pInstance->pfnAppCallback(0x10, u16WriteAddr, u16WriteCount, temp_data_buffer);
+                        }
+                        if (callback_result == MODBUS_OK)
+                        {
+                            callback_result = pInstance->pfnAppCallback(0x03, u16ReadAddr, u16ReadCount, temp_data_buffer);
+                        }
+                    }
+
+                    if (callback_result == MODBUS_OK)
+                    {
+                        pInstance->au8TxBuffer[0] = pInstance->u8SlaveAddress;
+                        pInstance->au8TxBuffer[1] = u8FuncCode;
+                        pInstance->au8TxBuffer[2] = (uint8_t)(u16ReadCount * 2);
+                        for (int i = 0; i < u16ReadCount; i++)
+                        {
+                            pInstance->au8TxBuffer[3 + i * 2] = (uint8_t)(temp_data_buffer[i] >> 8);
+                            pInstance->au8TxBuffer[4 + i * 2] = (uint8_t)(temp_data_buffer[i] & 0xFF);
+                        }
+                        u16TxLen = 3 + u16ReadCount * 2;
+                    }
+                }
+                else
+                {
+                    callback_result = MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE;
+                }
+            }
+            break;
+#endif
+#if (MODBUS_SUPPORT_FC08 == 1)
+        case 0x08: // 诊断
+#endif
+#if (MODBUS_SUPPORT_FC0B == 1)
+        case 0x0B: // 通信事件计数
+#endif
+#if (MODBUS_SUPPORT_FC08 == 1) || (MODBUS_SUPPORT_FC0B == 1)
+        {
+            // 计数由协议栈自己维护，不经过应用回调
+            uint8_t u8Ex;
+            u16TxLen = ModbusDiag_Serve(&pInstance->stDiag, pInstance->au8RxBuffer, pInstance->u16RxLen - 2,
+                                        pInstance->au8TxBuffer, &u8Ex);
+            callback_result = (u8Ex != 0) ? u8Ex : MODBUS_OK;
+            break;
+        }
 #endif
         default:
             callback_result = MODBUS_EXCEPTION_ILLEGAL_FUNCTION;
@@ -264,12 +387,28 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
     }
 
     // 5. ������Ӧ�����㲥
+    if ((callback_result == MODBUS_OK) && (u8FuncCode != 0x0B))
+    {
+        pInstance->stDiag.eventCount++; // 正常完成（广播也算），异常与 0x0B 本身不计
+    }
+
     if (u8SlaveAddr!= MODBUS_BROADCAST_ADDRESS)
     {
         if (callback_result!= MODBUS_OK)
         {
+            pInstance->stDiag.busException++;
+            if (callback_result == 0x06)
+            {
+                pInstance->stDiag.slaveBusy++;
+            }
             prvBuildExceptionResponse(pInstance, u8FuncCode, callback_result);
         }
+        else if (u16TxLen == 0)
+        {
+            // 强制只听 / 只听模式下的重启：不应答
+            pInstance->stDiag.slaveNoResponse++;
+            pInstance->eState = STATE_IDLE;
+        }
         else
         {
             uint16_t u16ResponseCRC = prvCRC16(pInstance->au8TxBuffer, u16TxLen);
@@ -282,6 +421,7 @@ static void prvProcessFrame(ModbusInstance_t *pInstance)
     }
     else // ���ڹ㲥��ַ��ִֻ��д����������Ӧ 
     {
+        pInstance->stDiag.slaveNoResponse++;
         pInstance->eState = STATE_IDLE;
     }
 }
@@ -302,55 +442,14 @@ static void prvBuildExceptionResponse(ModbusInstance_t *pInstance, uint8_t u8Fun
 
 static uint16_t prvCRC16(const uint8_t *puchMsg, uint16_t usDataLen)
 {
-    static const uint8_t auchCRCHi[] = {
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81,
-        0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01,
-        0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81,
-        0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0,
-        0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01,
-        0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81,
-        0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01,
-        0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81,
-        0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0,
-        0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01,
-        0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81,
-        0x40
-    };
-    static const uint8_t auchCRCLo[] = {
-        0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7, 0x05, 0xC5, 0xC4,
-        0x04, 0xCC, 0x0C, 0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09,
-        0x08, 0xC8, 0xD8, 0x18, 0x19, 0xD9, 0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD,
-        0x1D, 0x1C, 0xDC, 0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3,
-        0x11, 0xD1, 0xD0, 0x10, 0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32, 0x36, 0xF6, 0xF7,
-        0x37, 0xF5, 0x35, 0x34, 0xF4, 0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A,
-        0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38, 0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE,
-        0x2E, 0x2F, 0xEF, 0x2D, 0xED, 0xEC, 0x2C, 0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26,
-        0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0, 0xA0, 0x60, 0x61, 0xA1, 0x63, 0xA3, 0xA2,
-        0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4, 0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F,
-        0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68, 0x78, 0xB8, 0xB9, 0x79, 0xBB,
-        0x7B, 0x7A, 0xBA, 0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C, 0xB4, 0x74, 0x75, 0xB5,
-        0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0, 0x50, 0x90, 0x91,
-        0x51, 0x93, 0x53, 0x52, 0x92, 0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54, 0x9C, 0x5C,
-        0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E, 0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98, 0x88,
-        0x48, 0x49, 0x89, 0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
-        0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83, 0x41, 0x81, 0x80,
-        0x40
-    };
-    uint8_t uchCRCHi = 0xFF;
-    uint8_t uchCRCLo = 0xFF;
-    uint16_t uIndex;
-
-    while (usDataLen--)
+    // 公共 slicing-by-4 实现，见 modbus_crc.c
+    return ModbusCRC16(puchMsg, usDataLen);
+}
+
+static void prvUnpackRegisters(const uint8_t *pu8Src, uint16_t u16Count, uint16_t *pu16Dst)
+{
+    for (uint16_t i = 0; i < u16Count; i++)
     {
-        uIndex = uchCRCLo ^ *puchMsg++;
-        uchCRCLo = uchCRCHi ^ auchCRCHi[uIndex];
-        uchCRCHi = auchCRCLo[uIndex];
+        pu16Dst[i] = (uint16_t)((pu8Src[2 * i] << 8) | pu8Src[2 * i + 1]);
     }
-    return (uchCRCHi << 8 | uchCRCLo);
-}
\ No newline at end of file
+}
@@ -0,0 +1,167 @@
+/**
+ * @file modbus_trace.c
+ * @brief Modbus 流水线延时跟踪：记录环与按功能码统计
+ * @details
+ * Commit 在 USART TC 中断中调用，两个串口同抢占级互不嵌套；
+ * Snapshot/Reset 在主循环中调用，逐组关中断拷贝，避免读到一半被中断更新。
+ */
+
+#include <string.h>
+#include "modbus_trace.h"
+
+#if MODBUS_TRACE_ENABLE
+
+//=============================================================================
+// 1. 私有类型与变量 (Private Types & Variables)
+//=============================================================================
+
+/* 半倍频程直方图：0-3us 各一桶，之后每个 2 的幂区间分两桶，最后一桶约 98-131ms 并收纳更大值 */
+#define MB_TRACE_HIST_BUCKETS   34U
+#define MB_TRACE_STAGE_DELTAS   (MB_TRACE_STAGES - 1U)
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t sumUs;
+    uint32_t stageSumUs[MB_TRACE_STAGE_DELTAS];
+    uint16_t hist[MB_TRACE_HIST_BUCKETS];
+} ModbusTraceFcStats_t;
+
+static const uint8_t s_fcList[MB_TRACE_FC_SLOTS - 1U] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0F, 0x10, 0x16, 0x17
+};
+
+ModbusTraceRecord_t g_mbTraceRing[MB_TRACE_RING_LEN];
+static uint32_t             s_ringHead;
+static ModbusTraceFcStats_t s_fcStats[MB_TRACE_FC_SLOTS];
+
+//=============================================================================
+// 2. 私有函数 (Private Functions)
+//=============================================================================
+
+static uint32_t mbTraceSlot(uint8_t fc)
+{
+    for (uint32_t i = 0; i < MB_TRACE_FC_SLOTS - 1U; i++) {
+        if (s_fcList[i] == fc) return i;
+    }
+    return MB_TRACE_FC_SLOTS - 1U;
+}
+
+static uint32_t mbTraceBucket(uint32_t us)
+{
+    if (us < 4U) return us;
+    uint32_t e = 31U - __CLZ(us);
+    uint32_t b = 2U * e + ((us >> (e - 1U)) & 1U);
+    return (b < MB_TRACE_HIST_BUCKETS) ? b : MB_TRACE_HIST_BUCKETS - 1U;
+}
+
+/* 桶的上界（不含） */
+static uint32_t mbTraceBucketUpper(uint32_t b)
+{
+    if (b < 4U) return b + 1U;
+    uint32_t e = b / 2U;
+    return (1UL << e) + (b & 1U) * (1UL << (e - 1U)) + (1UL << (e - 1U));
+}
+
+/* 任一桶将满或任一累加和将回绕时，桶、样本数与各累加和一起折半：
+   平均值与分位点只取决于比例，折半后仍一致，并自然偏重近期样本 */
+static void mbTraceHalve(ModbusTraceFcStats_t *st)
+{
+    st->count >>= 1;
+    st->sumUs >>= 1;
+    for (uint32_t i = 0; i < MB_TRACE_STAGE_DELTAS; i++) st->stageSumUs[i] >>= 1;
+    for (uint32_t b = 0; b < MB_TRACE_HIST_BUCKETS; b++) st->hist[b] >>= 1;
+}
+
+static inline uint16_t mbTraceSat16(uint32_t v)
+{
+    return (v > 0xFFFFU) ? 0xFFFFU : (uint16_t)v;
+}
+
+//=============================================================================
+// 3. 接口实现 (API Implementation)
+//=============================================================================
+
+void ModbusTrace_Commit(ModbusTraceCtx_t *c)
+{
+    if (!c->active) return;
+    c->cur.t[MB_TRACE_TC] = DWT->CYCCNT;
+    c->active = 0;
+
+    g_mbTraceRing[s_ringHead & (MB_TRACE_RING_LEN - 1U)] = c->cur;
+    s_ringHead++;
+
+    uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+    ModbusTraceFcStats_t *st = &s_fcStats[mbTraceSlot(c->cur.fc)];
+    uint32_t us = (c->cur.t[MB_TRACE_TX_START] - c->cur.t[MB_TRACE_IDLE]) / cyclesPerUs;
+
+    uint32_t stageUs[MB_TRACE_STAGE_DELTAS];
+    uint32_t b = mbTraceBucket(us);
+    uint8_t full = (uint8_t)(st->hist[b] == 0xFFFFU || st->sumUs > 0xFFFFFFFFU - us);
+    for (uint32_t i = 0; i < MB_TRACE_STAGE_DELTAS; i++) {
+        stageUs[i] = (c->cur.t[i + 1U] - c->cur.t[i]) / cyclesPerUs;
+        if (st->stageSumUs[i] > 0xFFFFFFFFU - stageUs[i]) full = 1;
+    }
+    if (full) mbTraceHalve(st);
+
+    if (st->count == 0U || us < st->minUs) st->minUs = us;
+    if (us > st->maxUs) st->maxUs = us;
+    st->sumUs += us;
+    for (uint32_t i = 0; i < MB_TRACE_STAGE_DELTAS; i++) {
+        st->stageSumUs[i] += stageUs[i];
+    }
+    st->hist[b]++;
+    st->count++;
+}
+
+void ModbusTrace_Snapshot(uint16_t *regs)
+{
+    for (uint32_t s = 0; s < MB_TRACE_FC_SLOTS; s++) {
+        ModbusTraceFcStats_t st;
+        __disable_irq();
+        st = s_fcStats[s];
+        __enable_irq();
+
+        uint16_t *r = &regs[s * MB_TRACE_REGS_PER_FC];
+        memset(r, 0, MB_TRACE_REGS_PER_FC * sizeof(uint16_t));
+        r[MB_TRACE_OFS_FC]    = (s < MB_TRACE_FC_SLOTS - 1U) ? s_fcList[s] : 0U;
+        r[MB_TRACE_OFS_COUNT] = mbTraceSat16(st.count);
+        if (st.count == 0U) continue;
+
+        r[MB_TRACE_OFS_MIN] = mbTraceSat16(st.minUs);
+        r[MB_TRACE_OFS_AVG] = mbTraceSat16(st.sumUs / st.count);
+        r[MB_TRACE_OFS_MAX] = mbTraceSat16(st.maxUs);
+        for (uint32_t i = 0; i < MB_TRACE_STAGE_DELTAS; i++) {
+            r[MB_TRACE_OFS_STAGE_AVG + i] = mbTraceSat16(st.stageSumUs[i] / st.count);
+        }
+
+        /* p99：累计到 99% 样本所在桶的上界（桶与样本数同步折半，比例不变） */
+        uint32_t total = 0;
+        for (uint32_t b = 0; b < MB_TRACE_HIST_BUCKETS; b++) total += st.hist[b];
+        uint32_t need = (total * 99U + 99U) / 100U;
+        uint32_t acc = 0;
+        uint32_t p99 = st.maxUs;
+        for (uint32_t b = 0; b < MB_TRACE_HIST_BUCKETS; b++) {
+            acc += st.hist[b];
+            if (acc >= need) {
+                uint32_t upper = mbTraceBucketUpper(b) - 1U;
+                p99 = (upper < st.maxUs) ? upper : st.maxUs;
+                break;
+            }
+        }
+        r[MB_TRACE_OFS_P99] = mbTraceSat16(p99);
+    }
+}
+
+void ModbusTrace_Reset(void)
+{
+    __disable_irq();
+    memset(s_fcStats, 0, sizeof(s_fcStats));
+    memset(g_mbTraceRing, 0, sizeof(g_mbTraceRing));
+    s_ringHead = 0;
+    __enable_irq();
+}
+
+#endif /* MODBUS_TRACE_ENABLE */
@@ -11,6 +11,8 @@
  * 
  * 修订历史：
  * - v1.0.0: 初始版本，实现基本继电器控制功能
+ * - v1.1.0: 多路同时切换改为每个端口写一次 BSRR（初始化时由 relayConfigs 生成端口/引脚查表）
+ * - v1.2.0: 每次状态变化记入变位事件环（relay_event.h）
  */
 
 #include "relay.h"
@@ -32,6 +34,19 @@ static RelayConfig_t relayConfigs[RELAY_CHANNEL_COUNT] = {
     {GPIOA, GPIO_PIN_11, RELAY_STATE_OFF}   // 继电器5 - PA11
 };
 
+/**
+ * @brief 批量输出查表（relayInit 中由 relayConfigs 生成）
+ * @details relayPortPins[p][m] = 通道子集 m 中位于第 p 个端口的引脚掩码。
+ *          任意“哪些通道改、改成什么”都可由两次查表拼成该端口的一个 BSRR 字
+ *          （低 16 位置位、高 16 位复位），每个端口一次写入，同一端口上的继电器同时动作。
+ */
+#define RELAY_PORT_MAX      2U                          /**< 继电器占用的 GPIO 端口数上限 */
+#define RELAY_MASK_COUNT    (1U << RELAY_CHANNEL_COUNT)
+
+static GPIO_TypeDef* relayPorts[RELAY_PORT_MAX];
+static uint16_t relayPortPins[RELAY_PORT_MAX][RELAY_MASK_COUNT];
+static uint8_t relayPortCount;
+
 //=============================================================================
 // 2. 私有函数声明 (Private Function Prototypes) 
 //=============================================================================
@@ -52,6 +67,12 @@ static bool isValidChannel(RelayChannel_e channel);
  */
 static void setGpioState(RelayConfig_t* config, RelayState_e state);
 
+/**
+ * @brief 由 relayConfigs 生成批量输出查表
+ * @return HAL_StatusTypeDef 端口数超过 RELAY_PORT_MAX 时返回 HAL_ERROR
+ */
+static HAL_StatusTypeDef buildPortTable(void);
+
 //=============================================================================
 // 3. 公共API函数实现 (Public API Implementations)
 //=============================================================================
@@ -60,6 +81,11 @@ HAL_StatusTypeDef relayInit(void)
 {
     GPIO_InitTypeDef GPIO_InitStruct = {0};
     
+    if (buildPortTable() != HAL_OK)
+    {
+        return HAL_ERROR;
+    }
+    
     // 配置所有继电器引脚为推挽输出
     GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
     GPIO_InitStruct.Pull = GPIO_NOPULL;
@@ -87,8 +113,13 @@ HAL_StatusTypeDef relaySetState(RelayChannel_e channel, RelayState_e state)
     }
     
     RelayConfig_t* config = &relayConfigs[channel];
+    bool changed = (config->currentState != state);
     setGpioState(config, state);
     config->currentState = state;
+    if (changed)
+    {
+        relayEventPush((uint8_t)channel, (uint8_t)state, RELAY_SRC_APP);
+    }
     
     return HAL_OK;
 }
@@ -119,20 +150,46 @@ HAL_StatusTypeDef relayToggle(RelayChannel_e channel)
 
 HAL_StatusTypeDef relaySetAllStates(uint8_t stateMask)
 {
-    HAL_StatusTypeDef status = HAL_OK;
+    return relaySetMasked(RELAY_MASK_COUNT - 1U, stateMask);
+}
+
+HAL_StatusTypeDef relaySetMasked(uint8_t changeMask, uint8_t stateMask)
+{
+    return relaySetMaskedFrom(changeMask, stateMask, RELAY_SRC_APP);
+}
+
+HAL_StatusTypeDef relaySetMaskedFrom(uint8_t changeMask, uint8_t stateMask, uint8_t source)
+{
+    uint8_t onMask = changeMask & stateMask & (RELAY_MASK_COUNT - 1U);
+    uint8_t offMask = changeMask & (uint8_t)~stateMask & (RELAY_MASK_COUNT - 1U);
+    
+    // 主循环与定时中断（relay_timer.c）都会调用：输出、状态与事件一并在关中断下更新，
+    // 事件顺序与实际输出顺序一致
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    
+    // 每个端口一个 BSRR 字：置位与复位在同一次写入中生效
+    for (uint8_t p = 0; p < relayPortCount; p++)
+    {
+        relayPorts[p]->BSRR = (uint32_t)relayPortPins[p][onMask]
+                            | ((uint32_t)relayPortPins[p][offMask] << 16);
+    }
     
     for (int i = 0; i < RELAY_CHANNEL_COUNT; i++)
     {
-        RelayState_e state = (stateMask & (1 << i)) ? 
-                            RELAY_STATE_ON : RELAY_STATE_OFF;
-        
-        if (relaySetState((RelayChannel_e)i, state) != HAL_OK)
+        if (changeMask & (1U << i))
         {
-            status = HAL_ERROR;
+            RelayState_e state = (onMask & (1U << i)) ? RELAY_STATE_ON : RELAY_STATE_OFF;
+            if (relayConfigs[i].currentState != state)
+            {
+                relayConfigs[i].currentState = state;
+                relayEventPush((uint8_t)i, (uint8_t)state, source);
+            }
         }
     }
     
-    return status;
+    __set_PRIMASK(primask);
+    return HAL_OK;
 }
 
 uint8_t relayGetAllStates(void)
@@ -170,3 +227,44 @@ static void setGpioState(RelayConfig_t* config, RelayState_e state)
                             GPIO_PIN_SET : GPIO_PIN_RESET;
     HAL_GPIO_WritePin(config->port, config->pin, pinState);
 }
+
+static HAL_StatusTypeDef buildPortTable(void)
+{
+    uint8_t portOf[RELAY_CHANNEL_COUNT];
+    
+    relayPortCount = 0;
+    for (int i = 0; i < RELAY_CHANNEL_COUNT; i++)
+    {
+        uint8_t p = 0;
+        while (p < relayPortCount && relayPorts[p] != relayConfigs[i].port)
+        {
+            p++;
+        }
+        if (p == relayPortCount)
+        {
+            if (relayPortCount >= RELAY_PORT_MAX)
+            {
+                return HAL_ERROR;
+            }
+            relayPorts[relayPortCount++] = relayConfigs[i].port;
+        }
+        portOf[i] = p;
+    }
+    
+    for (uint32_t m = 0; m < RELAY_MASK_COUNT; m++)
+    {
+        for (uint8_t p = 0; p < relayPortCount; p++)
+        {
+            relayPortPins[p][m] = 0;
+        }
+        for (int i = 0; i < RELAY_CHANNEL_COUNT; i++)
+        {
+            if (m & (1U << i))
+            {
+                relayPortPins[portOf[i]][m] |= relayConfigs[i].pin;
+            }
+        }
+    }
+    
+    return HAL_OK;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file relay_event.c
+ * @brief 继电器变位事件环实现
+ * @details
+ * 领取序号后被更高优先级的写入方打断时，打断者领到更大的序号、写入另一个槽，互不干扰；
+ * 只有在一个写入方写完之前环又转满一圈才会争用同一槽，此时槽内序号以后写完者为准，
+ * 读方按序号校验，不会把两条事件拼在一起。
+ */
+
+#include "relay_event.h"
+#include "stm32f1xx_hal.h"
+
+//=============================================================================
+// 1. 私有变量 (Private Variables)
+//=============================================================================
+
+#define RELAY_EVENT_MASK    (RELAY_EVENT_RING - 1U)
+
+static RelayEvent_t relayEvents[RELAY_EVENT_RING];
+static volatile uint32_t relayEventSeq;         /**< 最近领取的序号 */
+
+//=============================================================================
+// 2. 公共API函数实现 (Public API Implementations)
+//=============================================================================
+
+void relayEventPush(uint8_t channel, uint8_t state, uint8_t source)
+{
+    uint32_t seq;
+    do
+    {
+        seq = __LDREXW(&relayEventSeq) + 1U;
+    } while (__STREXW(seq, &relayEventSeq));
+
+    volatile RelayEvent_t *e = &relayEvents[seq & RELAY_EVENT_MASK];
+    e->seq = 0;                 // 先作废旧内容，再写新内容，最后写序号
+    __DMB();
+    e->tickMs = HAL_GetTick();
+    e->channel = channel;
+    e->state = state;
+    e->source = source;
+    __DMB();
+    e->seq = seq;
+}
+
+uint32_t relayEventLatest(void)
+{
+    return relayEventSeq;
+}
+
+bool relayEventGet(uint32_t seq, RelayEvent_t *event)
+{
+    const volatile RelayEvent_t *e = &relayEvents[seq & RELAY_EVENT_MASK];
+
+    if (seq == 0U || e->seq != seq)
+    {
+        return false;
+    }
+    __DMB();
+    event->tickMs = e->tickMs;
+    event->channel = e->channel;
+    event->state = e->state;
+    event->source = e->source;
+    event->reserved = 0;
+    __DMB();
+    event->seq = seq;
+    return e->seq == seq;       // 复制期间被覆盖则作废
+}
+
+void relayEventToRegs(const RelayEvent_t *event, uint16_t *regs)
+{
+    regs[0] = (uint16_t)event->seq;
+    regs[1] = (uint16_t)((event->channel & 0x0FU) | (event->state ? 0x80U : 0U)
+                         | ((uint16_t)(event->source & 0x0FU) << 8));
+    regs[2] = (uint16_t)(event->tickMs >> 16);
+    regs[3] = (uint16_t)event->tickMs;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file relay_seq.c
+ * @brief 继电器场景命令队列实现
+ * @details
+ * 入队只写 relaySeqQueue[head] 后推进 head，出队只在 SysTick 中推进 tail，
+ * 两个下标都是自由运行的 8 位计数，head - tail 即队列深度。
+ * 清空队列要同时改动 tail 与执行状态，在关中断下进行。
+ * 命令改变某路状态时取消该路的定时（与直接写线圈相同）。
+ */
+
+#include "relay_seq.h"
+#include "relay_timer.h"
+#include "app_event.h"
+
+//=============================================================================
+// 1. 私有定义和静态变量 (Private Definitions & Static Variables)
+//=============================================================================
+
+#define RELAY_SEQ_MASK      (RELAY_SEQ_DEPTH - 1U)
+#define RELAY_SEQ_ALL       ((uint8_t)((1U << RELAY_CHANNEL_COUNT) - 1U))
+
+static uint8_t relaySeqQueue[RELAY_SEQ_DEPTH];
+static volatile uint8_t relaySeqHead;       /**< 主循环写 */
+static volatile uint8_t relaySeqTail;       /**< SysTick 写 */
+
+static uint8_t relaySeqActive;              /**< 队首命令已开始执行 */
+static volatile uint8_t relaySeqOnPending;  /**< 队首命令待吸合的通道 */
+static uint32_t relaySeqNextOn;             /**< 下一路最早可吸合的时刻（HAL_GetTick） */
+static uint8_t relaySeqSpacing;             /**< 距上一路吸合未满错开间隔，relaySeqNextOn 有效 */
+static volatile uint16_t relaySeqStagger = RELAY_SEQ_STAGGER_DEFAULT_MS;
+static volatile uint16_t relaySeqDone;
+
+//=============================================================================
+// 2. 公共API函数实现 (Public API Implementations)
+//=============================================================================
+
+HAL_StatusTypeDef relaySeqEnqueue(uint8_t targetMask)
+{
+    uint8_t head = relaySeqHead;
+
+    if ((uint8_t)(head - relaySeqTail) >= RELAY_SEQ_DEPTH)
+    {
+        return HAL_BUSY;
+    }
+    relaySeqQueue[head & RELAY_SEQ_MASK] = targetMask & RELAY_SEQ_ALL;
+    relaySeqHead = head + 1U;
+    return HAL_OK;
+}
+
+void relaySeqFlush(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    relaySeqTail = relaySeqHead;
+    relaySeqActive = 0;
+    relaySeqOnPending = 0;
+    __set_PRIMASK(primask);
+}
+
+void relaySeqSetStagger(uint16_t staggerMs)
+{
+    relaySeqStagger = staggerMs;
+}
+
+uint8_t relaySeqDepth(void)
+{
+    return (uint8_t)(relaySeqHead - relaySeqTail);
+}
+
+uint8_t relaySeqPending(void)
+{
+    return relaySeqOnPending;
+}
+
+uint16_t relaySeqCompleted(void)
+{
+    return relaySeqDone;
+}
+
+void relaySeqTickISR(void)
+{
+    uint8_t tail = relaySeqTail;
+    uint32_t now = HAL_GetTick();
+
+    // 间隔到期即解除（空闲时也检查）：长时间无命令后不会拿一个早已回绕的旧时刻去比较
+    if (relaySeqSpacing && (int32_t)(now - relaySeqNextOn) >= 0)
+    {
+        relaySeqSpacing = 0;
+    }
+
+    if (!relaySeqActive && tail == relaySeqHead)
+    {
+        return;
+    }
+
+    uint8_t changed = 0;
+
+    if (!relaySeqActive)
+    {
+        // 开始新命令：需要断开的通道一次断开，吸合的留给后面逐路进行
+        uint8_t target = relaySeqQueue[tail & RELAY_SEQ_MASK];
+        uint8_t current = relayGetAllStates();
+        uint8_t offMask = current & (uint8_t)~target;
+
+        relaySeqOnPending = target & (uint8_t)~current;
+        relaySeqActive = 1;
+        relayTimerCancel(offMask | relaySeqOnPending);
+        if (offMask)
+        {
+            relaySetMaskedFrom(offMask, 0, RELAY_SRC_SEQUENCE);
+            changed = 1;
+        }
+        if (relaySeqStagger == 0U && relaySeqOnPending)
+        {
+            relaySetMaskedFrom(relaySeqOnPending, relaySeqOnPending, RELAY_SRC_SEQUENCE);
+            relaySeqOnPending = 0;
+            changed = 1;
+        }
+    }
+
+    if (relaySeqOnPending && !relaySeqSpacing)
+    {
+        uint8_t bit = relaySeqOnPending & (uint8_t)(0U - relaySeqOnPending);   // 最低位的通道
+
+        relaySetMaskedFrom(bit, bit, RELAY_SRC_SEQUENCE);
+        relaySeqOnPending &= (uint8_t)~bit;
+        relaySeqNextOn = now + relaySeqStagger;
+        relaySeqSpacing = (relaySeqStagger != 0U);
+        changed = 1;
+    }
+
+    if (!relaySeqOnPending)
+    {
+        relaySeqActive = 0;
+        relaySeqTail = tail + 1U;
+        relaySeqDone++;
+        changed = 1;
+    }
+
+    if (changed)
+    {
+        appEventSet(APP_EVT_RELAY);
+    }
+}
@@ -11,6 +11,10 @@
 
 #include "relay_test.h"
 #include "relay.h"
+#include "relay_timer.h"
+#include "relay_seq.h"
+#include "relay_event.h"
+#include "../../MDK-ARM/modbus_rtu_slave.h"
 
 //=============================================================================
 // 私有变量 (Private Variables)
@@ -21,8 +25,96 @@ static struct {
     uint32_t passedTests;
     uint32_t failedTests;
     bool relayStatus[RELAY_CHANNEL_COUNT];
+    uint32_t failedLine;        /**< 最近一次失败检查所在行（定时/排队/事件自检） */
 } testReport = {0};
 
+/* 定时/排队/事件自检用的步进时钟：关中断后由测试直接改 uwTick 并调用两个 SysTick 处理函数 */
+#define TEST_RELAY_ALL          ((uint8_t)((1U << RELAY_CHANNEL_COUNT) - 1U))
+#define TEST_COIL_RELAY_BASE    0U      /* 线圈 0-4 = 继电器 1-5（Core/Doc/ModbusRegisterMap.md） */
+#define TEST_HREG_RELAY_MASK    10U     /* 保持寄存器 10 = 继电器位图 */
+#define TEST_CHECK(cond)        testCheck((cond), __LINE__)
+
+extern ModbusRTU_Slave g_mb;            /* main.c，USART1 从站 */
+
+static uint32_t testTickSaved;
+static uint32_t testPrimask;
+
+//=============================================================================
+// 私有函数 (Private Functions)
+//=============================================================================
+
+static void testReportReset(void)
+{
+    testReport.totalTests = 0;
+    testReport.passedTests = 0;
+    testReport.failedTests = 0;
+    testReport.failedLine = 0;
+}
+
+static bool testCheck(bool cond, uint32_t line)
+{
+    testReport.totalTests++;
+    if (cond)
+    {
+        testReport.passedTests++;
+    }
+    else
+    {
+        testReport.failedTests++;
+        testReport.failedLine = line;
+    }
+    return cond;
+}
+
+static bool testStates(uint8_t expected)
+{
+    return relayGetAllStates() == expected;
+}
+
+/**
+ * @brief 进入步进时钟：关中断、清掉定时与排队、继电器全关，时钟置为 start
+ * @details 先把时钟拨到原时刻之后 65.536 s 跑一次排队处理，
+ *          解除上一条命令留下的错开间隔（间隔最长 65535 ms），再跳到 start
+ */
+static void testClockBegin(uint32_t start)
+{
+    testPrimask = __get_PRIMASK();
+    __disable_irq();
+    testTickSaved = uwTick;
+    relayTimerCancel(TEST_RELAY_ALL);
+    relaySeqFlush();
+    relayTurnOffAll();
+    uwTick = testTickSaved + 0x10000U;
+    relaySeqTickISR();
+    uwTick = start;
+}
+
+static void testClockTick(void)
+{
+    relayTimerTickISR();
+    relaySeqTickISR();
+}
+
+static void testClockAdvance(uint32_t ms)
+{
+    while (ms--)
+    {
+        uwTick++;
+        testClockTick();
+    }
+}
+
+/* 退出步进时钟：恢复默认错开间隔、继电器全关、时钟与中断屏蔽还原（测试期间的时间不计入 uwTick） */
+static void testClockEnd(void)
+{
+    relayTimerCancel(TEST_RELAY_ALL);
+    relaySeqFlush();
+    relaySeqSetStagger(RELAY_SEQ_STAGGER_DEFAULT_MS);
+    relayTurnOffAll();
+    uwTick = testTickSaved;
+    __set_PRIMASK(testPrimask);
+}
+
 //=============================================================================
 // 公共函数实现 (Public Function Implementations)  
 //=============================================================================
@@ -206,6 +298,228 @@ uint32_t relayResponseTimeTest(RelayChannel_e channel, uint8_t testCount)
     return totalTime / testCount; // 返回平均时间
 }
 
+bool relayTimerSelfTest(void)
+{
+    uint16_t pulse50 = RELAY_TIMER_CMD(RELAY_TIMER_PULSE, 0, 5);
+    uint16_t blink20 = RELAY_TIMER_CMD(RELAY_TIMER_BLINK, 0, 2);
+
+    testReportReset();
+    testClockBegin(1000U);
+
+    // 脉冲：立即开启，50 ms 后关闭，运行中读回命令字，到期清零
+    TEST_CHECK(relayTimerArm(RELAY_CHANNEL_FIRST, pulse50) == HAL_OK);
+    TEST_CHECK(testStates(0x01) && relayTimerGetCommand(RELAY_CHANNEL_FIRST) == pulse50);
+    testClockAdvance(49);
+    TEST_CHECK(testStates(0x01));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x00) && relayTimerGetCommand(RELAY_CHANNEL_FIRST) == 0U);
+
+    // 重新装定：从装定时刻重新计时
+    relayTimerArm(RELAY_CHANNEL_FIRST, pulse50);
+    testClockAdvance(30);
+    relayTimerArm(RELAY_CHANNEL_FIRST, pulse50);
+    testClockAdvance(49);
+    TEST_CHECK(testStates(0x01));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x00));
+
+    // 闪烁：每 20 ms 翻转并续期，直到取消
+    TEST_CHECK(relayTimerArm(RELAY_CHANNEL_SECOND, blink20) == HAL_OK);
+    TEST_CHECK(testStates(0x02));
+    testClockAdvance(20);
+    TEST_CHECK(testStates(0x00));
+    testClockAdvance(20);
+    TEST_CHECK(testStates(0x02) && relayTimerGetCommand(RELAY_CHANNEL_SECOND) == blink20);
+
+    // 中断晚到 5 ms：下一次翻转仍在原节拍上（再过 15 ms）
+    uwTick += 25U;
+    testClockTick();
+    TEST_CHECK(testStates(0x00));
+    testClockAdvance(14);
+    TEST_CHECK(testStates(0x00));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x02));
+
+    // 取消：保持当前状态
+    relayTimerCancel(1U << RELAY_CHANNEL_SECOND);
+    testClockAdvance(100);
+    TEST_CHECK(testStates(0x02) && relayTimerGetCommand(RELAY_CHANNEL_SECOND) == 0U);
+    relayTurnOffAll();
+
+    // 到期时刻跨越 32 位回绕：0xFFFFFFF0 + 30 ms 的脉冲排在 +10 ms 的延时开之后
+    uwTick = 0xFFFFFFF0U;
+    relayTimerArm(RELAY_CHANNEL_FIRST, RELAY_TIMER_CMD(RELAY_TIMER_PULSE, 0, 3));
+    relayTimerArm(RELAY_CHANNEL_THIRD, RELAY_TIMER_CMD(RELAY_TIMER_ON_DELAY, 0, 1));
+    testClockTick();
+    TEST_CHECK(testStates(0x01));
+    testClockAdvance(9);
+    TEST_CHECK(testStates(0x01));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x05));
+    testClockAdvance(19);
+    TEST_CHECK(uwTick == 0x0000000DU && testStates(0x05));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x04) && relayTimerGetCommand(RELAY_CHANNEL_FIRST) == 0U);
+
+    // 无效命令字（计数为 0 / 模式越界）拒绝
+    TEST_CHECK(relayTimerArm(RELAY_CHANNEL_FIRST, RELAY_TIMER_CMD(RELAY_TIMER_PULSE, 0, 0)) == HAL_ERROR);
+    TEST_CHECK(relayTimerArm(RELAY_CHANNEL_FIRST, 0xE001U) == HAL_ERROR);
+
+    testClockEnd();
+    return testReport.failedTests == 0U;
+}
+
+bool relaySeqSelfTest(void)
+{
+    testReportReset();
+    testClockBegin(5000U);
+    relaySeqSetStagger(20);
+
+    // 0x07 后接 0x1F：逐路吸合间隔 20 ms，跨命令同样保持间隔
+    uint16_t done = relaySeqCompleted();
+    TEST_CHECK(relaySeqEnqueue(0x07) == HAL_OK);
+    TEST_CHECK(relaySeqEnqueue(0x1F) == HAL_OK);
+    TEST_CHECK(relaySeqDepth() == 2U);
+    testClockTick();
+    TEST_CHECK(testStates(0x01) && relaySeqPending() == 0x06);
+    testClockAdvance(19);
+    TEST_CHECK(testStates(0x01));
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x03));
+    testClockAdvance(20);
+    TEST_CHECK(testStates(0x07) && (uint16_t)(relaySeqCompleted() - done) == 1U);
+    testClockAdvance(19);
+    TEST_CHECK(testStates(0x07) && relaySeqPending() == 0x18);
+    testClockAdvance(1);
+    TEST_CHECK(testStates(0x0F));
+    testClockAdvance(20);
+    TEST_CHECK(testStates(0x1F) && relaySeqDepth() == 0U && (uint16_t)(relaySeqCompleted() - done) == 2U);
+
+    // 需要断开的通道一次断开，并取消其上的定时
+    relayTimerArm(RELAY_CHANNEL_FIFTH, RELAY_TIMER_CMD(RELAY_TIMER_BLINK, 1, 1));
+    testClockAdvance(20);
+    relaySeqEnqueue(0x01);
+    testClockTick();
+    TEST_CHECK(testStates(0x01) && relayTimerGetCommand(RELAY_CHANNEL_FIFTH) == 0U);
+
+    // 间隔为 0：同时吸合
+    relaySeqSetStagger(0);
+    relaySeqEnqueue(0x1F);
+    testClockTick();
+    TEST_CHECK(testStates(0x1F) && relaySeqDepth() == 0U);
+
+    // 队列满返回 HAL_BUSY，清空后深度与待吸合位图归零
+    relaySeqSetStagger(20);
+    for (uint8_t i = 0; i < RELAY_SEQ_DEPTH; i++)
+    {
+        TEST_CHECK(relaySeqEnqueue((uint8_t)(i & 1U) ? 0x1F : 0x00) == HAL_OK);
+    }
+    TEST_CHECK(relaySeqEnqueue(0x00) == HAL_BUSY && relaySeqDepth() == RELAY_SEQ_DEPTH);
+    testClockTick();
+    testClockTick();
+    TEST_CHECK(testStates(0x01) && relaySeqPending() == 0x1E);
+    relaySeqFlush();
+    TEST_CHECK(relaySeqDepth() == 0U && relaySeqPending() == 0U);
+    testClockAdvance(100);
+    TEST_CHECK(testStates(0x01));
+
+    testClockEnd();
+    return testReport.failedTests == 0U;
+}
+
+bool relayEventSelfTest(void)
+{
+    RelayEvent_t ev;
+    uint16_t regs[RELAY_EVENT_REGS];
+
+    testReportReset();
+    testClockBegin(0x12345678U);
+
+    // 写入一整环再多 3 条：最早的 3 条被覆盖
+    uint32_t first = relayEventLatest();
+    for (uint32_t i = 0; i < RELAY_EVENT_RING + 3U; i++)
+    {
+        relayEventPush((uint8_t)(i % RELAY_CHANNEL_COUNT), (uint8_t)(i & 1U), RELAY_SRC_APP);
+        uwTick++;
+    }
+    uint32_t latest = relayEventLatest();
+    TEST_CHECK(latest == first + RELAY_EVENT_RING + 3U);
+
+    // 被覆盖的序号（与新事件同槽）读取失败，尚未写入的序号与 0 同样失败
+    TEST_CHECK(!relayEventGet(latest - RELAY_EVENT_RING, &ev));
+    TEST_CHECK(!relayEventGet(first + 1U, &ev));
+    TEST_CHECK(!relayEventGet(latest + 1U, &ev));
+    TEST_CHECK(!relayEventGet(0, &ev));
+
+    // 环内最早与最新的一条内容正确
+    uint32_t oldest = latest - RELAY_EVENT_RING + 1U;
+    uint32_t i = oldest - first - 1U;
+    TEST_CHECK(relayEventGet(oldest, &ev) && ev.seq == oldest && ev.tickMs == 0x12345678U + i
+               && ev.channel == i % RELAY_CHANNEL_COUNT && ev.state == (i & 1U) && ev.source == RELAY_SRC_APP);
+    i = latest - first - 1U;
+    TEST_CHECK(relayEventGet(latest, &ev) && ev.seq == latest && ev.channel == i % RELAY_CHANNEL_COUNT);
+
+    // 寄存器编码：序号低 16 位 / 通道 + 状态位 7 + 来源 / 时刻高低字
+    ev.seq = 0x00012345U;
+    ev.tickMs = 0xA1B2C3D4U;
+    ev.channel = RELAY_CHANNEL_FOURTH;
+    ev.state = RELAY_STATE_ON;
+    ev.source = RELAY_SRC_TIMER;
+    relayEventToRegs(&ev, regs);
+    TEST_CHECK(regs[0] == 0x2345U && regs[1] == 0x0283U && regs[2] == 0xA1B2U && regs[3] == 0xC3D4U);
+
+    // 继电器动作按来源记录
+    first = relayEventLatest();
+    relayTimerArm(RELAY_CHANNEL_SECOND, RELAY_TIMER_CMD(RELAY_TIMER_PULSE, 0, 1));
+    TEST_CHECK(relayEventLatest() == first + 1U && relayEventGet(first + 1U, &ev)
+               && ev.channel == RELAY_CHANNEL_SECOND && ev.state == RELAY_STATE_ON && ev.source == RELAY_SRC_TIMER);
+
+    testClockEnd();
+    return testReport.failedTests == 0U;
+}
+
+bool relayDirectWriteSelfTest(void)
+{
+    testReportReset();
+    testClockBegin(20000U);
+    relaySeqSetStagger(20);
+
+    // 排队命令执行到一半，通道 1 闪烁、通道 2 脉冲
+    relaySeqEnqueue(0x1C);
+    testClockTick();
+    relayTimerArm(RELAY_CHANNEL_FIRST, RELAY_TIMER_CMD(RELAY_TIMER_BLINK, 0, 1));
+    relayTimerArm(RELAY_CHANNEL_SECOND, RELAY_TIMER_CMD(RELAY_TIMER_PULSE, 1, 1));
+    TEST_CHECK(testStates(0x07) && relaySeqPending() == 0x18);
+
+    // 写线圈 1（继电器 2）= 0：清空排队，只取消状态被改变的通道 2 的定时
+    MB_BitPut(g_mb.coils, TEST_COIL_RELAY_BASE + 1U, 0);
+    ModbusRTU_CommitWriteCoils(&g_mb, TEST_COIL_RELAY_BASE + 1U, 1);
+    TEST_CHECK(testStates(0x05) && relaySeqDepth() == 0U && relaySeqPending() == 0U);
+    TEST_CHECK(relayTimerGetCommand(RELAY_CHANNEL_SECOND) == 0U && relayTimerGetCommand(RELAY_CHANNEL_FIRST) != 0U);
+    testClockAdvance(5);
+    TEST_CHECK((relayGetAllStates() & 0x1A) == 0U);
+    testClockAdvance(1000);
+    TEST_CHECK((relayGetAllStates() & 0x1E) == 0x04 && relayTimerGetCommand(RELAY_CHANNEL_FIRST) != 0U);
+
+    // 写寄存器 10 = 0x10：通道 1 被改变，闪烁取消
+    g_mb.holdingRegs[TEST_HREG_RELAY_MASK] = 0x10;
+    ModbusRTU_CommitWriteRange(&g_mb, TEST_HREG_RELAY_MASK, 1);
+    TEST_CHECK(testStates(0x10) && relayTimerGetCommand(RELAY_CHANNEL_FIRST) == 0U);
+    testClockAdvance(100);
+    TEST_CHECK(testStates(0x10));
+
+    // 写入值与当前状态相同的通道不取消定时
+    relayTimerArm(RELAY_CHANNEL_FIFTH, RELAY_TIMER_CMD(RELAY_TIMER_OFF_DELAY, 0, 5));
+    MB_BitPut(g_mb.coils, TEST_COIL_RELAY_BASE + 4U, 1);
+    ModbusRTU_CommitWriteCoils(&g_mb, TEST_COIL_RELAY_BASE + 4U, 1);
+    TEST_CHECK(relayTimerGetCommand(RELAY_CHANNEL_FIFTH) != 0U);
+    testClockAdvance(50);
+    TEST_CHECK(testStates(0x00));
+
+    testClockEnd();
+    return testReport.failedTests == 0U;
+}
+
 void relayPrintTestReport(void)
 {
     // 注意：此函数需要printf重定向到调试串口才能工作
@@ -216,6 +530,10 @@ void relayPrintTestReport(void)
     printf("总测试数: %lu\r\n", testReport.totalTests);
     printf("通过数: %lu\r\n", testReport.passedTests);
     printf("失败数: %lu\r\n", testReport.failedTests);
+    if (testReport.failedLine != 0U)
+    {
+        printf("最近失败: relay_test.c:%lu\r\n", testReport.failedLine);
+    }
     printf("通过率: %.1f%%\r\n", 
            (float)testReport.passedTests * 100.0f / testReport.totalTests);
     
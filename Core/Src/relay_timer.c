@@ -0,0 +1,191 @@
+/**
+ * @file relay_timer.c
+ * @brief 继电器定时引擎实现（SysTick 驱动的有序到期链表）
+ * @details
+ * 链表只在两处修改：主循环的装定/取消（关中断下进行）与 SysTick 中断的到期处理，
+ * 两者互斥，因此中断里无需再加锁。到期时刻用 HAL_GetTick 的 32 位毫秒计数，
+ * 以有符号差比较，回绕（约 49 天）不影响判断。
+ */
+
+#include "relay_timer.h"
+#include "app_event.h"
+
+//=============================================================================
+// 1. 私有定义和静态变量 (Private Definitions & Static Variables)
+//=============================================================================
+
+#define RELAY_TIMER_NIL     0xFFU
+
+/**
+ * @brief 单路定时器
+ */
+typedef struct
+{
+    uint32_t deadline;          /**< 下次到期时刻（HAL_GetTick） */
+    uint32_t period;            /**< 定时长度（ms），闪烁时为半周期 */
+    uint16_t cmd;               /**< 运行中的命令字，0 = 空闲 */
+    uint8_t  mode;              /**< RelayTimerMode_e */
+    uint8_t  next;              /**< 链表中的下一路，RELAY_TIMER_NIL 结束 */
+    uint8_t  linked;            /**< 是否在链表中 */
+    uint8_t  level;             /**< 闪烁：当前输出电平 */
+} RelayTimer_t;
+
+static RelayTimer_t relayTimers[RELAY_CHANNEL_COUNT];
+static uint8_t relayTimerHead = RELAY_TIMER_NIL;
+
+//=============================================================================
+// 2. 私有函数 (Private Functions)
+//=============================================================================
+
+/* 以下两个函数须在关中断或 SysTick 中断内调用 */
+
+static void timerInsert(uint8_t ch)
+{
+    RelayTimer_t *t = &relayTimers[ch];
+    uint8_t *link = &relayTimerHead;
+
+    // 到期时刻相同的排在后面，保持装定顺序
+    while (*link != RELAY_TIMER_NIL && (int32_t)(relayTimers[*link].deadline - t->deadline) <= 0)
+    {
+        link = &relayTimers[*link].next;
+    }
+    t->next = *link;
+    *link = ch;
+    t->linked = 1;
+}
+
+static void timerUnlink(uint8_t ch)
+{
+    if (!relayTimers[ch].linked)
+    {
+        return;
+    }
+
+    uint8_t *link = &relayTimerHead;
+    while (*link != ch)
+    {
+        link = &relayTimers[*link].next;
+    }
+    *link = relayTimers[ch].next;
+    relayTimers[ch].linked = 0;
+}
+
+//=============================================================================
+// 3. 公共API函数实现 (Public API Implementations)
+//=============================================================================
+
+bool relayTimerCommandValid(uint16_t cmd)
+{
+    uint16_t mode = cmd >> RELAY_TIMER_MODE_SHIFT;
+
+    if (mode >= RELAY_TIMER_MODE_COUNT)
+    {
+        return false;
+    }
+    return (mode == RELAY_TIMER_CANCEL) || ((cmd & RELAY_TIMER_COUNT_MASK) != 0U);
+}
+
+HAL_StatusTypeDef relayTimerArm(RelayChannel_e channel, uint16_t cmd)
+{
+    if (channel < RELAY_CHANNEL_FIRST || channel >= RELAY_CHANNEL_COUNT || !relayTimerCommandValid(cmd))
+    {
+        return HAL_ERROR;
+    }
+
+    uint8_t ch = (uint8_t)channel;
+    uint8_t bit = (uint8_t)(1U << ch);
+    uint8_t mode = (uint8_t)(cmd >> RELAY_TIMER_MODE_SHIFT);
+    uint32_t period = (cmd & RELAY_TIMER_COUNT_MASK) * ((cmd & RELAY_TIMER_UNIT_1S) ? 1000U : 10U);
+    RelayTimer_t *t = &relayTimers[ch];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    timerUnlink(ch);
+    t->cmd = 0;
+    if (mode != RELAY_TIMER_CANCEL)
+    {
+        if (mode == RELAY_TIMER_PULSE || mode == RELAY_TIMER_BLINK)
+        {
+            relaySetMaskedFrom(bit, bit, RELAY_SRC_TIMER);
+            t->level = 1;
+        }
+        t->mode = mode;
+        t->period = period;
+        t->deadline = HAL_GetTick() + period;
+        t->cmd = cmd;
+        timerInsert(ch);
+    }
+    __set_PRIMASK(primask);
+
+    return HAL_OK;
+}
+
+void relayTimerCancel(uint8_t channelMask)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (uint8_t ch = 0; ch < RELAY_CHANNEL_COUNT; ch++)
+    {
+        if (channelMask & (1U << ch))
+        {
+            timerUnlink(ch);
+            relayTimers[ch].cmd = 0;
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+uint16_t relayTimerGetCommand(RelayChannel_e channel)
+{
+    if (channel < RELAY_CHANNEL_FIRST || channel >= RELAY_CHANNEL_COUNT)
+    {
+        return 0;
+    }
+    return relayTimers[channel].cmd;
+}
+
+void relayTimerTickISR(void)
+{
+    uint8_t ch = relayTimerHead;
+    uint32_t now = HAL_GetTick();
+
+    if (ch == RELAY_TIMER_NIL || (int32_t)(now - relayTimers[ch].deadline) < 0)
+    {
+        return;
+    }
+
+    // 同一 tick 到期的通道合并为一次输出
+    uint8_t changeMask = 0;
+    uint8_t stateMask = 0;
+    do
+    {
+        RelayTimer_t *t = &relayTimers[ch];
+        uint8_t bit = (uint8_t)(1U << ch);
+
+        relayTimerHead = t->next;
+        t->linked = 0;
+        changeMask |= bit;
+        if (t->mode == RELAY_TIMER_BLINK)
+        {
+            t->level ^= 1U;
+            if (t->level)
+            {
+                stateMask |= bit;
+            }
+            t->deadline += t->period;       // 按原节拍续期，不随中断延迟漂移
+            timerInsert(ch);
+        }
+        else
+        {
+            if (t->mode == RELAY_TIMER_ON_DELAY)
+            {
+                stateMask |= bit;
+            }
+            t->cmd = 0;
+        }
+        ch = relayTimerHead;
+    } while (ch != RELAY_TIMER_NIL && (int32_t)(now - relayTimers[ch].deadline) >= 0);
+
+    relaySetMaskedFrom(changeMask, stateMask, RELAY_SRC_TIMER);
+    appEventSet(APP_EVT_RELAY);
+}
@@ -27,10 +27,19 @@
 #include "usart2_echo_test_debug.h"
 #include "usart2_simple_test.h"
 #include "app_config.h"  // 配置文件
+#include "app_event.h"
+#include "relay_timer.h"
+#include "relay_seq.h"
+#include "app_gateway.h"
+#include "modbus_hal.h"
 
-// 声明全局 Modbus 实例在main.c中定义
-extern ModbusRTU_Slave g_mb;   /* USART1 (PA9/PA10) */
-extern ModbusRTU_Slave g_mb2;  /* USART2 (PA2/PA3) */
+/* Modbus 实例由 ModbusRTU_Init 按 USART 登记，这里经 ModbusRTU_FromUart 查找 */
+
+/* 通知主循环该 Modbus 通道有事可做（收到帧/发送完成/错误恢复） */
+static inline void ModbusSignal(const UART_HandleTypeDef *huart)
+{
+  appEventSet((huart->Instance == USART1) ? APP_EVT_MB_USART1 : APP_EVT_MB_USART2);
+}
 
 /* 从 main.c 获取运行模式定义（编译期选择） */
 #ifndef RUN_MODE_ECHO_TEST
@@ -103,7 +112,24 @@ extern UART_HandleTypeDef huart1;
 extern DMA_HandleTypeDef hdma_usart2_rx;
 extern DMA_HandleTypeDef hdma_usart2_tx;
 extern UART_HandleTypeDef huart2;
+
+#if MODBUS_CAPTURE_ENABLE
+extern DMA_HandleTypeDef hdma_usart3_tx;
+extern UART_HandleTypeDef huart3;
+#endif
 /* USER CODE BEGIN EV */
+#if RUN_MODE_INSTANCE
+/* 运行模式 6：ModbusInstance_t 协议栈的两个实例在 main.c 中定义 */
+extern ModbusInstance_t g_modbus_instance1;
+extern ModbusInstance_t g_modbus_instance2;
+
+static inline ModbusInstance_t *ModbusInstanceFromUart(const UART_HandleTypeDef *huart)
+{
+  if (huart == &huart1) return &g_modbus_instance1;
+  if (huart == &huart2) return &g_modbus_instance2;
+  return NULL;
+}
+#endif
 
 /* USER CODE END EV */
 
@@ -234,7 +260,17 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+  /* 每秒唤醒一次主循环刷新负载统计；其余 SysTick 只计时不派发 */
+  if ((HAL_GetTick() % 1000U) == 0U) {
+    appEventSet(APP_EVT_SECOND);
+  }
+#if RUN_MODE_MODBUS
+  relayTimerTickISR();      /* 继电器定时：无到期时只比较一次表头 */
+  relaySeqTickISR();        /* 继电器排队命令：队列空时只比较一次下标 */
+#endif
+#if RUN_MODE_GATEWAY
+  gatewayTickISR();
+#endif
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -295,6 +331,24 @@ void DMA1_Channel7_IRQHandler(void)
   /* USER CODE END DMA1_Channel7_IRQn 1 */
 }
 
+#if MODBUS_CAPTURE_ENABLE
+/**
+  * @brief This function handles DMA1 channel2 global interrupt (USART3 TX, capture stream).
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_usart3_tx);
+}
+
+/**
+  * @brief This function handles USART3 global interrupt (capture stream TC).
+  */
+void USART3_IRQHandler(void)
+{
+  HAL_UART_IRQHandler(&huart3);
+}
+#endif
+
 /**
   * @brief This function handles USART1 global interrupt.
   */
@@ -309,15 +363,52 @@ void USART1_IRQHandler(void)
       /* 重要：IDLE已处理，不再调用HAL_UART_IRQHandler */
       return;
     }
-  #else
-    /* Modbus模式：先处理IDLE，再调用HAL（避免HAL清除标志） */
+  #elif RUN_MODE_INSTANCE
+    /* ModbusInstance_t 协议栈：IDLE 停接收 DMA 取帧长，主循环 Modbus_Poll 处理 */
     if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE) != RESET)
     {
       __HAL_UART_CLEAR_IDLEFLAG(&huart1);
-      ModbusRTU_UartRxCallback(&g_mb);
+      if (Modbus_HAL_RxIdleISR(&g_modbus_instance1)) {
+        ModbusSignal(&huart1);
+      }
+      return;
+    }
+  #else
+    /* Modbus模式：先处理接收错误与IDLE，再调用HAL（避免HAL清除标志、中止DMA） */
+    ModbusRTU_Slave *mb = ModbusRTU_FromUart(&huart1);
+    uint32_t sr = huart1.Instance->SR;
+    if (mb && (sr & MB_UART_SR_RX_ERRORS))
+    {
+      /* ORE/FE/NE/PE：计数并作废当前帧，接收 DMA 不停；会读 DR，IDLE 以快照为准 */
+      ModbusRTU_RxErrorISR(mb, sr);
+    }
+  #if RUN_MODE_GATEWAY
+    /* 逐字节（RXNEIE）与 IDLE 都会进来：直通起转/续传不等 SysTick */
+    gatewayRxProgressISR();
+  #endif
+    if (sr & USART_SR_IDLE)
+    {
+      __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+      if (mb) {
+        ModbusTrace_MarkIdle(&mb->trace);   /* 请求最后一字节之后一个字符：延时跟踪起点 */
+        /* 帧定时模式下 IDLE 只布防 t1.5/t3.5，结帧由 TIM2 中断通知 */
+        if (ModbusRTU_UartRxCallback(mb)) {
+          ModbusSignal(&huart1);
+        }
+      }
       /* 重要：IDLE已处理，不再调用HAL_UART_IRQHandler */
       return;
     }
+  #if RUN_MODE_GATEWAY
+    {
+      /* RXNEIE 只作唤醒、数据归 DMA：屏蔽后再交给 HAL（只剩 TC），免得它按中断接收读走 DR */
+      uint32_t rxneie = huart1.Instance->CR1 & USART_CR1_RXNEIE;
+      huart1.Instance->CR1 &= ~USART_CR1_RXNEIE;
+      HAL_UART_IRQHandler(&huart1);
+      huart1.Instance->CR1 |= rxneie;
+      return;
+    }
+  #endif
   #endif
   /* USER CODE END USART1_IRQn 0 */
   HAL_UART_IRQHandler(&huart1);
@@ -355,12 +446,35 @@ void USART2_IRQHandler(void)
       usart2EchoHandleIdle();
       return;
     }
-  #else
-    /* Modbus模式：先处理IDLE，再调用HAL */
+  #elif RUN_MODE_INSTANCE
+    /* ModbusInstance_t 协议栈：IDLE 停接收 DMA 取帧长，主循环 Modbus_Poll 处理 */
     if (__HAL_UART_GET_FLAG(&huart2, UART_FLAG_IDLE) != RESET)
     {
       __HAL_UART_CLEAR_IDLEFLAG(&huart2);
-      ModbusRTU_UartRxCallback(&g_mb2);
+      if (Modbus_HAL_RxIdleISR(&g_modbus_instance2)) {
+        ModbusSignal(&huart2);
+      }
+      return;
+    }
+  #else
+    /* Modbus模式：先处理接收错误与IDLE，再调用HAL */
+    ModbusRTU_Slave *mb = ModbusRTU_FromUart(&huart2);
+    uint32_t sr = huart2.Instance->SR;
+    if (mb && (sr & MB_UART_SR_RX_ERRORS))
+    {
+      /* ORE/FE/NE/PE：计数并作废当前帧，接收 DMA 不停；会读 DR，IDLE 以快照为准 */
+      ModbusRTU_RxErrorISR(mb, sr);
+    }
+    if (sr & USART_SR_IDLE)
+    {
+      __HAL_UART_CLEAR_IDLEFLAG(&huart2);
+      if (mb) {
+        ModbusTrace_MarkIdle(&mb->trace);   /* 请求最后一字节之后一个字符：延时跟踪起点 */
+        /* 帧定时模式下 IDLE 只布防 t1.5/t3.5，结帧由 TIM2 中断通知 */
+        if (ModbusRTU_UartRxCallback(mb)) {
+          ModbusSignal(&huart2);
+        }
+      }
       /* 重要：IDLE已处理，不再调用HAL_UART_IRQHandler */
       return;
     }
@@ -371,6 +485,23 @@ void USART2_IRQHandler(void)
   /* USER CODE END USART2_IRQn 1 */
 }
 
+/**
+  * @brief This function handles TIM2 global interrupt.
+  * @details Modbus RTU t1.5/t3.5 帧定时（比较通道由 modbus_rtu_slave.c 按寄存器配置）
+  */
+void TIM2_IRQHandler(void)
+{
+  /* USER CODE BEGIN TIM2_IRQn 0 */
+  /* 未注册 Modbus 实例的串口（回显测试模式）FromUart 返回 NULL，不会启用 TIM2 */
+  if (ModbusRTU_FrameTimerISR(ModbusRTU_FromUart(&huart1))) {
+    ModbusSignal(&huart1);
+  }
+  if (ModbusRTU_FrameTimerISR(ModbusRTU_FromUart(&huart2))) {
+    ModbusSignal(&huart2);
+  }
+  /* USER CODE END TIM2_IRQn 0 */
+}
+
 /**
   * @brief  Tx Transfer completed callback.
   * @param  huart UART handle.
@@ -379,7 +510,8 @@ void USART2_IRQHandler(void)
   * @details 
   * Critical callback for Modbus RTU communication:
   * 1. Switch RS485 transceiver back to receive mode
-  * 2. Restart DMA reception for next Modbus frame
+  * 2. Discard bytes seen while transmitting (RX DMA runs continuously in
+  *    a circular ring and is never restarted)
   * 3. Clear transmission flags and reset state
   * 
   * Without this implementation, the system will deadlock after first response.
@@ -393,16 +525,6 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
       return;
     }
   #endif
-  /* Modbus: USART1 Tx 完成处理 */
-  if (huart == &huart1) {
-    /* 等待 TC，避免过早切 DE */
-    uint32_t t0 = HAL_GetTick();
-    while (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_TC) == RESET) {
-      if ((HAL_GetTick() - t0) > 2U) break;
-    }
-    ModbusRTU_TxCpltISR(&g_mb);
-    return;
-  }
   #if USART2_TEST_MODE == 3
     /* 简单测试模式 - USART2发送完成 */
     if (huart == &huart2) {
@@ -422,33 +544,32 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
       return;
     }
   #endif
-  
-  /* 处理USART1 - Modbus */
-  if (huart == &huart1) {
-    /* Step 1: Switch RS485 to receive mode */
-    HAL_GPIO_WritePin(MB_USART1_RS485_DE_GPIO_Port, MB_USART1_RS485_DE_Pin, GPIO_PIN_RESET);
-    
-    /* Step 2: Clear transmission state flags */
-    g_mb.txCount = 0;
-    g_mb.rxComplete = 0;
-    g_mb.rxCount = 0;
-    g_mb.frameReceiving = 0;
-    
-    /* Step 3: Restart DMA reception */
-    HAL_UART_Receive_DMA(&huart1, g_mb.rxBuffer, MB_RTU_FRAME_MAX_SIZE);
-  }
-  
-  #if USART2_TEST_MODE == 0
-    /* 处理USART2 - 仅Modbus模式 */
-    if (huart == &huart2) {
-      uint32_t t1 = HAL_GetTick();
-      while (__HAL_UART_GET_FLAG(&huart2, UART_FLAG_TC) == RESET) {
-        if ((HAL_GetTick() - t1) > 2U) break;
-      }
-      ModbusRTU_TxCpltISR(&g_mb2);
+
+  #if MODBUS_CAPTURE_ENABLE
+    if (huart == &huart3) {
+      appEventSet(APP_EVT_CAPTURE);   /* 抓包流一段送完，主循环接着送 */
+      return;
+    }
+  #endif
+
+  #if RUN_MODE_INSTANCE
+    ModbusInstance_t *inst = ModbusInstanceFromUart(huart);
+    if (inst != NULL) {
+      Modbus_HAL_TxCpltISR(inst);   /* 释放 DE、恢复接收 */
       return;
     }
   #endif
+
+  /* Modbus：按 USART 找到实例，各通道发送状态互不影响 */
+  ModbusRTU_Slave *mb = ModbusRTU_FromUart(huart);
+  if (mb != NULL) {
+    /* HAL 的 DMA 发送在 DMA 完成后改开 TC 中断，本回调就在 TC 置位时进入：
+       最后一个停止位已移出，直接释放 DE；配置了 POST 保护时间则由 TIM2 到期释放 */
+    if (ModbusRTU_TxCpltISR(mb)) {
+      ModbusSignal(huart);
+    }
+    return;
+  }
   /* USER CODE END HAL_UART_TxCpltCallback 0 */
   
   /* USER CODE BEGIN HAL_UART_TxCpltCallback 1 */
@@ -460,24 +581,41 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
   */
 void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
 {
-  /* 清错误标志：读 SR/DR */
+  /* ORE/FE/NE/PE 已在 USARTx_IRQHandler 中由 ModbusRTU_RxErrorISR 就地处理，
+     走到这里的是 HAL 仍然报告的错误（如 DMA 传输错误），需要重启接收 */
   volatile uint32_t sr = huart->Instance->SR; (void)sr;
   volatile uint32_t dr = huart->Instance->DR; (void)dr;
 
-  if (huart == &huart1) {
-    /* Modbus USART1 恢复接收 */
-    HAL_UART_Receive_DMA(&huart1, g_mb.rxBuffer, MB_RTU_FRAME_MAX_SIZE);
-    return;
+  /* Modbus 恢复接收（未登记的测试模式串口不处理） */
+  ModbusRTU_Slave *mb = ModbusRTU_FromUart(huart);
+  if (mb != NULL) {
+    ModbusRTU_ErrorISR(mb);
+    ModbusSignal(huart);
   }
-  #if USART2_TEST_MODE == 0
-    if (huart == &huart2) {
-      /* Modbus USART2 恢复接收 */
-      HAL_UART_Receive_DMA(&huart2, g_mb2.rxBuffer, MB_RTU_FRAME_MAX_SIZE);
-      return;
-    }
-  #endif
+#if RUN_MODE_INSTANCE
+  /* HAL 已中止接收 DMA；协议栈空闲时重启，处理/发送中的由 Modbus_Poll 或发送完成重启 */
+  ModbusInstance_t *inst = ModbusInstanceFromUart(huart);
+  if (inst != NULL) {
+    if (huart->ErrorCode & HAL_UART_ERROR_ORE) inst->stDiag.charOverrun++;
+    if (inst->eState == STATE_IDLE) Modbus_HAL_StartReception(inst);
+  }
+#endif
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+  * @brief  Rx 半满/满回调：Modbus 接收期间分段折叠 CRC
+  * @details 与 IDLE 同抢占级（见 MX_DMA_Init），帧尾只剩最后一段需要计算
+  */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+  ModbusRTU_RxChunkISR(ModbusRTU_FromUart(huart));
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+  ModbusRTU_RxChunkISR(ModbusRTU_FromUart(huart));
+}
+
 /* USER CODE END 1 */
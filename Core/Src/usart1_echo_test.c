@@ -112,9 +112,6 @@ void usart1EchoProcess(void)
     /* 切换RS485到发送模式 */
     HAL_GPIO_WritePin(ECHO1_RS485_PORT, ECHO1_RS485_PIN, GPIO_PIN_SET);
     
-    /* 小延时确保RS485切换稳定 */
-    for(volatile uint32_t i = 0; i < 100; i++); // 约10us延时
-    
     /* DMA异步发送 */
     HAL_UART_Transmit_DMA(&huart1, echo1TxBuffer, rxLen);
     
@@ -127,13 +124,7 @@ void usart1EchoTxCallback(UART_HandleTypeDef *huart)
         diag1TxCpltCount++;
         HAL_GPIO_WritePin(ECHO1_LED_PORT, ECHO1_LED_PIN, GPIO_PIN_RESET);
 
-        /* 等待 TC，最长约 2ms */
-        uint32_t t0 = HAL_GetTick();
-        while (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_TC) == RESET) {
-            if ((HAL_GetTick() - t0) > 2U) break;
-        }
-
-        /* 切换RS485回接收模式 */
+        /* 本回调在 TC 置位时进入（HAL DMA 发送完成后改开 TC 中断），直接切回接收 */
         HAL_GPIO_WritePin(ECHO1_RS485_PORT, ECHO1_RS485_PIN, GPIO_PIN_RESET);
         
         /* 重要：立即重启DMA接收，准备接收下一帧数据 */
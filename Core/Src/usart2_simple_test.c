@@ -100,10 +100,7 @@ void usart2SimpleHandleIdle(void)
 void usart2SimpleTxCallback(UART_HandleTypeDef *huart)
 {
     if (huart == &huart2) {
-        /* 短暂延迟确保数据发出 */
-        for(volatile uint32_t i = 0; i < 200; i++);  // 约200us @ 72MHz
-        
-        /* 切换RS485回接收 */
+        /* 本回调在 TC 置位时进入，数据已全部移出，直接切回接收 */
         HAL_GPIO_WritePin(SIMPLE_RS485_PORT, SIMPLE_RS485_PIN, GPIO_PIN_RESET);
     }
 }
@@ -133,7 +130,6 @@ void usart2SimpleProcess(void)
     
     /* 切换RS485到发送 */
     HAL_GPIO_WritePin(SIMPLE_RS485_PORT, SIMPLE_RS485_PIN, GPIO_PIN_SET);
-    HAL_Delay(1);
     
     /* DMA发送 */
     HAL_UART_Transmit_DMA(&huart2, simpleTxBuf, len);
@@ -8,225 +8,804 @@
 
 /* ------ �ڲ�ǰ������ ------ */
 static void ModbusRTU_Exception(ModbusRTU_Slave *mb, uint8_t funcCode, uint8_t exceptionCode);
+static void ModbusRTU_ReadCoils(ModbusRTU_Slave *mb);
+static void ModbusRTU_ReadDiscreteInputs(ModbusRTU_Slave *mb);
+static void ModbusRTU_WriteSingleCoil(ModbusRTU_Slave *mb);
+static void ModbusRTU_WriteMultipleCoils(ModbusRTU_Slave *mb);
 static void ModbusRTU_ReadHoldingRegisters(ModbusRTU_Slave *mb);
 static void ModbusRTU_ReadInputRegisters(ModbusRTU_Slave *mb);
 static void ModbusRTU_WriteSingleRegister(ModbusRTU_Slave *mb);
 static void ModbusRTU_WriteMultipleRegisters(ModbusRTU_Slave *mb);
-static void ModbusRTU_ProcessFrame(ModbusRTU_Slave *mb);
+static void ModbusRTU_MaskWriteRegister(ModbusRTU_Slave *mb);
+static void ModbusRTU_ReadWriteMultipleRegisters(ModbusRTU_Slave *mb);
+static void ModbusRTU_Diagnostics(ModbusRTU_Slave *mb);
+static void ModbusRTU_ProcessFrame(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d);
 
-/* ------ ����ʱ�󶨵Ļʵ�������� HAL �ص��� ------ */
-// static ModbusRTU_Slave *s_active_mb = NULL; // 未使用，因为 MB_PROVIDE_IRQ_HANDLERS = 0
-/* ����״̬ & ͳһ�������� */
-static volatile uint8_t s_txInProgress = 0;
+/* ------ 实例登记表：按 USART 外设索引，HAL 回调 O(1) 找到实例 ------ */
+static ModbusRTU_Slave *s_instances[MB_MAX_INSTANCES];
 
-static void MB_RestartRx(ModbusRTU_Slave *mb){
-    mb->rxComplete = 0;
-    mb->rxCount = 0;
-    mb->frameReceiving = 0;
-    HAL_UART_Receive_DMA(mb->huart, mb->rxBuffer, MB_RTU_FRAME_MAX_SIZE);
-}
-
-/* ------ CRC16 �� ------ */
-static const uint16_t crcTable[256] = {
-    0x0000,0xC0C1,0xC181,0x0140,0xC301,0x03C0,0x0280,0xC241,0xC601,0x06C0,0x0780,0xC741,0x0500,0xC5C1,0xC481,0x0440,
-    0xCC01,0x0CC0,0x0D80,0xCD41,0x0F00,0xCFC1,0xCE81,0x0E40,0x0A00,0xCAC1,0xCB81,0x0B40,0xC901,0x09C0,0x0880,0xC841,
-    0xD801,0x18C0,0x1980,0xD941,0x1B00,0xDBC1,0xDA81,0x1A40,0x1E00,0xDEC1,0xDF81,0x1F40,0xDD01,0x1DC0,0x1C80,0xDC41,
-    0x1400,0xD4C1,0xD581,0x1540,0xD701,0x17C0,0x1680,0xD641,0xD201,0x12C0,0x1380,0xD341,0x1100,0xD1C1,0xD081,0x1040,
-    0xF001,0x30C0,0x3180,0xF141,0x3300,0xF3C1,0xF281,0x3240,0x3600,0xF6C1,0xF781,0x3740,0xF501,0x35C0,0x3480,0xF441,
-    0x3C00,0xFCC1,0xFD81,0x3D40,0xFF01,0x3FC0,0x3E80,0xFE41,0xFA01,0x3AC0,0x3B80,0xFB41,0x3900,0xF9C1,0xF881,0x3840,
-    0x2800,0xE8C1,0xE981,0x2940,0xEB01,0x2BC0,0x2A80,0xEA41,0xEE01,0x2EC0,0x2F80,0xEF41,0x2D00,0xEDC1,0xEC81,0x2C40,
-    0xE401,0x24C0,0x2580,0xE541,0x2700,0xE7C1,0xE681,0x2640,0x2200,0xE2C1,0xE381,0x2340,0xE101,0x21C0,0x2080,0xE041,
-    0xA001,0x60C0,0x6180,0xA141,0x6300,0xA3C1,0xA281,0x6240,0x6600,0xA6C1,0xA781,0x6740,0xA501,0x65C0,0x6480,0xA441,
-    0x6C00,0xACC1,0xAD81,0x6D40,0xAF01,0x6FC0,0x6E80,0xAE41,0xAA01,0x6AC0,0x6B80,0xAB41,0x6900,0xA9C1,0xA881,0x6840,
-    0x7800,0xB8C1,0xB981,0x7940,0xBB01,0x7BC0,0x7A80,0xBA41,0xBE01,0x7EC0,0x7F80,0xBF41,0x7D00,0xBDC1,0xBC81,0x7C40,
-    0xB401,0x74C0,0x7580,0xB541,0x7700,0xB7C1,0xB681,0x7640,0x7200,0xB2C1,0xB381,0x7340,0xB101,0x71C0,0x7080,0xB041,
-    0x5000,0x90C1,0x9181,0x5140,0x9301,0x53C0,0x5280,0x9241,0x9601,0x56C0,0x5780,0x9741,0x5500,0x95C1,0x9481,0x5440,
-    0x9C01,0x5CC0,0x5D80,0x9D41,0x5F00,0x9FC1,0x9E81,0x5E40,0x5A00,0x9AC1,0x9B81,0x5B40,0x9901,0x59C0,0x5880,0x9841,
-    0x8801,0x48C0,0x4980,0x8941,0x4E00,0x8EC1,0x8F81,0x4F40,0x8D01,0x4DC0,0x4C80,0x8C41,0x4400,0x84C1,0x8581,0x4540,
-    0x8701,0x47C0,0x4680,0x8641,0x8201,0x42C0,0x4380,0x8341,0x4100,0x81C1,0x8081,0x4040
+/* 每个 USART 对应的默认 RS485 方向引脚；未定义引脚宏即不做方向控制 */
+static const struct {
+    USART_TypeDef *instance;
+    GPIO_TypeDef  *dePort;
+    uint16_t       dePin;
+} s_mbPorts[MB_MAX_INSTANCES] = {
+#ifdef MB_USART1_RS485_DE_Pin
+    { USART1, MB_USART1_RS485_DE_GPIO_Port, MB_USART1_RS485_DE_Pin },
+#else
+    { USART1, NULL, 0 },
+#endif
+#ifdef MB_USART2_RS485_DE_Pin
+    { USART2, MB_USART2_RS485_DE_GPIO_Port, MB_USART2_RS485_DE_Pin },
+#else
+    { USART2, NULL, 0 },
+#endif
 };
 
+static inline int MB_UartIndex(const USART_TypeDef *instance){
+    for (uint32_t i = 0; i < MB_MAX_INSTANCES; i++) {
+        if (s_mbPorts[i].instance == instance) return (int)i;
+    }
+    return -1;
+}
+
+ModbusRTU_Slave *ModbusRTU_FromUart(const UART_HandleTypeDef *huart)
+{
+    if (huart == NULL) return NULL;
+    int idx = MB_UartIndex(huart->Instance);
+    if (idx < 0) return NULL;
+    ModbusRTU_Slave *mb = s_instances[idx];
+    return (mb != NULL && mb->huart == huart) ? mb : NULL;
+}
+
+/* ------ CRC16：公共 slicing-by-4 实现见 modbus_crc.c ------ */
 uint16_t ModbusRTU_CRC16(uint8_t *buffer, uint16_t length)
 {
-    uint16_t crc = 0xFFFF;
-    for (uint16_t i = 0; i < length; i++) {
-        crc = (crc >> 8) ^ crcTable[(crc ^ buffer[i]) & 0xFF];
+    return ModbusCRC16(buffer, length);
+}
+
+/* ---------- 接收环：循环 DMA 位置与 CRC 折叠 ---------- */
+/* 接收 DMA 当前写入的环下标 */
+static inline uint16_t MB_RxDmaPos(ModbusRTU_Slave *mb){
+    return (uint16_t)((MB_RX_RING_SIZE - __HAL_DMA_GET_COUNTER(mb->huart->hdmarx)) & MB_RX_RING_MASK);
+}
+
+/* 已写入环但尚未折叠的字节数（半满/满中断保证不会超过半个环） */
+static inline uint16_t MB_RxPending(ModbusRTU_Slave *mb){
+    return (uint16_t)((MB_RxDmaPos(mb) - mb->rxCrc.pos) & MB_RX_RING_MASK);
+}
+
+/* 把 n 个新字节计入当前帧（仅在 USART/RX DMA 同级中断或关中断下调用） */
+static void MB_RxAdvance(ModbusRTU_Slave *mb, uint16_t n){
+    if (n == 0U) return;
+#if MB_RX_CRC_INCREMENTAL
+    ModbusCRC16_StreamFoldRing(&mb->rxCrc, mb->rxRing, MB_RX_RING_SIZE, n);
+#else
+    mb->rxCrc.pos = (uint16_t)((mb->rxCrc.pos + n) & MB_RX_RING_MASK);
+#endif
+    mb->rxTotal += n;
+    mb->frameReceiving = 1;
+    mb->lastReceiveTime = HAL_GetTick();
+}
+
+/* 帧结束：把 [rxFrameStart, rxTotal) 作为一帧入队，不停 DMA；返回 1 = 已入队 */
+static uint8_t MB_RxFrameEnd(ModbusRTU_Slave *mb){
+    MB_RxAdvance(mb, MB_RxPending(mb));
+    uint32_t len = mb->rxTotal - mb->rxFrameStart;
+    if (len == 0U) return 0;
+
+    uint8_t queued = 0;
+    uint8_t head = mb->rxQHead;
+    mb->diag.busMessage++;
+    if (mb->rxFrameBad) {
+        mb->rxDropped++;
+        mb->diag.busFrameError++;
+    } else if (len > MB_RTU_FRAME_MAX_SIZE
+        || (uint8_t)(head - mb->rxQTail) >= MB_RX_QUEUE_LEN) {
+        mb->rxDropped++;
+        mb->diag.messageOverrun++;
+    } else {
+        ModbusRTU_RxDesc *d = &mb->rxQueue[head & MB_RX_QUEUE_MASK];
+        d->start     = mb->rxFrameStart;
+        d->length    = (uint16_t)len;
+        d->crc       = mb->rxCrc.crc;
+        d->timestamp = HAL_GetTick();
+        d->idleCyc   = mb->trace.idleCyc;
+        __DMB();                        /* 描述符写完再发布 */
+        mb->rxQHead = (uint8_t)(head + 1U);
+        queued = 1;
+    }
+    mb->rxFrameStart = mb->rxTotal;
+    mb->rxCrc.crc = MB_CRC16_INIT;
+    mb->rxFrameBad = 0;
+    mb->frameReceiving = 0;
+    return queued;
+}
+
+/* ---------- RTU 帧定时：TIM2 自由运行 1MHz，比较通道判 t1.5/t3.5 ----------
+   IDLE（线路空闲一个字符）时布防：t1.5 到期若无新字节则字符流结束，
+   t3.5 到期仍无新字节才结帧；t1.5~t3.5 之间再来字节即为违例，整段丢弃。
+   实例下标 idx 占用 CH(2*idx+1) 判 t1.5、CH(2*idx+2) 判 t3.5。
+   TIM2 与 USART 同抢占级，与 IDLE/DMA 回调互不嵌套。 */
+#if MB_FRAME_TIMER
+#define MB_FT_IDLE          0U
+#define MB_FT_WAIT_T15      1U
+#define MB_FT_WAIT_T35      2U
+#define MB_FT_TX_PRE        3U      /* 发送中：t1.5 通道计 DE 前保护时间 */
+#define MB_FT_TX_POST       4U      /* 发送中：t1.5 通道计 DE 后保护时间 */
+#define MB_FT_TX_HOLD       5U      /* 续传挂起：t1.5 通道计最长帧内间隙，到期放弃续传 */
+#define MB_FT_NONE          0xFFU
+
+static uint8_t s_ftStarted;
+
+static inline uint32_t MB_FtFlag15(const ModbusRTU_Slave *mb){ return TIM_SR_CC1IF << (2U * mb->ftIndex); }
+static inline uint32_t MB_FtFlag35(const ModbusRTU_Slave *mb){ return TIM_SR_CC2IF << (2U * mb->ftIndex); }
+static inline volatile uint32_t *MB_FtCcr15(const ModbusRTU_Slave *mb){ return &TIM2->CCR1 + 2U * mb->ftIndex; }
+static inline volatile uint32_t *MB_FtCcr35(const ModbusRTU_Slave *mb){ return &TIM2->CCR2 + 2U * mb->ftIndex; }
+
+static void MB_FrameTimerStart(void){
+    if (s_ftStarted) return;
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    /* APB1 分频时定时器时钟为 PCLK1 x2（72MHz 系统下为 72MHz） */
+    uint32_t clk = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) clk *= 2U;
+
+    TIM2->CR1  = 0;
+    TIM2->PSC  = clk / 1000000U - 1U;   /* 1 tick = 1us */
+    TIM2->ARR  = 0xFFFFU;
+    TIM2->DIER = 0;
+    TIM2->EGR  = TIM_EGR_UG;            /* 立即装载 PSC */
+    TIM2->SR   = 0;
+    TIM2->CR1  = TIM_CR1_CEN;
+
+    HAL_NVIC_SetPriority(TIM2_IRQn, 0, 2);
+    HAL_NVIC_EnableIRQ(TIM2_IRQn);
+    s_ftStarted = 1;
+}
+
+/* 按串口配置计算 IDLE 之后到 t1.5/t3.5 的延时 */
+static void MB_FrameTimerConfig(ModbusRTU_Slave *mb){
+    uint32_t baud = mb->huart->Init.BaudRate;
+    uint32_t bits = 1U + ((mb->huart->Init.WordLength == UART_WORDLENGTH_9B) ? 9U : 8U)
+                  + ((mb->huart->Init.StopBits == UART_STOPBITS_2) ? 2U : 1U);
+    uint32_t tChar = (bits * 1000000U + baud - 1U) / baud;
+    uint32_t t15, t35;
+    if (baud > 19200U) {
+        t15 = MB_T15_FIXED_US;
+        t35 = MB_T35_FIXED_US;
+    } else {
+        t15 = (bits * 1500000U + baud - 1U) / baud;
+        t35 = (bits * 3500000U + baud - 1U) / baud;
+    }
+    /* IDLE 在最后一个字符之后再空闲一个字符时间才置位 */
+    mb->ftT15 = (uint16_t)((t15 > tChar) ? (t15 - tChar) : 1U);
+    mb->ftT35 = (uint16_t)((t35 > tChar) ? (t35 - tChar) : 1U);
+    mb->ftTxHold = (uint16_t)t15;       /* TC 时最后一个停止位已发完，间隙从此刻算 */
+}
+
+static void MB_FrameTimerDisarm(ModbusRTU_Slave *mb){
+    if (mb->ftIndex == MB_FT_NONE) return;
+    uint32_t f = MB_FtFlag15(mb) | MB_FtFlag35(mb);
+    TIM2->DIER &= ~f;
+    TIM2->SR = ~f;                      /* rc_w0：写 0 清除，写 1 不影响 */
+    mb->ftState = MB_FT_IDLE;
+}
+
+/* IDLE 中断：折叠已到字节，从此刻起布防 t1.5/t3.5 */
+static void MB_FrameTimerArm(ModbusRTU_Slave *mb){
+    uint16_t now = (uint16_t)TIM2->CNT;
+    uint32_t f = MB_FtFlag15(mb) | MB_FtFlag35(mb);
+
+    if (mb->ftState == MB_FT_WAIT_T35) {
+        /* t1.5 已过、t3.5 未到又收到字节：帧内间隔超限 */
+        mb->rxFrameBad = 1;
+        mb->rxT15Violations++;
+    }
+    MB_RxAdvance(mb, MB_RxPending(mb));
+    mb->ftPos = mb->rxCrc.pos;
+
+    *MB_FtCcr15(mb) = (uint16_t)(now + mb->ftT15);
+    *MB_FtCcr35(mb) = (uint16_t)(now + mb->ftT35);
+    TIM2->SR = ~f;
+    TIM2->DIER |= f;
+    mb->ftState = MB_FT_WAIT_T15;
+}
+
+/* 发送期间借 t1.5 通道计 DE 保护时间（调用方保证不与 TIM2 中断交错） */
+static void MB_DeGuardArm(ModbusRTU_Slave *mb, uint8_t state, uint16_t us){
+    uint32_t f = MB_FtFlag15(mb);
+    TIM2->DIER &= ~(f | MB_FtFlag35(mb));
+    uint16_t t0 = (uint16_t)TIM2->CNT;
+    *MB_FtCcr15(mb) = (uint16_t)(t0 + us);
+    TIM2->SR = ~(f | MB_FtFlag35(mb));
+    mb->ftState = state;
+    TIM2->DIER |= f;
+    /* 保护时间只有几 us 时，写比较值前计数器可能已越过：软件触发比较事件（CCxG 与 CCxIF 同位） */
+    if ((uint16_t)((uint16_t)TIM2->CNT - t0) >= us) {
+        TIM2->EGR = f;
     }
-    return crc;
 }
+#endif /* MB_FRAME_TIMER */
 
-/* ---------- RS485 方向控制 (支持多串口) ---------- */
-static inline void RS485_TxEnable(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART1) {
-        #ifdef MB_USART1_RS485_DE_Pin
-        HAL_GPIO_WritePin(MB_USART1_RS485_DE_GPIO_Port, MB_USART1_RS485_DE_Pin, GPIO_PIN_SET);
-        #endif
-    } else if (huart->Instance == USART2) {
-        #ifdef MB_USART2_RS485_DE_Pin
-        HAL_GPIO_WritePin(MB_USART2_RS485_DE_GPIO_Port, MB_USART2_RS485_DE_Pin, GPIO_PIN_SET);
-        #endif
+/* DMA 被 HAL 错误处理中止后重新启动：新一圈从环下标 0 开始，
+   累计序号对齐到下一整圈，已入队的帧仍可按序号判断是否被覆盖 */
+static void MB_RxRingRestart(ModbusRTU_Slave *mb){
+#if MB_FRAME_TIMER
+    if (!mb->txInProgress) MB_FrameTimerDisarm(mb);   /* 发送中的 DE 保护计时不能丢 */
+#endif
+    mb->rxFrameBad = 0;
+    mb->rxTotal = (mb->rxTotal + MB_RX_RING_MASK) & ~(uint32_t)MB_RX_RING_MASK;
+    mb->rxFrameStart = mb->rxTotal;
+    ModbusCRC16_StreamReset(&mb->rxCrc);
+    mb->frameReceiving = 0;
+    HAL_UART_Receive_DMA(mb->huart, mb->rxRing, MB_RX_RING_SIZE);
+}
+
+/* 取出一帧供处理：未回绕直接指向环内，回绕则拷到 rxBuffer；被覆盖返回 0 */
+static uint8_t MB_RxLoadFrame(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d){
+    uint16_t off = (uint16_t)(d->start & MB_RX_RING_MASK);
+    if (off + d->length <= MB_RX_RING_SIZE) {
+        mb->req = &mb->rxRing[off];
+    } else {
+        uint16_t first = (uint16_t)(MB_RX_RING_SIZE - off);
+        memcpy(mb->rxBuffer, &mb->rxRing[off], first);
+        memcpy(mb->rxBuffer + first, mb->rxRing, (size_t)(d->length - first));
+        mb->req = mb->rxBuffer;
+    }
+    mb->rxCount = d->length;
+
+    /* DMA 写入位置领先帧首超过一整圈，说明帧已被新数据覆盖 */
+    uint8_t ok = 1;
+    uint32_t pm = MB_CriticalEnter();
+    uint32_t writer = mb->rxTotal + MB_RxPending(mb);
+    if (writer - d->start > MB_RX_RING_SIZE) {
+        mb->rxDropped++;
+        mb->diag.messageOverrun++;      /* 与中断侧共用字段，在临界区内累加 */
+        ok = 0;
+    }
+    MB_CriticalExit(pm);
+    return ok;
+}
+
+/* ---------- RS485 方向控制（每实例独立引脚） ---------- */
+static inline void RS485_TxEnable(ModbusRTU_Slave *mb) {
+    if (mb->dePort != NULL) {
+        HAL_GPIO_WritePin(mb->dePort, mb->dePin, GPIO_PIN_SET);
+    }
+}
+static inline void RS485_RxEnable(ModbusRTU_Slave *mb) {
+    if (mb->dePort != NULL) {
+        HAL_GPIO_WritePin(mb->dePort, mb->dePin, GPIO_PIN_RESET);
     }
 }
-static inline void RS485_RxEnable(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART1) {
-        #ifdef MB_USART1_RS485_DE_Pin
-        HAL_GPIO_WritePin(MB_USART1_RS485_DE_GPIO_Port, MB_USART1_RS485_DE_Pin, GPIO_PIN_RESET);
-        #endif
-    } else if (huart->Instance == USART2) {
-        #ifdef MB_USART2_RS485_DE_Pin
-        HAL_GPIO_WritePin(MB_USART2_RS485_DE_GPIO_Port, MB_USART2_RS485_DE_Pin, GPIO_PIN_RESET);
-        #endif
+
+/* 把暂存的发送数据交给 DMA；HAL 在 DMA 完成后改开 TC 中断，TxCplt 回调即在 TC 时到来 */
+static HAL_StatusTypeDef MB_TxStart(ModbusRTU_Slave *mb){
+    ModbusTrace_Stamp(&mb->trace, MB_TRACE_TX_START);
+    if (HAL_UART_Transmit_DMA(mb->huart, (uint8_t *)mb->txData, mb->txLen) != HAL_OK) {
+        ModbusTrace_Abort(&mb->trace);
+        /* 发不出去就别占着总线，直接回到接收 */
+        mb->txInProgress = 0;
+        RS485_RxEnable(mb);
+        return HAL_ERROR;
+    }
+    ModbusCapture_Tx((uint8_t)MB_UartIndex(mb->huart->Instance), mb->txData, mb->txLen);
+    return HAL_OK;
+}
+
+/* 发送收尾：释放 DE，发送期间的回显/噪声整段丢弃 */
+static void MB_TxFinish(ModbusRTU_Slave *mb){
+    RS485_RxEnable(mb);
+#if MB_FRAME_TIMER
+    MB_FrameTimerDisarm(mb);
+#endif
+    mb->rxFrameBad = 0;
+    MB_RxAdvance(mb, MB_RxPending(mb));
+    mb->rxFrameStart = mb->rxTotal;
+    mb->rxCrc.crc = MB_CRC16_INIT;
+    mb->frameReceiving = 0;
+    mb->txInProgress = 0;
+    mb->txCount = 0;
+}
+
+/* 发送结束释放总线：配置了 POST 保护则由 TIM2 到期收尾并返回 0，否则立即切回接收返回 1 */
+static uint8_t MB_TxRelease(ModbusRTU_Slave *mb){
+#if MB_FRAME_TIMER
+    if (mb->dePostGuardUs != 0U && mb->ftIndex != MB_FT_NONE) {
+        MB_DeGuardArm(mb, MB_FT_TX_POST, mb->dePostGuardUs);
+        return 0;
+    }
+#endif
+    MB_TxFinish(mb);
+    return 1;
+}
+
+HAL_StatusTypeDef ModbusRTU_SendRaw(ModbusRTU_Slave *mb, const uint8_t *data, uint16_t len)
+{
+    uint32_t pm = MB_CriticalEnter();
+    uint8_t chained = mb->txInProgress;     /* 续传：DE 已在发送方向，不再等 PRE */
+    mb->txData = data;
+    mb->txLen  = len;
+    mb->txInProgress = 1;
+#if MB_FRAME_TIMER
+    if (chained && mb->ftState == MB_FT_TX_HOLD) {
+        MB_FrameTimerDisarm(mb);            /* 挂起后赶在 t1.5 内续上 */
+    }
+#endif
+    if (!chained) {
+#if MB_FRAME_TIMER
+        MB_FrameTimerDisarm(mb);            /* 发送期间不判帧 */
+#endif
+        RS485_TxEnable(mb);
+#if MB_FRAME_TIMER
+        if (mb->dePreGuardUs != 0U && mb->ftIndex != MB_FT_NONE) {
+            MB_DeGuardArm(mb, MB_FT_TX_PRE, mb->dePreGuardUs);
+            MB_CriticalExit(pm);
+            return HAL_OK;
+        }
+#endif
     }
+    HAL_StatusTypeDef st = MB_TxStart(mb);
+    MB_CriticalExit(pm);
+    return st;
+}
+
+uint32_t ModbusRTU_RxWritePos(ModbusRTU_Slave *mb)
+{
+    uint32_t pm = MB_CriticalEnter();
+    uint32_t pos = mb->rxTotal + MB_RxPending(mb);
+    MB_CriticalExit(pm);
+    return pos;
 }
 
 /* ---------- ��ʼ�� ---------- */
 void ModbusRTU_Init(ModbusRTU_Slave *mb, UART_HandleTypeDef *huart, uint8_t slaveAddr)
 {
-    // s_active_mb   = mb; // 注释掉，因为变量未定义
     mb->huart     = huart;
     mb->slaveAddr = slaveAddr;
     mb->rxCount = 0;
-    mb->rxComplete = 0;
+    mb->req = mb->rxBuffer;
     mb->txCount = 0;
     mb->frameReceiving = 0;
     mb->lastReceiveTime = 0;
+    mb->rxTotal = 0;
+    mb->rxFrameStart = 0;
+    mb->rxQHead = 0;
+    mb->rxQTail = 0;
+    mb->rxDropped = 0;
+    ModbusCRC16_StreamReset(&mb->rxCrc);
+    memset(&mb->diag, 0, sizeof(mb->diag));
 
     memset(mb->holdingRegs, 0, sizeof(mb->holdingRegs));
     memset(mb->inputRegs,   0, sizeof(mb->inputRegs));
     memset(mb->coils,       0, sizeof(mb->coils));
     memset(mb->discreteInputs, 0, sizeof(mb->discreteInputs));
 
-    s_txInProgress = 0;
-    RS485_RxEnable(mb->huart);
-    HAL_UART_Receive_DMA(mb->huart, mb->rxBuffer, MB_RTU_FRAME_MAX_SIZE);
+    mb->txInProgress = 0;
+    mb->dePort = NULL;
+    mb->dePin  = 0;
+    mb->dePreGuardUs  = MB_DE_PRE_GUARD_US;
+    mb->dePostGuardUs = MB_DE_POST_GUARD_US;
+    mb->txData = mb->txBuffer;
+    mb->txLen  = 0;
+    mb->rxFrameBad = 0;
+    mb->rxT15Violations = 0;
+    mb->rxErrOverrun = 0;
+    mb->rxErrFraming = 0;
+    mb->rxErrNoise   = 0;
+    mb->rxErrParity  = 0;
+    memset(&mb->trace, 0, sizeof(mb->trace));
+    mb->regSeq = 0;
+    mb->regReadRetries = 0;
+    mb->chgSeq = 0;
+    mb->dirtyHolding = (1UL << MB_DIRTY_BLOCKS(MB_HOLDING_REGS_SIZE)) - 1U;   /* 上电后主站先全读一遍 */
+    mb->dirtyInput   = (1UL << MB_DIRTY_BLOCKS(MB_INPUT_REGS_SIZE)) - 1U;
+    memset(mb->holdingBlockSeq, 0, sizeof(mb->holdingBlockSeq));
+    memset(mb->inputBlockSeq, 0, sizeof(mb->inputBlockSeq));
+    mb->ftState = 0;
+    mb->ftIndex = 0xFFU;
+    int idx = MB_UartIndex(huart->Instance);
+    if (idx >= 0) {
+        mb->dePort = s_mbPorts[idx].dePort;
+        mb->dePin  = s_mbPorts[idx].dePin;
+        s_instances[idx] = mb;
+#if MB_FRAME_TIMER
+        mb->ftIndex = (uint8_t)idx;
+        MB_FrameTimerConfig(mb);
+        MB_FrameTimerStart();
+#endif
+    }
+
+    RS485_RxEnable(mb);
+    /* 接收 DMA 改为循环模式：此后整个运行期间不再停止/重启 */
+    mb->huart->hdmarx->Init.Mode = DMA_CIRCULAR;
+    HAL_DMA_Init(mb->huart->hdmarx);
+    HAL_UART_Receive_DMA(mb->huart, mb->rxRing, MB_RX_RING_SIZE);
 }
 
-/* ---------- �����ּĴ��� 0x03������ʽ�� ---------- */
+/* ---------- 读寄存器应答：seqlock 下直接序列化到 txBuffer，CRC 同趟计算 ----------
+   读前后序列号一致且为偶数，说明期间没有写入，本次结果是一致快照；
+   否则整段重读（帧头的 CRC 只算一次）。不关中断，也不占用栈上的快照数组。 */
+static void ModbusRTU_SerializeRegisters(ModbusRTU_Slave *mb, uint8_t funcCode,
+                                         const uint16_t *regs, uint16_t startAddr, uint16_t quantity)
+{
+    mb->txBuffer[0] = mb->slaveAddr;
+    mb->txBuffer[1] = funcCode;
+    mb->txBuffer[2] = (uint8_t)(quantity * 2);
+    uint16_t crcHead = ModbusRTU_CRC16(mb->txBuffer, 3);
+
+    const volatile uint16_t *src = (const volatile uint16_t *)&regs[startAddr];
+    for (uint32_t tries = 0; tries < MB_REG_SEQ_READ_TRIES; tries++) {
+        uint32_t seq = mb->regSeq;
+        __DMB();
+        if (seq & 1U) {                 /* 被打断的写入尚未结束 */
+            mb->regReadRetries++;
+            continue;
+        }
+
+        uint8_t *out = &mb->txBuffer[3];
+        uint16_t crc = crcHead;
+        uint16_t i = 0;
+        for (; i + 1U < quantity; i += 2U) {   /* 每次两个寄存器，正好一步 slicing-by-4 */
+            uint16_t v0 = src[i];
+            uint16_t v1 = src[i + 1U];
+            out[0] = (uint8_t)(v0 >> 8);
+            out[1] = (uint8_t)(v0 & 0xFF);
+            out[2] = (uint8_t)(v1 >> 8);
+            out[3] = (uint8_t)(v1 & 0xFF);
+            crc = ModbusCRC16_Update4(crc, out[0], out[1], out[2], out[3]);
+            out += 4;
+        }
+        if (i < quantity) {
+            uint16_t v = src[i];
+            out[0] = (uint8_t)(v >> 8);
+            out[1] = (uint8_t)(v & 0xFF);
+            crc = ModbusCRC16_Update2(crc, out[0], out[1]);
+        }
+
+        __DMB();
+        if (mb->regSeq == seq) {
+            mb->txCount = 3 + quantity * 2;
+            mb->txBuffer[mb->txCount++] = (uint8_t)(crc & 0xFF);       /* LSB */
+            mb->txBuffer[mb->txCount++] = (uint8_t)((crc >> 8) & 0xFF);/* MSB */
+            return;
+        }
+        mb->regReadRetries++;
+    }
+    /* 写入持续打断读取（中断里高频刷新寄存器），让主站稍后重试 */
+    ModbusRTU_Exception(mb, funcCode, MB_EX_SLAVE_DEVICE_BUSY);
+}
+
+/* 校验读请求的起始地址与数量，不合法时回异常并返回 0 */
+static uint8_t ModbusRTU_ReadRangeOk(ModbusRTU_Slave *mb, uint8_t funcCode, uint16_t regsSize,
+                                     uint16_t *startAddr, uint16_t *quantity)
+{
+    if (mb->rxCount < 8) return 0;
+    *startAddr = (mb->req[2] << 8) | mb->req[3];
+    *quantity  = (mb->req[4] << 8) | mb->req[5];
+    uint32_t endAddr = (uint32_t)*startAddr + *quantity - 1U;
+
+    if (*quantity < 1 || *quantity > 125) {
+        ModbusRTU_Exception(mb, funcCode, MB_EX_ILLEGAL_DATA_VALUE);
+        return 0;
+    }
+    if (endAddr >= regsSize) {
+        ModbusRTU_Exception(mb, funcCode, MB_EX_ILLEGAL_DATA_ADDRESS);
+        return 0;
+    }
+    return 1;
+}
+
+static void ModbusRTU_ReadRegisters(ModbusRTU_Slave *mb, uint8_t funcCode,
+                                    const uint16_t *regs, uint16_t regsSize)
+{
+    uint16_t startAddr, quantity;
+    if (!ModbusRTU_ReadRangeOk(mb, funcCode, regsSize, &startAddr, &quantity)) return;
+    ModbusRTU_SerializeRegisters(mb, funcCode, regs, startAddr, quantity);
+}
+
+/* ---------- 读保持寄存器 0x03 ---------- */
 static void ModbusRTU_ReadHoldingRegisters(ModbusRTU_Slave *mb)
+{
+    ModbusRTU_ReadRegisters(mb, MB_FUNC_READ_HOLDING_REGISTERS,
+                            mb->holdingRegs, MB_HOLDING_REGS_SIZE);
+}
+
+typedef char mbDirtyMapCheck[(MB_DIRTY_BLOCKS(MB_HOLDING_REGS_SIZE) < 32U
+                              && MB_DIRTY_BLOCKS(MB_INPUT_REGS_SIZE) < 32U
+                              && MB_IREG_CHANGE_BASE + MB_IREG_CHANGE_COUNT <= MB_INPUT_REGS_SIZE) ? 1 : -1];
+
+/* ---------- 变化检测寄存器：读到时现取 ----------
+   232 变化序号低 16 位，233 保持寄存器脏块位图，234/235 输入寄存器脏块位图低/高 16 位。
+   读只取快照不清位：应答丢失也不会漏掉变化，清位要等主站写 MB_HREG_CHANGE_ACK 确认。
+   序号与位图在关中断下一起取，保证位图里的变化都不晚于读到的序号。
+   这四个寄存器不登记变化，也不经 seqlock：只在主循环的读请求里写。 */
+static void ModbusRTU_LoadChangeRegs(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity)
+{
+    uint32_t endAddr = (uint32_t)startAddr + quantity;
+    if (startAddr >= MB_IREG_CHANGE_BASE + MB_IREG_CHANGE_COUNT || endAddr <= MB_IREG_CHANGE_BASE) return;
+
+    uint32_t primask = MB_CriticalEnter();
+    uint16_t seq     = (uint16_t)mb->chgSeq;
+    uint32_t holding = mb->dirtyHolding;
+    uint32_t input   = mb->dirtyInput;
+    MB_CriticalExit(primask);
+
+    mb->inputRegs[MB_IREG_CHANGE_BASE + 0U] = seq;
+    mb->inputRegs[MB_IREG_CHANGE_BASE + 1U] = (uint16_t)holding;
+    mb->inputRegs[MB_IREG_CHANGE_BASE + 2U] = (uint16_t)input;
+    mb->inputRegs[MB_IREG_CHANGE_BASE + 3U] = (uint16_t)(input >> 16);
+}
+
+/* 清掉最后一次变化不晚于 ack 的块；之后又变过的块保留 */
+static void MB_DirtyAckMap(volatile uint32_t *map, const uint16_t *blockSeq, uint16_t ack)
+{
+    uint32_t v = *map;
+    for (uint32_t n = 0; v != 0U; n++, v >>= 1) {
+        if ((v & 1U) && (int16_t)(uint16_t)(blockSeq[n] - ack) <= 0) {
+            *map &= ~(1UL << n);
+        }
+    }
+}
+
+/* ---------- 主站确认变化：写 MB_HREG_CHANGE_ACK ---------- */
+static void ModbusRTU_DirtyAck(ModbusRTU_Slave *mb, uint16_t ack)
+{
+    uint32_t primask = MB_CriticalEnter();
+    MB_DirtyAckMap(&mb->dirtyHolding, mb->holdingBlockSeq, ack);
+    MB_DirtyAckMap(&mb->dirtyInput, mb->inputBlockSeq, ack);
+    MB_CriticalExit(primask);
+}
+
+/* ---------- 读输入寄存器 0x04 ---------- */
+static void ModbusRTU_ReadInputRegisters(ModbusRTU_Slave *mb)
+{
+    uint16_t startAddr, quantity;
+    if (!ModbusRTU_ReadRangeOk(mb, MB_FUNC_READ_INPUT_REGISTERS, MB_INPUT_REGS_SIZE,
+                               &startAddr, &quantity)) return;
+    ModbusRTU_LoadChangeRegs(mb, startAddr, quantity);
+    ModbusRTU_SerializeRegisters(mb, MB_FUNC_READ_INPUT_REGISTERS, mb->inputRegs, startAddr, quantity);
+}
+
+/* ---------- 位表：任意起始地址按 32 位整字移位/掩码存取 ---------- */
+/* 取 [bit, bit+32) 的 32 位（越过表尾的高位为 0） */
+static inline uint32_t MB_BitsGet32(const volatile uint32_t *w, uint16_t words, uint16_t bit)
+{
+    uint16_t i  = bit >> 5;
+    uint32_t sh = bit & 31U;
+    uint32_t v  = w[i] >> sh;
+    if (sh != 0U && (uint16_t)(i + 1U) < words) v |= w[i + 1U] << (32U - sh);
+    return v;
+}
+
+/* 把 v 的低 n 位（1~32）写到 [bit, bit+n)，调用方保证不越过表尾 */
+static inline void MB_BitsPut32(uint32_t *w, uint16_t bit, uint32_t v, uint32_t n)
+{
+    uint16_t i    = bit >> 5;
+    uint32_t sh   = bit & 31U;
+    uint32_t mask = (n >= 32U) ? 0xFFFFFFFFUL : ((1UL << n) - 1U);
+    v &= mask;
+    w[i] = (w[i] & ~(mask << sh)) | (v << sh);
+    if (sh != 0U && n > 32U - sh) {
+        uint32_t hiMask = mask >> (32U - sh);
+        w[i + 1U] = (w[i + 1U] & ~hiMask) | (v >> (32U - sh));
+    }
+}
+
+/* ---------- 读线圈/离散输入应答：seqlock 下每次取 32 位写 4 字节 ---------- */
+static void ModbusRTU_ReadBits(ModbusRTU_Slave *mb, uint8_t funcCode,
+                               const uint32_t *bits, uint16_t bitsSize)
 {
     if (mb->rxCount < 8) return;
-    uint16_t startAddr = (mb->rxBuffer[2] << 8) | mb->rxBuffer[3];
-    uint16_t quantity  = (mb->rxBuffer[4] << 8) | mb->rxBuffer[5];
-    uint16_t endAddr   = startAddr + quantity - 1;
+    uint16_t startAddr = (mb->req[2] << 8) | mb->req[3];
+    uint16_t quantity  = (mb->req[4] << 8) | mb->req[5];
+    uint32_t endAddr   = (uint32_t)startAddr + quantity - 1U;
 
-    if (quantity < 1 || quantity > 125) {
-        ModbusRTU_Exception(mb, MB_FUNC_READ_HOLDING_REGISTERS, MB_EX_ILLEGAL_DATA_VALUE);
+    if (quantity < 1 || quantity > 2000) {
+        ModbusRTU_Exception(mb, funcCode, MB_EX_ILLEGAL_DATA_VALUE);
         return;
     }
-    if (endAddr >= MB_HOLDING_REGS_SIZE) {
-        ModbusRTU_Exception(mb, MB_FUNC_READ_HOLDING_REGISTERS, MB_EX_ILLEGAL_DATA_ADDRESS);
+    if (endAddr >= bitsSize) {
+        ModbusRTU_Exception(mb, funcCode, MB_EX_ILLEGAL_DATA_ADDRESS);
         return;
     }
 
-    /* --- ���գ��ڶ��ٽ����ڰ�Ҫ�����������忽������ --- */
-    uint16_t snapCnt = quantity;
-    uint16_t snapBuf[125]; /* Modbus ������� 125 �Ĵ��� */
-    {
-        uint32_t pm = MB_CriticalEnter();
-        for (uint16_t i = 0; i < snapCnt; i++) {
-            snapBuf[i] = mb->holdingRegs[startAddr + i];
+    uint16_t nBytes = (uint16_t)((quantity + 7U) / 8U);
+    uint16_t words  = (uint16_t)MB_BIT_WORDS(bitsSize);
+    const volatile uint32_t *src = (const volatile uint32_t *)bits;
+    mb->txBuffer[0] = mb->slaveAddr;
+    mb->txBuffer[1] = funcCode;
+    mb->txBuffer[2] = (uint8_t)nBytes;
+
+    for (uint32_t tries = 0; tries < MB_REG_SEQ_READ_TRIES; tries++) {
+        uint32_t seq = mb->regSeq;
+        __DMB();
+        if (seq & 1U) {
+            mb->regReadRetries++;
+            continue;
         }
-        MB_CriticalExit(pm);
-    }
 
-    /* --- �ÿ������ --- */
-    mb->txBuffer[0] = mb->slaveAddr;
-    mb->txBuffer[1] = MB_FUNC_READ_HOLDING_REGISTERS;
-    mb->txBuffer[2] = (uint8_t)(snapCnt * 2);
+        uint8_t *out = &mb->txBuffer[3];
+        uint16_t bit = startAddr;
+        for (uint16_t k = 0; k < nBytes; k += 4U, bit += 32U) {
+            uint32_t v = MB_BitsGet32(src, words, bit);
+            uint16_t n = (uint16_t)(nBytes - k);
+            if (n > 4U) n = 4U;
+            for (uint16_t j = 0; j < n; j++) {
+                *out++ = (uint8_t)(v >> (8U * j));
+            }
+        }
 
-    for (uint16_t i = 0; i < snapCnt; i++) {
-        uint16_t v = snapBuf[i];
-        mb->txBuffer[3 + 2*i] = (uint8_t)(v >> 8);
-        mb->txBuffer[4 + 2*i] = (uint8_t)(v & 0xFF);
+        __DMB();
+        if (mb->regSeq == seq) {
+            /* 最后一个字节多出来的位按规范补 0 */
+            if (quantity & 7U) {
+                mb->txBuffer[2 + nBytes] &= (uint8_t)((1U << (quantity & 7U)) - 1U);
+            }
+            mb->txCount = 3 + nBytes;
+            uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, mb->txCount);
+            mb->txBuffer[mb->txCount++] = (uint8_t)(crc & 0xFF);
+            mb->txBuffer[mb->txCount++] = (uint8_t)((crc >> 8) & 0xFF);
+            return;
+        }
+        mb->regReadRetries++;
     }
+    ModbusRTU_Exception(mb, funcCode, MB_EX_SLAVE_DEVICE_BUSY);
+}
 
-    mb->txCount = 3 + snapCnt * 2;
-    uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, mb->txCount);
-    mb->txBuffer[mb->txCount++] = (uint8_t)(crc & 0xFF);       /* LSB */
-    mb->txBuffer[mb->txCount++] = (uint8_t)((crc >> 8) & 0xFF);/* MSB */
+/* ---------- 读线圈 0x01 ---------- */
+static void ModbusRTU_ReadCoils(ModbusRTU_Slave *mb)
+{
+    ModbusRTU_ReadBits(mb, MB_FUNC_READ_COILS, mb->coils, MB_COILS_SIZE);
 }
 
-/* ---------- ������Ĵ��� 0x04������ʽ�� ---------- */
-static void ModbusRTU_ReadInputRegisters(ModbusRTU_Slave *mb)
+/* ---------- 读离散输入 0x02 ---------- */
+static void ModbusRTU_ReadDiscreteInputs(ModbusRTU_Slave *mb)
+{
+    ModbusRTU_ReadBits(mb, MB_FUNC_READ_DISCRETE_INPUTS, mb->discreteInputs, MB_DISCRETE_INPUTS_SIZE);
+}
+
+/* ---------- 写单个线圈 0x05：0xFF00 = ON，0x0000 = OFF ---------- */
+static void ModbusRTU_WriteSingleCoil(ModbusRTU_Slave *mb)
 {
     if (mb->rxCount < 8) return;
-    uint16_t startAddr = (mb->rxBuffer[2] << 8) | mb->rxBuffer[3];
-    uint16_t quantity  = (mb->rxBuffer[4] << 8) | mb->rxBuffer[5];
-    uint16_t endAddr   = startAddr + quantity - 1;
+    uint16_t addr  = (mb->req[2] << 8) | mb->req[3];
+    uint16_t value = (mb->req[4] << 8) | mb->req[5];
 
-    if (quantity < 1 || quantity > 125) {
-        ModbusRTU_Exception(mb, MB_FUNC_READ_INPUT_REGISTERS, MB_EX_ILLEGAL_DATA_VALUE);
+    if (value != 0xFF00U && value != 0x0000U) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_SINGLE_COIL, MB_EX_ILLEGAL_DATA_VALUE);
         return;
     }
-    if (endAddr >= MB_INPUT_REGS_SIZE) {
-        ModbusRTU_Exception(mb, MB_FUNC_READ_INPUT_REGISTERS, MB_EX_ILLEGAL_DATA_ADDRESS);
+    if (addr >= MB_COILS_SIZE) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_SINGLE_COIL, MB_EX_ILLEGAL_DATA_ADDRESS);
         return;
     }
 
-    /* --- ���գ��ڶ��ٽ����ڰ�Ҫ�����������忽������ --- */
-    uint16_t snapCnt = quantity;
-    uint16_t snapBuf[125];
-    {
-        uint32_t pm = MB_CriticalEnter();
-        for (uint16_t i = 0; i < snapCnt; i++) {
-            snapBuf[i] = mb->inputRegs[startAddr + i];
+    MB_RegWriteBegin(mb);
+    MB_BitPut(mb->coils, addr, (uint8_t)(value != 0U));
+    MB_RegWriteEnd(mb);
+    ModbusRTU_CommitWriteCoils(mb, addr, 1);
+
+    /* 回显请求 */
+    memcpy(mb->txBuffer, mb->req, 6);
+    uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, 6);
+    mb->txBuffer[6] = (uint8_t)(crc & 0xFF);
+    mb->txBuffer[7] = (uint8_t)((crc >> 8) & 0xFF);
+    mb->txCount = 8;
+}
+
+/* ---------- 写多个线圈 0x0F：请求中的位串按 32 位整字插入 ---------- */
+static void ModbusRTU_WriteMultipleCoils(ModbusRTU_Slave *mb)
+{
+    if (mb->rxCount < 10) return;
+    uint16_t startAddr = (mb->req[2] << 8) | mb->req[3];
+    uint16_t quantity  = (mb->req[4] << 8) | mb->req[5];
+    uint8_t  byteCount =  mb->req[6];
+    uint32_t endAddr   = (uint32_t)startAddr + quantity - 1U;
+
+    if (quantity < 1 || quantity > 1968 || byteCount != (quantity + 7U) / 8U) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_MULTIPLE_COILS, MB_EX_ILLEGAL_DATA_VALUE);
+        return;
+    }
+    if (endAddr >= MB_COILS_SIZE) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_MULTIPLE_COILS, MB_EX_ILLEGAL_DATA_ADDRESS);
+        return;
+    }
+    if (mb->rxCount < (uint16_t)(7 + byteCount + 2)) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_MULTIPLE_COILS, MB_EX_ILLEGAL_DATA_VALUE);
+        return;
+    }
+
+    const uint8_t *in = &mb->req[7];
+    MB_RegWriteBegin(mb);
+    for (uint16_t done = 0; done < quantity; done += 32U) {
+        uint32_t n = (uint32_t)(quantity - done);
+        if (n > 32U) n = 32U;
+        uint32_t v = 0;
+        for (uint32_t j = 0; j < (n + 7U) / 8U; j++) {   /* 只读本帧内的字节 */
+            v |= (uint32_t)in[j] << (8U * j);
         }
-        MB_CriticalExit(pm);
+        MB_BitsPut32(mb->coils, (uint16_t)(startAddr + done), v, n);
+        in += 4;
     }
+    MB_RegWriteEnd(mb);
+    ModbusRTU_CommitWriteCoils(mb, startAddr, quantity);
 
-    /* --- �ÿ������ --- */
     mb->txBuffer[0] = mb->slaveAddr;
-    mb->txBuffer[1] = MB_FUNC_READ_INPUT_REGISTERS;
-    mb->txBuffer[2] = (uint8_t)(snapCnt * 2);
-
-    for (uint16_t i = 0; i < snapCnt; i++) {
-        uint16_t v = snapBuf[i];
-        mb->txBuffer[3 + 2*i] = (uint8_t)(v >> 8);
-        mb->txBuffer[4 + 2*i] = (uint8_t)(v & 0xFF);
-    }
+    mb->txBuffer[1] = MB_FUNC_WRITE_MULTIPLE_COILS;
+    mb->txBuffer[2] = (uint8_t)(startAddr >> 8);
+    mb->txBuffer[3] = (uint8_t)(startAddr & 0xFF);
+    mb->txBuffer[4] = (uint8_t)(quantity >> 8);
+    mb->txBuffer[5] = (uint8_t)(quantity & 0xFF);
 
-    mb->txCount = 3 + snapCnt * 2;
+    mb->txCount = 6;
     uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, mb->txCount);
     mb->txBuffer[mb->txCount++] = (uint8_t)(crc & 0xFF);
     mb->txBuffer[mb->txCount++] = (uint8_t)((crc >> 8) & 0xFF);
 }
 
-/* ---------- д���Ĵ��� 0x06��д����ٽ����� ---------- */
+/* ---------- 写保持寄存器：整段校验 -> 整段提交（全部成功或全部不写） ----------
+   values 指向请求中的大端数据；校验回调返回非 0 异常码时寄存器保持原样，
+   提交在一次 seqlock 写区间内完成，读方看不到写了一半的范围。 */
+static uint8_t ModbusRTU_WriteRange(ModbusRTU_Slave *mb, uint16_t startAddr,
+                                    uint16_t quantity, const uint8_t *values)
+{
+    uint8_t ex = ModbusRTU_ValidateWriteRange(mb, startAddr, quantity, values);
+    if (ex != 0) return ex;
+
+    uint32_t blocks = 0;
+    MB_RegWriteBegin(mb);
+    for (uint16_t i = 0; i < quantity; i++) {
+        uint16_t addr = (uint16_t)(startAddr + i);
+        uint16_t v = MB_BE16(&values[2*i]);
+        if (mb->holdingRegs[addr] != v) {
+            mb->holdingRegs[addr] = v;
+            if (addr != MB_HREG_CHANGE_ACK) blocks |= 1UL << (addr >> MB_DIRTY_BLOCK_SHIFT);
+        }
+    }
+    MB_DirtyMark(mb, &mb->dirtyHolding, mb->holdingBlockSeq, blocks);
+    MB_RegWriteEnd(mb);
+
+    if (startAddr <= MB_HREG_CHANGE_ACK && (uint32_t)startAddr + quantity > MB_HREG_CHANGE_ACK) {
+        ModbusRTU_DirtyAck(mb, mb->holdingRegs[MB_HREG_CHANGE_ACK]);
+    }
+    ModbusRTU_CommitWriteRange(mb, startAddr, quantity);
+    return 0;
+}
+
+/* ---------- 写单个寄存器 0x06 ---------- */
 static void ModbusRTU_WriteSingleRegister(ModbusRTU_Slave *mb)
 {
     if (mb->rxCount < 8) return;
-    uint16_t addr  = (mb->rxBuffer[2] << 8) | mb->rxBuffer[3];
-    uint16_t value = (mb->rxBuffer[4] << 8) | mb->rxBuffer[5];
+    uint16_t addr  = (mb->req[2] << 8) | mb->req[3];
 
     if (addr >= MB_HOLDING_REGS_SIZE) {
         ModbusRTU_Exception(mb, MB_FUNC_WRITE_SINGLE_REGISTER, MB_EX_ILLEGAL_DATA_ADDRESS);
         return;
     }
 
-    ModbusRTU_PreWriteCallback(addr, value);
-    {
-        uint32_t pm = MB_CriticalEnter();
-        mb->holdingRegs[addr] = value;
-        MB_CriticalExit(pm);
+    uint8_t ex = ModbusRTU_WriteRange(mb, addr, 1, &mb->req[4]);
+    if (ex != 0) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_SINGLE_REGISTER, ex);
+        return;
     }
-    ModbusRTU_PostWriteCallback(addr, value);
 
     /* �������󣨵�ַ+������+��ַ+ֵ+CRC�� */
-    memcpy(mb->txBuffer, mb->rxBuffer, 6);
+    memcpy(mb->txBuffer, mb->req, 6);
     uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, 6);
     mb->txBuffer[6] = (uint8_t)(crc & 0xFF);
     mb->txBuffer[7] = (uint8_t)((crc >> 8) & 0xFF);
     mb->txCount = 8;
 }
 
-/* ---------- д��Ĵ��� 0x10��д����ٽ����� ---------- */
+/* ---------- 写多个寄存器 0x10 ---------- */
 static void ModbusRTU_WriteMultipleRegisters(ModbusRTU_Slave *mb)
 {
     if (mb->rxCount < 9) return;
-    uint16_t startAddr = (mb->rxBuffer[2] << 8) | mb->rxBuffer[3];
-    uint16_t quantity  = (mb->rxBuffer[4] << 8) | mb->rxBuffer[5];
-    uint8_t  byteCount =  mb->rxBuffer[6];
-    uint16_t endAddr   = startAddr + quantity - 1;
+    uint16_t startAddr = (mb->req[2] << 8) | mb->req[3];
+    uint16_t quantity  = (mb->req[4] << 8) | mb->req[5];
+    uint8_t  byteCount =  mb->req[6];
+    uint32_t endAddr   = (uint32_t)startAddr + quantity - 1U;
 
     if (quantity < 1 || quantity > 123 || byteCount != quantity * 2) {
         ModbusRTU_Exception(mb, MB_FUNC_WRITE_MULTIPLE_REGISTERS, MB_EX_ILLEGAL_DATA_VALUE);
@@ -241,15 +820,10 @@ static void ModbusRTU_WriteMultipleRegisters(ModbusRTU_Slave *mb)
         return;
     }
 
-    for (uint16_t i = 0; i < quantity; i++) {
-        uint16_t v = (mb->rxBuffer[7 + 2*i] << 8) | mb->rxBuffer[8 + 2*i];
-        ModbusRTU_PreWriteCallback(startAddr + i, v);
-        {
-            uint32_t pm = MB_CriticalEnter();
-            mb->holdingRegs[startAddr + i] = v;
-            MB_CriticalExit(pm);
-        }
-        ModbusRTU_PostWriteCallback(startAddr + i, v);
+    uint8_t ex = ModbusRTU_WriteRange(mb, startAddr, quantity, &mb->req[7]);
+    if (ex != 0) {
+        ModbusRTU_Exception(mb, MB_FUNC_WRITE_MULTIPLE_REGISTERS, ex);
+        return;
     }
 
     mb->txBuffer[0] = mb->slaveAddr;
@@ -265,6 +839,92 @@ static void ModbusRTU_WriteMultipleRegisters(ModbusRTU_Slave *mb)
     mb->txBuffer[mb->txCount++] = (uint8_t)((crc >> 8) & 0xFF);
 }
 
+/* ---------- 掩码写寄存器 0x16：新值 = (当前 & AND) | (OR & ~AND) ----------
+   读改写在主循环里一次完成，两个串口的请求都在主循环串行处理，不会互相穿插；
+   写入走整段校验/提交，与 0x06 一样触发应用回调（如继电器位图）。
+   镜像可能落后于实际状态的寄存器（中断里会改动的输出）由 ModbusRTU_MaskWriteHook 接管。 */
+static void ModbusRTU_MaskWriteRegister(ModbusRTU_Slave *mb)
+{
+    if (mb->rxCount < 10) return;
+    uint16_t addr    = MB_BE16(&mb->req[2]);
+    uint16_t andMask = MB_BE16(&mb->req[4]);
+    uint16_t orMask  = MB_BE16(&mb->req[6]);
+
+    if (addr >= MB_HOLDING_REGS_SIZE) {
+        ModbusRTU_Exception(mb, MB_FUNC_MASK_WRITE_REGISTER, MB_EX_ILLEGAL_DATA_ADDRESS);
+        return;
+    }
+
+    uint8_t handled = 0;
+    uint8_t ex = ModbusRTU_MaskWriteHook(mb, addr, andMask, orMask, &handled);
+    if (!handled && ex == 0) {
+        uint16_t value = (uint16_t)((mb->holdingRegs[addr] & andMask) | (orMask & (uint16_t)~andMask));
+        uint8_t be[2] = { (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) };
+        ex = ModbusRTU_WriteRange(mb, addr, 1, be);
+    }
+    if (ex != 0) {
+        ModbusRTU_Exception(mb, MB_FUNC_MASK_WRITE_REGISTER, ex);
+        return;
+    }
+
+    /* 回显请求（地址+功能码+地址+AND+OR） */
+    memcpy(mb->txBuffer, mb->req, 8);
+    uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, 8);
+    mb->txBuffer[8] = (uint8_t)(crc & 0xFF);
+    mb->txBuffer[9] = (uint8_t)((crc >> 8) & 0xFF);
+    mb->txCount = 10;
+}
+
+/* ---------- 读写多个寄存器 0x17：先写后读，一次往返 ---------- */
+static void ModbusRTU_ReadWriteMultipleRegisters(ModbusRTU_Slave *mb)
+{
+    if (mb->rxCount < 13) return;
+    uint16_t readStart  = MB_BE16(&mb->req[2]);
+    uint16_t readQty    = MB_BE16(&mb->req[4]);
+    uint16_t writeStart = MB_BE16(&mb->req[6]);
+    uint16_t writeQty   = MB_BE16(&mb->req[8]);
+    uint8_t  byteCount  = mb->req[10];
+
+    if (readQty < 1 || readQty > 125 || writeQty < 1 || writeQty > 121
+        || byteCount != writeQty * 2) {
+        ModbusRTU_Exception(mb, MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS, MB_EX_ILLEGAL_DATA_VALUE);
+        return;
+    }
+    if ((uint32_t)readStart + readQty > MB_HOLDING_REGS_SIZE
+        || (uint32_t)writeStart + writeQty > MB_HOLDING_REGS_SIZE) {
+        ModbusRTU_Exception(mb, MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS, MB_EX_ILLEGAL_DATA_ADDRESS);
+        return;
+    }
+    if (mb->rxCount < (uint16_t)(11 + byteCount + 2)) {
+        ModbusRTU_Exception(mb, MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS, MB_EX_ILLEGAL_DATA_VALUE);
+        return;
+    }
+
+    uint8_t ex = ModbusRTU_WriteRange(mb, writeStart, writeQty, &mb->req[11]);
+    if (ex != 0) {
+        ModbusRTU_Exception(mb, MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS, ex);
+        return;
+    }
+    ModbusRTU_SerializeRegisters(mb, MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS,
+                                 mb->holdingRegs, readStart, readQty);
+}
+
+/* ---------- 诊断 0x08 / 通信事件计数 0x0B（modbus_diag.c） ---------- */
+static void ModbusRTU_Diagnostics(ModbusRTU_Slave *mb)
+{
+    uint8_t ex;
+    uint16_t n = ModbusDiag_Serve(&mb->diag, mb->req, (uint16_t)(mb->rxCount - 2U), mb->txBuffer, &ex);
+    if (ex != 0) {
+        ModbusRTU_Exception(mb, mb->req[1], ex);
+        return;
+    }
+    if (n == 0U) return;                /* 强制只听 / 只听模式下的重启：不应答 */
+    uint16_t crc = ModbusRTU_CRC16(mb->txBuffer, n);
+    mb->txBuffer[n++] = (uint8_t)(crc & 0xFF);
+    mb->txBuffer[n++] = (uint8_t)((crc >> 8) & 0xFF);
+    mb->txCount = n;
+}
+
 /* ---------- �쳣��Ӧ ---------- */
 static void ModbusRTU_Exception(ModbusRTU_Slave *mb, uint8_t funcCode, uint8_t exceptionCode)
 {
@@ -278,81 +938,242 @@ static void ModbusRTU_Exception(ModbusRTU_Slave *mb, uint8_t funcCode, uint8_t e
 }
 
 /* ---------- ����һ֡ ---------- */
-static void ModbusRTU_ProcessFrame(ModbusRTU_Slave *mb)
+static void ModbusRTU_ProcessFrame(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d)
 {
     if (mb->rxCount < 4) return;
 
     /* ��ַƥ���㲥 */
-    uint8_t addr = mb->rxBuffer[0];
+    uint8_t addr = mb->req[0];
     uint8_t isBroadcast = (addr == 0);
-    if (!isBroadcast && addr != mb->slaveAddr) return;
+    if (isBroadcast || addr != mb->slaveAddr) {
+#if MB_RX_CRC_INCREMENTAL
+        uint8_t crcOk = (uint8_t)(d->crc == 0U);
+#else
+        uint8_t crcOk = (uint8_t)(ModbusCRC16(mb->req, mb->rxCount) == 0U);
+#endif
+        if (!isBroadcast && !crcOk) mb->diag.busCommError++;
+        ModbusRTU_ForeignFrameCallback(mb, d, mb->req, crcOk);
+        if (!isBroadcast) return;       /* 广播帧交给回调后本站照常执行 */
+    }
+    ModbusTrace_Begin(&mb->trace, d->idleCyc, mb->req[1], (uint8_t)MB_UartIndex(mb->huart->Instance));
 
     /* CRC У�� */
-    uint16_t crcRx = (uint16_t)((mb->rxBuffer[mb->rxCount - 1] << 8) | mb->rxBuffer[mb->rxCount - 2]);
-    uint16_t crcClc = ModbusRTU_CRC16(mb->rxBuffer, mb->rxCount - 2);
-    if (crcRx != crcClc) return;
+#if MB_RX_CRC_INCREMENTAL
+    /* 接收过程中已折叠完毕，整帧（含 CRC）余数为 0 即通过 */
+    if (d->crc != 0U) {
+        mb->diag.busCommError++;
+        ModbusTrace_Abort(&mb->trace);
+        return;
+    }
+#else
+    (void)d;
+    uint16_t crcRx = (uint16_t)((mb->req[mb->rxCount - 1] << 8) | mb->req[mb->rxCount - 2]);
+    uint16_t crcClc = ModbusCRC16(mb->req, (uint16_t)(mb->rxCount - 2));
+    if (crcRx != crcClc) {
+        mb->diag.busCommError++;
+        ModbusTrace_Abort(&mb->trace);
+        return;
+    }
+#endif
+    ModbusTrace_Stamp(&mb->trace, MB_TRACE_CRC);
+
+    mb->diag.slaveMessage++;
+    if (!ModbusDiag_Accepts(&mb->diag, mb->req, (uint16_t)(mb->rxCount - 2U))) {
+        mb->diag.slaveNoResponse++;     /* 只听模式：只计数 */
+        ModbusTrace_Abort(&mb->trace);
+        return;
+    }
 
-    uint8_t fc = mb->rxBuffer[1];
+    uint8_t fc = mb->req[1];
+    mb->txCount = 0;
     switch (fc) {
+        case MB_FUNC_READ_COILS:               ModbusRTU_ReadCoils(mb);             break;
+        case MB_FUNC_READ_DISCRETE_INPUTS:     ModbusRTU_ReadDiscreteInputs(mb);    break;
+        case MB_FUNC_WRITE_SINGLE_COIL:        ModbusRTU_WriteSingleCoil(mb);       break;
+        case MB_FUNC_WRITE_MULTIPLE_COILS:     ModbusRTU_WriteMultipleCoils(mb);    break;
         case MB_FUNC_READ_HOLDING_REGISTERS:   ModbusRTU_ReadHoldingRegisters(mb);  break;
         case MB_FUNC_READ_INPUT_REGISTERS:     ModbusRTU_ReadInputRegisters(mb);    break;
         case MB_FUNC_WRITE_SINGLE_REGISTER:    ModbusRTU_WriteSingleRegister(mb);   break;
         case MB_FUNC_WRITE_MULTIPLE_REGISTERS: ModbusRTU_WriteMultipleRegisters(mb);break;
+        case MB_FUNC_MASK_WRITE_REGISTER:      ModbusRTU_MaskWriteRegister(mb);     break;
+        case MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS: ModbusRTU_ReadWriteMultipleRegisters(mb); break;
+        case MB_FUNC_DIAGNOSTICS:
+        case MB_FUNC_GET_COMM_EVENT_COUNTER:   ModbusRTU_Diagnostics(mb);           break;
         default:
             ModbusRTU_Exception(mb, fc, MB_EX_ILLEGAL_FUNCTION);
             break;
     }
 
     /* �㲥���ذ������лذ����� DMA ���� Tx ��ɻص��ؿ����գ����򵱳��ؿ����� */
+    ModbusTrace_Stamp(&mb->trace, MB_TRACE_HANDLER);
+    uint8_t isException = (uint8_t)(mb->txCount > 0 && (mb->txBuffer[1] & 0x80U));
+    if (mb->txCount > 0 && !isException && fc != MB_FUNC_GET_COMM_EVENT_COUNTER) {
+        mb->diag.eventCount++;          /* 正常完成（广播也算），异常与 0x0B 本身不计 */
+    }
     if (mb->txCount > 0 && !isBroadcast) {
-        RS485_TxEnable(mb->huart);
-        s_txInProgress = 1;
-        HAL_UART_Transmit_DMA(mb->huart, mb->txBuffer, mb->txCount);
+        if (isException) {
+            mb->diag.busException++;
+            if (mb->txBuffer[2] == MB_EX_SLAVE_DEVICE_BUSY) mb->diag.slaveBusy++;
+        }
+        (void)ModbusRTU_SendRaw(mb, mb->txBuffer, mb->txCount);
     } else {
-        MB_RestartRx(mb);
+        mb->diag.slaveNoResponse++;
+        ModbusTrace_Abort(&mb->trace);
     }
 }
 
 /* ---------- ������ ---------- */
 void ModbusRTU_Process(ModbusRTU_Slave *mb)
 {
-    if (mb->rxComplete) {
-        ModbusRTU_ProcessFrame(mb);
-        /* ��û�н��뷢�����̣��㲥/�쳣/У��ʧ�ܣ��������ؿ����� */
-        if (!s_txInProgress) {
-            MB_RestartRx(mb);
+#if MB_RX_CRC_INCREMENTAL
+    /* 空闲时顺手折叠已到达的字节，IDLE 到来时只剩最后几个字节 */
+    {
+        uint32_t pm = MB_CriticalEnter();
+        uint16_t n = MB_RxPending(mb);
+        MB_RxAdvance(mb, (n > MB_RX_CRC_POLL_MAX) ? (uint16_t)MB_RX_CRC_POLL_MAX : n);
+        MB_CriticalExit(pm);
+    }
+#endif
+    /* 队列里的帧一次处理完（广播/非本站帧不应答）；
+       半双工：开始应答后停下，剩余帧留在队列里，等 Tx 完成事件再处理 */
+    while (!mb->txInProgress) {
+        uint8_t tail = mb->rxQTail;
+        if (tail == mb->rxQHead) break;
+
+        const ModbusRTU_RxDesc *d = &mb->rxQueue[tail & MB_RX_QUEUE_MASK];
+        if (MB_RxLoadFrame(mb, d)) {
+            ModbusCapture_Rx((uint8_t)MB_UartIndex(mb->huart->Instance), mb->req, mb->rxCount,
+                             d->idleCyc, mb->huart->Init.BaudRate, 0);
+            ModbusRTU_ProcessFrame(mb, d);
         }
+        mb->rxQTail = (uint8_t)(tail + 1U);  /* 处理完才释放，生产者据此判断队列满 */
     }
 }
 
-/* ---------- ��ʱ�����ף���ѡ�� ---------- */
-void ModbusRTU_TimerISR(ModbusRTU_Slave *mb)
+/* ---------- IDLE 中断回调：帧定时布防，或直接结帧 ---------- */
+uint8_t ModbusRTU_UartRxCallback(ModbusRTU_Slave *mb)
 {
-    if (mb->frameReceiving) {
-        uint32_t now = HAL_GetTick();
-        if ((now - mb->lastReceiveTime) >= 4U) { /* �� 9600bps Լ 3.5T */
-            mb->frameReceiving = 0;
-            HAL_UART_DMAStop(mb->huart);
-            mb->rxCount = MB_RTU_FRAME_MAX_SIZE - __HAL_DMA_GET_COUNTER(mb->huart->hdmarx);
-            mb->rxComplete = 1;
+    /* IDLE 标志已由调用方按 SR->DR 顺序清除；DMA 继续运行，只登记帧边界 */
+#if MB_FRAME_TIMER
+    if (mb->ftIndex != MB_FT_NONE) {
+        /* 发送中通道用于 DE 保护计时；回显字节在发送收尾时整段丢弃，无需判帧 */
+        if (!mb->txInProgress) MB_FrameTimerArm(mb);
+        return 0;
+    }
+#endif
+    return MB_RxFrameEnd(mb);
+}
+
+/* ---------- TIM2 比较中断：t1.5/t3.5 到期 ---------- */
+uint8_t ModbusRTU_FrameTimerISR(ModbusRTU_Slave *mb)
+{
+#if MB_FRAME_TIMER
+    if (mb == NULL || mb->ftIndex == MB_FT_NONE) return 0;
+    uint32_t f15 = MB_FtFlag15(mb);
+    uint32_t f35 = MB_FtFlag35(mb);
+    uint32_t sr  = TIM2->SR & TIM2->DIER & (f15 | f35);
+    uint8_t queued = 0;
+
+    if (sr & f15) {
+        TIM2->DIER &= ~f15;
+        TIM2->SR = ~f15;
+        if (mb->ftState == MB_FT_TX_PRE) {
+            mb->ftState = MB_FT_IDLE;
+            (void)MB_TxStart(mb);
+            return 0;
+        }
+        if (mb->ftState == MB_FT_TX_POST || mb->ftState == MB_FT_TX_HOLD) {
+            MB_TxFinish(mb);            /* 挂起到期：线路已空闲 t1.5，不再加 POST 保护 */
+            return 1;
+        }
+        if (MB_RxDmaPos(mb) != mb->ftPos) {
+            /* 1.5 字符内又有字节：仍是同一帧，等下一次 IDLE 重新布防 */
+            MB_FrameTimerDisarm(mb);
+            return 0;
+        }
+        mb->ftState = MB_FT_WAIT_T35;
+    }
+    if (sr & f35) {
+        TIM2->DIER &= ~f35;
+        TIM2->SR = ~f35;
+        if (mb->ftState == MB_FT_WAIT_T35) {
+            if (MB_RxDmaPos(mb) != mb->ftPos) {
+                mb->rxFrameBad = 1;
+                mb->rxT15Violations++;
+            } else {
+                queued = MB_RxFrameEnd(mb);
+            }
+            mb->ftState = MB_FT_IDLE;
         }
     }
+    return queued;
+#else
+    (void)mb;
+    return 0;
+#endif
 }
 
-/* ---------- IDLE �жϻص���ǿ�ƽ�֡�� ---------- */
-void ModbusRTU_UartRxCallback(ModbusRTU_Slave *mb)
+/* ---------- DMA 半满/满回调：折叠已收到的一段 CRC ---------- */
+void ModbusRTU_RxChunkISR(ModbusRTU_Slave *mb)
 {
-    HAL_UART_DMAStop(mb->huart);
-    /* 清 ORE：读 SR 再读 DR（F1系列） */
-    volatile uint32_t sr = mb->huart->Instance->SR; (void)sr;
-    volatile uint32_t dr = mb->huart->Instance->DR; (void)dr;
-    mb->rxCount = MB_RTU_FRAME_MAX_SIZE - __HAL_DMA_GET_COUNTER(mb->huart->hdmarx);
-    mb->rxComplete = 1;
-    mb->frameReceiving = 0;
-    mb->lastReceiveTime = HAL_GetTick();
+    if (mb == NULL || mb->huart == NULL) return;
+    MB_RxAdvance(mb, MB_RxPending(mb));
+}
+
+/* ---------- 写寄存器回调（弱定义，可重载） ----------
+   默认实现：MB_WRITE_PER_REG_CALLBACKS=1 时逐寄存器转调旧的 Pre/Post 回调（兼容层），
+   否则什么也不做。新代码请直接重载整段的 Validate/Commit。 */
+__weak uint8_t ModbusRTU_ValidateWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr,
+                                            uint16_t quantity, const uint8_t *values)
+{
+    (void)mb;
+#if MB_WRITE_PER_REG_CALLBACKS
+    for (uint16_t i = 0; i < quantity; i++) {
+        ModbusRTU_PreWriteCallback(startAddr + i, MB_BE16(&values[2*i]));
+    }
+#else
+    (void)startAddr; (void)quantity; (void)values;
+#endif
+    return 0;
+}
+__weak void ModbusRTU_CommitWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity)
+{
+#if MB_WRITE_PER_REG_CALLBACKS
+    for (uint16_t i = 0; i < quantity; i++) {
+        ModbusRTU_PostWriteCallback(startAddr + i, mb->holdingRegs[startAddr + i]);
+    }
+#else
+    (void)mb; (void)startAddr; (void)quantity;
+#endif
+}
+
+__weak uint8_t ModbusRTU_MaskWriteHook(ModbusRTU_Slave *mb, uint16_t addr, uint16_t andMask,
+                                       uint16_t orMask, uint8_t *handled)
+{
+    (void)mb; (void)addr; (void)andMask; (void)orMask;
+    *handled = 0;
+    return 0;
+}
+
+__weak void ModbusRTU_CommitWriteCoils(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity)
+{
+    (void)mb; (void)startAddr; (void)quantity;
+}
+
+/* 默认不转发非本站帧、不续传 */
+__weak void ModbusRTU_ForeignFrameCallback(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d,
+                                           const uint8_t *frame, uint8_t crcOk)
+{
+    (void)mb; (void)d; (void)frame; (void)crcOk;
+}
+
+__weak uint8_t ModbusRTU_TxChainCallback(ModbusRTU_Slave *mb)
+{
+    (void)mb;
+    return 0;
 }
 
-/* ---------- ��������û��ص� ---------- */
+#if MB_WRITE_PER_REG_CALLBACKS
 __weak void ModbusRTU_PreWriteCallback(uint16_t addr, uint16_t value)
 {
     (void)addr; (void)value;
@@ -361,6 +1182,7 @@ __weak void ModbusRTU_PostWriteCallback(uint16_t addr, uint16_t value)
 {
     (void)addr; (void)value;
 }
+#endif
 
 /* ---------- ��ѡ�����ļ�ֱ���ṩ�жϴ������������� stm32f1xx_it.c�� ---------- */
 #if MB_PROVIDE_IRQ_HANDLERS
@@ -368,14 +1190,21 @@ __weak void ModbusRTU_PostWriteCallback(uint16_t addr, uint16_t value)
 extern UART_HandleTypeDef huart1;
 extern DMA_HandleTypeDef  hdma_usart1_rx;
 extern DMA_HandleTypeDef  hdma_usart1_tx;
-extern TIM_HandleTypeDef  htim2;
 
 void USART1_IRQHandler(void)
 {
     /* �ȴ��� IDLE���ٽ��� HAL */
-    if (__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE)) {
+    ModbusRTU_Slave *mb = ModbusRTU_FromUart(&huart1);
+    uint32_t sr = huart1.Instance->SR;
+    if (mb && (sr & MB_UART_SR_RX_ERRORS)) {
+        ModbusRTU_RxErrorISR(mb, sr);   /* 会读 DR：IDLE 以快照为准 */
+    }
+    if (sr & USART_SR_IDLE) {
         __HAL_UART_CLEAR_IDLEFLAG(&huart1);
-        if (s_active_mb) ModbusRTU_UartRxCallback(s_active_mb);
+        if (mb) {
+            ModbusTrace_MarkIdle(&mb->trace);
+            ModbusRTU_UartRxCallback(mb);
+        }
     }
     HAL_UART_IRQHandler(&huart1);
 }
@@ -383,33 +1212,69 @@ void USART1_IRQHandler(void)
 void DMA1_Channel4_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart1_tx); }
 void DMA1_Channel5_IRQHandler(void) { HAL_DMA_IRQHandler(&hdma_usart1_rx); }
 
-void TIM2_IRQHandler(void) { HAL_TIM_IRQHandler(&htim2); }
-
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+void TIM2_IRQHandler(void)
 {
-    if (htim->Instance == TIM2 && s_active_mb) {
-        ModbusRTU_TimerISR(s_active_mb);
+    for (uint32_t i = 0; i < MB_MAX_INSTANCES; i++) {
+        if (s_instances[i]) ModbusRTU_FrameTimerISR(s_instances[i]);
     }
 }
 
 void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
 {
-    if (s_active_mb && huart == s_active_mb->huart) {
-        RS485_RxEnable();
-        s_txInProgress = 0;
-        MB_RestartRx(s_active_mb);
-        s_active_mb->txCount = 0;
-    }
+    (void)ModbusRTU_TxCpltISR(ModbusRTU_FromUart(huart));
 }
 #endif /* MB_PROVIDE_IRQ_HANDLERS */
 
-/* ---------- 外部供中断回调使用的 Tx 完成收尾 ---------- */
-void ModbusRTU_TxCpltISR(ModbusRTU_Slave *mb)
+/* ---------- 外部供中断回调使用的 Tx 完成收尾（TC 时调用） ---------- */
+uint8_t ModbusRTU_TxCpltISR(ModbusRTU_Slave *mb)
+{
+    if (mb == NULL || mb->huart == NULL) return 0;
+    /* 直通转发续传下一段：总线保持发送方向 */
+    uint8_t chain = ModbusRTU_TxChainCallback(mb);
+    if (chain == MB_TX_CHAIN_HOLD) {
+#if MB_FRAME_TIMER
+        /* 数据未到：DE 保持挂起，t1.5 内没有续发就由 TIM2 到期放弃续传、释放总线 */
+        if (mb->ftIndex != MB_FT_NONE) MB_DeGuardArm(mb, MB_FT_TX_HOLD, mb->ftTxHold);
+#endif
+        return 0;
+    }
+    if (chain) return 0;
+    ModbusTrace_Commit(&mb->trace);     /* 本站应答的 TC 时刻；转发流量未开跟踪，直接跳过 */
+    /* 切回接收；接收 DMA 一直在运行，无需重启 */
+    return MB_TxRelease(mb);
+}
+
+/* ---------- 放弃挂起的续传：TxChainCallback 返回 1 却未续发、DMA 已空闲时调用 ---------- */
+void ModbusRTU_TxChainAbort(ModbusRTU_Slave *mb)
+{
+    uint32_t pm = MB_CriticalEnter();
+    if (mb->txInProgress) (void)MB_TxRelease(mb);
+    MB_CriticalExit(pm);
+}
+
+/* ---------- 接收错误快速路径：分类计数、只作废当前帧，DMA 继续写同一个环 ----------
+   调用方已读出 SR，这里再读一次 DR 即完成清标志序列，HAL 看不到错误也就不会中止 DMA。
+   若 DMA 尚未取走 DR（RXNE 仍置位），被读掉的只可能是本帧的字节，而本帧反正要丢弃。 */
+void ModbusRTU_RxErrorISR(ModbusRTU_Slave *mb, uint32_t sr)
+{
+    (void)mb->huart->Instance->DR;
+    if (mb->txInProgress) return;       /* 发送期间的回显在收尾时整段丢弃 */
+    if (sr & USART_SR_ORE) {
+        mb->rxErrOverrun++;
+        mb->diag.charOverrun++;
+    }
+    if (sr & USART_SR_FE) mb->rxErrFraming++;
+    if (sr & USART_SR_NE) mb->rxErrNoise++;
+    if (sr & USART_SR_PE) mb->rxErrParity++;
+    mb->rxFrameBad = 1;                 /* 结帧时丢弃并计入总线通信错误 */
+}
+
+/* ---------- 外部供错误回调使用：HAL 仍报告的错误（如 DMA 传输错误）才重启接收 ---------- */
+void ModbusRTU_ErrorISR(ModbusRTU_Slave *mb)
 {
     if (mb == NULL || mb->huart == NULL) return;
-    /* 切回接收并重启 DMA */
-    RS485_RxEnable(mb->huart);
-    s_txInProgress = 0;
-    mb->txCount = 0;
-    MB_RestartRx(mb);
+    /* HAL 遇到接收错误会中止 RX DMA；发送侧错误不影响接收则不动 */
+    if (mb->huart->ErrorCode & HAL_UART_ERROR_ORE) mb->diag.charOverrun++;
+    if (mb->huart->RxState == HAL_UART_STATE_BUSY_RX) return;
+    MB_RxRingRestart(mb);
 }
@@ -8,6 +8,10 @@ extern "C" {
 
 #include "stm32f1xx_hal.h"
 #include "stm32f1xx_hal_tim.h"
+#include "modbus_crc.h"
+#include "modbus_trace.h"
+#include "modbus_diag.h"
+#include "modbus_capture.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -33,6 +37,9 @@ extern "C" {
 #define MB_RS485_DE_GPIO_Port  MB_USART1_RS485_DE_GPIO_Port
 #define MB_RS485_DE_Pin        MB_USART1_RS485_DE_Pin
 
+/* 实例登记表容量：每个 USART 外设最多一个从站实例（USART1/USART2） */
+#define MB_MAX_INSTANCES       2U
+
 /* ---------- ������ ---------- */
 #define MB_FUNC_READ_COILS                  0x01
 #define MB_FUNC_READ_DISCRETE_INPUTS        0x02
@@ -42,40 +49,154 @@ extern "C" {
 #define MB_FUNC_WRITE_SINGLE_REGISTER       0x06
 #define MB_FUNC_WRITE_MULTIPLE_COILS        0x0F
 #define MB_FUNC_WRITE_MULTIPLE_REGISTERS    0x10
+#define MB_FUNC_MASK_WRITE_REGISTER         0x16
+#define MB_FUNC_READ_WRITE_MULTIPLE_REGISTERS 0x17
 
 /* ---------- �쳣�� ---------- */
 #define MB_EX_ILLEGAL_FUNCTION              0x01
 #define MB_EX_ILLEGAL_DATA_ADDRESS          0x02
 #define MB_EX_ILLEGAL_DATA_VALUE            0x03
 #define MB_EX_SLAVE_DEVICE_FAILURE          0x04
+#define MB_EX_SLAVE_DEVICE_BUSY             0x06
+#define MB_EX_GATEWAY_PATH_UNAVAILABLE      0x0A
+#define MB_EX_GATEWAY_TARGET_FAILED         0x0B
 
 /* ---------- ���� ---------- */
 #define MB_RTU_FRAME_MAX_SIZE               256U
 #define MB_HOLDING_REGS_SIZE                100U
-#define MB_INPUT_REGS_SIZE                  100U
+#define MB_INPUT_REGS_SIZE                  368U    /* 100-231：流水线延时跟踪（modbus_trace.h）；236、240-367：继电器变位事件窗口 */
+
+/* 变化检测：寄存器表按 16 个一块登记“主站确认之后有变化”，每张表的块数不超过 32 */
+#define MB_DIRTY_BLOCK_SHIFT                4U
+#define MB_DIRTY_BLOCKS(n)                  (((n) + (1U << MB_DIRTY_BLOCK_SHIFT) - 1U) >> MB_DIRTY_BLOCK_SHIFT)
+#define MB_IREG_CHANGE_BASE                 232U    /* 232-235：变化序号、保持/输入寄存器脏块位图（由读请求现取） */
+#define MB_IREG_CHANGE_COUNT                4U
+#define MB_HREG_CHANGE_ACK                  99U     /* 写入已取到的变化序号：不晚于它的变化清位 */
 #define MB_COILS_SIZE                       100U
 #define MB_DISCRETE_INPUTS_SIZE             100U
+/* 线圈/离散输入按位存放，32 位一字，地址 n 在第 n/32 字的第 n%32 位 */
+#define MB_BIT_WORDS(bits)                  (((bits) + 31U) / 32U)
+
+/* 接收 CRC 增量累加：1 = DMA 半满/满、IDLE 及主循环轮询时边收边算，
+   帧尾只需比较余数是否为 0；0 = 帧尾整帧重算（旧行为） */
+#ifndef MB_RX_CRC_INCREMENTAL
+#define MB_RX_CRC_INCREMENTAL               1
+#endif
+/* 主循环每次关中断折叠的最大字节数，限制关中断时间 */
+#define MB_RX_CRC_POLL_MAX                  32U
+
+/* 接收环：循环 DMA 持续写入，运行期间不停止/重启。
+   必须为 2 的幂且不小于两帧，主循环落后一帧时仍不丢字节 */
+#define MB_RX_RING_SIZE                     512U
+
+/* 接收错误标志：由 ModbusRTU_RxErrorISR 在 HAL 之前处理，不再中止 RX DMA */
+#define MB_UART_SR_RX_ERRORS                (USART_SR_ORE | USART_SR_FE | USART_SR_NE | USART_SR_PE)
+#define MB_RX_RING_MASK                     (MB_RX_RING_SIZE - 1U)
+/* 帧描述符队列长度（2 的幂）：IDLE 中断入队，主循环出队 */
+#define MB_RX_QUEUE_LEN                     8U
+#define MB_RX_QUEUE_MASK                    (MB_RX_QUEUE_LEN - 1U)
+
+/* RTU 帧定时：1 = TIM2 比较通道按 t1.5/t3.5 判帧（规范做法，IDLE 只负责布防）；
+   0 = 单字符 IDLE 即结帧（响应更快，但帧内 1~1.5 字符的合法间隔会被拆帧） */
+#ifndef MB_FRAME_TIMER
+#define MB_FRAME_TIMER                      1
+#endif
+/* 波特率高于 19200 时规范规定的固定值（us） */
+#define MB_T15_FIXED_US                     750U
+#define MB_T35_FIXED_US                     1750U
+
+/* 1 = 默认的整段写回调逐寄存器转调旧的 Pre/PostWriteCallback（兼容旧应用代码） */
+#ifndef MB_WRITE_PER_REG_CALLBACKS
+#define MB_WRITE_PER_REG_CALLBACKS          0
+#endif
+
+/* RS485 方向保护时间（us，由帧定时的 TIM2 比较通道计时，0 = 不等待）
+   PRE：置 DE 到启动发送的间隔，给慢速收发器留使能时间；
+   POST：TC（最后一个停止位移出）到释放 DE 的间隔，给隔离器/长线留余量。
+   发送期间本实例的 t1.5 通道空闲（回显字节发送完成后整段丢弃），借来计时。 */
+#ifndef MB_DE_PRE_GUARD_US
+#define MB_DE_PRE_GUARD_US                  0U
+#endif
+#ifndef MB_DE_POST_GUARD_US
+#define MB_DE_POST_GUARD_US                 0U
+#endif
+
+/* 读寄存器时序列号校验失败（被中断里的写入打断）的最大重试次数，超过后回 0x06 忙 */
+#ifndef MB_REG_SEQ_READ_TRIES
+#define MB_REG_SEQ_READ_TRIES               4U
+#endif
+
+/* 一帧在接收环中的位置，由 IDLE 中断（或 t3.5 定时）生成 */
+typedef struct {
+    uint32_t start;                     /* 帧首字节的累计接收序号，环下标 = start & MB_RX_RING_MASK */
+    uint16_t length;                    /* 帧长（含 CRC） */
+    uint16_t crc;                       /* 整帧 CRC 余数，0 = 校验通过 */
+    uint32_t timestamp;                 /* IDLE 时刻 HAL_GetTick() */
+    uint32_t idleCyc;                   /* 结帧前最后一次 IDLE 中断的 DWT 周期计数（延时跟踪） */
+} ModbusRTU_RxDesc;
 
 typedef struct {
     uint8_t  slaveAddr;                 /* ��վ��ַ */
     UART_HandleTypeDef *huart;          /* UART ��� */
 
-    /* ���ջ����� */
+    /* 每实例独立的发送状态与 RS485 方向引脚（Init 时按 USART 填入） */
+    volatile uint8_t txInProgress;
+    GPIO_TypeDef *dePort;               /* NULL = 无方向控制（232/自动收发 485） */
+    uint16_t dePin;
+    uint16_t dePreGuardUs;              /* 方向保护时间，Init 时取 MB_DE_*_GUARD_US，可运行中修改 */
+    uint16_t dePostGuardUs;
+    const uint8_t *txData;              /* 等 PRE 保护时间到期后才交给 DMA 的发送数据 */
+    uint16_t txLen;
+
+    /* 接收环（循环 DMA）与帧描述符队列：IDLE 中断为唯一生产者，主循环为唯一消费者 */
+    uint8_t  rxRing[MB_RX_RING_SIZE];
+    ModbusCRC16_Stream rxCrc;           /* 当前帧 CRC；pos 为下一个待折叠字节的环下标 */
+    uint32_t rxTotal;                   /* 已折叠字节累计（自由运行），rxTotal & MASK == rxCrc.pos */
+    uint32_t rxFrameStart;              /* 当前帧首字节的累计序号 */
+    ModbusRTU_RxDesc rxQueue[MB_RX_QUEUE_LEN];
+    volatile uint8_t rxQHead;           /* 生产者下标（自由运行） */
+    volatile uint8_t rxQTail;           /* 消费者下标（自由运行） */
+    uint32_t rxDropped;                 /* 超长/队列满/被 DMA 覆盖而丢弃的帧数 */
+    uint8_t  frameReceiving;            /* 当前帧已有字节到达 */
+    uint32_t lastReceiveTime;
+
+    /* t1.5/t3.5 帧定时（TIM2 比较通道，按实例下标分配） */
+    uint8_t  ftIndex;                   /* 0xFF = 未分配通道，退回 IDLE 判帧 */
+    uint8_t  ftState;
+    uint16_t ftPos;                     /* 布防时的 DMA 写入位置 */
+    uint16_t ftT15;                     /* IDLE 到 t1.5 的延时（us） */
+    uint16_t ftT35;                     /* IDLE 到 t3.5 的延时（us） */
+    uint16_t ftTxHold;                  /* 续传挂起的最长间隙 t1.5（us，从 TC 算起） */
+    uint8_t  rxFrameBad;                /* 本帧出现 t1.5 违例，结帧时丢弃 */
+    ModbusTraceCtx_t trace;             /* 当前请求的流水线打点 */
+    ModbusDiag_t diag;                  /* 串行链路诊断计数（0x08/0x0B） */
+    uint32_t rxT15Violations;           /* t1.5~t3.5 之间又收到字节的次数 */
+    uint32_t rxErrOverrun;              /* USART 接收错误计数（发送期间的回显错误不计） */
+    uint32_t rxErrFraming;
+    uint32_t rxErrNoise;
+    uint32_t rxErrParity;
+
+    /* 当前处理的请求：未回绕时直接指向环内，回绕时线性化到 rxBuffer */
+    const uint8_t *req;
     uint8_t  rxBuffer[MB_RTU_FRAME_MAX_SIZE];
     uint16_t rxCount;
-    uint8_t  rxComplete;
-    uint8_t  frameReceiving;
-    uint32_t lastReceiveTime;
 
     /* ���ͻ����� */
     uint8_t  txBuffer[MB_RTU_FRAME_MAX_SIZE];
     uint16_t txCount;
 
     /* ������ */
+    volatile uint32_t regSeq;           /* 寄存器写序列号：奇数 = 写入进行中（seqlock） */
+    uint32_t regReadRetries;            /* 读寄存器因并发写入重试的次数 */
+    volatile uint32_t chgSeq;           /* 寄存器内容变化序号：每登记一次变化 +1 */
+    volatile uint32_t dirtyHolding;     /* bit n = 保持寄存器 16n~16n+15 有未确认的变化 */
+    volatile uint32_t dirtyInput;       /* bit n = 输入寄存器 16n~16n+15 有未确认的变化 */
+    uint16_t holdingBlockSeq[MB_DIRTY_BLOCKS(MB_HOLDING_REGS_SIZE)];   /* 各块最后一次变化的序号 */
+    uint16_t inputBlockSeq[MB_DIRTY_BLOCKS(MB_INPUT_REGS_SIZE)];
     uint16_t holdingRegs[MB_HOLDING_REGS_SIZE];
     uint16_t inputRegs[MB_INPUT_REGS_SIZE];
-    uint8_t  coils[MB_COILS_SIZE];
-    uint8_t  discreteInputs[MB_DISCRETE_INPUTS_SIZE];
+    uint32_t coils[MB_BIT_WORDS(MB_COILS_SIZE)];
+    uint32_t discreteInputs[MB_BIT_WORDS(MB_DISCRETE_INPUTS_SIZE)];
 } ModbusRTU_Slave;
 
 /* --------- �����ٽ����������жϣ�����ʱ�䣩 --------- */
@@ -88,32 +209,155 @@ static inline void MB_CriticalExit(uint32_t primask){
     __set_PRIMASK(primask);
 }
 
-/* ��ȫ�������֣���ѡ����Ӧ�ò�ʹ�ã� */
+/* 大端 16 位（请求/应答中的寄存器值） */
+static inline uint16_t MB_BE16(const uint8_t *p){
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/* 按位表的单点读写（不做越界检查，由调用方保证） */
+static inline uint8_t MB_BitGet(const uint32_t *words, uint16_t addr){
+    return (uint8_t)((((const volatile uint32_t *)words)[addr >> 5] >> (addr & 31U)) & 1U);
+}
+static inline void MB_BitPut(uint32_t *words, uint16_t addr, uint8_t on){
+    uint32_t m = 1UL << (addr & 31U);
+    if (on) words[addr >> 5] |= m; else words[addr >> 5] &= ~m;
+}
+
+/* --------- 寄存器写入的 seqlock 协议 ---------
+   写入方（主循环或中断）把对 holdingRegs/inputRegs 的修改包在 Begin/End 之间；
+   读方在序列号前后不变且为偶数时才采用读到的数据，否则重读。全程不关中断。
+   序列号用 LDREX/STREX 递增，中断里的写入打断主循环的写入也不会丢计数。 */
+static inline void MB_RegSeqBump(ModbusRTU_Slave *mb){
+    uint32_t v;
+    do {
+        v = __LDREXW((volatile uint32_t *)&mb->regSeq);
+    } while (__STREXW(v + 1U, (volatile uint32_t *)&mb->regSeq));
+}
+static inline void MB_RegWriteBegin(ModbusRTU_Slave *mb){
+    MB_RegSeqBump(mb);
+    __DMB();                            /* 序列号先于数据可见 */
+}
+static inline void MB_RegWriteEnd(ModbusRTU_Slave *mb){
+    __DMB();                            /* 数据先于序列号可见 */
+    MB_RegSeqBump(mb);
+}
+
+/* --------- 变化检测（报告即变化） ---------
+   所有写寄存器的路径（Modbus 写请求、应用层 MB_PutHolding 等及 MB_SafeWriteHolding）在值确实改变时
+   递增变化序号、把所在块记入脏位图并记下该块的序号；主站读输入寄存器 232-235 得到位图，
+   只读有变化的块，再把读到的序号写回保持寄存器 99 确认，确认之前的变化才清位。
+   应答丢失或请求出错时位图原样保留。序号、位图与块序号在关中断下一起更新（至多几十条指令）。
+   每秒自刷新的诊断块（负载统计、延时跟踪、网关统计）直接写，不登记变化。 */
+static inline void MB_DirtyMark(ModbusRTU_Slave *mb, volatile uint32_t *map, uint16_t *blockSeq, uint32_t blocks){
+    if (blocks == 0U) return;
+    uint32_t primask = MB_CriticalEnter();
+    uint16_t seq = (uint16_t)++mb->chgSeq;
+    *map |= blocks;
+    for (uint32_t n = 0; blocks != 0U; n++, blocks >>= 1){
+        if (blocks & 1U) blockSeq[n] = seq;
+    }
+    MB_CriticalExit(primask);
+}
+
+/* 以下写入须在 seqlock 写区间内调用；值未变的寄存器不登记 */
+static inline void MB_PutHolding(ModbusRTU_Slave *mb, uint16_t addr, uint16_t val){
+    if (mb->holdingRegs[addr] != val){
+        mb->holdingRegs[addr] = val;
+        MB_DirtyMark(mb, &mb->dirtyHolding, mb->holdingBlockSeq, 1UL << (addr >> MB_DIRTY_BLOCK_SHIFT));
+    }
+}
+static inline void MB_PutInput(ModbusRTU_Slave *mb, uint16_t addr, uint16_t val){
+    if (mb->inputRegs[addr] != val){
+        mb->inputRegs[addr] = val;
+        MB_DirtyMark(mb, &mb->dirtyInput, mb->inputBlockSeq, 1UL << (addr >> MB_DIRTY_BLOCK_SHIFT));
+    }
+}
+static inline void MB_PutInputRange(ModbusRTU_Slave *mb, uint16_t start, const uint16_t *src, uint16_t qty){
+    uint32_t blocks = 0;
+    for (uint16_t i = 0; i < qty; i++){
+        uint16_t addr = (uint16_t)(start + i);
+        if (mb->inputRegs[addr] != src[i]){
+            mb->inputRegs[addr] = src[i];
+            blocks |= 1UL << (addr >> MB_DIRTY_BLOCK_SHIFT);
+        }
+    }
+    MB_DirtyMark(mb, &mb->dirtyInput, mb->inputBlockSeq, blocks);
+}
+
+/* 单个寄存器/线圈/离散输入的读写（可选，供应用层使用）；
+   16 位对齐读不会撕裂，位表的写入是读改写，须放在 seqlock 写区间内 */
 static inline uint16_t MB_SafeReadHolding(ModbusRTU_Slave *mb, uint16_t addr){
-    uint32_t pm = MB_CriticalEnter();
-    uint16_t v = (addr < MB_HOLDING_REGS_SIZE) ? mb->holdingRegs[addr] : 0;
-    MB_CriticalExit(pm);
-    return v;
+    return (addr < MB_HOLDING_REGS_SIZE) ? ((volatile uint16_t *)mb->holdingRegs)[addr] : 0;
 }
 static inline void MB_SafeWriteHolding(ModbusRTU_Slave *mb, uint16_t addr, uint16_t val){
     if (addr < MB_HOLDING_REGS_SIZE){
-        uint32_t pm = MB_CriticalEnter();
-        mb->holdingRegs[addr] = val;
-        MB_CriticalExit(pm);
+        MB_RegWriteBegin(mb);
+        MB_PutHolding(mb, addr, val);
+        MB_RegWriteEnd(mb);
+    }
+}
+static inline uint8_t MB_SafeReadCoil(ModbusRTU_Slave *mb, uint16_t addr){
+    return (addr < MB_COILS_SIZE) ? MB_BitGet(mb->coils, addr) : 0;
+}
+static inline void MB_SafeWriteDiscreteInput(ModbusRTU_Slave *mb, uint16_t addr, uint8_t on){
+    if (addr < MB_DISCRETE_INPUTS_SIZE){
+        MB_RegWriteBegin(mb);
+        MB_BitPut(mb->discreteInputs, addr, on);
+        MB_RegWriteEnd(mb);
     }
 }
 
 /* API */
 void     ModbusRTU_Init(ModbusRTU_Slave *mb, UART_HandleTypeDef *huart, uint8_t slaveAddr);
 void     ModbusRTU_Process(ModbusRTU_Slave *mb);
-void     ModbusRTU_TimerISR(ModbusRTU_Slave *mb);     /* ���׳�ʱ�ã���ѡ */
-void     ModbusRTU_UartRxCallback(ModbusRTU_Slave *mb);
+uint8_t  ModbusRTU_FrameTimerISR(ModbusRTU_Slave *mb); /* TIM2 中断中调用，返回 1 = 有新帧入队或发送收尾完成 */
+uint8_t  ModbusRTU_UartRxCallback(ModbusRTU_Slave *mb); /* IDLE 中断中调用，返回 1 = 有新帧入队 */
+void     ModbusRTU_RxChunkISR(ModbusRTU_Slave *mb);   /* DMA 半满/满回调中调用 */
 uint16_t ModbusRTU_CRC16(uint8_t *buffer, uint16_t length);
-void     ModbusRTU_TxCpltISR(ModbusRTU_Slave *mb);
+uint8_t  ModbusRTU_TxCpltISR(ModbusRTU_Slave *mb);    /* TC 回调中调用，返回 1 = 已切回接收 */
+void     ModbusRTU_RxErrorISR(ModbusRTU_Slave *mb, uint32_t sr); /* USART 中断入口、HAL 之前调用，sr 为已读出的 SR */
+void     ModbusRTU_ErrorISR(ModbusRTU_Slave *mb);
+ModbusRTU_Slave *ModbusRTU_FromUart(const UART_HandleTypeDef *huart);  /* 未登记返回 NULL */
+uint32_t ModbusRTU_RxWritePos(ModbusRTU_Slave *mb);  /* 已写入接收环的累计字节数（含未折叠），中断/主循环均可调用 */
+/* 直接从 data 发送 len 字节（不拷贝，发送完成前 data 须保持有效）；置 DE、txInProgress */
+HAL_StatusTypeDef ModbusRTU_SendRaw(ModbusRTU_Slave *mb, const uint8_t *data, uint16_t len);
+/* 放弃挂起的续传（TxChainCallback 返回 1 后未再续发）：按正常发送结束释放 DE */
+void     ModbusRTU_TxChainAbort(ModbusRTU_Slave *mb);
 
-/* �û��ص��������壬�����أ� */
+/* 非本站帧回调（弱定义，可重载）：地址不是本站时由 Process 调用，广播帧也调用一次
+   （之后本站照常执行），frame 为线性化后的整帧（含 CRC），crcOk 为校验结果。网关据此转发。 */
+void    ModbusRTU_ForeignFrameCallback(ModbusRTU_Slave *mb, const ModbusRTU_RxDesc *d,
+                                       const uint8_t *frame, uint8_t crcOk);
+
+/* 发送完成时先调用（中断上下文，弱定义，可重载）：返回 1 表示已用 SendRaw 续发下一段；
+   返回 MB_TX_CHAIN_HOLD 表示数据未到、挂起等待，之后须再 SendRaw 续发或 ModbusRTU_TxChainAbort 收尾，
+   帧定时模式下 t1.5 内未续发由协议栈自行放弃（释放 DE、txInProgress 清零）。
+   两种情况都保持 DE 与 txInProgress，不切回接收。用于直通转发分段续传。 */
+#define MB_TX_CHAIN_HOLD    2U
+uint8_t ModbusRTU_TxChainCallback(ModbusRTU_Slave *mb);
+
+/* 写保持寄存器回调（弱定义，可重载）
+   Validate：写入前对整段调用一次，values 为请求中的大端数据，
+             返回 0 允许写入，返回异常码（如 MB_EX_ILLEGAL_DATA_VALUE）则整段不写；
+   Commit：  整段写入 holdingRegs 后调用一次。0x06 按长度 1 的范围处理。 */
+uint8_t ModbusRTU_ValidateWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr,
+                                     uint16_t quantity, const uint8_t *values);
+void    ModbusRTU_CommitWriteRange(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity);
+
+/* 线圈写入（0x05/0x0F）提交后调用一次，可在此驱动输出（弱定义，可重载） */
+void    ModbusRTU_CommitWriteCoils(ModbusRTU_Slave *mb, uint16_t startAddr, uint16_t quantity);
+
+/* 掩码写（0x16）接管（弱定义，可重载）：寄存器镜像可能落后于中断里改动的实际状态时，
+   应用在自己的临界区内对实际状态做 AND/OR，置 *handled = 1 并返回异常码（0 = 成功）；
+   默认不接管，由协议栈按 holdingRegs 当前值计算后走整段校验/提交。 */
+uint8_t ModbusRTU_MaskWriteHook(ModbusRTU_Slave *mb, uint16_t addr, uint16_t andMask,
+                                uint16_t orMask, uint8_t *handled);
+
+#if MB_WRITE_PER_REG_CALLBACKS
+/* 兼容层：逐寄存器回调，由默认的 Validate/Commit 转调 */
 void ModbusRTU_PreWriteCallback(uint16_t addr, uint16_t value);
 void ModbusRTU_PostWriteCallback(uint16_t addr, uint16_t value);
+#endif
 
 #ifdef __cplusplus
 }
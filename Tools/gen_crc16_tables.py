@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Modbus CRC16 查表生成器
+
+生成 slicing-by-4 所需的 4 张 256 项查找表（多项式 0xA001，反射，初值 0xFFFF），
+输出为 C 源文件。Keil 工程在编译前（Before Build）与主机 Makefile 都会调用本脚本，
+表格不再手工粘贴进源码。
+
+生成前会做自校验：
+  1. 表0 与逐位算法逐项比对；
+  2. 表1~3 与“字节后跟 k 个零字节”的定义比对；
+  3. 用 slicing-by-4 路径与逐位算法对随机数据（含各种长度/余数）比对；
+  4. 标准校验值 CRC16/MODBUS("123456789") == 0x4B37。
+任一项失败则不写文件并返回非零，编译随之失败。
+
+使用方法：
+python gen_crc16_tables.py ../Core/Src/modbus_crc16_table.c
+"""
+
+import argparse
+import random
+import sys
+
+POLY = 0xA001
+INIT = 0xFFFF
+CHECK_INPUT = b"123456789"
+CHECK_VALUE = 0x4B37
+SLICES = 4
+
+
+def crc16_bitwise(data, crc=INIT):
+    """逐位参考实现（与 Tools/uart_test.py 中 modbus_crc16 相同）"""
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            if crc & 0x0001:
+                crc = (crc >> 1) ^ POLY
+            else:
+                crc >>= 1
+    return crc
+
+
+def build_tables():
+    """生成 slicing-by-4 表：T[k][i] 为字节 i 之后再经过 k 个零字节的 CRC 贡献"""
+    t0 = [crc16_bitwise([i], 0) for i in range(256)]
+    tables = [t0]
+    for _ in range(1, SLICES):
+        prev = tables[-1]
+        tables.append([(v >> 8) ^ t0[v & 0xFF] for v in prev])
+    return tables
+
+
+def crc16_sliced(tables, data, crc=INIT):
+    """按固件 modbus_crc.c 的同一路径计算，用于自校验"""
+    t0, t1, t2, t3 = tables
+    i = 0
+    n = len(data)
+    while n - i >= 4:
+        crc = (t3[(crc ^ data[i]) & 0xFF] ^
+               t2[((crc >> 8) ^ data[i + 1]) & 0xFF] ^
+               t1[data[i + 2]] ^
+               t0[data[i + 3]])
+        i += 4
+    while i < n:
+        crc = (crc >> 8) ^ t0[(crc ^ data[i]) & 0xFF]
+        i += 1
+    return crc
+
+
+def verify(tables):
+    """返回错误描述列表，空列表表示全部通过"""
+    errors = []
+    for i in range(256):
+        if tables[0][i] != crc16_bitwise([i], 0):
+            errors.append(f"T0[{i}] mismatch")
+    for k in range(1, SLICES):
+        for i in range(256):
+            expect = crc16_bitwise([i] + [0] * k, 0)
+            if tables[k][i] != expect:
+                errors.append(f"T{k}[{i}] mismatch")
+                break
+    rng = random.Random(0x4B37)
+    for length in list(range(0, 67)) + [255, 256]:
+        data = bytes(rng.randrange(256) for _ in range(length))
+        seed = rng.randrange(0x10000)
+        if crc16_sliced(tables, data, seed) != crc16_bitwise(data, seed):
+            errors.append(f"sliced/bitwise mismatch at length {length}")
+    if crc16_sliced(tables, CHECK_INPUT) != CHECK_VALUE:
+        errors.append("check value 0x4B37 mismatch")
+    return errors
+
+
+def render(tables):
+    lines = [
+        "/* modbus_crc16_table.c",
+        " * 自动生成文件，请勿手工修改：由 Tools/gen_crc16_tables.py 在编译前生成。",
+        " * CRC16/MODBUS (poly 0xA001 reflected, init 0xFFFF), slicing-by-4 tables.",
+        " */",
+        '#include "modbus_crc.h"',
+        "",
+        f"const uint16_t g_mbCrc16Table[{SLICES}][256] = {{",
+    ]
+    for k, table in enumerate(tables):
+        lines.append("    {")
+        for row in range(0, 256, 8):
+            vals = ",".join(f"0x{v:04X}" for v in table[row:row + 8])
+            lines.append(f"        {vals},")
+        lines.append("    }," if k < SLICES - 1 else "    }")
+    lines.append("};")
+    lines.append("")
+    return "\n".join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="生成 Modbus CRC16 slicing-by-4 查找表")
+    parser.add_argument("output", help="输出 C 文件路径")
+    args = parser.parse_args()
+
+    tables = build_tables()
+    errors = verify(tables)
+    if errors:
+        for e in errors:
+            print(f"gen_crc16_tables: {e}", file=sys.stderr)
+        return 1
+
+    text = render(tables)
+    try:
+        with open(args.output, "r", encoding="utf-8") as f:
+            if f.read() == text:
+                return 0  # 内容未变，不触碰时间戳，避免无谓重编译
+    except OSError:
+        pass
+    with open(args.output, "w", encoding="utf-8", newline="\n") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,304 @@
+/**
+ * @file crc16_bench.c
+ * @brief 主机端 CRC16 基准：逐字节查表 vs slicing-by-4
+ * @details
+ * 先对随机数据逐长度交叉校验两条路径，再对典型帧长（8/64/256 字节）
+ * 测量吞吐，输出 bytes/cycle（x86 使用 TSC，其他平台退化为 bytes/ns）。
+ * 最后模拟接收一帧 0x10 写 123 个寄存器（255 字节）：按合成的 DMA 分段
+ * （半满、主循环轮询、IDLE）折叠 CRC，测量 IDLE 之后到校验结论的耗时，
+ * 与整帧重算对比。
+ * 注意主机 CPU 的结果只用于对比两种算法的相对收益，不代表 F103 绝对值。
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "modbus_crc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycle"
+static inline uint64_t benchNow(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t benchNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/* 原三套协议栈共同的逐字节查表算法，作为基线 */
+static uint16_t crc16Bytewise(uint16_t crc, const uint8_t *data, uint16_t len)
+{
+    while (len--) {
+        crc = (crc >> 8) ^ g_mbCrc16Table[0][(uint8_t)(crc ^ *data++)];
+    }
+    return crc;
+}
+
+static volatile uint16_t s_sink;
+
+static double benchOne(uint16_t (*fn)(uint16_t, const uint8_t *, uint16_t),
+                       const uint8_t *buf, uint16_t len, uint32_t iters)
+{
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint16_t crc = MB_CRC16_INIT;
+        uint64_t t0 = benchNow();
+        for (uint32_t i = 0; i < iters; i++) {
+            crc = fn(crc, buf, len);
+        }
+        uint64_t dt = benchNow() - t0;
+        s_sink = crc;
+        if (dt < best) best = dt;
+    }
+    return (double)len * iters / (double)best;
+}
+
+/* 按固定步长模拟 DMA 到达事件，最多折叠到 len - tail，其余留给 IDLE */
+static void feedChunks(ModbusCRC16_Stream *s, const uint8_t *frame, uint16_t len,
+                       uint16_t step, uint16_t tail)
+{
+    ModbusCRC16_StreamReset(s);
+    for (uint16_t end = step; end + tail <= len; end = (uint16_t)(end + step)) {
+        ModbusCRC16_StreamFold(s, frame, end);
+    }
+}
+
+/* 0x10 写 123 个寄存器：7 字节头 + 246 字节数据 + 2 字节 CRC */
+static uint16_t buildWriteFrame(uint8_t *frame)
+{
+    uint16_t n = 0;
+    frame[n++] = 0x01; frame[n++] = 0x10;
+    frame[n++] = 0x00; frame[n++] = 0x00;
+    frame[n++] = 0x00; frame[n++] = 123;
+    frame[n++] = 246;
+    for (uint16_t i = 0; i < 246; i++) frame[n++] = (uint8_t)rand();
+    uint16_t crc = ModbusCRC16(frame, n);
+    frame[n++] = (uint8_t)(crc & 0xFF);
+    frame[n++] = (uint8_t)(crc >> 8);
+    return n;
+}
+
+static int checkStream(void)
+{
+    static uint8_t frame[256];
+    uint16_t len = buildWriteFrame(frame);
+    for (uint16_t step = 1; step <= len; step++) {
+        ModbusCRC16_Stream s;
+        feedChunks(&s, frame, len, step, 0);
+        ModbusCRC16_StreamFold(&s, frame, len);
+        if (s.pos != len || s.crc != 0U) {
+            fprintf(stderr, "crc16_bench: stream residue nonzero at step %u\n", step);
+            return 1;
+        }
+        frame[step - 1U] ^= 0x01;   /* 任一位翻转都必须检出 */
+        feedChunks(&s, frame, len, step, 0);
+        ModbusCRC16_StreamFold(&s, frame, len);
+        frame[step - 1U] ^= 0x01;
+        if (s.crc == 0U) {
+            fprintf(stderr, "crc16_bench: stream missed bit flip at %u\n", step);
+            return 1;
+        }
+    }
+
+    /* 环形缓冲：帧跨越环尾，按不同步长折叠，余数同样必须为 0 */
+    static uint8_t ring[512];
+    for (uint16_t off = 300; off < 300 + 8; off++) {
+        for (uint16_t i = 0; i < len; i++) ring[(off + i) & 511U] = frame[i];
+        for (uint16_t step = 1; step <= 64; step++) {
+            ModbusCRC16_Stream s;
+            ModbusCRC16_StreamReset(&s);
+            s.pos = off;
+            for (uint16_t done = 0; done < len; ) {
+                uint16_t n = (uint16_t)((len - done < step) ? len - done : step);
+                ModbusCRC16_StreamFoldRing(&s, ring, sizeof(ring), n);
+                done = (uint16_t)(done + n);
+            }
+            if (s.crc != 0U || s.pos != ((off + len) & 511U)) {
+                fprintf(stderr, "crc16_bench: ring fold mismatch at offset %u step %u\n", off, step);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* IDLE 之后的耗时：整帧重算 vs 折叠剩余 tail 字节后比较 */
+static void benchTurnaround(void)
+{
+    static uint8_t frame[256];
+    uint16_t len = buildWriteFrame(frame);
+    static const struct { const char *name; uint16_t step; uint16_t tail; } cases[] = {
+        { "half-transfer only", 128, 127 },
+        { "poll every 32 B",     32,  31 },
+        { "poll every 4 B",       4,   3 },
+    };
+    const uint32_t iters = 200000U;
+
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint32_t ok = 0;
+        uint64_t t0 = benchNow();
+        for (uint32_t i = 0; i < iters; i++) {
+            uint16_t rx = (uint16_t)(frame[len - 2U] | (frame[len - 1U] << 8));
+            ok += (ModbusCRC16(frame, (uint16_t)(len - 2U)) == rx);
+        }
+        uint64_t dt = benchNow() - t0;
+        s_sink = (uint16_t)ok;
+        if (dt < best) best = dt;
+    }
+    double full = (double)best / iters;
+    printf("\n0x10 x123 (%u B) IDLE->verdict, " BENCH_UNIT "s/frame\n", len);
+    printf("%-20s %10.1f\n", "full recompute", full);
+
+    for (unsigned c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        ModbusCRC16_Stream pre;
+        feedChunks(&pre, frame, len, cases[c].step, cases[c].tail);
+        best = UINT64_MAX;
+        for (int round = 0; round < 5; round++) {
+            uint32_t ok = 0;
+            uint64_t t0 = benchNow();
+            for (uint32_t i = 0; i < iters; i++) {
+                ModbusCRC16_Stream s = pre;
+                ModbusCRC16_StreamFold(&s, frame, len);
+                ok += (s.crc == 0U);
+            }
+            uint64_t dt = benchNow() - t0;
+            s_sink = (uint16_t)ok;
+            if (dt < best) best = dt;
+        }
+        double inc = (double)best / iters;
+        printf("%-20s %10.1f  (%u B left at IDLE, %.1fx)\n",
+               cases[c].name, inc, (unsigned)(len - pre.pos), full / inc);
+    }
+}
+
+/* 0x03 读 125 个寄存器的应答组帧：快照 + 逐字节拷贝 + 整帧 CRC vs 单趟序列化并折叠 CRC */
+static uint16_t s_regs[125];
+static uint8_t  s_tx[256];
+
+static uint16_t buildReadTwoPass(void)
+{
+    uint16_t snap[125];
+    for (uint16_t i = 0; i < 125U; i++) snap[i] = ((volatile uint16_t *)s_regs)[i];
+    s_tx[0] = 0x01; s_tx[1] = 0x03; s_tx[2] = 250;
+    for (uint16_t i = 0; i < 125U; i++) {
+        s_tx[3 + 2*i] = (uint8_t)(snap[i] >> 8);
+        s_tx[4 + 2*i] = (uint8_t)(snap[i] & 0xFF);
+    }
+    return ModbusCRC16(s_tx, 253);
+}
+
+static uint16_t buildReadFused(void)
+{
+    s_tx[0] = 0x01; s_tx[1] = 0x03; s_tx[2] = 250;
+    uint16_t crc = ModbusCRC16(s_tx, 3);
+    const uint16_t quantity = 125;
+    const volatile uint16_t *src = s_regs;
+    uint8_t *out = &s_tx[3];
+    uint16_t i = 0;
+    for (; i + 1U < quantity; i += 2U) {   /* 每次两个寄存器，正好一步 slicing-by-4 */
+        uint16_t v0 = src[i];
+        uint16_t v1 = src[i + 1U];
+        out[0] = (uint8_t)(v0 >> 8);
+        out[1] = (uint8_t)(v0 & 0xFF);
+        out[2] = (uint8_t)(v1 >> 8);
+        out[3] = (uint8_t)(v1 & 0xFF);
+        crc = ModbusCRC16_Update4(crc, out[0], out[1], out[2], out[3]);
+        out += 4;
+    }
+    if (i < quantity) {
+        uint16_t v = src[i];
+        out[0] = (uint8_t)(v >> 8);
+        out[1] = (uint8_t)(v & 0xFF);
+        crc = ModbusCRC16_Update2(crc, out[0], out[1]);
+    }
+    return crc;
+}
+
+static int checkReadFused(void)
+{
+    for (uint16_t i = 0; i < 125U; i++) s_regs[i] = (uint16_t)rand();
+    if (buildReadTwoPass() != buildReadFused()) {
+        fprintf(stderr, "crc16_bench: fused serialize mismatch\n");
+        return 1;
+    }
+    for (unsigned v = 0; v < 0x10000U; v += 0x101U) {
+        uint8_t b[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+        if (ModbusCRC16_Update2((uint16_t)(v * 7U), b[0], b[1])
+            != ModbusCRC16_Update((uint16_t)(v * 7U), b, 2)) {
+            fprintf(stderr, "crc16_bench: Update2 mismatch\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double benchBuild(uint16_t (*fn)(void), uint32_t iters)
+{
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < 5; round++) {
+        uint16_t acc = 0;
+        uint64_t t0 = benchNow();
+        for (uint32_t i = 0; i < iters; i++) acc ^= fn();
+        uint64_t dt = benchNow() - t0;
+        s_sink = acc;
+        if (dt < best) best = dt;
+    }
+    return (double)best / iters;
+}
+
+static void benchReadResponse(void)
+{
+    const uint32_t iters = 200000U;
+    double twoPass = benchBuild(buildReadTwoPass, iters);
+    double fused   = benchBuild(buildReadFused, iters);
+    printf("\n0x03 x125 response build, " BENCH_UNIT "s/frame\n");
+    printf("%-20s %10.1f\n", "snapshot+copy+crc", twoPass);
+    printf("%-20s %10.1f  (%.1fx)\n", "fused in-place", fused, twoPass / fused);
+}
+
+int main(void)
+{
+    static uint8_t buf[256];
+    srand(0x4B37);
+    for (unsigned i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t)rand();
+
+    /* 正确性：所有长度与分段方式都必须一致 */
+    for (uint16_t len = 0; len <= sizeof(buf); len++) {
+        uint16_t ref = crc16Bytewise(MB_CRC16_INIT, buf, len);
+        uint16_t split = len / 3U;
+        uint16_t inc = ModbusCRC16_Update(ModbusCRC16_Update(MB_CRC16_INIT, buf, split),
+                                          buf + split, (uint16_t)(len - split));
+        if (ModbusCRC16(buf, len) != ref || inc != ref) {
+            fprintf(stderr, "crc16_bench: mismatch at length %u\n", len);
+            return 1;
+        }
+    }
+    if (ModbusCRC16((const uint8_t *)"123456789", 9) != 0x4B37) {
+        fprintf(stderr, "crc16_bench: check value mismatch\n");
+        return 1;
+    }
+    if (checkStream() != 0) {
+        return 1;
+    }
+    if (checkReadFused() != 0) {
+        return 1;
+    }
+
+    static const uint16_t sizes[] = { 8, 64, 256 };
+    printf("%-6s %18s %18s %8s\n", "bytes", "bytewise B/" BENCH_UNIT, "slice4 B/" BENCH_UNIT, "speedup");
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        uint32_t iters = 2000000U / sizes[i] * 16U;
+        double a = benchOne(crc16Bytewise, buf, sizes[i], iters);
+        double b = benchOne(ModbusCRC16_Update, buf, sizes[i], iters);
+        printf("%-6u %18.3f %18.3f %7.2fx\n", sizes[i], a, b, b / a);
+    }
+    benchTurnaround();
+    benchReadResponse();
+    return 0;
+}
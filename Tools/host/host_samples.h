@@ -0,0 +1,63 @@
+/**
+ * @file host_samples.h
+ * @brief 主机工具共用的时延样本集：追加、排序、分位数与均值
+ * @details
+ * mb_load、lighting_bus、mb_replay 都按纳秒记录样本，排序后按最近秩取分位数，输出单位为微秒。
+ * 取分位数之前须先调用 samplesSort。
+ */
+
+#ifndef HOST_SAMPLES_H
+#define HOST_SAMPLES_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    uint64_t *v;
+    uint32_t  n;
+    uint32_t  cap;
+} Samples;
+
+static inline void samplesAdd(Samples *s, uint64_t v)
+{
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2U : 4096U;
+        s->v = realloc(s->v, s->cap * sizeof(uint64_t));
+        if (s->v == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    s->v[s->n++] = v;
+}
+
+static inline int samplesCmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void samplesSort(Samples *s)
+{
+    qsort(s->v, s->n, sizeof(uint64_t), samplesCmp);
+}
+
+/* p 为百分数（0-100），返回微秒 */
+static inline double samplesPct(const Samples *s, double p)
+{
+    if (s->n == 0U) return 0.0;
+    uint32_t i = (uint32_t)(p / 100.0 * (s->n - 1U) + 0.5);
+    return (double)s->v[i] / 1000.0;
+}
+
+static inline double samplesMean(const Samples *s)
+{
+    if (s->n == 0U) return 0.0;
+    double sum = 0.0;
+    for (uint32_t i = 0; i < s->n; i++) sum += (double)s->v[i];
+    return sum / s->n / 1000.0;
+}
+
+#endif // HOST_SAMPLES_H
@@ -0,0 +1,650 @@
+/**
+ * @file mb_load.c
+ * @brief Modbus RTU 主站压测：多串口/PTY 并发，开环/闭环定速，功能码混合，应答校验
+ * @details
+ * 每个 -p 端口是一条独立的 RTU 线路（同一时刻只有一个未完成请求），单线程 ppoll 驱动全部端口。
+ *   闭环：应答收齐（或超时）后隔 -g 再发下一条；给了 -R 时另按速率限速。
+ *   开环：请求按 -R 的速率到达（固定间隔或 -x 泊松），线路忙时排队，
+ *         延时从“应该发出”的时刻算起（不因线路积压而少算排队时间）。
+ * 应答按期望长度判完（异常应答 5 字节），校验 CRC、地址、功能码、长度、
+ * 读应答的字节数字段和写应答的回显。
+ * 延时 = 写出请求到读到最后一个字节，包含请求/应答在线上的传输时间。
+ * -c 把各端口收发的字节写成 .mbcap 抓包（主站角色，通道号 = -p 的顺序，见 modbus_capture.h），
+ * 可交给 mb_replay 在仿真固件上回放；收到的字节按读到的时刻减去在线时间估计起始位，精度受调度影响。
+ *
+ * 用法示例：
+ *   mb_load -p /tmp/ttyMB1:1 -p /tmp/ttyMB2:2 -r 3,0,10,7 -r 16,0,4,3 -d 10 -j result.json
+ *   mb_load -p /dev/ttyUSB0 -b 19200 -o -R 50 -x -d 60
+ *   mb_load -p /tmp/ttyMB1:1 -d 5 -c run.mbcap
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "modbus_crc.h"
+#include "modbus_capture.h"
+#include "host_samples.h"
+
+//=============================================================================
+// 1. 配置与状态 (Configuration & State)
+//=============================================================================
+
+#define LOAD_PORTS_MAX      16U
+#define LOAD_REQS_MAX       16U
+#define LOAD_FRAME_MAX      256U
+#define LOAD_BACKLOG        65536U          /* 开环排队上限（2 的幂） */
+#define LOAD_NEVER          UINT64_MAX
+
+typedef struct
+{
+    uint8_t  fc;
+    uint16_t start;
+    uint16_t qty;           /**< 0x05/0x06 为写入值 */
+    uint32_t weight;
+} LoadReq;
+
+typedef enum
+{
+    LOAD_BAD_CRC = 0,
+    LOAD_BAD_ADDR,
+    LOAD_BAD_FC,
+    LOAD_BAD_LEN,
+    LOAD_BAD_ECHO,
+    LOAD_BAD_KINDS
+} LoadBad;
+
+static const char *const s_badNames[LOAD_BAD_KINDS] = { "crc", "addr", "fc", "length", "echo" };
+
+typedef struct
+{
+    uint64_t sent;
+    uint64_t ok;
+    uint64_t exception;
+    uint64_t timeout;
+    uint64_t bad[LOAD_BAD_KINDS];
+    uint64_t dropped;       /**< 开环排队溢出 */
+    uint64_t stray;         /**< 空闲时收到的字节 */
+    uint64_t txBytes;
+    uint64_t rxBytes;
+    Samples  lat;
+} LoadStats;
+
+typedef struct
+{
+    const char *dev;
+    int         fd;
+    uint8_t     addr;
+
+    uint8_t     busy;
+    const LoadReq *req;
+    uint64_t    intended;       /**< 本请求应当发出的时刻（开环 = 到达时刻） */
+    uint64_t    deadline;
+    uint64_t    nextSend;       /**< 闭环：最早的下一次发送 */
+    uint64_t    nextArrival;    /**< 开环：下一个请求到达 */
+    uint64_t    backlog[LOAD_BACKLOG];
+    uint32_t    blHead;
+    uint32_t    blTail;
+
+    uint8_t     tx[LOAD_FRAME_MAX];
+    uint16_t    txLen;
+    uint8_t     rx[LOAD_FRAME_MAX];
+    uint16_t    rxLen;
+    uint16_t    expect;
+
+    LoadStats   st;
+} LoadPort;
+
+static LoadPort  s_ports[LOAD_PORTS_MAX];
+static uint32_t  s_nPorts;
+static LoadReq   s_reqs[LOAD_REQS_MAX];
+static uint32_t  s_nReqs;
+static uint32_t  s_weightSum;
+static uint32_t  s_baud = 115200U;
+static double    s_rate;                    /* 每端口 req/s，0 = 闭环不限速 */
+static uint8_t   s_openLoop;
+static uint8_t   s_poisson;
+static uint64_t  s_timeoutNs = 100000000ULL;
+static uint64_t  s_gapNs = LOAD_NEVER;      /* 默认 t3.5 */
+static uint64_t  s_durationNs = 10000000000ULL;
+static uint64_t  s_seed = 1;
+static FILE     *s_capture;                 /* -c 抓包输出 */
+static uint64_t  s_captureT0;
+
+static uint64_t loadNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* xorshift64*：请求选择与泊松间隔，-s 固定种子可复现 */
+static uint64_t loadRand(void)
+{
+    s_seed ^= s_seed >> 12;
+    s_seed ^= s_seed << 25;
+    s_seed ^= s_seed >> 27;
+    return s_seed * 0x2545F4914F6CDD1DULL;
+}
+
+//=============================================================================
+// 2. 组帧与校验 (Framing & Validation)
+//=============================================================================
+
+static uint16_t loadBuild(const LoadReq *r, uint8_t addr, uint8_t *out, uint16_t *expect)
+{
+    uint16_t n = 0;
+    out[n++] = addr;
+    out[n++] = r->fc;
+    out[n++] = (uint8_t)(r->start >> 8);
+    out[n++] = (uint8_t)r->start;
+    switch (r->fc) {
+        case 0x01:
+        case 0x02:
+            out[n++] = (uint8_t)(r->qty >> 8);
+            out[n++] = (uint8_t)r->qty;
+            *expect = (uint16_t)(5U + (r->qty + 7U) / 8U);
+            break;
+        case 0x03:
+        case 0x04:
+            out[n++] = (uint8_t)(r->qty >> 8);
+            out[n++] = (uint8_t)r->qty;
+            *expect = (uint16_t)(5U + 2U * r->qty);
+            break;
+        case 0x05:
+            out[n++] = r->qty ? 0xFFU : 0x00U;
+            out[n++] = 0x00U;
+            *expect = 8U;
+            break;
+        case 0x06:
+            out[n++] = (uint8_t)(r->qty >> 8);
+            out[n++] = (uint8_t)r->qty;
+            *expect = 8U;
+            break;
+        case 0x0F:
+            out[n++] = (uint8_t)(r->qty >> 8);
+            out[n++] = (uint8_t)r->qty;
+            out[n++] = (uint8_t)((r->qty + 7U) / 8U);
+            for (uint16_t i = 0; i < (r->qty + 7U) / 8U; i++) out[n++] = (uint8_t)loadRand();
+            *expect = 8U;
+            break;
+        case 0x10:
+            out[n++] = (uint8_t)(r->qty >> 8);
+            out[n++] = (uint8_t)r->qty;
+            out[n++] = (uint8_t)(2U * r->qty);
+            for (uint16_t i = 0; i < 2U * r->qty; i++) out[n++] = (uint8_t)loadRand();
+            *expect = 8U;
+            break;
+        default:
+            break;
+    }
+    uint16_t crc = ModbusCRC16(out, n);
+    out[n++] = (uint8_t)crc;
+    out[n++] = (uint8_t)(crc >> 8);
+    return n;
+}
+
+/**
+ * @return -1 = 正常应答，-2 = 异常应答，否则为 LoadBad
+ */
+static int loadCheck(const LoadPort *p)
+{
+    const uint8_t *r = p->rx;
+    uint16_t n = p->rxLen;
+    if (n < 5U || ModbusCRC16(r, n) != 0U) return LOAD_BAD_CRC;
+    if (r[0] != p->addr) return LOAD_BAD_ADDR;
+    if ((r[1] & 0x7FU) != p->req->fc) return LOAD_BAD_FC;
+    if (r[1] & 0x80U) return (n == 5U) ? -2 : LOAD_BAD_LEN;
+    if (n != p->expect) return LOAD_BAD_LEN;
+    switch (p->req->fc) {
+        case 0x01: case 0x02: case 0x03: case 0x04:
+            return (r[2] == n - 5U) ? -1 : LOAD_BAD_LEN;
+        default:
+            /* 0x05/0x06 回显地址与值，0x0F/0x10 回显起始地址与数量 */
+            return (memcmp(&r[2], &p->tx[2], 4) == 0) ? -1 : LOAD_BAD_ECHO;
+    }
+}
+
+static const LoadReq *loadPick(void)
+{
+    if (s_nReqs == 1U) return &s_reqs[0];
+    uint32_t x = (uint32_t)(loadRand() % s_weightSum);
+    for (uint32_t i = 0; i < s_nReqs; i++) {
+        if (x < s_reqs[i].weight) return &s_reqs[i];
+        x -= s_reqs[i].weight;
+    }
+    return &s_reqs[s_nReqs - 1U];
+}
+
+static uint64_t loadInterval(void)
+{
+    double mean = 1e9 / s_rate;
+    if (!s_poisson) return (uint64_t)mean;
+    double u = ((double)(loadRand() >> 11) + 1.0) / 9007199254740993.0;
+    return (uint64_t)(-log(u) * mean);
+}
+
+//=============================================================================
+// 3. 串口 (Serial Port)
+//=============================================================================
+
+static speed_t loadSpeed(uint32_t baud)
+{
+    switch (baud) {
+        case 1200:   return B1200;
+        case 2400:   return B2400;
+        case 4800:   return B4800;
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default:     return B0;
+    }
+}
+
+static int loadOpen(LoadPort *p)
+{
+    p->fd = open(p->dev, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (p->fd < 0) {
+        perror(p->dev);
+        return -1;
+    }
+    struct termios tio;
+    if (tcgetattr(p->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        cfsetispeed(&tio, loadSpeed(s_baud));
+        cfsetospeed(&tio, loadSpeed(s_baud));
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(p->fd, TCSANOW, &tio);
+        tcflush(p->fd, TCIOFLUSH);
+    }
+    return 0;
+}
+
+//=============================================================================
+// 4. 事务 (Transactions)
+//=============================================================================
+
+/* 写一条抓包记录：tNs 为首字节起始位时刻 */
+static void loadCapture(const LoadPort *p, uint8_t flags, const uint8_t *data, uint16_t len, uint64_t tNs)
+{
+    if (s_capture == NULL || len == 0U) return;
+    ModbusCaptureRec_t rec;
+    rec.sync  = MB_CAP_SYNC;
+    rec.flags = (uint8_t)(flags | ((uint32_t)(p - s_ports) & MB_CAP_CHAN_MASK));
+    rec.len   = len;
+    rec.tUs   = (uint32_t)((tNs - s_captureT0) / 1000U);
+    fwrite(&rec, sizeof(rec), 1, s_capture);
+    fwrite(data, 1, len, s_capture);
+}
+
+static void loadSend(LoadPort *p, uint64_t intended, uint64_t now)
+{
+    p->req = loadPick();
+    p->txLen = loadBuild(p->req, p->addr, p->tx, &p->expect);
+    p->rxLen = 0;
+    ssize_t n = write(p->fd, p->tx, p->txLen);
+    if (n != (ssize_t)p->txLen) {
+        fprintf(stderr, "%s: write: %s\n", p->dev, (n < 0) ? strerror(errno) : "short write");
+        exit(1);
+    }
+    loadCapture(p, MB_CAP_F_TX, p->tx, p->txLen, now);
+    p->busy = 1;
+    p->intended = intended;
+    p->deadline = now + s_timeoutNs;
+    p->st.sent++;
+    p->st.txBytes += p->txLen;
+}
+
+static void loadDone(LoadPort *p, uint64_t now)
+{
+    p->busy = 0;
+    p->nextSend = now + s_gapNs;
+    if (!s_openLoop && s_rate > 0.0) {
+        uint64_t paced = p->intended + (uint64_t)(1e9 / s_rate);
+        if (paced > p->nextSend) p->nextSend = paced;
+    }
+}
+
+static void loadRx(LoadPort *p, uint64_t now)
+{
+    for (;;) {
+        uint8_t buf[LOAD_FRAME_MAX];
+        ssize_t n = read(p->fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        p->st.rxBytes += (uint64_t)n;
+        /* 8N1：每字节 10 位；最后一个字节刚收齐，往前推整段的在线时间 */
+        uint64_t onLine = (uint64_t)n * 10U * 1000000000ULL / s_baud;
+        loadCapture(p, 0, buf, (uint16_t)n, (now > onLine) ? now - onLine : now);
+        if (!p->busy) {
+            p->st.stray += (uint64_t)n;
+            continue;
+        }
+        for (ssize_t i = 0; i < n && p->rxLen < LOAD_FRAME_MAX; i++) p->rx[p->rxLen++] = buf[i];
+    }
+    if (!p->busy || p->rxLen < 2U) return;
+
+    uint16_t want = (p->rx[1] & 0x80U) ? 5U : p->expect;
+    if (p->rxLen < want) return;
+    int r = loadCheck(p);
+    if (r == -1) {
+        p->st.ok++;
+        samplesAdd(&p->st.lat, now - p->intended);
+    } else if (r == -2) {
+        p->st.exception++;
+    } else {
+        p->st.bad[r]++;
+    }
+    loadDone(p, now);
+}
+
+/* 到期的发送、到达与超时；返回下一个需要醒来的时刻 */
+static uint64_t loadStep(LoadPort *p, uint64_t now, uint64_t end)
+{
+    if (s_openLoop) {
+        while (p->nextArrival <= now && p->nextArrival < end) {
+            if (p->blHead - p->blTail < LOAD_BACKLOG) {
+                p->backlog[p->blHead++ & (LOAD_BACKLOG - 1U)] = p->nextArrival;
+            } else {
+                p->st.dropped++;
+            }
+            p->nextArrival += loadInterval();
+        }
+    }
+    if (p->busy && now >= p->deadline) {
+        if (p->rxLen != 0U) p->st.bad[LOAD_BAD_LEN]++; else p->st.timeout++;
+        loadDone(p, now);
+    }
+    if (!p->busy && now >= p->nextSend && now < end) {
+        if (!s_openLoop) {
+            loadSend(p, now, now);
+        } else if (p->blHead != p->blTail) {
+            loadSend(p, p->backlog[p->blTail++ & (LOAD_BACKLOG - 1U)], now);
+        }
+    }
+
+    uint64_t wake = LOAD_NEVER;
+    if (p->busy) {
+        wake = p->deadline;
+    } else if (!s_openLoop || p->blHead != p->blTail) {
+        wake = p->nextSend;
+    }
+    if (s_openLoop && p->nextArrival < wake) wake = p->nextArrival;
+    return wake;
+}
+
+static void loadRun(void)
+{
+    uint64_t start = loadNowNs();
+    uint64_t end = start + s_durationNs;
+    for (uint32_t i = 0; i < s_nPorts; i++) {
+        s_ports[i].nextSend = start;
+        s_ports[i].nextArrival = start;
+    }
+
+    struct pollfd fds[LOAD_PORTS_MAX];
+    for (;;) {
+        uint64_t now = loadNowNs();
+        uint64_t wake = LOAD_NEVER;
+        uint8_t active = 0;
+        for (uint32_t i = 0; i < s_nPorts; i++) {
+            uint64_t w = loadStep(&s_ports[i], now, end);
+            if (w < wake) wake = w;
+            active |= s_ports[i].busy;
+        }
+        /* 时间到后不再发新请求，等未完成的收尾 */
+        if (now >= end && !active) break;
+        if (now < end && end < wake) wake = end;
+
+        for (uint32_t i = 0; i < s_nPorts; i++) {
+            fds[i].fd = s_ports[i].fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        now = loadNowNs();
+        if (wake > now) {
+            uint64_t d = (wake == LOAD_NEVER) ? 100000000ULL : wake - now;
+            struct timespec ts = { (time_t)(d / 1000000000ULL), (long)(d % 1000000000ULL) };
+            ppoll(fds, s_nPorts, &ts, NULL);
+        }
+        now = loadNowNs();
+        for (uint32_t i = 0; i < s_nPorts; i++) {
+            if (fds[i].revents & (POLLIN | POLLHUP)) loadRx(&s_ports[i], now);
+        }
+    }
+}
+
+//=============================================================================
+// 5. 报告 (Report)
+//=============================================================================
+
+static void loadMerge(LoadStats *dst, const LoadStats *src)
+{
+    dst->sent += src->sent;
+    dst->ok += src->ok;
+    dst->exception += src->exception;
+    dst->timeout += src->timeout;
+    for (uint32_t k = 0; k < LOAD_BAD_KINDS; k++) dst->bad[k] += src->bad[k];
+    dst->dropped += src->dropped;
+    dst->stray += src->stray;
+    dst->txBytes += src->txBytes;
+    dst->rxBytes += src->rxBytes;
+    for (uint32_t i = 0; i < src->lat.n; i++) samplesAdd(&dst->lat, src->lat.v[i]);
+}
+
+static uint64_t loadBadTotal(const LoadStats *st)
+{
+    uint64_t n = 0;
+    for (uint32_t k = 0; k < LOAD_BAD_KINDS; k++) n += st->bad[k];
+    return n;
+}
+
+static void loadText(const char *name, LoadStats *st, double sec)
+{
+    samplesSort(&st->lat);
+    double line = (double)(st->txBytes + st->rxBytes) * 10.0 / s_baud / sec;
+    printf("%-16s sent %-8llu ok %-8llu exc %-5llu bad %-5llu timeout %-5llu -> %8.1f ok/s, line %5.1f%%\n",
+           name, (unsigned long long)st->sent, (unsigned long long)st->ok,
+           (unsigned long long)st->exception, (unsigned long long)loadBadTotal(st),
+           (unsigned long long)st->timeout, (double)st->ok / sec, 100.0 * line);
+    printf("%-16s latency us: min %.1f p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n", "",
+           samplesPct(&st->lat, 0), samplesPct(&st->lat, 50), samplesPct(&st->lat, 90),
+           samplesPct(&st->lat, 99), samplesPct(&st->lat, 99.9), samplesPct(&st->lat, 100));
+    if (loadBadTotal(st) != 0U || st->dropped != 0U || st->stray != 0U) {
+        printf("%-16s", "");
+        for (uint32_t k = 0; k < LOAD_BAD_KINDS; k++) {
+            printf(" %s %llu", s_badNames[k], (unsigned long long)st->bad[k]);
+        }
+        printf(" dropped %llu stray %llu\n", (unsigned long long)st->dropped, (unsigned long long)st->stray);
+    }
+}
+
+static void loadJsonStats(FILE *f, const LoadStats *st, double sec)
+{
+    fprintf(f, "\"sent\": %llu, \"ok\": %llu, \"exception\": %llu, \"timeout\": %llu, "
+               "\"dropped\": %llu, \"stray_bytes\": %llu, \"tx_bytes\": %llu, \"rx_bytes\": %llu, ",
+            (unsigned long long)st->sent, (unsigned long long)st->ok, (unsigned long long)st->exception,
+            (unsigned long long)st->timeout, (unsigned long long)st->dropped, (unsigned long long)st->stray,
+            (unsigned long long)st->txBytes, (unsigned long long)st->rxBytes);
+    fprintf(f, "\"bad\": {");
+    for (uint32_t k = 0; k < LOAD_BAD_KINDS; k++) {
+        fprintf(f, "%s\"%s\": %llu", k ? ", " : "", s_badNames[k], (unsigned long long)st->bad[k]);
+    }
+    fprintf(f, "}, \"throughput_rps\": %.3f, \"line_utilisation\": %.4f, ",
+            (double)st->ok / sec, (double)(st->txBytes + st->rxBytes) * 10.0 / s_baud / sec);
+    fprintf(f, "\"latency_us\": {\"count\": %u, \"mean\": %.1f, \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, "
+               "\"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}",
+            (unsigned)st->lat.n, samplesMean(&st->lat), samplesPct(&st->lat, 0), samplesPct(&st->lat, 50),
+            samplesPct(&st->lat, 90), samplesPct(&st->lat, 99), samplesPct(&st->lat, 99.9),
+            samplesPct(&st->lat, 100));
+}
+
+static void loadJson(const char *path, LoadStats *total, double sec)
+{
+    FILE *f = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(f, "{\n  \"tool\": \"mb_load\", \"timestamp\": %lld, \"mode\": \"%s\", \"rate_per_port\": %.3f, "
+               "\"arrivals\": \"%s\", \"baud\": %u, \"duration_s\": %.3f, \"timeout_ms\": %.3f, \"gap_us\": %.1f,\n",
+            (long long)time(NULL), s_openLoop ? "open" : "closed", s_rate, s_poisson ? "poisson" : "fixed",
+            (unsigned)s_baud, sec, (double)s_timeoutNs / 1e6, (double)s_gapNs / 1e3);
+    fprintf(f, "  \"requests\": [");
+    for (uint32_t i = 0; i < s_nReqs; i++) {
+        fprintf(f, "%s{\"fc\": %u, \"start\": %u, \"qty\": %u, \"weight\": %u}", i ? ", " : "",
+                (unsigned)s_reqs[i].fc, (unsigned)s_reqs[i].start, (unsigned)s_reqs[i].qty,
+                (unsigned)s_reqs[i].weight);
+    }
+    fprintf(f, "],\n  \"total\": {");
+    loadJsonStats(f, total, sec);
+    fprintf(f, "},\n  \"ports\": [\n");
+    for (uint32_t i = 0; i < s_nPorts; i++) {
+        fprintf(f, "    {\"dev\": \"%s\", \"addr\": %u, ", s_ports[i].dev, (unsigned)s_ports[i].addr);
+        loadJsonStats(f, &s_ports[i].st, sec);
+        fprintf(f, "}%s\n", (i + 1U < s_nPorts) ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    if (f != stdout) fclose(f);
+}
+
+//=============================================================================
+// 6. 入口 (Entry)
+//=============================================================================
+
+static void loadUsage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s -p DEV[:ADDR]... [-b BAUD] [-r FC,START,QTY[,WEIGHT]]... [-R RATE] [-o] [-x]\n"
+            "          [-d SEC] [-t MS] [-g US] [-s SEED] [-j FILE] [-c FILE] [-q]\n"
+            "  -p  serial port or pty and slave address (default 1), up to %u ports\n"
+            "  -b  baud rate, 8N1 (default 115200; ignored by ptys)\n"
+            "  -r  request mix entry (default 3,0,10); QTY is the value for FC 5/6\n"
+            "  -R  target requests/s per port (closed loop: upper bound; open loop: arrival rate)\n"
+            "  -o  open loop: latency counted from the scheduled send time\n"
+            "  -x  Poisson arrivals instead of fixed intervals (open loop)\n"
+            "  -d  duration (default 10 s)   -t  response timeout (default 100 ms)\n"
+            "  -g  gap after a response before the next request (default t3.5)\n"
+            "  -j  write JSON results to FILE ('-' for stdout)   -q  no text report\n"
+            "  -c  write the line traffic to FILE as an .mbcap capture (for mb_replay)\n",
+            prog, (unsigned)LOAD_PORTS_MAX);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *json = NULL;
+    const char *capture = NULL;
+    uint8_t quiet = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:b:r:R:oxd:t:g:s:j:c:qh")) != -1) {
+        switch (opt) {
+            case 'p': {
+                if (s_nPorts >= LOAD_PORTS_MAX) loadUsage(argv[0]);
+                LoadPort *p = &s_ports[s_nPorts++];
+                char *colon = strrchr(optarg, ':');
+                p->addr = 1;
+                if (colon != NULL) {
+                    *colon = '\0';
+                    p->addr = (uint8_t)strtoul(colon + 1, NULL, 0);
+                }
+                p->dev = optarg;
+                break;
+            }
+            case 'b': s_baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'R': s_rate = atof(optarg); break;
+            case 'o': s_openLoop = 1; break;
+            case 'x': s_poisson = 1; break;
+            case 'd': s_durationNs = (uint64_t)(atof(optarg) * 1e9); break;
+            case 't': s_timeoutNs = (uint64_t)(atof(optarg) * 1e6); break;
+            case 'g': s_gapNs = (uint64_t)(atof(optarg) * 1e3); break;
+            case 's': s_seed = strtoull(optarg, NULL, 0) | 1U; break;
+            case 'j': json = optarg; break;
+            case 'c': capture = optarg; break;
+            case 'q': quiet = 1; break;
+            case 'r': {
+                unsigned fc, start, qty, weight = 1;
+                if (s_nReqs >= LOAD_REQS_MAX || sscanf(optarg, "%i,%i,%i,%i", &fc, &start, &qty, &weight) < 3
+                    || weight == 0U) {
+                    loadUsage(argv[0]);
+                }
+                s_reqs[s_nReqs++] = (LoadReq){ (uint8_t)fc, (uint16_t)start, (uint16_t)qty, weight };
+                break;
+            }
+            default:
+                loadUsage(argv[0]);
+        }
+    }
+    if (s_nPorts == 0U || loadSpeed(s_baud) == B0 || (s_openLoop && s_rate <= 0.0)) loadUsage(argv[0]);
+    if (s_nReqs == 0U) s_reqs[s_nReqs++] = (LoadReq){ 0x03, 0, 10, 1 };
+    for (uint32_t i = 0; i < s_nReqs; i++) {
+        const LoadReq *r = &s_reqs[i];
+        uint8_t okFc = (r->fc >= 0x01 && r->fc <= 0x06) || r->fc == 0x0F || r->fc == 0x10;
+        uint8_t okQty = (r->fc == 0x05 || r->fc == 0x06) || (r->qty >= 1U && r->qty <= 123U)
+                     || ((r->fc <= 0x02 || r->fc == 0x0F) && r->qty >= 1U && r->qty <= 1968U);
+        if (!okFc || !okQty) {
+            fprintf(stderr, "unsupported request %u,%u,%u\n", (unsigned)r->fc, (unsigned)r->start, (unsigned)r->qty);
+            return 2;
+        }
+        s_weightSum += r->weight;
+    }
+    /* t3.5：19200 以上固定 1750us（与固件一致） */
+    if (s_gapNs == LOAD_NEVER) s_gapNs = (s_baud > 19200U) ? 1750000ULL : 35ULL * 1000000000ULL / s_baud;
+
+    for (uint32_t i = 0; i < s_nPorts; i++) {
+        if (loadOpen(&s_ports[i]) != 0) return 1;
+    }
+
+    if (capture != NULL) {
+        s_capture = fopen(capture, "wb");
+        if (s_capture == NULL) {
+            perror(capture);
+            return 1;
+        }
+        ModbusCaptureHdr_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, MB_CAP_MAGIC, MB_CAP_MAGIC_LEN);
+        hdr.baud = s_baud;
+        hdr.role = MB_CAP_ROLE_MASTER;
+        fwrite(&hdr, sizeof(hdr), 1, s_capture);
+        s_captureT0 = loadNowNs();
+    }
+
+    loadRun();
+    if (s_capture != NULL) fclose(s_capture);
+
+    double sec = (double)s_durationNs / 1e9;
+    LoadStats total;
+    memset(&total, 0, sizeof(total));
+    for (uint32_t i = 0; i < s_nPorts; i++) loadMerge(&total, &s_ports[i].st);
+    if (!quiet) {
+        printf("%s loop, %u port(s), %u bps, %.1f s%s\n", s_openLoop ? "open" : "closed",
+               (unsigned)s_nPorts, (unsigned)s_baud, sec, s_rate > 0.0 ? "" : ", unpaced");
+        for (uint32_t i = 0; i < s_nPorts; i++) loadText(s_ports[i].dev, &s_ports[i].st, sec);
+        if (s_nPorts > 1U) loadText("total", &total, sec);
+    } else {
+        samplesSort(&total.lat);
+        for (uint32_t i = 0; i < s_nPorts; i++) {
+            samplesSort(&s_ports[i].st.lat);
+        }
+    }
+    if (json != NULL) loadJson(json, &total, sec);
+
+    uint64_t bad = loadBadTotal(&total) + total.timeout;
+    return (bad != 0U) ? 1 : 0;
+}
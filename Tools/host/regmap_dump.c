@@ -0,0 +1,68 @@
+/**
+ * @file regmap_dump.c
+ * @brief 由 app_modbus_regmap.h 生成主机端寄存器映射文件（JSON）
+ * @details
+ * 与固件展开同一个 APP_MODBUS_REGMAP 声明，上位机工具与固件的地址、权限、
+ * 换算系数不会各写一份而走样。同时检查表项按地址升序且互不重叠，
+ * 不满足时返回非 0，make 随即失败。
+ *
+ * 用法：regmap_dump > Tools/modbus_regmap.json
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "app_modbus_regmap.h"
+
+typedef struct {
+    const char *name;
+    unsigned    start;
+    unsigned    count;
+    unsigned    access;
+    const char *getter;
+    const char *setter;
+    unsigned    scale;
+    const char *unit;
+    const char *desc;
+} RegRow;
+
+#define REG_ROW(name, start, count, access, get, set, scale, unit, desc) \
+    { #name, (start), (count), (access), #get, #set, (scale), (unit), (desc) },
+
+static const RegRow s_rows[] = {
+    APP_MODBUS_REGMAP(REG_ROW)
+};
+
+static const char *accessName(unsigned access)
+{
+    switch (access) {
+    case APP_REG_RO: return "r";
+    case APP_REG_WO: return "w";
+    case APP_REG_RW: return "rw";
+    default:         return "?";
+    }
+}
+
+int main(void)
+{
+    const unsigned n = sizeof(s_rows) / sizeof(s_rows[0]);
+
+    for (unsigned i = 1; i < n; i++) {
+        if (s_rows[i].start < s_rows[i - 1].start + s_rows[i - 1].count) {
+            fprintf(stderr, "regmap_dump: %s overlaps or precedes %s\n",
+                    s_rows[i].name, s_rows[i - 1].name);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"table\": \"holding\",\n  \"registers\": [\n");
+    for (unsigned i = 0; i < n; i++) {
+        const RegRow *r = &s_rows[i];
+        printf("    {\"name\": \"%s\", \"start\": %u, \"count\": %u, \"access\": \"%s\", "
+               "\"storage\": \"%s\", \"scale\": %u, \"unit\": \"%s\", \"desc\": \"%s\"}%s\n",
+               r->name, r->start, r->count, accessName(r->access),
+               (strcmp(r->getter, "NULL") == 0) ? "plain" : "function",
+               r->scale, r->unit, r->desc, (i + 1 < n) ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file core_cm3.h
+ * @brief 主机仿真用的 Cortex-M3 内核头，替代 CMSIS 的 core_cm3.h
+ * @details
+ * stm32f103xb.h 定义完 IRQn_Type 后包含本文件；仿真构建把 Tools/host/sim/inc
+ * 放在 CMSIS 之前，固件源码一行不改。这里只提供固件实际用到的内核部分：
+ *   - DWT / CoreDebug / SysTick / SCB 寄存器（DWT->CYCCNT 由仿真时钟换算）
+ *   - PRIMASK、WFI、LDREX/STREX、屏障等内在函数（语义见 sim_core.h）
+ *   - NVIC 使能/挂起接口（由 sim_hw.c 的中断派发实现）
+ */
+
+#ifndef SIM_CORE_CM3_H
+#define SIM_CORE_CM3_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=============================================================================
+// 1. 编译器与访问限定符 (Compiler & Access Qualifiers)
+//=============================================================================
+
+#define __CM3_CMSIS_VERSION_MAIN    5U
+#define __CM3_CMSIS_VERSION_SUB     6U
+#define __CORTEX_M                  3U
+
+#define __I     volatile const
+#define __O     volatile
+#define __IO    volatile
+#define __IM    volatile const
+#define __OM    volatile
+#define __IOM   volatile
+
+#ifndef __ASM
+#define __ASM               __asm__
+#endif
+#ifndef __INLINE
+#define __INLINE            inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE     static inline
+#endif
+#ifndef __STATIC_FORCEINLINE
+#define __STATIC_FORCEINLINE static inline __attribute__((always_inline))
+#endif
+#ifndef __NO_RETURN
+#define __NO_RETURN         __attribute__((__noreturn__))
+#endif
+#ifndef __USED
+#define __USED              __attribute__((used))
+#endif
+#ifndef __WEAK
+#define __WEAK              __attribute__((weak))
+#endif
+#ifndef __PACKED
+#define __PACKED            __attribute__((packed, aligned(1)))
+#endif
+#ifndef __ALIGNED
+#define __ALIGNED(x)        __attribute__((aligned(x)))
+#endif
+
+//=============================================================================
+// 2. 内核外设寄存器 (Core Peripherals)
+//=============================================================================
+
+typedef struct
+{
+    __IOM uint32_t CTRL;
+    __IOM uint32_t LOAD;
+    __IOM uint32_t VAL;
+    __IM  uint32_t CALIB;
+} SysTick_Type;
+
+#define SysTick_CTRL_COUNTFLAG_Msk  (1UL << 16U)
+#define SysTick_CTRL_CLKSOURCE_Msk  (1UL << 2U)
+#define SysTick_CTRL_TICKINT_Msk    (1UL << 1U)
+#define SysTick_CTRL_ENABLE_Msk     (1UL)
+
+typedef struct
+{
+    __IM  uint32_t CPUID;
+    __IOM uint32_t ICSR;
+    __IOM uint32_t VTOR;
+    __IOM uint32_t AIRCR;
+    __IOM uint32_t SCR;
+    __IOM uint32_t CCR;
+} SCB_Type;
+
+#define SCB_SCR_SLEEPDEEP_Msk       (1UL << 2U)
+#define SCB_SCR_SLEEPONEXIT_Msk     (1UL << 1U)
+
+typedef struct
+{
+    __IOM uint32_t CTRL;
+    __IOM uint32_t CYCCNT;
+    __IOM uint32_t CPICNT;
+    __IOM uint32_t EXCCNT;
+    __IOM uint32_t SLEEPCNT;
+    __IOM uint32_t LSUCNT;
+    __IOM uint32_t FOLDCNT;
+    __IM  uint32_t PCSR;
+} DWT_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL)
+
+typedef struct
+{
+    __IOM uint32_t DHCSR;
+    __OM  uint32_t DCRSR;
+    __IOM uint32_t DCRDR;
+    __IOM uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24U)
+
+#include "sim_core.h"
+
+#define SysTick     (&g_simSysTick)
+#define SCB         (&g_simScb)
+#define CoreDebug   (&g_simCoreDebug)
+#define DWT         (simDwtSync())      /* 每次访问先按仿真时钟刷新 CYCCNT */
+
+//=============================================================================
+// 3. 内在函数 (Intrinsics)
+//=============================================================================
+
+__STATIC_INLINE void __disable_irq(void)                { g_simPrimask = 1U; }
+__STATIC_INLINE void __enable_irq(void)                 { simEnableIrq(); }
+__STATIC_INLINE uint32_t __get_PRIMASK(void)            { return g_simPrimask; }
+__STATIC_INLINE void __set_PRIMASK(uint32_t priMask)
+{
+    if (priMask & 1U) {
+        g_simPrimask = 1U;
+    } else {
+        simEnableIrq();
+    }
+}
+
+__STATIC_INLINE void __NOP(void)    { }
+__STATIC_INLINE void __WFI(void)    { simWfi(); }
+__STATIC_INLINE void __WFE(void)    { simWfi(); }
+__STATIC_INLINE void __SEV(void)    { }
+__STATIC_INLINE void __DSB(void)    { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+__STATIC_INLINE void __DMB(void)    { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+__STATIC_INLINE void __ISB(void)    { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+__STATIC_INLINE uint32_t __REV(uint32_t value)      { return __builtin_bswap32(value); }
+__STATIC_INLINE uint32_t __REV16(uint32_t value)
+{
+    return ((value & 0xFF00FF00UL) >> 8) | ((value & 0x00FF00FFUL) << 8);
+}
+__STATIC_INLINE uint8_t __CLZ(uint32_t value)       { return (uint8_t)(value ? __builtin_clz(value) : 32); }
+
+__STATIC_INLINE uint32_t __LDREXW(volatile uint32_t *addr)                 { return simLdrex(addr); }
+__STATIC_INLINE uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) { return simStrex(value, addr); }
+__STATIC_INLINE void __CLREX(void)                                         { simClrex(); }
+
+//=============================================================================
+// 4. NVIC (Nested Vectored Interrupt Controller)
+//=============================================================================
+
+void     NVIC_SetPriorityGrouping(uint32_t priorityGroup);
+uint32_t NVIC_GetPriorityGrouping(void);
+void     NVIC_EnableIRQ(IRQn_Type IRQn);
+void     NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetEnableIRQ(IRQn_Type IRQn);
+void     NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void     NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void     NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+__NO_RETURN void NVIC_SystemReset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_CORE_CM3_H */
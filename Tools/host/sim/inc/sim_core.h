@@ -0,0 +1,54 @@
+/**
+ * @file sim_core.h
+ * @brief 仿真内核：PRIMASK、WFI、独占访问与 DWT 周期计数
+ * @details
+ * 固件的“中断”由 sim_hw.c 在主机进程内同步派发：外设事件按仿真时钟排序推进，
+ * 有挂起且使能的中断、PRIMASK 为 0、当前不在中断中时，依优先级调用对应的
+ * xxx_IRQHandler。派发点：
+ *   - 开中断（__enable_irq / __set_PRIMASK(0)）
+ *   - WFI（PRIMASK 为 1 时只等到有中断挂起，开中断后才执行，与硬件一致）
+ *   - 访问 TIM2 / DWT 等随时间变化的寄存器
+ *   - SIGALRM（1ms）/ SIGIO（PTY 有数据）信号处理函数
+ * 因此固件看到的中断时机与硬件一样“可在任意开中断处抢占主循环”。
+ *
+ * LDREX/STREX：中断派发时清除独占监视，STREX 在其间有中断执行过时返回 1。
+ */
+
+#ifndef SIM_CORE_H
+#define SIM_CORE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile uint32_t g_simPrimask;
+extern SysTick_Type      g_simSysTick;
+extern SCB_Type          g_simScb;
+extern CoreDebug_Type    g_simCoreDebug;
+
+/**
+ * @brief 清 PRIMASK 并派发挂起的中断
+ */
+void simEnableIrq(void);
+
+/**
+ * @brief 休眠直到有中断挂起（或下一个外设事件/PTY 数据到来）
+ */
+void simWfi(void);
+
+uint32_t simLdrex(volatile uint32_t *addr);
+uint32_t simStrex(uint32_t value, volatile uint32_t *addr);
+void     simClrex(void);
+
+/**
+ * @brief 按仿真时钟刷新 CYCCNT 后返回 DWT（固件写入 CYCCNT 会重设基准）
+ */
+DWT_Type *simDwtSync(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_CORE_H */
@@ -0,0 +1,239 @@
+/**
+ * @file sim_hw.h
+ * @brief 仿真外设模型：USART + DMA、TIM2、GPIO、SysTick 与中断派发
+ * @details
+ * 外设寄存器是普通内存，固件照常读写；随时间变化的部分由模型在“推进”时更新：
+ *   USART   每个字节按字符时间（起始位 + 数据位 + 校验 + 停止位）上线，
+ *           DMA 接收写入缓冲区并递减 CNDTR，半满/满置 DMA 标志；
+ *           最后一个字节之后空闲一个字符时间置 IDLE。
+ *           发送：DMA 把最后一个字节送入 DR 时置 DMA TC，最后一个停止位移出时置 USART TC，
+ *           整帧在 TC 时刻交给输出端（PTY）。
+ *   TIM2    CNT 按 PSC 由仿真时钟换算，CCRx 到达置 CCxIF，SR 为 rc_w0，EGR 软件触发。
+ *   GPIO    BSRR/ODR 写入记录电平变化，可输出到跟踪文件。
+ *   SysTick 1ms 周期中断，节拍按仿真时钟逐个到期，不合并。
+ * 中断按电平语义：标志与使能同时为真即挂起，处理函数返回后仍为真会再次进入。
+ * 读 SR 再读 DR 清除的标志（IDLE/ORE/NE/FE/PE）在该 USART 中断返回后由模型清除。
+ *
+ * 事件按时间顺序逐个推进，遇到新挂起的中断先派发再继续，
+ * 宿主调度滞后时外设“暂停”等固件处理完，而不是把多个事件挤在一次中断里。
+ *
+ * 默认跟墙钟走（sim_main.c，PTY 联调）；simVirtualClock 之后改用虚拟时钟（bus_main.c，总线仿真）：
+ * 固件执行时间 = 线程 CPU 时间 × 系数，WFI 跳到下一个事件，推进到外部许可的时刻为止。
+ */
+
+#ifndef SIM_HW_H
+#define SIM_HW_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//=============================================================================
+// 1. 仿真外设对象 (Peripheral Objects)
+//=============================================================================
+
+#define SIM_UART_PORTS      3U      /**< USART1..USART3 */
+#define SIM_GPIO_PORTS      5U      /**< GPIOA..GPIOE */
+#define SIM_DMA1_CHANNELS   7U
+
+extern USART_TypeDef       g_simUsart[SIM_UART_PORTS];
+extern GPIO_TypeDef        g_simGpio[SIM_GPIO_PORTS];
+extern DMA_TypeDef         g_simDma1;
+extern DMA_Channel_TypeDef g_simDma1Ch[SIM_DMA1_CHANNELS];
+extern RCC_TypeDef         g_simRcc;
+extern AFIO_TypeDef        g_simAfio;
+extern FLASH_TypeDef       g_simFlash;
+extern PWR_TypeDef         g_simPwr;
+extern EXTI_TypeDef        g_simExti;
+extern TIM_TypeDef         g_simTim3;
+
+/**
+ * @brief 按仿真时钟刷新 TIM2 的 CNT/SR，处理上次写入的 SR/EGR/CR1 后返回寄存器
+ */
+TIM_TypeDef *simTim2Sync(void);
+
+#undef USART1
+#undef USART2
+#undef USART3
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef GPIOD
+#undef GPIOE
+#undef DMA1
+#undef DMA1_Channel1
+#undef DMA1_Channel2
+#undef DMA1_Channel3
+#undef DMA1_Channel4
+#undef DMA1_Channel5
+#undef DMA1_Channel6
+#undef DMA1_Channel7
+#undef RCC
+#undef AFIO
+#undef FLASH
+#undef PWR
+#undef EXTI
+#undef TIM2
+#undef TIM3
+
+#define USART1          (&g_simUsart[0])
+#define USART2          (&g_simUsart[1])
+#define USART3          (&g_simUsart[2])
+#define GPIOA           (&g_simGpio[0])
+#define GPIOB           (&g_simGpio[1])
+#define GPIOC           (&g_simGpio[2])
+#define GPIOD           (&g_simGpio[3])
+#define GPIOE           (&g_simGpio[4])
+#define DMA1            (&g_simDma1)
+#define DMA1_Channel1   (&g_simDma1Ch[0])
+#define DMA1_Channel2   (&g_simDma1Ch[1])
+#define DMA1_Channel3   (&g_simDma1Ch[2])
+#define DMA1_Channel4   (&g_simDma1Ch[3])
+#define DMA1_Channel5   (&g_simDma1Ch[4])
+#define DMA1_Channel6   (&g_simDma1Ch[5])
+#define DMA1_Channel7   (&g_simDma1Ch[6])
+#define RCC             (&g_simRcc)
+#define AFIO            (&g_simAfio)
+#define FLASH           (&g_simFlash)
+#define PWR             (&g_simPwr)
+#define EXTI            (&g_simExti)
+#define TIM2            (simTim2Sync())
+#define TIM3            (&g_simTim3)
+
+//=============================================================================
+// 2. 模型接口（供 sim_hal.c 使用）(HAL-side Model API)
+//=============================================================================
+
+/* DMA 通道的仿真侧状态：CMAR 只有 32 位，放不下主机指针 */
+typedef struct
+{
+    uint8_t *mem;       /**< 存储器地址 */
+    uint16_t size;      /**< 启动时的传输长度（循环模式重装值） */
+    uint8_t  flags;     /**< SIM_DMA_FLAG_xxx，由 HAL_DMA_IRQHandler 清除 */
+} SimDmaChannel;
+
+#define SIM_DMA_FLAG_TC     0x01U
+#define SIM_DMA_FLAG_HT     0x02U
+#define SIM_DMA_FLAG_TE     0x04U
+
+SimDmaChannel *simDmaChannel(const DMA_Channel_TypeDef *ch);
+IRQn_Type      simDmaIrq(const DMA_Channel_TypeDef *ch);
+
+/**
+ * @brief 登记 USART 句柄并按 Init 计算字符时间（HAL_UART_Init 调用）
+ */
+void simUartRegister(UART_HandleTypeDef *huart);
+
+/**
+ * @brief 开始发送（DMA：由 hdmatx 通道搬运；否则为阻塞发送）
+ */
+void simUartTxStart(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len, uint8_t dma);
+
+/**
+ * @brief 阻塞发送是否已完成（最后一个停止位已移出）
+ */
+uint8_t simUartTxIdle(const UART_HandleTypeDef *huart);
+
+/**
+ * @brief 中止正在进行的发送（HAL_UART_DMAStop）
+ */
+void simUartTxAbort(UART_HandleTypeDef *huart);
+
+void simGpioWrite(GPIO_TypeDef *port, uint16_t pins, uint8_t set);
+
+void simSysTickStart(uint32_t periodUs);
+
+/**
+ * @brief 推进外设并派发中断（不在中断中且 PRIMASK 为 0 时）
+ */
+void simService(void);
+
+//=============================================================================
+// 3. 宿主接口（供 sim_main.c 使用）(Host-side API)
+//=============================================================================
+
+/**
+ * @brief 仿真时钟（纳秒，自 simHwInit 起）
+ */
+uint64_t simNowNs(void);
+
+void simHwInit(void);
+
+/**
+ * @brief 把 USARTn（port = 0..2）绑定到一个非阻塞的文件描述符（PTY 主端）
+ * @details 读到的字节按到达时刻排队上线；发送完成的帧整帧写出
+ */
+void simUartAttach(uint32_t port, int fd);
+
+/**
+ * @brief GPIO 电平变化输出（时间戳 us、端口引脚、电平），NULL 关闭
+ */
+void simGpioTrace(FILE *out);
+
+/**
+ * @brief SIGALRM / SIGIO 处理函数
+ */
+void simSignalHandler(int sig);
+
+typedef struct
+{
+    uint32_t rxBytes;       /**< 上线的字节 */
+    uint32_t rxDropped;     /**< 接收未使能或 ORE 丢弃的字节 */
+    uint32_t txBytes;
+    uint32_t txFrames;
+    uint32_t idleEvents;
+} SimUartStats;
+
+void simUartGetStats(uint32_t port, SimUartStats *stats);
+
+/**
+ * @brief 覆盖 USARTn 的波特率（在固件 HAL_UART_Init 之前调用，固件看到的 Init.BaudRate 随之改变）
+ */
+void simUartSetBaud(uint32_t port, uint32_t baud);
+
+/**
+ * @brief 向 USARTn 的接收线注入一个字节
+ * @param startNs 起始位时刻（不早于已注入字节），字节在 startNs + 字符时间 收齐
+ * @param err     非 0 时该字节带帧错误（FE）
+ */
+void simUartInject(uint32_t port, uint8_t byte, uint8_t err, uint64_t startNs);
+
+//=============================================================================
+// 4. 虚拟时钟 (Virtual Clock)
+//=============================================================================
+
+typedef struct
+{
+    /**
+     * @brief 已推进到许可时刻 reached（不含）：交换线路数据后返回下一个许可时刻（> reached）
+     * @param earliest 固件最早可能再有动作的时刻（WFI 中为下一个外设事件，否则为 reached）
+     * @details 在钩子里用 simUartInject 注入新的接收字节
+     */
+    uint64_t (*sync)(uint64_t reached, uint64_t earliest);
+    /** 开始发送一帧：第 k 个字节的起始位在 startNs + k * charNs */
+    void (*txStart)(uint32_t port, const uint8_t *data, uint16_t len, uint64_t startNs, uint64_t charNs);
+    /** 发送被中止：只有前 sent 个字节上了线 */
+    void (*txAbort)(uint32_t port, uint16_t sent);
+    /** GPIO 电平变化（可为 NULL） */
+    void (*gpio)(uint32_t port, uint32_t pin, uint8_t level, uint64_t atNs);
+} SimVirtualHooks;
+
+/**
+ * @brief 切换到虚拟时钟（simHwInit 之后、进入固件之前调用）
+ * @param cpuScale 固件执行时间 = 宿主线程 CPU 时间 × cpuScale；0 = 固件执行不耗时
+ */
+void simVirtualClock(const SimVirtualHooks *hooks, double cpuScale);
+
+/**
+ * @brief 累计计入虚拟时钟的固件执行时间（ns）
+ */
+uint64_t simCpuNs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_HW_H */
@@ -0,0 +1,15 @@
+/**
+ * @file stm32f1xx_hal.h
+ * @brief 仿真构建的 HAL 总头：先包含真实的 HAL 头，再把外设基址换成仿真对象
+ * @details
+ * 类型、常量与 __HAL_xxx 宏全部来自 Drivers/STM32F1xx_HAL_Driver，
+ * 函数实现换成 sim_hal.c，寄存器访问落到 sim_hw.c 的外设模型上。
+ */
+
+#ifndef SIM_STM32F1XX_HAL_H
+#define SIM_STM32F1XX_HAL_H
+
+#include_next "stm32f1xx_hal.h"
+#include "sim_hw.h"
+
+#endif /* SIM_STM32F1XX_HAL_H */
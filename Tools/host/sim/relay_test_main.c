@@ -0,0 +1,43 @@
+/**
+ * @file relay_test_main.c
+ * @brief 继电器定时/排队/事件自检的主机运行器
+ * @details
+ * 与 lighting_sim 同一套固件目标文件（仿真 HAL），不启动固件主循环与 SysTick：
+ * relay_test.c 的自检自己步进 uwTick 并调用 SysTick 里的处理函数，结果可复现。
+ * 全部通过时退出码为 0，可直接用于回归（make -C Tools/host relaytest）。
+ */
+
+#include "stm32f1xx_hal.h"
+#include "relay.h"
+#include "relay_test.h"
+#include <stdio.h>
+
+typedef struct
+{
+    const char *name;
+    bool (*run)(void);
+} RelayTestCase;
+
+static const RelayTestCase s_cases[] = {
+    { "timer",        relayTimerSelfTest },
+    { "sequence",     relaySeqSelfTest },
+    { "event",        relayEventSelfTest },
+    { "direct-write", relayDirectWriteSelfTest },
+};
+
+int main(void)
+{
+    simHwInit();
+    if (relayInit() != HAL_OK) {
+        fprintf(stderr, "relaytest: relayInit failed\n");
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(s_cases) / sizeof(s_cases[0]); i++) {
+        bool ok = s_cases[i].run();
+        printf("%-14s %s\n", s_cases[i].name, ok ? "ok" : "FAIL");
+        failed += !ok;
+    }
+    return failed ? 1 : 0;
+}
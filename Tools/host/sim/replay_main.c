@@ -0,0 +1,568 @@
+/**
+ * @file replay_main.c
+ * @brief 抓包回放：把 .mbcap 中的线路字节按原时序或加速注入仿真固件，比对应答并统计时序
+ * @details
+ * 固件与 lighting_sim 相同（仿真 HAL，虚拟时钟，单进程），抓包里通道 0/1 的字节分别注入 USART1/USART2，
+ * 经 DMA、IDLE、t1.5/t3.5 帧定时进入 ModbusRTU_Process，与现场走的是同一条路径。
+ *
+ * 注入哪些字节由采集角色决定：从站抓包（固件流）注入收到的字节，本站当时的应答作为参照；
+ * 主站抓包（mb_load -c）注入请求，收到的应答作为参照。
+ * 参照字节（包括线路上别的从站的应答）不注入，但照样占用回放时间轴。
+ *
+ * 时间轴：记录按时间排序后依次映射到虚拟时间，
+ *   小于 t3.5 + 1 个字符的空隙（帧内间隙、t1.5 违例、紧贴的帧）原样保留；
+ *   更长的静默除以 -x 倍数，但不短于 t3.5 + 1 个字符；-x 0 表示全部压到这个下限。
+ * 同一通道上固件的应答还没发完（或刚发完不足 t3.5）时，下一段注入往后顺延，
+ * 顺延量带入后续整条时间轴。
+ *
+ * 每个注入帧（同一通道上间隙小于 t3.5 的若干记录）与其后、下一个注入帧之前的
+ * 参照字节和固件实际应答配对：
+ *   一致 / 不一致 / 缺应答（抓包里有、回放没有）/ 多应答（抓包里没有、回放有）。
+ * -S 只比较地址、功能码、长度与异常码（现场寄存器值与仿真初值不同时用）。
+ * 时序：回放与抓包各自的应答延时（请求最后一个停止位 → 应答起始位）分布，
+ * 回放延时超过中位数 -T 以上的列为离群，并统计比抓包慢 -T 以上的帧数。
+ * 有任何不一致时退出码为 1，可直接用于回归。
+ */
+
+#define _GNU_SOURCE
+#include "stm32f1xx_hal.h"
+#include "modbus_rtu_slave.h"
+#include "modbus_capture.h"
+#include "host_samples.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int simFirmwareMain(void);
+
+//=============================================================================
+// 1. 抓包与帧 (Capture & Frames)
+//=============================================================================
+
+#define REPLAY_CHANNELS     2U
+#define REPLAY_BOOT_NS      20000000ULL     /* 固件初始化完成之后再开始注入 */
+#define REPLAY_TAIL_NS      20000000ULL     /* 最后一段之后继续跑，等应答 */
+#define REPLAY_NONE         UINT32_MAX
+
+typedef struct
+{
+    uint64_t t;                 /**< 抓包时刻（ns，已展开回绕） */
+    uint32_t off;               /**< 数据在 s_data 中的偏移 */
+    uint32_t seq;               /**< 文件中的顺序（排序稳定） */
+    uint32_t frame;             /**< 注入记录所属的帧，参照记录为 REPLAY_NONE */
+    uint16_t len;
+    uint8_t  chan;
+    uint8_t  flags;
+    uint8_t  inject;
+} ReplayRec;
+
+typedef struct
+{
+    uint8_t  chan;
+    uint16_t reqLen;
+    uint16_t expLen;
+    uint16_t actLen;
+    uint32_t firstRec;
+    uint64_t recEnd;            /**< 抓包中请求最后一个停止位 */
+    uint64_t expStart;          /**< 抓包中第一个参照字节，UINT64_MAX = 无 */
+    uint64_t repEnd;            /**< 回放中请求最后一个停止位 */
+    uint64_t actStart;          /**< 回放中应答起始，UINT64_MAX = 无 */
+    uint8_t  req[MB_CAP_REC_MAX];
+    uint8_t  exp[MB_CAP_REC_MAX];
+    uint8_t  act[MB_CAP_REC_MAX];
+} ReplayFrame;
+
+static uint8_t     *s_data;
+static ReplayRec   *s_recs;
+static uint32_t     s_nRecs;
+static ReplayFrame *s_frames;
+static uint32_t     s_nFrames;
+static uint32_t     s_baud;
+static uint8_t      s_role = 0xFFU;
+static uint64_t     s_charNs;
+static uint64_t     s_t35Ns;
+static uint32_t     s_resyncBytes;
+static uint32_t     s_skippedRecs;
+static uint32_t     s_headers;
+
+/* 回放参数 */
+static double       s_speed = 1.0;
+static uint8_t      s_structOnly;
+static uint64_t     s_outlierNs = 500000ULL;
+static uint32_t     s_verbose = 5;
+static int          s_addr[REPLAY_CHANNELS] = { -1, -1 };
+static const char  *s_json;
+
+static int recCmp(const void *a, const void *b)
+{
+    const ReplayRec *x = a, *y = b;
+    if (x->t != y->t) return (x->t > y->t) ? 1 : -1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* 读入整个文件并切成记录：文件头可出现在任意位置（固件重启），不认识的字节逐个跳过 */
+static void replayLoad(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+    size_t cap = 1U << 20, size = 0;
+    s_data = malloc(cap);
+    for (;;) {
+        if (size == cap) s_data = realloc(s_data, cap *= 2U);
+        size_t n = fread(s_data + size, 1, cap - size, f);
+        if (n == 0U) break;
+        size += n;
+    }
+    fclose(f);
+
+    uint32_t recCap = 4096;
+    s_recs = malloc(recCap * sizeof(ReplayRec));
+    uint64_t t64 = 0, lastT = 0;
+    uint32_t prevUs = 0;
+    uint8_t havePrev = 0;
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= sizeof(ModbusCaptureHdr_t) && memcmp(&s_data[i], MB_CAP_MAGIC, MB_CAP_MAGIC_LEN) == 0) {
+            if (s_baud == 0U) s_baud = rd32(&s_data[i + 8]);
+            if (s_role == 0xFFU) s_role = s_data[i + 12];
+            s_headers++;
+            havePrev = 0;               /* 新的时间基准（固件重启）：接在已有记录之后 */
+            t64 = (s_nRecs != 0U) ? lastT + 100000000ULL : 0U;
+            i += sizeof(ModbusCaptureHdr_t);
+            continue;
+        }
+        uint16_t len = (size - i >= sizeof(ModbusCaptureRec_t))
+                     ? (uint16_t)(s_data[i + 2] | (s_data[i + 3] << 8)) : 0U;
+        if (s_data[i] != MB_CAP_SYNC || len == 0U || len > MB_CAP_REC_MAX
+            || size - i < sizeof(ModbusCaptureRec_t) + len) {
+            s_resyncBytes++;
+            i++;
+            continue;
+        }
+        uint32_t us = rd32(&s_data[i + 4]);
+        /* 相邻记录的时间差按有符号 32 位展开（两通道交错时可以略微倒退） */
+        if (havePrev) t64 += (uint64_t)(int64_t)(int32_t)(us - prevUs) * 1000U;
+        prevUs = us;
+        havePrev = 1;
+
+        uint8_t flags = s_data[i + 1];
+        if ((flags & MB_CAP_CHAN_MASK) >= REPLAY_CHANNELS) {
+            s_skippedRecs++;
+        } else {
+            if (s_nRecs == recCap) s_recs = realloc(s_recs, (recCap *= 2U) * sizeof(ReplayRec));
+            ReplayRec *r = &s_recs[s_nRecs];
+            memset(r, 0, sizeof(*r));
+            r->t = t64;
+            r->off = (uint32_t)(i + sizeof(ModbusCaptureRec_t));
+            r->seq = s_nRecs++;
+            r->len = len;
+            r->chan = flags & MB_CAP_CHAN_MASK;
+            r->flags = flags;
+        }
+        if (t64 > lastT) lastT = t64;
+        i += sizeof(ModbusCaptureRec_t) + len;
+    }
+    if (s_baud == 0U) s_baud = 115200U;
+    if (s_role == 0xFFU) s_role = MB_CAP_ROLE_SLAVE;
+
+    /* 时间可能为负（开头几条倒退）：整体平移到从 0 开始 */
+    qsort(s_recs, s_nRecs, sizeof(ReplayRec), recCmp);
+    if (s_nRecs != 0U && (int64_t)s_recs[0].t < 0) {
+        uint64_t base = s_recs[0].t;
+        for (uint32_t k = 0; k < s_nRecs; k++) s_recs[k].t -= base;
+    }
+}
+
+/* 切分注入帧，并把每帧之后的参照字节挂到该帧 */
+static void replayFrames(void)
+{
+    s_frames = calloc(s_nRecs ? s_nRecs : 1U, sizeof(ReplayFrame));
+    uint32_t open[REPLAY_CHANNELS] = { REPLAY_NONE, REPLAY_NONE };
+    for (uint32_t k = 0; k < s_nRecs; k++) {
+        ReplayRec *r = &s_recs[k];
+        uint8_t tx = (r->flags & MB_CAP_F_TX) != 0U;
+        r->inject = (s_role == MB_CAP_ROLE_SLAVE) ? !tx : tx;
+        r->frame = REPLAY_NONE;
+        ReplayFrame *f = (open[r->chan] != REPLAY_NONE) ? &s_frames[open[r->chan]] : NULL;
+        uint64_t end = r->t + r->len * s_charNs;
+        if (r->inject) {
+            if (f == NULL || f->expStart != UINT64_MAX || r->t >= f->recEnd + s_t35Ns) {
+                f = &s_frames[s_nFrames];
+                open[r->chan] = s_nFrames++;
+                f->chan = r->chan;
+                f->firstRec = k;
+                f->expStart = UINT64_MAX;
+                f->actStart = UINT64_MAX;
+            }
+            uint16_t n = (uint16_t)((f->reqLen + r->len > MB_CAP_REC_MAX) ? MB_CAP_REC_MAX - f->reqLen : r->len);
+            memcpy(&f->req[f->reqLen], &s_data[r->off], n);
+            f->reqLen += n;
+            f->recEnd = end;
+            r->frame = open[r->chan];
+        } else if (f != NULL) {
+            if (f->expStart == UINT64_MAX) f->expStart = r->t;
+            uint16_t n = (uint16_t)((f->expLen + r->len > MB_CAP_REC_MAX) ? MB_CAP_REC_MAX - f->expLen : r->len);
+            memcpy(&f->exp[f->expLen], &s_data[r->off], n);
+            f->expLen += n;
+        }
+    }
+}
+
+static void replayList(void)
+{
+    printf("%u records, role %s, %u bps\n", (unsigned)s_nRecs,
+           (s_role == MB_CAP_ROLE_MASTER) ? "master" : "slave", (unsigned)s_baud);
+    for (uint32_t k = 0; k < s_nRecs; k++) {
+        const ReplayRec *r = &s_recs[k];
+        printf("%12.1f us  ch%u %s%s ", (double)r->t / 1000.0, (unsigned)r->chan,
+               (r->flags & MB_CAP_F_TX) ? "tx" : "rx", (r->flags & MB_CAP_F_ERR) ? "!" : " ");
+        for (uint16_t b = 0; b < r->len; b++) printf(" %02X", s_data[r->off + b]);
+        printf("\n");
+    }
+}
+
+//=============================================================================
+// 2. 虚拟时间回放 (Virtual-time Replay)
+//=============================================================================
+
+static uint32_t s_cursor;               /* 下一条待处理的记录 */
+static uint64_t s_pendingAt;            /* 当前记录映射到的回放时刻，0 = 未计算 */
+static uint64_t s_busyRec;              /* 已处理记录在抓包中占线到的时刻 */
+static uint64_t s_busyRep;              /* 对应的回放时刻 */
+static uint64_t s_fwTxEnd[REPLAY_CHANNELS];
+static uint64_t s_injEnd[REPLAY_CHANNELS];
+static uint32_t s_lastFrame[REPLAY_CHANNELS] = { REPLAY_NONE, REPLAY_NONE };
+static uint64_t s_delayedNs;            /* 因固件应答未完而顺延的总量 */
+static uint32_t s_unsolicited;          /* 第一帧之前的固件发送 */
+static struct timespec s_wall0;
+
+static void replayReport(void);
+
+void __real_ModbusRTU_Init(ModbusRTU_Slave *mb, UART_HandleTypeDef *huart, uint8_t slaveAddr);
+
+/* -a 指定的从站地址替换固件里写死的 1/2 */
+void __wrap_ModbusRTU_Init(ModbusRTU_Slave *mb, UART_HandleTypeDef *huart, uint8_t slaveAddr)
+{
+    int idx = (huart->Instance == USART1) ? 0 : (huart->Instance == USART2) ? 1 : -1;
+    if (idx >= 0 && s_addr[idx] >= 0) slaveAddr = (uint8_t)s_addr[idx];
+    __real_ModbusRTU_Init(mb, huart, slaveAddr);
+}
+
+/* 当前记录在回放时间轴上的位置（见文件头说明） */
+static uint64_t replayMap(const ReplayRec *r, uint64_t reached)
+{
+    uint64_t minGap = s_t35Ns + s_charNs;
+    uint64_t at;
+    if (r->t <= s_busyRec) {
+        uint64_t back = s_busyRec - r->t;
+        at = (s_busyRep > back) ? s_busyRep - back : 0U;
+    } else {
+        uint64_t idle = r->t - s_busyRec;
+        if (idle < minGap) {
+            at = s_busyRep + idle;
+        } else {
+            uint64_t scaled = (s_speed > 0.0) ? (uint64_t)((double)idle / s_speed) : 0U;
+            at = s_busyRep + ((scaled > minGap) ? scaled : minGap);
+        }
+    }
+    if (at < reached) at = reached;
+    return at;
+}
+
+static uint64_t replaySync(uint64_t reached, uint64_t earliest)
+{
+    (void)earliest;
+    while (s_cursor < s_nRecs) {
+        const ReplayRec *r = &s_recs[s_cursor];
+        if (s_pendingAt == 0U) s_pendingAt = replayMap(r, reached);
+        uint64_t at = s_pendingAt;
+        uint64_t dur = r->len * s_charNs;
+
+        if (r->inject) {
+            /* 不打断固件自己的应答；不早于本通道已注入的字节 */
+            uint64_t free = s_fwTxEnd[r->chan] ? s_fwTxEnd[r->chan] + s_t35Ns : 0U;
+            if (free > at) {
+                s_delayedNs += free - at;
+                at = s_pendingAt = free;
+            }
+            if (s_injEnd[r->chan] > at) at = s_pendingAt = s_injEnd[r->chan];
+            if (at > reached) return at;
+
+            for (uint16_t b = 0; b < r->len; b++) {
+                uint8_t err = (r->flags & MB_CAP_F_ERR) && b + 1U == r->len;
+                simUartInject(r->chan, s_data[r->off + b], err, at + b * s_charNs);
+            }
+            s_injEnd[r->chan] = at + dur;
+            ReplayFrame *f = &s_frames[r->frame];
+            f->repEnd = at + dur;
+            s_lastFrame[r->chan] = r->frame;
+        }
+        if (r->t + dur > s_busyRec) s_busyRec = r->t + dur;
+        if (at + dur > s_busyRep) s_busyRep = at + dur;
+        s_pendingAt = 0;
+        s_cursor++;
+    }
+
+    uint64_t done = s_busyRep;
+    for (uint32_t c = 0; c < REPLAY_CHANNELS; c++) {
+        if (s_fwTxEnd[c] > done) done = s_fwTxEnd[c];
+    }
+    done += REPLAY_TAIL_NS;
+    if (reached >= done) {
+        replayReport();
+        /* 不返回固件 */
+    }
+    return done;
+}
+
+static void replayTxStart(uint32_t port, const uint8_t *data, uint16_t len, uint64_t startNs, uint64_t charNs)
+{
+    if (port >= REPLAY_CHANNELS) return;
+    s_fwTxEnd[port] = startNs + len * charNs;
+    uint32_t fi = s_lastFrame[port];
+    if (fi == REPLAY_NONE) {
+        s_unsolicited++;
+        return;
+    }
+    ReplayFrame *f = &s_frames[fi];
+    if (f->actStart == UINT64_MAX) f->actStart = startNs;
+    uint16_t n = (uint16_t)((f->actLen + len > MB_CAP_REC_MAX) ? MB_CAP_REC_MAX - f->actLen : len);
+    memcpy(&f->act[f->actLen], data, n);
+    f->actLen += n;
+}
+
+static void replayTxAbort(uint32_t port, uint16_t sent)
+{
+    if (port >= REPLAY_CHANNELS || s_lastFrame[port] == REPLAY_NONE) return;
+    ReplayFrame *f = &s_frames[s_lastFrame[port]];
+    if (sent < f->actLen) f->actLen = sent;
+}
+
+//=============================================================================
+// 3. 比对与报告 (Compare & Report)
+//=============================================================================
+
+typedef enum
+{
+    REPLAY_SILENT = 0,          /* 双方都无应答（广播、别的从站的帧） */
+    REPLAY_MATCH,
+    REPLAY_MISMATCH,
+    REPLAY_MISSING,
+    REPLAY_EXTRA,
+    REPLAY_VERDICTS
+} ReplayVerdict;
+
+static const char *const s_verdictNames[REPLAY_VERDICTS] = { "silent", "match", "mismatch", "missing", "extra" };
+
+static ReplayVerdict replayJudge(const ReplayFrame *f)
+{
+    if (f->expLen == 0U) return (f->actLen == 0U) ? REPLAY_SILENT : REPLAY_EXTRA;
+    if (f->actLen == 0U) return REPLAY_MISSING;
+    if (f->expLen != f->actLen) return REPLAY_MISMATCH;
+    if (!s_structOnly) return (memcmp(f->exp, f->act, f->expLen) == 0) ? REPLAY_MATCH : REPLAY_MISMATCH;
+    /* 结构比较：地址、功能码（含异常位）、异常码 */
+    if (f->exp[0] != f->act[0] || (f->expLen >= 2U && f->exp[1] != f->act[1])) return REPLAY_MISMATCH;
+    if (f->expLen >= 3U && (f->exp[1] & 0x80U) && f->exp[2] != f->act[2]) return REPLAY_MISMATCH;
+    return REPLAY_MATCH;
+}
+
+static void replayHex(const char *label, const uint8_t *p, uint16_t n)
+{
+    printf("    %-9s", label);
+    if (n == 0U) printf(" (none)");
+    for (uint16_t i = 0; i < n && i < 32U; i++) printf(" %02X", p[i]);
+    if (n > 32U) printf(" ... (%u bytes)", (unsigned)n);
+    printf("\n");
+}
+
+static void replayReport(void)
+{
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double wall = (double)(t1.tv_sec - s_wall0.tv_sec) + (double)(t1.tv_nsec - s_wall0.tv_nsec) / 1e9;
+
+    uint32_t count[REPLAY_VERDICTS] = { 0 };
+    Samples rep = { 0 }, rec = { 0 };
+    uint32_t slower = 0, shown = 0;
+    for (uint32_t i = 0; i < s_nFrames; i++) {
+        const ReplayFrame *f = &s_frames[i];
+        ReplayVerdict v = replayJudge(f);
+        count[v]++;
+        if (f->actStart != UINT64_MAX && f->actStart >= f->repEnd) samplesAdd(&rep, f->actStart - f->repEnd);
+        if (f->expStart != UINT64_MAX && f->expStart >= f->recEnd) samplesAdd(&rec, f->expStart - f->recEnd);
+        if (f->actStart != UINT64_MAX && f->expStart != UINT64_MAX && f->actStart >= f->repEnd
+            && f->expStart >= f->recEnd
+            && (f->actStart - f->repEnd) > (f->expStart - f->recEnd) + s_outlierNs) {
+            slower++;
+        }
+        if (v >= REPLAY_MISMATCH && shown < s_verbose) {
+            if (shown++ == 0U) printf("divergences:\n");
+            printf("  frame %u ch%u at %.3f ms: %s\n", (unsigned)i, (unsigned)f->chan,
+                   (double)s_recs[f->firstRec].t / 1e6, s_verdictNames[v]);
+            replayHex("request", f->req, f->reqLen);
+            replayHex("captured", f->exp, f->expLen);
+            replayHex("replayed", f->act, f->actLen);
+        }
+    }
+    samplesSort(&rep);
+    samplesSort(&rec);
+
+    uint64_t span = (s_nRecs != 0U) ? s_recs[s_nRecs - 1U].t - s_recs[0].t : 0U;
+    uint64_t vspan = s_busyRep - REPLAY_BOOT_NS;
+    uint32_t diverged = count[REPLAY_MISMATCH] + count[REPLAY_MISSING] + count[REPLAY_EXTRA];
+
+    char speed[32];
+    if (s_speed > 0.0) snprintf(speed, sizeof(speed), "%.1fx", s_speed);
+    else snprintf(speed, sizeof(speed), "t3.5 gaps");
+    printf("replay: %u records (%u frames injected), role %s, %u bps, speed %s\n",
+           (unsigned)s_nRecs, (unsigned)s_nFrames, (s_role == MB_CAP_ROLE_MASTER) ? "master" : "slave",
+           (unsigned)s_baud, speed);
+    if (s_resyncBytes || s_skippedRecs || s_headers > 1U) {
+        printf("input: %u bytes skipped to resync, %u records on other channels, %u headers\n",
+               (unsigned)s_resyncBytes, (unsigned)s_skippedRecs, (unsigned)s_headers);
+    }
+    printf("time: captured %.3f s -> virtual %.3f s in %.2f s wall (%.1f frames/s, %.1fx real time)",
+           (double)span / 1e9, (double)vspan / 1e9, wall, (double)s_nFrames / wall,
+           (double)vspan / 1e9 / wall);
+    if (s_delayedNs != 0U) printf(", %.1f ms pushed back behind responses", (double)s_delayedNs / 1e6);
+    printf("\nresponses: %u match, %u mismatch, %u missing, %u extra, %u silent%s",
+           (unsigned)count[REPLAY_MATCH], (unsigned)count[REPLAY_MISMATCH], (unsigned)count[REPLAY_MISSING],
+           (unsigned)count[REPLAY_EXTRA], (unsigned)count[REPLAY_SILENT], s_structOnly ? " (structure only)" : "");
+    if (s_unsolicited) printf(", %u unsolicited", (unsigned)s_unsolicited);
+    printf("\nturnaround us   replay:   min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f (%u)\n",
+           samplesPct(&rep, 0), samplesPct(&rep, 50), samplesPct(&rep, 90), samplesPct(&rep, 99),
+           samplesPct(&rep, 100), (unsigned)rep.n);
+    printf("                captured: min %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f (%u)\n",
+           samplesPct(&rec, 0), samplesPct(&rec, 50), samplesPct(&rec, 90), samplesPct(&rec, 99),
+           samplesPct(&rec, 100), (unsigned)rec.n);
+
+    /* 离群：回放延时超过中位数 -T 以上，按延时从大到小列出 */
+    uint64_t limit = (rep.n ? rep.v[(rep.n - 1U) / 2U] : 0U) + s_outlierNs;
+    uint32_t outliers = 0;
+    for (uint32_t i = 0; i < rep.n; i++) outliers += (rep.v[i] > limit);
+    printf("outliers: %u above p50 + %.0f us, %u slower than captured by > %.0f us\n",
+           (unsigned)outliers, (double)s_outlierNs / 1000.0, (unsigned)slower, (double)s_outlierNs / 1000.0);
+    for (uint32_t shownOut = 0; shownOut < outliers && shownOut < s_verbose; shownOut++) {
+        uint64_t want = rep.v[rep.n - 1U - shownOut];
+        for (uint32_t i = 0; i < s_nFrames; i++) {
+            const ReplayFrame *f = &s_frames[i];
+            if (f->actStart == UINT64_MAX || f->actStart < f->repEnd || f->actStart - f->repEnd != want) continue;
+            printf("  frame %u ch%u fc %02X at %.3f ms: %.1f us", (unsigned)i, (unsigned)f->chan,
+                   (unsigned)(f->reqLen > 1U ? f->req[1] : 0U), (double)s_recs[f->firstRec].t / 1e6,
+                   (double)want / 1000.0);
+            if (f->expStart != UINT64_MAX && f->expStart >= f->recEnd) {
+                printf(" (captured %.1f us)", (double)(f->expStart - f->recEnd) / 1000.0);
+            }
+            printf("\n");
+            break;
+        }
+    }
+
+    if (s_json != NULL) {
+        FILE *f = (strcmp(s_json, "-") == 0) ? stdout : fopen(s_json, "w");
+        if (f != NULL) {
+            fprintf(f, "{\"tool\": \"mb_replay\", \"records\": %u, \"frames\": %u, \"speed\": %.3f, "
+                       "\"captured_s\": %.6f, \"virtual_s\": %.6f, \"wall_s\": %.3f, \"frames_per_s\": %.1f, ",
+                    (unsigned)s_nRecs, (unsigned)s_nFrames, s_speed, (double)span / 1e9, (double)vspan / 1e9,
+                    wall, (double)s_nFrames / wall);
+            for (uint32_t v = 0; v < REPLAY_VERDICTS; v++) {
+                fprintf(f, "\"%s\": %u, ", s_verdictNames[v], (unsigned)count[v]);
+            }
+            fprintf(f, "\"turnaround_us\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+                       "\"captured_turnaround_us\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+                       "\"outliers\": %u, \"slower_than_captured\": %u}\n",
+                    samplesPct(&rep, 50), samplesPct(&rep, 99), samplesPct(&rep, 100),
+                    samplesPct(&rec, 50), samplesPct(&rec, 99), samplesPct(&rec, 100),
+                    (unsigned)outliers, (unsigned)slower);
+            if (f != stdout) fclose(f);
+        }
+    }
+    fflush(stdout);
+    exit(diverged ? 1 : 0);
+}
+
+//=============================================================================
+// 4. 入口 (Entry)
+//=============================================================================
+
+static void replayUsage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-x SPEED] [-S] [-T US] [-a ADDR1[,ADDR2]] [-b BAUD] [-r slave|master]\n"
+            "          [-k SCALE] [-v N] [-j FILE] [-l] CAPTURE.mbcap\n"
+            "  -x  silence longer than t3.5 is divided by SPEED (default 1 = as captured, 0 = t3.5 only)\n"
+            "  -S  compare responses by address/function/length/exception only\n"
+            "  -T  outlier threshold above the median turnaround (default 500 us)\n"
+            "  -a  slave addresses of USART1/USART2 (default: firmware's 1 and 2)\n"
+            "  -b  line speed when the capture has no header (default 115200)\n"
+            "  -r  capture role when the capture has no header (default slave)\n"
+            "  -k  firmware time = host CPU time x SCALE (default 40, 0 = free)\n"
+            "  -v  divergences / outliers to print (default 5)\n"
+            "  -j  write a JSON summary to FILE ('-' for stdout)\n"
+            "  -l  list records and exit\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    double cpuScale = 40.0;
+    uint8_t list = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "x:ST:a:b:r:k:v:j:lh")) != -1) {
+        switch (opt) {
+            case 'x': s_speed = atof(optarg); break;
+            case 'S': s_structOnly = 1; break;
+            case 'T': s_outlierNs = (uint64_t)(atof(optarg) * 1e3); break;
+            case 'a':
+                if (sscanf(optarg, "%i,%i", &s_addr[0], &s_addr[1]) < 1) replayUsage(argv[0]);
+                break;
+            case 'b': s_baud = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'r':
+                if (strcmp(optarg, "slave") == 0) s_role = MB_CAP_ROLE_SLAVE;
+                else if (strcmp(optarg, "master") == 0) s_role = MB_CAP_ROLE_MASTER;
+                else replayUsage(argv[0]);
+                break;
+            case 'k': cpuScale = atof(optarg); break;
+            case 'v': s_verbose = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'j': s_json = optarg; break;
+            case 'l': list = 1; break;
+            default:
+                replayUsage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc || s_speed < 0.0) replayUsage(argv[0]);
+
+    replayLoad(argv[optind]);
+    /* 与固件相同：8N1 = 10 位；19200 以上 t3.5 固定 1750us */
+    s_charNs = 10ULL * 1000000000ULL / s_baud;
+    s_t35Ns = (s_baud > 19200U) ? (uint64_t)MB_T35_FIXED_US * 1000U : s_charNs * 35U / 10U;
+    if (list) {
+        replayList();
+        return 0;
+    }
+    replayFrames();
+    if (s_nFrames == 0U) {
+        fprintf(stderr, "%s: nothing to inject\n", argv[optind]);
+        return 2;
+    }
+
+    s_busyRec = s_recs[0].t;
+    s_busyRep = REPLAY_BOOT_NS;
+    static const SimVirtualHooks hooks = { replaySync, replayTxStart, replayTxAbort, NULL };
+    simHwInit();
+    for (uint32_t c = 0; c < REPLAY_CHANNELS; c++) simUartSetBaud(c, s_baud);
+    simVirtualClock(&hooks, cpuScale);
+    clock_gettime(CLOCK_MONOTONIC, &s_wall0);
+    return simFirmwareMain();
+}
@@ -0,0 +1,520 @@
+/**
+ * @file sim_hal.c
+ * @brief 仿真构建的 HAL 函数：固件用到的 RCC/GPIO/NVIC/DMA/UART/时基子集
+ * @details
+ * 状态机与回调顺序照搬 Drivers/STM32F1xx_HAL_Driver 的对应实现（F1 HAL 1.1.x），
+ * 只把寄存器搬运换成 sim_hw.c 的模型：
+ *   - DMA 的存储器地址保存在 SimDmaChannel（CMAR 放不下主机指针），
+ *     中断标志由模型置位、HAL_DMA_IRQHandler 清除
+ *   - UART 发送由模型按字符时间完成，DMA 完成后改开 TC 中断，与真实 HAL 一致
+ * 未用到的 HAL 接口不提供，链接报错即说明固件开始依赖新的外设，需要在这里补模型。
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+
+//=============================================================================
+// 1. 时基与系统 (Time Base & System)
+//=============================================================================
+
+uint32_t SystemCoreClock = 72000000U;
+const uint8_t AHBPrescTable[16U] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 6, 7, 8, 9};
+const uint8_t APBPrescTable[8U]  = {0, 0, 0, 0, 1, 2, 3, 4};
+
+__IO uint32_t uwTick;
+uint32_t uwTickPrio = (1UL << __NVIC_PRIO_BITS);
+HAL_TickFreqTypeDef uwTickFreq = HAL_TICK_FREQ_DEFAULT;
+
+void SystemInit(void) { }
+void SystemCoreClockUpdate(void) { }
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+    HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_4);
+    HAL_InitTick(TICK_INT_PRIORITY);
+    HAL_MspInit();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+    NVIC_SetPriority(SysTick_IRQn, TickPriority << (8U - __NVIC_PRIO_BITS));
+    uwTickPrio = TickPriority;
+    simSysTickStart(1000U * (uint32_t)uwTickFreq);
+    return HAL_OK;
+}
+
+__weak void HAL_MspInit(void) { }
+__weak void HAL_MspDeInit(void) { }
+
+void HAL_IncTick(void)
+{
+    uwTick += (uint32_t)uwTickFreq;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    simService();
+    return uwTick;
+}
+
+uint32_t HAL_GetTickPrio(void)
+{
+    return uwTickPrio;
+}
+
+HAL_TickFreqTypeDef HAL_GetTickFreq(void)
+{
+    return uwTickFreq;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    uint32_t tickstart = HAL_GetTick();
+    uint32_t wait = Delay;
+    if (wait < HAL_MAX_DELAY) wait += (uint32_t)uwTickFreq;
+    while ((HAL_GetTick() - tickstart) < wait) {
+        simWfi();
+    }
+}
+
+void HAL_SuspendTick(void) { }
+void HAL_ResumeTick(void) { }
+
+//=============================================================================
+// 2. RCC 与 NVIC (RCC & NVIC)
+//=============================================================================
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+    (void)RCC_OscInitStruct;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+    (void)FLatency;
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_HPRE | RCC_CFGR_PPRE1 | RCC_CFGR_PPRE2,
+               RCC_ClkInitStruct->AHBCLKDivider | RCC_ClkInitStruct->APB1CLKDivider
+               | (RCC_ClkInitStruct->APB2CLKDivider << 3U));
+    return HAL_OK;
+}
+
+uint32_t HAL_RCC_GetSysClockFreq(void) { return SystemCoreClock; }
+uint32_t HAL_RCC_GetHCLKFreq(void)     { return SystemCoreClock; }
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+    return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos];
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+    return SystemCoreClock >> APBPrescTable[(RCC->CFGR & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos];
+}
+
+void HAL_NVIC_SetPriorityGrouping(uint32_t PriorityGroup)
+{
+    NVIC_SetPriorityGrouping(PriorityGroup);
+}
+
+/* 仿真按 (抢占 << 4 | 子优先级) 比较，数值小者先派发 */
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    NVIC_SetPriority(IRQn, ((PreemptPriority & 0x0FU) << 4U) | (SubPriority & 0x0FU));
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)         { NVIC_EnableIRQ(IRQn); }
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)        { NVIC_DisableIRQ(IRQn); }
+void HAL_NVIC_SetPendingIRQ(IRQn_Type IRQn)     { NVIC_SetPendingIRQ(IRQn); }
+void HAL_NVIC_ClearPendingIRQ(IRQn_Type IRQn)   { NVIC_ClearPendingIRQ(IRQn); }
+void HAL_NVIC_SystemReset(void)                 { NVIC_SystemReset(); }
+
+uint32_t HAL_SYSTICK_Config(uint32_t TicksNumb)
+{
+    simSysTickStart((uint32_t)((uint64_t)TicksNumb * 1000000U / SystemCoreClock));
+    return 0U;
+}
+
+//=============================================================================
+// 3. GPIO (GPIO)
+//=============================================================================
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+    simGpioWrite(GPIOx, (uint16_t)GPIO_Pin, 0);
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    simGpioWrite(GPIOx, GPIO_Pin, PinState != GPIO_PIN_RESET);
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    uint32_t odr = GPIOx->ODR;
+    simGpioWrite(GPIOx, (uint16_t)(odr & GPIO_Pin), 0);
+    simGpioWrite(GPIOx, (uint16_t)(~odr & GPIO_Pin), 1);
+}
+
+//=============================================================================
+// 4. DMA (DMA)
+//=============================================================================
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    if (hdma == NULL) return HAL_ERROR;
+
+    hdma->ChannelIndex = (uint32_t)(hdma->Instance - DMA1_Channel1) * 4U;
+    hdma->DmaBaseAddress = DMA1;
+    hdma->Instance->CCR = hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc
+                        | hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment
+                        | hdma->Init.Mode | hdma->Init.Priority;
+    simDmaChannel(hdma->Instance)->flags = 0;
+
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_READY;
+    hdma->Lock = HAL_UNLOCKED;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+    if (hdma == NULL) return HAL_ERROR;
+
+    hdma->Instance->CCR = 0;
+    hdma->Instance->CNDTR = 0;
+    simDmaChannel(hdma->Instance)->flags = 0;
+    hdma->XferCpltCallback = NULL;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferErrorCallback = NULL;
+    hdma->XferAbortCallback = NULL;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_RESET;
+    hdma->Lock = HAL_UNLOCKED;
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef simDmaStart(DMA_HandleTypeDef *hdma, uint8_t *mem, uint16_t len)
+{
+    if (hdma->State != HAL_DMA_STATE_READY) return HAL_BUSY;
+
+    hdma->State = HAL_DMA_STATE_BUSY;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+
+    DMA_Channel_TypeDef *ch = hdma->Instance;
+    SimDmaChannel *c = simDmaChannel(ch);
+    ch->CCR &= ~DMA_CCR_EN;
+    c->mem = mem;
+    c->size = len;
+    c->flags = 0;
+    ch->CNDTR = len;
+
+    uint32_t it = DMA_IT_TC | DMA_IT_TE;
+    if (hdma->XferHalfCpltCallback != NULL) it |= DMA_IT_HT;
+    ch->CCR = (ch->CCR & ~DMA_IT_HT) | it | DMA_CCR_EN;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    if (hdma->State != HAL_DMA_STATE_BUSY) {
+        hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+        return HAL_ERROR;
+    }
+    hdma->Instance->CCR &= ~(DMA_IT_TC | DMA_IT_HT | DMA_IT_TE | DMA_CCR_EN);
+    simDmaChannel(hdma->Instance)->flags = 0;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort_IT(DMA_HandleTypeDef *hdma)
+{
+    HAL_StatusTypeDef st = HAL_DMA_Abort(hdma);
+    if (st == HAL_OK && hdma->XferAbortCallback != NULL) {
+        hdma->XferAbortCallback(hdma);
+    }
+    return st;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+    DMA_Channel_TypeDef *ch = hdma->Instance;
+    SimDmaChannel *c = simDmaChannel(ch);
+    uint32_t ccr = ch->CCR;
+
+    if ((c->flags & SIM_DMA_FLAG_HT) && (ccr & DMA_IT_HT)) {
+        if (!(ccr & DMA_CCR_CIRC)) ch->CCR &= ~DMA_IT_HT;
+        c->flags &= (uint8_t)~SIM_DMA_FLAG_HT;
+        if (hdma->XferHalfCpltCallback != NULL) hdma->XferHalfCpltCallback(hdma);
+    } else if ((c->flags & SIM_DMA_FLAG_TC) && (ccr & DMA_IT_TC)) {
+        if (!(ccr & DMA_CCR_CIRC)) {
+            ch->CCR &= ~(DMA_IT_TE | DMA_IT_TC);
+            hdma->State = HAL_DMA_STATE_READY;
+        }
+        c->flags &= (uint8_t)~SIM_DMA_FLAG_TC;
+        if (hdma->XferCpltCallback != NULL) hdma->XferCpltCallback(hdma);
+    } else if ((c->flags & SIM_DMA_FLAG_TE) && (ccr & DMA_IT_TE)) {
+        ch->CCR &= ~(DMA_IT_TC | DMA_IT_HT | DMA_IT_TE);
+        c->flags = 0;
+        hdma->ErrorCode = HAL_DMA_ERROR_TE;
+        hdma->State = HAL_DMA_STATE_READY;
+        if (hdma->XferErrorCallback != NULL) hdma->XferErrorCallback(hdma);
+    }
+}
+
+//=============================================================================
+// 5. UART (UART)
+//=============================================================================
+
+__weak void HAL_UART_MspInit(UART_HandleTypeDef *huart)               { (void)huart; }
+__weak void HAL_UART_MspDeInit(UART_HandleTypeDef *huart)             { (void)huart; }
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)        { (void)huart; }
+__weak void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart)    { (void)huart; }
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)        { (void)huart; }
+__weak void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)    { (void)huart; }
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)         { (void)huart; }
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    if (huart == NULL) return HAL_ERROR;
+
+    if (huart->gState == HAL_UART_STATE_RESET) {
+        huart->Lock = HAL_UNLOCKED;
+        HAL_UART_MspInit(huart);
+    }
+    huart->gState = HAL_UART_STATE_BUSY;
+
+    USART_TypeDef *r = huart->Instance;
+    r->CR1 = huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode | USART_CR1_UE;
+    r->CR2 = huart->Init.StopBits;
+    r->CR3 = huart->Init.HwFlowCtl;
+    r->BRR = HAL_RCC_GetPCLK2Freq() / huart->Init.BaudRate;    /* 只作记录，字符时间按 BaudRate 计算 */
+    simUartRegister(huart);
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DeInit(UART_HandleTypeDef *huart)
+{
+    if (huart == NULL) return HAL_ERROR;
+
+    huart->gState = HAL_UART_STATE_BUSY;
+    huart->Instance->CR1 &= ~USART_CR1_UE;
+    HAL_UART_MspDeInit(huart);
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_RESET;
+    huart->RxState = HAL_UART_STATE_RESET;
+    huart->Lock = HAL_UNLOCKED;
+    return HAL_OK;
+}
+
+static void simUartEndRxTransfer(UART_HandleTypeDef *huart)
+{
+    huart->Instance->CR1 &= ~(USART_CR1_RXNEIE | USART_CR1_PEIE);
+    huart->Instance->CR3 &= ~USART_CR3_EIE;
+    huart->RxState = HAL_UART_STATE_READY;
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+}
+
+static void simUartDmaReceiveCplt(DMA_HandleTypeDef *hdma)
+{
+    UART_HandleTypeDef *huart = (UART_HandleTypeDef *)hdma->Parent;
+    if (!(hdma->Instance->CCR & DMA_CCR_CIRC)) {
+        huart->RxXferCount = 0U;
+        huart->Instance->CR1 &= ~USART_CR1_PEIE;
+        huart->Instance->CR3 &= ~(USART_CR3_EIE | USART_CR3_DMAR);
+        huart->RxState = HAL_UART_STATE_READY;
+    }
+    HAL_UART_RxCpltCallback(huart);
+}
+
+static void simUartDmaRxHalfCplt(DMA_HandleTypeDef *hdma)
+{
+    HAL_UART_RxHalfCpltCallback((UART_HandleTypeDef *)hdma->Parent);
+}
+
+static void simUartDmaTransmitCplt(DMA_HandleTypeDef *hdma)
+{
+    UART_HandleTypeDef *huart = (UART_HandleTypeDef *)hdma->Parent;
+    if (!(hdma->Instance->CCR & DMA_CCR_CIRC)) {
+        huart->TxXferCount = 0U;
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        huart->Instance->CR1 |= USART_CR1_TCIE;     /* 等最后一个停止位移出 */
+    } else {
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
+
+static void simUartDmaTxHalfCplt(DMA_HandleTypeDef *hdma)
+{
+    HAL_UART_TxHalfCpltCallback((UART_HandleTypeDef *)hdma->Parent);
+}
+
+static void simUartDmaError(DMA_HandleTypeDef *hdma)
+{
+    UART_HandleTypeDef *huart = (UART_HandleTypeDef *)hdma->Parent;
+    huart->RxXferCount = 0U;
+    huart->TxXferCount = 0U;
+    huart->ErrorCode |= HAL_UART_ERROR_DMA;
+    HAL_UART_ErrorCallback(huart);
+}
+
+static void simUartDmaAbortOnError(DMA_HandleTypeDef *hdma)
+{
+    UART_HandleTypeDef *huart = (UART_HandleTypeDef *)hdma->Parent;
+    huart->RxXferCount = 0U;
+    huart->TxXferCount = 0U;
+    HAL_UART_ErrorCallback(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+    if (huart->RxState != HAL_UART_STATE_READY) return HAL_BUSY;
+    if (pData == NULL || Size == 0U) return HAL_ERROR;
+
+    huart->ReceptionType = HAL_UART_RECEPTION_STANDARD;
+    huart->pRxBuffPtr = pData;
+    huart->RxXferSize = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+
+    huart->hdmarx->XferCpltCallback = simUartDmaReceiveCplt;
+    huart->hdmarx->XferHalfCpltCallback = simUartDmaRxHalfCplt;
+    huart->hdmarx->XferErrorCallback = simUartDmaError;
+    huart->hdmarx->XferAbortCallback = NULL;
+    simDmaStart(huart->hdmarx, pData, Size);
+
+    huart->Instance->SR &= ~USART_SR_ORE;
+    if (huart->Init.Parity != UART_PARITY_NONE) huart->Instance->CR1 |= USART_CR1_PEIE;
+    huart->Instance->CR3 |= USART_CR3_EIE | USART_CR3_DMAR;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size)
+{
+    if (huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+    if (pData == NULL || Size == 0U) return HAL_ERROR;
+
+    huart->pTxBuffPtr = pData;
+    huart->TxXferSize = Size;
+    huart->TxXferCount = Size;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+
+    huart->hdmatx->XferCpltCallback = simUartDmaTransmitCplt;
+    huart->hdmatx->XferHalfCpltCallback = simUartDmaTxHalfCplt;
+    huart->hdmatx->XferErrorCallback = simUartDmaError;
+    huart->hdmatx->XferAbortCallback = NULL;
+    simDmaStart(huart->hdmatx, (uint8_t *)pData, Size);
+
+    simUartTxStart(huart, pData, Size, 1);          /* 同时清 TC 标志 */
+    huart->Instance->CR3 |= USART_CR3_DMAT;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    if (huart->gState != HAL_UART_STATE_READY) return HAL_BUSY;
+    if (pData == NULL || Size == 0U) return HAL_ERROR;
+
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    uint32_t tickstart = HAL_GetTick();
+    simUartTxStart(huart, pData, Size, 0);
+    while (!simUartTxIdle(huart)) {
+        if (Timeout != HAL_MAX_DELAY && (HAL_GetTick() - tickstart) > Timeout) {
+            simUartTxAbort(huart);
+            huart->gState = HAL_UART_STATE_READY;
+            return HAL_TIMEOUT;
+        }
+        simWfi();
+    }
+    huart->gState = HAL_UART_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart)
+{
+    if ((huart->Instance->CR3 & USART_CR3_DMAT) && huart->gState == HAL_UART_STATE_BUSY_TX) {
+        huart->Instance->CR3 &= ~USART_CR3_DMAT;
+        if (huart->hdmatx != NULL) HAL_DMA_Abort(huart->hdmatx);
+        simUartTxAbort(huart);
+        huart->Instance->CR1 &= ~(USART_CR1_TXEIE | USART_CR1_TCIE);
+        huart->gState = HAL_UART_STATE_READY;
+    }
+    if ((huart->Instance->CR3 & USART_CR3_DMAR) && huart->RxState == HAL_UART_STATE_BUSY_RX) {
+        huart->Instance->CR3 &= ~USART_CR3_DMAR;
+        if (huart->hdmarx != NULL) HAL_DMA_Abort(huart->hdmarx);
+        simUartEndRxTransfer(huart);
+    }
+    return HAL_OK;
+}
+
+void HAL_UART_IRQHandler(UART_HandleTypeDef *huart)
+{
+    uint32_t isrflags = huart->Instance->SR;
+    uint32_t cr1its   = huart->Instance->CR1;
+    uint32_t cr3its   = huart->Instance->CR3;
+    uint32_t errorflags = isrflags & (USART_SR_PE | USART_SR_FE | USART_SR_ORE | USART_SR_NE);
+
+    if (errorflags == 0U && (isrflags & USART_SR_RXNE) && (cr1its & USART_CR1_RXNEIE)) {
+        (void)huart->Instance->DR;                  /* 不支持中断方式接收，丢弃 */
+        return;
+    }
+
+    if (errorflags != 0U && ((cr3its & USART_CR3_EIE) || (cr1its & (USART_CR1_RXNEIE | USART_CR1_PEIE)))) {
+        if ((isrflags & USART_SR_PE) && (cr1its & USART_CR1_PEIE)) huart->ErrorCode |= HAL_UART_ERROR_PE;
+        if ((isrflags & USART_SR_NE) && (cr3its & USART_CR3_EIE))  huart->ErrorCode |= HAL_UART_ERROR_NE;
+        if ((isrflags & USART_SR_FE) && (cr3its & USART_CR3_EIE))  huart->ErrorCode |= HAL_UART_ERROR_FE;
+        if ((isrflags & USART_SR_ORE) && ((cr1its & USART_CR1_RXNEIE) || (cr3its & USART_CR3_EIE))) {
+            huart->ErrorCode |= HAL_UART_ERROR_ORE;
+        }
+
+        if (huart->ErrorCode != HAL_UART_ERROR_NONE) {
+            uint32_t dmarequest = huart->Instance->CR3 & USART_CR3_DMAR;
+            if ((huart->ErrorCode & HAL_UART_ERROR_ORE) || dmarequest) {
+                /* 阻塞性错误：结束接收并中止 DMA，中止完成后回调错误 */
+                simUartEndRxTransfer(huart);
+                if (huart->Instance->CR3 & USART_CR3_DMAR) {
+                    huart->Instance->CR3 &= ~USART_CR3_DMAR;
+                    if (huart->hdmarx != NULL) {
+                        huart->hdmarx->XferAbortCallback = simUartDmaAbortOnError;
+                        if (HAL_DMA_Abort_IT(huart->hdmarx) != HAL_OK) {
+                            huart->hdmarx->XferAbortCallback(huart->hdmarx);
+                        }
+                    } else {
+                        HAL_UART_ErrorCallback(huart);
+                    }
+                } else {
+                    HAL_UART_ErrorCallback(huart);
+                }
+            } else {
+                HAL_UART_ErrorCallback(huart);
+                huart->ErrorCode = HAL_UART_ERROR_NONE;
+            }
+        }
+        return;
+    }
+
+    if ((isrflags & USART_SR_TC) && (cr1its & USART_CR1_TCIE)) {
+        huart->Instance->CR1 &= ~USART_CR1_TCIE;
+        huart->gState = HAL_UART_STATE_READY;
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
@@ -0,0 +1,962 @@
+/**
+ * @file sim_hw.c
+ * @brief 仿真外设模型与中断派发
+ * @details
+ * 模型时间 s_now 单调不减、不超过墙钟。推进时取所有外设的下一个事件中最早的一个，
+ * 把 s_now 移到该时刻并执行；执行后若有挂起且使能的中断就停下，
+ * 能派发（PRIMASK 为 0、不在中断中）则派发一个中断后继续，否则保持冻结直到开中断。
+ * 中断不嵌套：固件里 Modbus 相关的 USART/DMA RX/TIM2 本来就在同一抢占级。
+ *
+ * 重入：信号处理函数可能在固件主循环的任意位置运行。模型被使用时 s_depth > 0，
+ * 此时信号只记一笔 s_kick，由正在使用模型的一方退出前补做推进。
+ *
+ * 虚拟时钟（simVirtualClock）：不跟墙钟，固件代码消耗的线程 CPU 时间乘以系数记入 s_fwNs，
+ * WFI 直接跳到下一个事件；推进不越过外部给的许可时刻 s_grant（不含），
+ * 到达后经 sync 钩子交换线路数据、取得下一个许可。
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "stm32f1xx_hal.h"
+
+//=============================================================================
+// 1. 外设对象与私有状态 (Peripheral Objects & Private State)
+//=============================================================================
+
+USART_TypeDef       g_simUsart[SIM_UART_PORTS];
+GPIO_TypeDef        g_simGpio[SIM_GPIO_PORTS];
+DMA_TypeDef         g_simDma1;
+DMA_Channel_TypeDef g_simDma1Ch[SIM_DMA1_CHANNELS];
+RCC_TypeDef         g_simRcc;
+AFIO_TypeDef        g_simAfio;
+FLASH_TypeDef       g_simFlash;
+PWR_TypeDef         g_simPwr;
+EXTI_TypeDef        g_simExti;
+TIM_TypeDef         g_simTim3;
+
+volatile uint32_t   g_simPrimask;          /* 复位值 0：中断开放 */
+SysTick_Type        g_simSysTick;
+SCB_Type            g_simScb;
+CoreDebug_Type      g_simCoreDebug;
+
+#define SIM_NEVER           UINT64_MAX
+#define SIM_IRQ_SLOTS       64U
+#define SIM_SLOT(irqn)      ((uint32_t)((int32_t)(irqn) + 16))
+#define SIM_RXQ_LEN         4096U           /* 每口待上线字节（2 的幂），满了留在 PTY 里 */
+#define SIM_TX_MAX          4096U
+
+typedef struct
+{
+    USART_TypeDef      *regs;
+    UART_HandleTypeDef *huart;
+    int                 fd;
+    uint64_t            charNs;             /**< 一个字符（含起止位、校验）的时间 */
+    uint32_t            baud;               /**< 非 0：覆盖固件配置的波特率 */
+
+    uint8_t             rxq[SIM_RXQ_LEN];
+    uint8_t             rxErr[SIM_RXQ_LEN]; /**< 非 0：该字节带帧错误（总线冲突） */
+    uint64_t            rxAt[SIM_RXQ_LEN];  /**< 到达时刻（读到 PTY 的时刻 / 注入的起始位时刻） */
+    uint32_t            rxHead;
+    uint32_t            rxTail;
+    uint64_t            rxLineFree;         /**< 上一个字符结束时刻 */
+    uint64_t            idleAt;
+    uint8_t             idleArmed;
+
+    uint8_t             txBuf[SIM_TX_MAX];
+    uint16_t            txLen;
+    uint8_t             txBusy;
+    uint8_t             txDma;
+    uint8_t             txDmaDone;
+    uint64_t            txStart;
+    uint64_t            txLineFree;
+
+    SimUartStats        st;
+} SimUart;
+
+typedef enum
+{
+    SIM_EV_NONE = 0,
+    SIM_EV_SYSTICK,
+    SIM_EV_TIM2,
+    SIM_EV_RX_BYTE,
+    SIM_EV_RX_IDLE,
+    SIM_EV_TX_DMA,
+    SIM_EV_TX_TC
+} SimEvent;
+
+static SimUart       s_uart[SIM_UART_PORTS];
+static SimDmaChannel s_dma[SIM_DMA1_CHANNELS];
+
+static uint64_t s_wallBase;
+static uint64_t s_now;
+
+static uint8_t         s_virtual;
+static SimVirtualHooks s_hooks;
+static double          s_cpuScale;
+static uint64_t        s_cpuMark;       /* 上次回到固件代码时的线程 CPU 时间 */
+static uint64_t        s_cpuNs;         /* 累计计入的固件执行时间 */
+static uint64_t        s_fwNs;          /* 固件执行到的时刻（虚拟时钟） */
+static uint64_t        s_grant;         /* 许可推进到的时刻（不含） */
+
+static volatile sig_atomic_t s_depth;
+static volatile sig_atomic_t s_kick;
+static volatile sig_atomic_t s_ioReady;
+static uint8_t  s_inIsr;
+static uint8_t  s_exclusive;
+
+static uint64_t s_irqEnabled;
+static uint64_t s_irqPending;
+static uint8_t  s_irqPrio[SIM_IRQ_SLOTS];
+static void   (*s_vector[SIM_IRQ_SLOTS])(void);
+static uint32_t s_prioGroup;
+
+static uint64_t s_sysTickPeriod;
+static uint64_t s_sysTickNext = SIM_NEVER;
+
+static DWT_Type s_dwt;
+static uint32_t s_dwtPub;
+static uint64_t s_dwtOffset;
+
+static TIM_TypeDef s_tim2;
+static struct
+{
+    uint64_t baseNs;        /**< ticks 的零点 */
+    uint64_t ticks;         /**< 已推进到的计数 */
+    uint32_t cntBase;       /**< ticks = 0 时的 CNT */
+    uint32_t sr;            /**< 模型侧 SR */
+    uint32_t pubSr;         /**< 上次写给固件看的 SR，用于识别 rc_w0 写入 */
+    uint8_t  running;
+} s_t2;
+
+static FILE    *s_gpioTrace;
+static uint32_t s_gpioOdr[SIM_GPIO_PORTS];
+
+/* 固件提供的中断处理函数（未定义的保持 NULL） */
+extern void SysTick_Handler(void)            __attribute__((weak));
+extern void TIM2_IRQHandler(void)            __attribute__((weak));
+extern void USART1_IRQHandler(void)          __attribute__((weak));
+extern void USART2_IRQHandler(void)          __attribute__((weak));
+extern void USART3_IRQHandler(void)          __attribute__((weak));
+extern void DMA1_Channel1_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel2_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel3_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel4_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel5_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel6_IRQHandler(void)   __attribute__((weak));
+extern void DMA1_Channel7_IRQHandler(void)   __attribute__((weak));
+
+static const IRQn_Type s_uartIrq[SIM_UART_PORTS] = { USART1_IRQn, USART2_IRQn, USART3_IRQn };
+
+//=============================================================================
+// 2. 时钟与中断控制器 (Clock & NVIC)
+//=============================================================================
+
+static uint64_t simWallNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec - s_wallBase;
+}
+
+uint64_t simNowNs(void)
+{
+    return s_now;
+}
+
+static uint64_t simThreadCpuNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* 固件代码 → 模型：把这段固件执行时间记到虚拟时钟上 */
+static void simCpuCharge(void)
+{
+    if (!s_virtual) return;
+    uint64_t cpu = simThreadCpuNs();
+    uint64_t d = (uint64_t)((double)(cpu - s_cpuMark) * s_cpuScale);
+    s_cpuMark = cpu;
+    s_cpuNs += d;
+    s_fwNs += d;
+}
+
+/* 模型 → 固件代码 */
+static void simCpuMark(void)
+{
+    if (s_virtual) s_cpuMark = simThreadCpuNs();
+}
+
+/* 本次推进的上限：墙钟，或虚拟时钟与许可时刻中较早的一个 */
+static uint64_t simLimitNs(void)
+{
+    if (!s_virtual) return simWallNs();
+    if (s_fwNs < s_grant) return s_fwNs;
+    return (s_grant != 0U) ? s_grant - 1U : 0U;
+}
+
+/* 固件动作（写引脚、启动发送）的时刻：虚拟时钟下模型可能还没推进到固件执行到的位置 */
+static uint64_t simStampNs(void)
+{
+    return (s_virtual && s_fwNs > s_now) ? s_fwNs : s_now;
+}
+
+/* 到达许可时刻：交出本段的线路输出，取回输入与下一个许可 */
+static void simSync(uint64_t earliest)
+{
+    uint64_t reached = s_grant;
+    s_grant = s_hooks.sync(reached, earliest);
+    if (s_fwNs < reached) s_fwNs = reached;
+}
+
+static void simPend(IRQn_Type irqn)
+{
+    s_irqPending |= 1ULL << SIM_SLOT(irqn);
+}
+
+static uint8_t simIrqReady(void)
+{
+    return (s_irqPending & s_irqEnabled) != 0U;
+}
+
+static void simEnter(void)
+{
+    if (s_depth++ == 0) simCpuCharge();
+}
+
+/* 固件上下文使用模型结束：期间到来的信号由这里补做推进 */
+static void simLeave(void)
+{
+    s_depth--;
+    if (s_depth == 0) {
+        if (s_kick) simService();
+        simCpuMark();
+    }
+}
+
+void NVIC_SetPriorityGrouping(uint32_t priorityGroup) { s_prioGroup = priorityGroup; }
+uint32_t NVIC_GetPriorityGrouping(void)               { return s_prioGroup; }
+void NVIC_EnableIRQ(IRQn_Type IRQn)                   { s_irqEnabled |= 1ULL << SIM_SLOT(IRQn); }
+void NVIC_DisableIRQ(IRQn_Type IRQn)                  { s_irqEnabled &= ~(1ULL << SIM_SLOT(IRQn)); }
+uint32_t NVIC_GetEnableIRQ(IRQn_Type IRQn)            { return (uint32_t)((s_irqEnabled >> SIM_SLOT(IRQn)) & 1U); }
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)               { simPend(IRQn); }
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)             { s_irqPending &= ~(1ULL << SIM_SLOT(IRQn)); }
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)           { return (uint32_t)((s_irqPending >> SIM_SLOT(IRQn)) & 1U); }
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority) { s_irqPrio[SIM_SLOT(IRQn)] = (uint8_t)priority; }
+uint32_t NVIC_GetPriority(IRQn_Type IRQn)             { return s_irqPrio[SIM_SLOT(IRQn)]; }
+
+void NVIC_SystemReset(void)
+{
+    fprintf(stderr, "sim: NVIC_SystemReset\n");
+    _exit(3);
+}
+
+void simSysTickStart(uint32_t periodUs)
+{
+    s_sysTickPeriod = (uint64_t)periodUs * 1000U;
+    s_sysTickNext = s_now + s_sysTickPeriod;
+    g_simSysTick.CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+    s_irqEnabled |= 1ULL << SIM_SLOT(SysTick_IRQn);
+}
+
+//=============================================================================
+// 3. DWT 与 TIM2 (Cycle Counter & Frame Timer)
+//=============================================================================
+
+static uint64_t simCyclesAt(uint64_t ns)
+{
+    return ns * (SystemCoreClock / 1000000U) / 1000U;
+}
+
+static void simDwtUpdate(void)
+{
+    if (s_dwt.CYCCNT != s_dwtPub || !(s_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        s_dwtOffset = simCyclesAt(s_now) - s_dwt.CYCCNT;    /* 固件写入或计数停止：从当前值继续 */
+    } else {
+        s_dwt.CYCCNT = (uint32_t)(simCyclesAt(s_now) - s_dwtOffset);
+    }
+    s_dwtPub = s_dwt.CYCCNT;
+}
+
+/* TIM2 时钟：APB1 分频不为 1 时为 PCLK1 的两倍，与固件按 RCC 推算的一致（72MHz） */
+static uint64_t simTim2Mhz(void)
+{
+    return SystemCoreClock / 1000000U;
+}
+
+static uint64_t simTim2TicksAt(uint64_t t)
+{
+    return (t - s_t2.baseNs) * simTim2Mhz() / ((uint64_t)(s_tim2.PSC + 1U) * 1000U);
+}
+
+static uint64_t simTim2TimeOf(uint64_t ticks)
+{
+    uint64_t num = ticks * (uint64_t)(s_tim2.PSC + 1U) * 1000U;
+    return s_t2.baseNs + (num + simTim2Mhz() - 1U) / simTim2Mhz();
+}
+
+/* 距离计数器下一次等于 target 还有多少个 tick（1..ARR+1） */
+static uint64_t simTim2TicksTo(uint32_t target)
+{
+    uint64_t period = (uint64_t)(s_tim2.ARR & 0xFFFFU) + 1U;
+    uint64_t cnt = (s_t2.cntBase + s_t2.ticks) % period;
+    uint64_t d = ((uint64_t)(target & 0xFFFFU) + period - cnt) % period;
+    return (d == 0U) ? period : d;
+}
+
+/* 处理固件对 CR1/EGR/SR 的写入，再把计数推进到 s_now */
+static void simTim2Update(void)
+{
+    if (s_tim2.SR != s_t2.pubSr) {
+        s_t2.sr &= s_tim2.SR;                   /* rc_w0：写 0 清除，写 1 不变 */
+    }
+    if ((s_tim2.CR1 & TIM_CR1_CEN) && !s_t2.running) {
+        s_t2.running = 1;
+        s_t2.cntBase = s_tim2.CNT & 0xFFFFU;
+        s_t2.baseNs = s_now;
+        s_t2.ticks = 0;
+    } else if (!(s_tim2.CR1 & TIM_CR1_CEN)) {
+        s_t2.running = 0;
+    }
+    if (s_tim2.EGR != 0U) {
+        if (s_tim2.EGR & TIM_EGR_UG) {
+            s_t2.cntBase = 0;
+            s_t2.baseNs = s_now;
+            s_t2.ticks = 0;
+            s_t2.sr |= TIM_SR_UIF;
+        }
+        s_t2.sr |= s_tim2.EGR & (TIM_SR_CC1IF | TIM_SR_CC2IF | TIM_SR_CC3IF | TIM_SR_CC4IF);
+        s_tim2.EGR = 0;
+    }
+
+    if (s_t2.running) {
+        uint64_t now = simTim2TicksAt(s_now);
+        if (now > s_t2.ticks) {
+            uint64_t step = now - s_t2.ticks;
+            const volatile uint32_t *ccr = &s_tim2.CCR1;
+            for (uint32_t ch = 0; ch < 4U; ch++) {
+                if (simTim2TicksTo(ccr[ch]) <= step) s_t2.sr |= TIM_SR_CC1IF << ch;
+            }
+            if (simTim2TicksTo(0U) <= step) s_t2.sr |= TIM_SR_UIF;
+            s_t2.ticks = now;
+        }
+        s_tim2.CNT = (uint32_t)((s_t2.cntBase + s_t2.ticks) % ((uint64_t)(s_tim2.ARR & 0xFFFFU) + 1U));
+    }
+    s_tim2.SR = s_t2.sr;
+    s_t2.pubSr = s_t2.sr;
+}
+
+/* 下一次会置位“已使能且未置位”的比较/更新标志的时刻 */
+static uint64_t simTim2NextEvent(void)
+{
+    if (!s_t2.running) return SIM_NEVER;
+    uint32_t want = s_tim2.DIER & ~s_t2.sr & (TIM_DIER_UIE | TIM_DIER_CC1IE | TIM_DIER_CC2IE
+                                              | TIM_DIER_CC3IE | TIM_DIER_CC4IE);
+    if (want == 0U) return SIM_NEVER;
+
+    uint64_t best = SIM_NEVER;
+    const volatile uint32_t *ccr = &s_tim2.CCR1;
+    for (uint32_t ch = 0; ch < 4U; ch++) {
+        if (want & (TIM_DIER_CC1IE << ch)) {
+            uint64_t t = simTim2TimeOf(s_t2.ticks + simTim2TicksTo(ccr[ch]));
+            if (t < best) best = t;
+        }
+    }
+    if (want & TIM_DIER_UIE) {
+        uint64_t t = simTim2TimeOf(s_t2.ticks + simTim2TicksTo(0U));
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+//=============================================================================
+// 4. GPIO 与 DMA (GPIO & DMA)
+//=============================================================================
+
+static void simGpioApply(uint32_t port, uint32_t odr)
+{
+    uint32_t changed = (s_gpioOdr[port] ^ odr) & 0xFFFFU;
+    s_gpioOdr[port] = odr;
+    g_simGpio[port].ODR = odr;
+    g_simGpio[port].IDR = odr;              /* 输入引脚没有外部激励，读回输出锁存 */
+    if ((s_gpioTrace == NULL && s_hooks.gpio == NULL) || changed == 0U) return;
+    for (uint32_t pin = 0; pin < 16U; pin++) {
+        if (!(changed & (1UL << pin))) continue;
+        uint8_t level = (uint8_t)((odr >> pin) & 1U);
+        if (s_hooks.gpio != NULL) s_hooks.gpio(port, pin, level, simStampNs());
+        if (s_gpioTrace != NULL) {
+            fprintf(s_gpioTrace, "%llu P%c%u=%u\n", (unsigned long long)(simStampNs() / 1000U),
+                    (char)('A' + port), (unsigned)pin, (unsigned)level);
+        }
+    }
+    if (s_gpioTrace != NULL) fflush(s_gpioTrace);
+}
+
+/* 固件直接写 BSRR/BRR/ODR 时在下一次推进中生效 */
+static void simGpioUpdate(void)
+{
+    for (uint32_t p = 0; p < SIM_GPIO_PORTS; p++) {
+        GPIO_TypeDef *g = &g_simGpio[p];
+        uint32_t odr = g->ODR;
+        if (g->BSRR != 0U) {
+            odr = (odr & ~(g->BSRR >> 16)) | (g->BSRR & 0xFFFFU);
+            g->BSRR = 0;
+        }
+        if (g->BRR != 0U) {
+            odr &= ~g->BRR;
+            g->BRR = 0;
+        }
+        if (odr != s_gpioOdr[p]) simGpioApply(p, odr);
+    }
+}
+
+void simGpioWrite(GPIO_TypeDef *port, uint16_t pins, uint8_t set)
+{
+    uint32_t p = (uint32_t)(port - g_simGpio);
+    simEnter();
+    simGpioUpdate();
+    simGpioApply(p, set ? (s_gpioOdr[p] | pins) : (s_gpioOdr[p] & ~(uint32_t)pins));
+    simLeave();
+}
+
+void simGpioTrace(FILE *out)
+{
+    s_gpioTrace = out;
+}
+
+SimDmaChannel *simDmaChannel(const DMA_Channel_TypeDef *ch)
+{
+    return &s_dma[ch - g_simDma1Ch];
+}
+
+IRQn_Type simDmaIrq(const DMA_Channel_TypeDef *ch)
+{
+    return (IRQn_Type)(DMA1_Channel1_IRQn + (ch - g_simDma1Ch));
+}
+
+//=============================================================================
+// 5. USART (USART Model)
+//=============================================================================
+
+void simUartRegister(UART_HandleTypeDef *huart)
+{
+    SimUart *u = &s_uart[huart->Instance - g_simUsart];
+    u->regs = huart->Instance;
+    u->huart = huart;
+    if (u->baud != 0U) huart->Init.BaudRate = u->baud;  /* 固件随后按句柄里的波特率算 t1.5/t3.5 */
+
+    /* F1 的 WordLength 含校验位：8N1 = 10 位，8E1/9N1 = 11 位 */
+    uint32_t bits = 1U + ((huart->Init.WordLength == UART_WORDLENGTH_9B) ? 9U : 8U)
+                  + ((huart->Init.StopBits == UART_STOPBITS_2) ? 2U : 1U);
+    u->charNs = (uint64_t)bits * 1000000000ULL / huart->Init.BaudRate;
+
+    u->regs->SR = USART_SR_TXE | USART_SR_TC;
+}
+
+static void simUartRxDeliver(SimUart *u, uint8_t byte, uint8_t err)
+{
+    USART_TypeDef *r = u->regs;
+    if (!(r->CR1 & USART_CR1_UE) || !(r->CR1 & USART_CR1_RE)) {
+        u->st.rxDropped++;
+        return;
+    }
+    u->st.rxBytes++;
+    if (err) r->SR |= USART_SR_FE;          /* 与 RXNE 同时置位，字节照常进 DR/DMA */
+
+    DMA_HandleTypeDef *h = u->huart->hdmarx;
+    if ((r->CR3 & USART_CR3_DMAR) && h != NULL
+        && (h->Instance->CCR & DMA_CCR_EN) && h->Instance->CNDTR != 0U) {
+        DMA_Channel_TypeDef *ch = h->Instance;
+        SimDmaChannel *c = simDmaChannel(ch);
+        c->mem[c->size - ch->CNDTR] = byte;
+        ch->CNDTR--;
+        if (ch->CNDTR == c->size / 2U) c->flags |= SIM_DMA_FLAG_HT;
+        if (ch->CNDTR == 0U) {
+            c->flags |= SIM_DMA_FLAG_TC;
+            if (ch->CCR & DMA_CCR_CIRC) {
+                ch->CNDTR = c->size;
+            }
+        }
+        /* RXNE 随即被 DMA 读 DR 清掉，但开着 RXNEIE 时 NVIC 已经挂起：每字节进一次中断 */
+        if (r->CR1 & USART_CR1_RXNEIE) simPend(s_uartIrq[u - s_uart]);
+        return;
+    }
+
+    if (r->SR & USART_SR_RXNE) {
+        r->SR |= USART_SR_ORE;              /* 上一个字节未读：新字节丢失 */
+        u->st.rxDropped++;
+    } else {
+        r->DR = byte;
+        r->SR |= USART_SR_RXNE;
+    }
+}
+
+static void simUartTxFlush(SimUart *u, uint16_t len)
+{
+    if (u->fd < 0 || len == 0U) return;
+    ssize_t n = write(u->fd, u->txBuf, len);
+    (void)n;                                /* 没人读、PTY 缓冲满时丢弃，与线上没有接收方一样 */
+}
+
+void simUartTxStart(UART_HandleTypeDef *huart, const uint8_t *data, uint16_t len, uint8_t dma)
+{
+    SimUart *u = &s_uart[huart->Instance - g_simUsart];
+    simEnter();
+    if (len > SIM_TX_MAX) len = SIM_TX_MAX;
+    memcpy(u->txBuf, data, len);
+    u->txLen = len;
+    u->txBusy = 1;
+    u->txDma = dma;
+    u->txDmaDone = 0;
+    u->txStart = (u->txLineFree > simStampNs()) ? u->txLineFree : simStampNs();
+    u->regs->SR &= ~USART_SR_TC;
+    if (s_hooks.txStart != NULL) {
+        s_hooks.txStart((uint32_t)(u - s_uart), u->txBuf, len, u->txStart, u->charNs);
+    }
+    simLeave();
+}
+
+uint8_t simUartTxIdle(const UART_HandleTypeDef *huart)
+{
+    return !s_uart[huart->Instance - g_simUsart].txBusy;
+}
+
+void simUartTxAbort(UART_HandleTypeDef *huart)
+{
+    SimUart *u = &s_uart[huart->Instance - g_simUsart];
+    simEnter();
+    if (u->txBusy) {
+        uint64_t sent = (simStampNs() > u->txStart) ? (simStampNs() - u->txStart) / u->charNs : 0U;
+        if (sent > u->txLen) sent = u->txLen;
+        simUartTxFlush(u, (uint16_t)sent);  /* 已移出的字节照常到达对端 */
+        if (s_hooks.txAbort != NULL) s_hooks.txAbort((uint32_t)(u - s_uart), (uint16_t)sent);
+        u->txBusy = 0;
+        u->txLineFree = u->txStart + sent * u->charNs;
+    }
+    simLeave();
+}
+
+static uint64_t simUartRxNextStart(const SimUart *u)
+{
+    if (u->rxHead == u->rxTail) return SIM_NEVER;
+    uint64_t at = u->rxAt[u->rxTail & (SIM_RXQ_LEN - 1U)];
+    return (at > u->rxLineFree) ? at : u->rxLineFree;
+}
+
+static uint64_t simUartNextEvent(const SimUart *u, SimEvent *ev)
+{
+    uint64_t best = SIM_NEVER;
+    *ev = SIM_EV_NONE;
+
+    uint64_t start = simUartRxNextStart(u);
+    if (start != SIM_NEVER) {
+        best = start + u->charNs;
+        *ev = SIM_EV_RX_BYTE;
+    }
+    /* 下一个字节在空闲满一个字符之前开始则没有 IDLE */
+    if (u->idleArmed && (start == SIM_NEVER || start >= u->idleAt) && u->idleAt < best) {
+        best = u->idleAt;
+        *ev = SIM_EV_RX_IDLE;
+    }
+    if (u->txBusy) {
+        if (u->txDma && !u->txDmaDone) {
+            uint64_t t = u->txStart + (uint64_t)(u->txLen - 1U) * u->charNs;
+            if (t < best) { best = t; *ev = SIM_EV_TX_DMA; }
+        }
+        uint64_t t = u->txStart + (uint64_t)u->txLen * u->charNs;
+        if (t < best) { best = t; *ev = SIM_EV_TX_TC; }
+    }
+    return best;
+}
+
+static void simUartFire(SimUart *u, SimEvent ev)
+{
+    switch (ev) {
+        case SIM_EV_RX_BYTE: {
+            uint32_t i = u->rxTail & (SIM_RXQ_LEN - 1U);
+            uint64_t start = (u->rxAt[i] > u->rxLineFree) ? u->rxAt[i] : u->rxLineFree;
+            u->rxTail++;
+            u->rxLineFree = start + u->charNs;
+            u->idleAt = u->rxLineFree + u->charNs;
+            u->idleArmed = 1;
+            simUartRxDeliver(u, u->rxq[i], u->rxErr[i]);
+            break;
+        }
+        case SIM_EV_RX_IDLE:
+            u->idleArmed = 0;
+            u->regs->SR |= USART_SR_IDLE;
+            u->st.idleEvents++;
+            break;
+        case SIM_EV_TX_DMA: {
+            /* 最后一个字节已送入 DR：DMA 传输完成，HAL 随后改开 TC 中断 */
+            DMA_Channel_TypeDef *ch = u->huart->hdmatx->Instance;
+            ch->CNDTR = 0;
+            simDmaChannel(ch)->flags |= SIM_DMA_FLAG_HT | SIM_DMA_FLAG_TC;
+            u->txDmaDone = 1;
+            break;
+        }
+        case SIM_EV_TX_TC:
+            simUartTxFlush(u, u->txLen);
+            u->txBusy = 0;
+            u->txLineFree = s_now;
+            u->regs->SR |= USART_SR_TC | USART_SR_TXE;
+            u->st.txBytes += u->txLen;
+            u->st.txFrames++;
+            break;
+        default:
+            break;
+    }
+}
+
+static uint8_t simUartIrqLevel(const SimUart *u)
+{
+    uint32_t sr = u->regs->SR, cr1 = u->regs->CR1, cr3 = u->regs->CR3;
+    return ((sr & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE))
+        || ((sr & USART_SR_TC)   && (cr1 & USART_CR1_TCIE))
+        || ((sr & USART_SR_TXE)  && (cr1 & USART_CR1_TXEIE))
+        || ((sr & (USART_SR_RXNE | USART_SR_ORE)) && (cr1 & USART_CR1_RXNEIE))
+        || ((sr & USART_SR_PE)   && (cr1 & USART_CR1_PEIE))
+        || ((sr & (USART_SR_ORE | USART_SR_NE | USART_SR_FE)) && (cr3 & USART_CR3_EIE));
+}
+
+void simUartAttach(uint32_t port, int fd)
+{
+    s_uart[port].fd = fd;
+}
+
+void simUartGetStats(uint32_t port, SimUartStats *stats)
+{
+    *stats = s_uart[port].st;
+}
+
+void simUartSetBaud(uint32_t port, uint32_t baud)
+{
+    s_uart[port].baud = baud;
+}
+
+void simUartInject(uint32_t port, uint8_t byte, uint8_t err, uint64_t startNs)
+{
+    SimUart *u = &s_uart[port];
+    if (u->rxHead - u->rxTail >= SIM_RXQ_LEN) {
+        u->st.rxDropped++;
+        return;
+    }
+    uint32_t i = u->rxHead & (SIM_RXQ_LEN - 1U);
+    u->rxq[i] = byte;
+    u->rxErr[i] = err;
+    u->rxAt[i] = startNs;
+    u->rxHead++;
+}
+
+/* 从 PTY 读入待上线字节，到达时刻取当前墙钟 */
+static void simUartPollInputs(void)
+{
+    uint64_t at = simWallNs();
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        SimUart *u = &s_uart[p];
+        if (u->fd < 0 || u->regs == NULL) continue;
+        for (;;) {
+            uint32_t space = SIM_RXQ_LEN - (u->rxHead - u->rxTail);
+            uint32_t head = u->rxHead & (SIM_RXQ_LEN - 1U);
+            uint32_t chunk = SIM_RXQ_LEN - head;
+            if (chunk > space) chunk = space;
+            if (chunk == 0U) break;
+            ssize_t n = read(u->fd, &u->rxq[head], chunk);
+            if (n <= 0) break;
+            for (ssize_t i = 0; i < n; i++) {
+                u->rxAt[head + (uint32_t)i] = at;
+                u->rxErr[head + (uint32_t)i] = 0;
+            }
+            u->rxHead += (uint32_t)n;
+        }
+    }
+}
+
+//=============================================================================
+// 6. 推进与派发 (Advance & Dispatch)
+//=============================================================================
+
+/* 电平型中断源 → 挂起 */
+static void simLevels(void)
+{
+    if (s_tim2.DIER & s_t2.sr & (TIM_DIER_UIE | TIM_DIER_CC1IE | TIM_DIER_CC2IE
+                                 | TIM_DIER_CC3IE | TIM_DIER_CC4IE)) {
+        simPend(TIM2_IRQn);
+    }
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        if (s_uart[p].regs != NULL && simUartIrqLevel(&s_uart[p])) simPend(s_uartIrq[p]);
+    }
+    for (uint32_t c = 0; c < SIM_DMA1_CHANNELS; c++) {
+        uint32_t ccr = g_simDma1Ch[c].CCR;
+        uint8_t f = s_dma[c].flags;
+        if (((f & SIM_DMA_FLAG_TC) && (ccr & DMA_CCR_TCIE))
+            || ((f & SIM_DMA_FLAG_HT) && (ccr & DMA_CCR_HTIE))
+            || ((f & SIM_DMA_FLAG_TE) && (ccr & DMA_CCR_TEIE))) {
+            simPend((IRQn_Type)(DMA1_Channel1_IRQn + (int32_t)c));
+        }
+    }
+}
+
+/**
+ * @brief 按时间顺序推进到 limit
+ * @return 1：有挂起且使能的中断（推进停在该事件时刻）；0：已推进到 limit
+ */
+static uint8_t simAdvance(uint64_t limit, uint64_t *nextEvent)
+{
+    for (;;) {
+        simGpioUpdate();
+        simTim2Update();
+        simDwtUpdate();
+        simLevels();
+        if (simIrqReady()) return 1;
+
+        uint64_t best = s_sysTickNext;
+        SimEvent ev = SIM_EV_SYSTICK;
+        SimUart *evUart = NULL;
+
+        uint64_t t = simTim2NextEvent();
+        if (t < best) { best = t; ev = SIM_EV_TIM2; }
+        for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+            SimEvent e;
+            if (s_uart[p].regs == NULL) continue;
+            t = simUartNextEvent(&s_uart[p], &e);
+            if (t < best) { best = t; ev = e; evUart = &s_uart[p]; }
+        }
+
+        if (best > limit) {
+            if (limit > s_now) s_now = limit;
+            simTim2Update();
+            simDwtUpdate();
+            if (nextEvent != NULL) *nextEvent = best;
+            return 0;
+        }
+        if (best > s_now) s_now = best;
+
+        if (ev == SIM_EV_SYSTICK) {
+            s_sysTickNext += s_sysTickPeriod;
+            simPend(SysTick_IRQn);
+        } else if (evUart != NULL) {
+            simUartFire(evUart, ev);
+        }
+        /* SIM_EV_TIM2：下一轮 simTim2Update 推进计数时置位标志 */
+    }
+}
+
+static void simDispatch(void)
+{
+    uint64_t ready = s_irqPending & s_irqEnabled;
+    uint32_t slot = SIM_IRQ_SLOTS;
+    for (uint32_t i = 0; i < SIM_IRQ_SLOTS; i++) {
+        if ((ready >> i) & 1U) {
+            if (slot == SIM_IRQ_SLOTS || s_irqPrio[i] < s_irqPrio[slot]) slot = i;
+        }
+    }
+    if (slot == SIM_IRQ_SLOTS) return;
+
+    s_irqPending &= ~(1ULL << slot);
+    s_inIsr = 1;
+    s_exclusive = 0;
+    /* 虚拟时钟：中断在事件时刻抢占，处理耗时顺延被打断的固件代码 */
+    uint64_t at = s_now, resume = s_fwNs;
+    if (s_virtual) s_fwNs = at;
+    simCpuMark();
+    if (s_vector[slot] != NULL) s_vector[slot]();
+    simCpuCharge();
+    if (s_virtual) s_fwNs = ((resume > at) ? resume : at) + (s_fwNs - at);
+    s_exclusive = 0;
+    s_inIsr = 0;
+
+    /* 固件在中断里读 SR 再读 DR：读清除的标志在此清掉 */
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        if (slot == SIM_SLOT(s_uartIrq[p]) && s_uart[p].regs != NULL) {
+            s_uart[p].regs->SR &= ~(USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE
+                                    | USART_SR_PE | USART_SR_RXNE);
+        }
+    }
+}
+
+void simService(void)
+{
+    if (s_depth != 0) return;
+    s_depth = 1;
+    simCpuCharge();
+    do {
+        s_kick = 0;
+        if (s_ioReady) {
+            s_ioReady = 0;
+            simUartPollInputs();
+        }
+        for (;;) {
+            if (simAdvance(simLimitNs(), NULL)) {
+                if (g_simPrimask || s_inIsr) break;
+                simDispatch();
+            } else if (s_virtual && s_fwNs >= s_grant) {
+                simSync(s_grant);           /* 固件一直在跑：最早动作就是现在 */
+            } else {
+                break;
+            }
+        }
+    } while (s_kick);
+    s_depth = 0;
+    if (s_kick) simService();
+    simCpuMark();
+}
+
+void simSignalHandler(int sig)
+{
+    (void)sig;
+    s_ioReady = 1;                          /* SIGIO：有输入；SIGALRM：顺便轮询一次 */
+    if (s_depth != 0) {
+        s_kick = 1;
+        return;
+    }
+    simService();
+}
+
+//=============================================================================
+// 7. 内核接口 (Core Intrinsics)
+//=============================================================================
+
+void simEnableIrq(void)
+{
+    g_simPrimask = 0;
+    if (!s_inIsr) simService();
+}
+
+/* 虚拟时钟下的 WFI：固件时钟跳到下一个事件，事件在许可之外则先同步 */
+static void simWfiVirtual(void)
+{
+    simEnter();
+    for (;;) {
+        uint64_t next = SIM_NEVER;
+        if (simAdvance(simLimitNs(), &next) || simIrqReady()) break;
+        if (next < s_grant) {
+            s_fwNs = next;
+        } else {
+            simSync(next);
+        }
+    }
+    simLeave();
+    simService();
+}
+
+void simWfi(void)
+{
+    simService();
+    if (simIrqReady()) return;
+    if (s_virtual) {
+        simWfiVirtual();
+        return;
+    }
+
+    /* 没有挂起的中断：睡到下一个外设事件或 PTY 来数据 */
+    uint64_t next = SIM_NEVER;
+    simEnter();
+    uint8_t ready = simAdvance(simWallNs(), &next);
+    simLeave();
+    if (ready || simIrqReady()) return;
+
+    struct pollfd fds[SIM_UART_PORTS];
+    nfds_t n = 0;
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        if (s_uart[p].fd >= 0 && s_uart[p].regs != NULL) {
+            fds[n].fd = s_uart[p].fd;
+            fds[n].events = POLLIN;
+            n++;
+        }
+    }
+    uint64_t wall = simWallNs();
+    uint64_t wait = (next == SIM_NEVER) ? 1000000ULL : (next > wall ? next - wall : 0U);
+    if (wait > 1000000ULL) wait = 1000000ULL;
+    struct timespec ts = { 0, (long)wait };
+    if (wait != 0U) ppoll(fds, n, &ts, NULL);
+
+    s_ioReady = 1;
+    simService();
+}
+
+uint32_t simLdrex(volatile uint32_t *addr)
+{
+    s_exclusive = 1;
+    return *addr;
+}
+
+uint32_t simStrex(uint32_t value, volatile uint32_t *addr)
+{
+    if (!s_exclusive) return 1U;            /* 其间发生过中断：独占失败，调用方重试 */
+    *addr = value;
+    s_exclusive = 0;
+    return 0U;
+}
+
+void simClrex(void)
+{
+    s_exclusive = 0;
+}
+
+DWT_Type *simDwtSync(void)
+{
+    simService();
+    simEnter();
+    simDwtUpdate();
+    simLeave();
+    return &s_dwt;
+}
+
+TIM_TypeDef *simTim2Sync(void)
+{
+    simService();
+    simEnter();
+    simTim2Update();
+    simLeave();
+    return &s_tim2;
+}
+
+//=============================================================================
+// 8. 初始化 (Initialization)
+//=============================================================================
+
+void simHwInit(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s_wallBase = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    s_now = 0;
+
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) s_uart[p].fd = -1;
+
+    s_vector[SIM_SLOT(SysTick_IRQn)]        = SysTick_Handler;
+    s_vector[SIM_SLOT(TIM2_IRQn)]           = TIM2_IRQHandler;
+    s_vector[SIM_SLOT(USART1_IRQn)]         = USART1_IRQHandler;
+    s_vector[SIM_SLOT(USART2_IRQn)]         = USART2_IRQHandler;
+    s_vector[SIM_SLOT(USART3_IRQn)]         = USART3_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel1_IRQn)]  = DMA1_Channel1_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel2_IRQn)]  = DMA1_Channel2_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel3_IRQn)]  = DMA1_Channel3_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel4_IRQn)]  = DMA1_Channel4_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel5_IRQn)]  = DMA1_Channel5_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel6_IRQn)]  = DMA1_Channel6_IRQHandler;
+    s_vector[SIM_SLOT(DMA1_Channel7_IRQn)]  = DMA1_Channel7_IRQHandler;
+
+    s_tim2.ARR = 0xFFFFU;
+}
+
+void simVirtualClock(const SimVirtualHooks *hooks, double cpuScale)
+{
+    s_hooks = *hooks;
+    s_cpuScale = cpuScale;
+    s_virtual = 1;
+    s_fwNs = s_now;
+    s_grant = s_now;                        /* 第一次推进前先同步 */
+    s_cpuMark = simThreadCpuNs();
+}
+
+uint64_t simCpuNs(void)
+{
+    return s_cpuNs;
+}
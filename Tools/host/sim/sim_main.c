@@ -0,0 +1,143 @@
+/**
+ * @file sim_main.c
+ * @brief 固件主机仿真入口：为每个 USART 创建 PTY，装好信号后进入固件 main
+ * @details
+ * 固件的 main 在编译 main.c 时改名为 simFirmwareMain。
+ * 每个 USART 一个伪终端：主端由仿真模型读写，从端路径打印到标准输出，
+ * Tools/uart_test.py 或任何 Modbus 主站直接打开从端即可（波特率设置被忽略，
+ * 线路时序按固件里配置的波特率计算）。
+ *
+ *   SIGALRM 每 1ms 一次，让外设模型在固件长时间不访问外设时也能推进并抢占主循环；
+ *   SIGIO   PTY 有数据时立即把字节排上线路。
+ * Ctrl-C 退出时打印各口收发统计。
+ */
+
+#define _GNU_SOURCE
+#include "stm32f1xx_hal.h"      /* 先于 termios.h：后者把 CR1/CR2/CR3 定义成宏 */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <termios.h>
+#include <unistd.h>
+
+int simFirmwareMain(void);
+
+static const char *s_links[SIM_UART_PORTS];
+static int         s_slaveFd[SIM_UART_PORTS] = { -1, -1, -1 };
+
+/* 打开一对 PTY，主端非阻塞 + O_ASYNC；从端保持打开，避免无人连接时主端读到 EIO */
+static int simOpenPty(uint32_t port, char *name, size_t nameLen)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0
+        || ptsname_r(master, name, nameLen) != 0) {
+        perror("sim: posix_openpt");
+        return -1;
+    }
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror("sim: open pts");
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    s_slaveFd[port] = slave;
+
+    fcntl(master, F_SETOWN, getpid());
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK | O_ASYNC);
+    return master;
+}
+
+static void simExit(int sig)
+{
+    static const char *const names[SIM_UART_PORTS] = { "USART1", "USART2", "USART3" };
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        if (s_slaveFd[p] < 0) continue;
+        SimUartStats st;
+        simUartGetStats(p, &st);
+        fprintf(stderr, "%s: rx %u bytes (%u dropped, %u idle), tx %u bytes / %u frames\n",
+                names[p], st.rxBytes, st.rxDropped, st.idleEvents, st.txBytes, st.txFrames);
+        if (s_links[p] != NULL) unlink(s_links[p]);
+    }
+    _exit(sig == SIGINT || sig == SIGTERM ? 0 : 1);
+}
+
+static void simUsage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-1 LINK] [-2 LINK] [-3 LINK] [-g FILE]\n"
+            "  -N LINK  create symlink LINK -> USARTN pseudo-terminal\n"
+            "  -g FILE  log GPIO level changes (\"us PXn=level\"), '-' for stdout\n",
+            prog);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *gpioLog = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "1:2:3:g:h")) != -1) {
+        switch (opt) {
+            case '1': case '2': case '3':
+                s_links[opt - '1'] = optarg;
+                break;
+            case 'g':
+                gpioLog = (strcmp(optarg, "-") == 0) ? stdout : fopen(optarg, "w");
+                if (gpioLog == NULL) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default:
+                simUsage(argv[0]);
+        }
+    }
+
+    simHwInit();
+    simGpioTrace(gpioLog);
+
+    for (uint32_t p = 0; p < SIM_UART_PORTS; p++) {
+        if (p >= 2U && s_links[p] == NULL) break;   /* 固件未使用 USART3，指定了链接才创建 */
+        char name[64];
+        int fd = simOpenPty(p, name, sizeof(name));
+        if (fd < 0) return 1;
+        simUartAttach(p, fd);
+        if (s_links[p] != NULL) {
+            unlink(s_links[p]);
+            if (symlink(name, s_links[p]) != 0) {
+                perror(s_links[p]);
+                return 1;
+            }
+        }
+        printf("USART%u %s%s%s\n", (unsigned)(p + 1U), name,
+               s_links[p] ? " <- " : "", s_links[p] ? s_links[p] : "");
+    }
+    fflush(stdout);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = simSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGALRM);
+    sigaddset(&sa.sa_mask, SIGIO);
+    sigaction(SIGALRM, &sa, NULL);
+    sigaction(SIGIO, &sa, NULL);
+
+    sa.sa_handler = simExit;
+    sigaddset(&sa.sa_mask, SIGINT);
+    sigaddset(&sa.sa_mask, SIGTERM);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    struct itimerval tv = { { 0, 1000 }, { 0, 1000 } };
+    setitimer(ITIMER_REAL, &tv, NULL);
+
+    return simFirmwareMain();
+}
@@ -8,6 +8,7 @@ pip install pyserial pymodbus colorama
 
 使用方法：
 python uart_test.py --port COM3 --baudrate 9600 --test all
+python uart_test.py --port COM3 --baudrate 115200 --test trace   # 读取请求处理延时统计
 """
 
 import serial
@@ -261,7 +262,10 @@ class UARTTester:
             return False
     
     def test_stress(self, duration=10, min_size=10, max_size=256):
-        """压力测试
+        """压力测试（回环模式下的收发一致性）
+
+        发送后直接阻塞读取到 size 字节或超时，不再按包长固定延时。
+        Modbus 从站的吞吐/延时压测请用 Tools/host/build/mb_load。
         
         Args:
             duration: 测试时长（秒）
@@ -285,12 +289,11 @@ class UARTTester:
         while time.time() - start_time < duration:
             # 生成随机大小的数据
             size = random.randint(min_size, max_size)
-            data = bytes([random.randint(0, 255) for _ in range(size)])
+            data = random.randbytes(size)
             
-            # 发送并接收
+            # 发送并接收（read 在收齐 size 字节或超时时返回）
             self.ser.reset_input_buffer()
             self.ser.write(data)
-            time.sleep(0.01 + size * 0.001)  # 动态延时
             
             received = self.ser.read(size)
             packet_count += 1
@@ -322,6 +325,108 @@ class UARTTester:
         
         return success_rate >= 90
     
+    def modbus_read_input_registers(self, slave_addr, start_addr, count):
+        """FC04 读输入寄存器
+
+        Returns:
+            list: 寄存器值；失败返回 None
+        """
+        request = bytearray([slave_addr, 0x04,
+                             (start_addr >> 8) & 0xFF, start_addr & 0xFF,
+                             (count >> 8) & 0xFF, count & 0xFF])
+        crc = self.modbus_crc16(request)
+        request.extend([crc & 0xFF, (crc >> 8) & 0xFF])
+
+        self.ser.reset_input_buffer()
+        self.ser.write(request)
+        expected_length = 5 + count * 2
+        response = self.ser.read(expected_length)
+        if (len(response) != expected_length or response[0] != slave_addr
+                or response[1] != 0x04 or self.modbus_crc16(response) != 0):
+            return None
+        return [(response[3 + i*2] << 8) | response[4 + i*2] for i in range(count)]
+
+    def dump_trace(self, slave_addr=0x01):
+        """读取并打印固件的流水线延时统计（输入寄存器 100-231，见 modbus_trace.h）
+
+        每个功能码 12 个寄存器：fc, 样本数, min, avg, max, p99（IDLE → 开始发送，us），
+        以及 IDLE→处理、处理→CRC、CRC→处理函数、处理函数→开始发送、开始发送→TC 的平均耗时。
+        """
+        TRACE_BASE, SLOTS, PER_FC = 100, 11, 12
+        print(f"\n{Fore.CYAN}=== 请求处理延时跟踪 (从站 0x{slave_addr:02X}) ===")
+
+        regs = []
+        total = SLOTS * PER_FC
+        while len(regs) < total:
+            n = min(120, total - len(regs))   # 单次 FC04 最多 125 个寄存器
+            part = self.modbus_read_input_registers(slave_addr, TRACE_BASE + len(regs), n)
+            if part is None:
+                print(f"{Fore.RED}✗ 读取输入寄存器失败")
+                return False
+            regs.extend(part)
+
+        print(f"  {'FC':>4} {'次数':>6} {'min':>6} {'avg':>6} {'max':>6} {'p99':>6} |"
+              f" {'排队':>6} {'CRC':>6} {'处理':>6} {'发起':>6} {'线上':>6}  (us)")
+        for i in range(SLOTS):
+            r = regs[i*PER_FC:(i+1)*PER_FC]
+            if r[1] == 0:
+                continue
+            fc = f"0x{r[0]:02X}" if r[0] else "其他"
+            print(f"  {fc:>4} {r[1]:>6} {r[2]:>6} {r[3]:>6} {r[4]:>6} {r[5]:>6} |"
+                  f" {r[6]:>6} {r[7]:>6} {r[8]:>6} {r[9]:>6} {r[10]:>6}")
+        return True
+
+    def modbus_diag(self, slave_addr, sub_func, data=0):
+        """FC08 诊断请求
+
+        Returns:
+            int: 应答数据字段；失败或异常返回 None
+        """
+        request = bytearray([slave_addr, 0x08, (sub_func >> 8) & 0xFF, sub_func & 0xFF,
+                             (data >> 8) & 0xFF, data & 0xFF])
+        crc = self.modbus_crc16(request)
+        request.extend([crc & 0xFF, (crc >> 8) & 0xFF])
+
+        self.ser.reset_input_buffer()
+        self.ser.write(request)
+        response = self.ser.read(8)
+        if len(response) != 8 or response[:4] != request[:4] or self.modbus_crc16(response) != 0:
+            return None
+        return (response[4] << 8) | response[5]
+
+    def dump_diag(self, slave_addr=0x01):
+        """读取并打印串行链路诊断计数（FC08 子功能 0x02、0x0B-0x12 与 FC0B，见 modbus_diag.h）"""
+        counters = [
+            (0x02, '诊断寄存器'),
+            (0x0B, '总线报文'),
+            (0x0C, '总线通信错误'),
+            (0x0D, '异常应答'),
+            (0x0E, '本站报文'),
+            (0x0F, '本站未应答'),
+            (0x10, 'NAK'),
+            (0x11, '忙'),
+            (0x12, '溢出'),
+        ]
+        print(f"\n{Fore.CYAN}=== 诊断计数 (从站 0x{slave_addr:02X}) ===")
+        for sub_func, name in counters:
+            value = self.modbus_diag(slave_addr, sub_func)
+            if value is None:
+                print(f"{Fore.RED}✗ 子功能 0x{sub_func:02X} 读取失败")
+                return False
+            print(f"  0x{sub_func:02X} {name:<8} {value:>6}")
+
+        request = bytearray([slave_addr, 0x0B])
+        crc = self.modbus_crc16(request)
+        request.extend([crc & 0xFF, (crc >> 8) & 0xFF])
+        self.ser.reset_input_buffer()
+        self.ser.write(request)
+        response = self.ser.read(8)
+        if len(response) != 8 or response[1] != 0x0B or self.modbus_crc16(response) != 0:
+            print(f"{Fore.RED}✗ FC0B 读取失败")
+            return False
+        print(f"  FC0B 通信事件计数 {(response[4] << 8) | response[5]:>6}")
+        return True
+
     def modbus_crc16(self, data):
         """计算Modbus CRC16
         
@@ -397,9 +502,10 @@ def main():
     parser.add_argument('--port', '-p', required=True, help='串口号 (如 COM3 或 /dev/ttyUSB0)')
     parser.add_argument('--baudrate', '-b', type=int, default=9600, help='波特率 (默认: 9600)')
     parser.add_argument('--test', '-t', default='all', 
-                       choices=['all', 'loopback', 'pattern', 'modbus', 'stress'],
+                       choices=['all', 'loopback', 'pattern', 'modbus', 'stress', 'trace', 'diag'],
                        help='测试类型 (默认: all)')
     parser.add_argument('--timeout', type=float, default=1.0, help='超时时间(秒) (默认: 1.0)')
+    parser.add_argument('--slave', type=lambda x: int(x, 0), default=0x01, help='trace/diag 测试的从站地址 (默认: 1)')
     
     args = parser.parse_args()
     
@@ -420,6 +526,10 @@ def main():
             tester.test_modbus_write()
         elif args.test == 'stress':
             tester.test_stress()
+        elif args.test == 'trace':
+            tester.dump_trace(args.slave)
+        elif args.test == 'diag':
+            tester.dump_diag(args.slave)
         
     except KeyboardInterrupt:
         print(f"\n{Fore.YELLOW}测试被用户中断")